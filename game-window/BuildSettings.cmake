@@ -3,4 +3,6 @@ if (APPLE)
     set(GAMEWINDOW_SYSTEM_DEFAULT GLFW)
 endif()
 
-set(GAMEWINDOW_SYSTEM ${GAMEWINDOW_SYSTEM_DEFAULT} CACHE STRING "The implementation to use for windows - EGLUT or GLFW")
\ No newline at end of file
+set(GAMEWINDOW_SYSTEM ${GAMEWINDOW_SYSTEM_DEFAULT} CACHE STRING "The implementation to use for windows - EGLUT or GLFW")
+
+option(GAMEWINDOW_HEADLESS "Build the offscreen EGL window system, selected at runtime with GAMEWINDOW_SYSTEM_HEADLESS=1" OFF)
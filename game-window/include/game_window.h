@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
 #include <functional>
 #include <vector>
@@ -68,6 +69,7 @@ public:
     using GamepadButtonCallback = std::function<void(int, GamepadButtonId, bool)>;
     using GamepadAxisCallback = std::function<void(int, GamepadAxisId, float)>;
     using CloseCallback = std::function<void()>;
+    using FocusCallback = std::function<void(bool)>;
 
 private:
     DrawCallback drawCallback;
@@ -86,6 +88,9 @@ private:
     GamepadButtonCallback gamepadButtonCallback;
     GamepadAxisCallback gamepadAxisCallback;
     CloseCallback closeCallback;
+    FocusCallback focusCallback;
+
+    int64_t gamepadEventTime = 0;
 
 public:
     GameWindow(std::string const& title, int width, int height, GraphicsApi api) {}
@@ -170,8 +175,13 @@ public:
 
     void setGamepadAxisCallback(GamepadAxisCallback callback) { gamepadAxisCallback = std::move(callback); }
 
+    // CLOCK_MONOTONIC time in nanoseconds the gamepad event being dispatched was read at, 0 if unknown
+    int64_t getGamepadEventTime() const { return gamepadEventTime; }
+
     void setCloseCallback(CloseCallback callback) { closeCallback = std::move(callback); }
 
+    void setFocusCallback(FocusCallback callback) { focusCallback = std::move(callback); }
+
 protected:
     void onDraw() {
         if(drawCallback != nullptr)
@@ -230,16 +240,25 @@ protected:
         if(gamepadStateCallback != nullptr)
             gamepadStateCallback(id, connected);
     }
-    void onGamepadButton(int id, GamepadButtonId btn, bool pressed) {
+    // eventTime is the CLOCK_MONOTONIC time in nanoseconds the event was read at if known, see getGamepadEventTime
+    void onGamepadButton(int id, GamepadButtonId btn, bool pressed, int64_t eventTime = 0) {
+        gamepadEventTime = eventTime;
         if(gamepadButtonCallback != nullptr && btn != GamepadButtonId::UNKNOWN)
             gamepadButtonCallback(id, btn, pressed);
+        gamepadEventTime = 0;
     }
-    void onGamepadAxis(int id, GamepadAxisId axis, float val) {
+    void onGamepadAxis(int id, GamepadAxisId axis, float val, int64_t eventTime = 0) {
+        gamepadEventTime = eventTime;
         if(gamepadAxisCallback != nullptr && axis != GamepadAxisId::UNKNOWN)
             gamepadAxisCallback(id, axis, val);
+        gamepadEventTime = 0;
     }
     void onClose() {
         if(closeCallback != nullptr)
             closeCallback();
     }
+    void onFocusChanged(bool focused) {
+        if(focusCallback != nullptr)
+            focusCallback(focused);
+    }
 };
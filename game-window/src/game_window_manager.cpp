@@ -1,9 +1,18 @@
 #include <game_window_manager.h>
+#ifdef GAMEWINDOW_HEADLESS
+#include "window_manager_headless.h"
+#endif
 
 std::shared_ptr<GameWindowManager> GameWindowManager::instance;
 
 std::shared_ptr<GameWindowManager> GameWindowManager::getManager() {
-    if (!instance)
-        instance = createManager();
+    if (!instance) {
+#ifdef GAMEWINDOW_HEADLESS
+        if (HeadlessWindowManager::isRequested())
+            instance = std::make_shared<HeadlessWindowManager>();
+#endif
+        if (!instance)
+            instance = createManager();
+    }
     return instance;
 }
\ No newline at end of file
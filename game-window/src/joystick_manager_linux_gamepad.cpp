@@ -1,5 +1,6 @@
 #include "joystick_manager_linux_gamepad.h"
 
+#include <cstdlib>
 #include <fstream>
 #include <gamepad/joystick_manager_factory.h>
 #include <gamepad/joystick.h>
@@ -25,6 +26,7 @@ LinuxGamepadJoystickManager::LinuxGamepadJoystickManager() : joystickManager(gam
 void LinuxGamepadJoystickManager::initialize() {
     if (!initialized) {
         initialized = true;
+        joystickManager->setUseInputThread(getenv("GAMEWINDOW_GAMEPAD_INPUT_THREAD") != nullptr);
         joystickManager->initialize();
     }
 }
@@ -133,12 +135,12 @@ void LinuxGamepadJoystickManager::warnOnMissingGamePadMapping(gamepad::Gamepad*
 
 void LinuxGamepadJoystickManager::onGamepadButton(gamepad::Gamepad* gp, gamepad::GamepadButton btn, bool state) {
     if (focusedWindow != nullptr)
-        focusedWindow->onGamepadButton(gp->getIndex(), mapButtonId(btn), state);
+        focusedWindow->onGamepadButton(gp->getIndex(), mapButtonId(btn), state, (int64_t) joystickManager->getCurrentEventTime());
 }
 
 void LinuxGamepadJoystickManager::onGamepadAxis(gamepad::Gamepad* gp, gamepad::GamepadAxis axis, float value) {
     if (focusedWindow != nullptr)
-        focusedWindow->onGamepadAxis(gp->getIndex(), mapAxisId(axis), value);
+        focusedWindow->onGamepadAxis(gp->getIndex(), mapAxisId(axis), value, (int64_t) joystickManager->getCurrentEventTime());
 }
 
 GamepadButtonId LinuxGamepadJoystickManager::mapButtonId(gamepad::GamepadButton id) {
@@ -0,0 +1,197 @@
+#include "window_headless.h"
+
+#include <EGL/eglext.h>
+#ifdef HAS_LIBPNG
+#include <png.h>
+#endif
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+
+static long long ReadEnvInt(const char* name, long long def = 0) {
+    auto val = getenv(name);
+    if(!val) {
+        return def;
+    }
+    return atoll(val);
+}
+
+#ifdef HAS_LIBPNG
+static bool writePng(std::string const& path, int width, int height, std::vector<unsigned char> const& rgba) {
+    FILE* file = fopen(path.c_str(), "wb");
+    if(!file)
+        return false;
+    png_struct* png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+    png_info* info_ptr = png_ptr ? png_create_info_struct(png_ptr) : nullptr;
+    if(!png_ptr || !info_ptr || setjmp(png_jmpbuf(png_ptr))) {
+        png_destroy_write_struct(&png_ptr, info_ptr ? &info_ptr : nullptr);
+        fclose(file);
+        remove(path.c_str());
+        return false;
+    }
+    png_init_io(png_ptr, file);
+    png_set_IHDR(png_ptr, info_ptr, width, height, 8, PNG_COLOR_TYPE_RGBA, PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+    png_write_info(png_ptr, info_ptr);
+    // glReadPixels returns the bottom row first
+    for(int y = height - 1; y >= 0; --y)
+        png_write_row(png_ptr, (png_const_bytep)&rgba[(size_t)y * width * 4]);
+    png_write_end(png_ptr, nullptr);
+    png_destroy_write_struct(&png_ptr, &info_ptr);
+    return fclose(file) == 0;
+}
+#endif
+
+EGLDisplay HeadlessWindow::openDisplay() {
+    EGLint major, minor;
+    const char* extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    if(extensions && strstr(extensions, "EGL_MESA_platform_surfaceless")) {
+        auto getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+        if(getPlatformDisplay) {
+            EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+            if(display != EGL_NO_DISPLAY && eglInitialize(display, &major, &minor))
+                return display;
+        }
+    }
+    EGLDisplay display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if(display != EGL_NO_DISPLAY && eglInitialize(display, &major, &minor))
+        return display;
+    return EGL_NO_DISPLAY;
+}
+
+HeadlessWindow::HeadlessWindow(const std::string& title, int width, int height, GraphicsApi api) : GameWindow(title, width, height, api), width(width), height(height) {
+    display = openDisplay();
+    if(display == EGL_NO_DISPLAY)
+        throw std::runtime_error("Headless: failed to initialize an EGL display");
+
+    EGLint configAttribs[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, api == GraphicsApi::OPENGL ? EGL_OPENGL_BIT : EGL_OPENGL_ES2_BIT,
+        EGL_RED_SIZE, 8,
+        EGL_GREEN_SIZE, 8,
+        EGL_BLUE_SIZE, 8,
+        EGL_ALPHA_SIZE, 8,
+        EGL_DEPTH_SIZE, 24,
+        EGL_STENCIL_SIZE, 8,
+        EGL_NONE};
+    EGLConfig config;
+    EGLint numConfigs = 0;
+    if(!eglChooseConfig(display, configAttribs, &config, 1, &numConfigs) || numConfigs == 0) {
+        eglTerminate(display);
+        throw std::runtime_error("Headless: no EGL config with pbuffer support");
+    }
+
+    EGLint contextAttribs[] = {EGL_CONTEXT_CLIENT_VERSION, 2, EGL_NONE};
+    eglBindAPI(api == GraphicsApi::OPENGL ? EGL_OPENGL_API : EGL_OPENGL_ES_API);
+    context = eglCreateContext(display, config, EGL_NO_CONTEXT, api == GraphicsApi::OPENGL ? nullptr : contextAttribs);
+    EGLint surfaceAttribs[] = {EGL_WIDTH, width, EGL_HEIGHT, height, EGL_NONE};
+    if(context != EGL_NO_CONTEXT)
+        surface = eglCreatePbufferSurface(display, config, surfaceAttribs);
+    if(context == EGL_NO_CONTEXT || surface == EGL_NO_SURFACE) {
+        if(context != EGL_NO_CONTEXT)
+            eglDestroyContext(display, context);
+        eglTerminate(display);
+        throw std::runtime_error("Headless: failed to create the EGL context or pbuffer");
+    }
+
+    frameLimit = ReadEnvInt("GAMEWINDOW_HEADLESS_FRAMES");
+    captureInterval = ReadEnvInt("GAMEWINDOW_HEADLESS_CAPTURE_INTERVAL");
+#ifndef HAS_LIBPNG
+    if(captureInterval > 0) {
+        printf("Headless: built without libpng, frame capture is disabled\n");
+        captureInterval = 0;
+    }
+#endif
+    auto dir = getenv("GAMEWINDOW_HEADLESS_CAPTURE_DIR");
+    captureDir = dir ? dir : ".";
+    if(!captureDir.empty() && captureDir.back() != '/')
+        captureDir += '/';
+    glReadPixels = (decltype(glReadPixels))eglGetProcAddress("glReadPixels");
+
+    printf("Headless: %dx%d pbuffer on %s\n", width, height, eglQueryString(display, EGL_VENDOR));
+}
+
+HeadlessWindow::~HeadlessWindow() {
+    if(display == EGL_NO_DISPLAY)
+        return;
+    eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroySurface(display, surface);
+    eglDestroyContext(display, context);
+    eglTerminate(display);
+}
+
+void HeadlessWindow::makeCurrent(bool active) {
+    if(active)
+        eglMakeCurrent(display, surface, surface, context);
+    else
+        eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+}
+
+void HeadlessWindow::show() {
+    // There is no window system to report these, so announce the virtual window once
+    onWindowSizeChanged(width, height);
+    onFocusChanged(true);
+}
+
+void HeadlessWindow::close() {
+    if(closed)
+        return;
+    closed = true;
+    onClose();
+}
+
+void HeadlessWindow::pollEvents() {
+    if(closeRequested)
+        close();
+}
+
+bool HeadlessWindow::getCursorDisabled() {
+    return cursorDisabled;
+}
+
+void HeadlessWindow::setCursorDisabled(bool disabled) {
+    cursorDisabled = disabled;
+}
+
+bool HeadlessWindow::getFullscreen() {
+    return fullscreen;
+}
+
+void HeadlessWindow::setFullscreen(bool fullscreen) {
+    this->fullscreen = fullscreen;
+}
+
+void HeadlessWindow::getWindowSize(int& width, int& height) const {
+    width = this->width;
+    height = this->height;
+}
+
+void HeadlessWindow::captureFrame() {
+    std::vector<unsigned char> pixels((size_t)width * height * 4);
+    glReadPixels(0, 0, width, height, 0x1908 /* GL_RGBA */, 0x1401 /* GL_UNSIGNED_BYTE */, pixels.data());
+    char name[32];
+    snprintf(name, sizeof(name), "frame-%06lld.png", frame);
+#ifdef HAS_LIBPNG
+    if(!writePng(captureDir + name, width, height, pixels))
+        printf("Headless: failed to write %s%s\n", captureDir.c_str(), name);
+#endif
+}
+
+void HeadlessWindow::swapBuffers() {
+    frame++;
+    // Read back before the swap, the back buffer is undefined afterwards
+    if(captureInterval > 0 && glReadPixels && frame % captureInterval == 0)
+        captureFrame();
+    eglSwapBuffers(display, surface);
+    if(frameLimit > 0 && frame >= frameLimit)
+        closeRequested = true;
+}
+
+void HeadlessWindow::setSwapInterval(int interval) {
+    eglSwapInterval(display, interval);
+}
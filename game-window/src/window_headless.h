@@ -0,0 +1,62 @@
+#pragma once
+
+#include <game_window.h>
+#include <EGL/egl.h>
+#include <atomic>
+
+// Offscreen window rendering into an EGL pbuffer, works without a display server (e.g. Mesa llvmpipe)
+class HeadlessWindow : public GameWindow {
+private:
+    int width, height;
+    bool cursorDisabled = false;
+    bool fullscreen = false;
+
+    EGLDisplay display = EGL_NO_DISPLAY;
+    EGLContext context = EGL_NO_CONTEXT;
+    EGLSurface surface = EGL_NO_SURFACE;
+
+    // GAMEWINDOW_HEADLESS_FRAMES, closes the window after this many frames
+    long long frameLimit = 0;
+    // GAMEWINDOW_HEADLESS_CAPTURE_INTERVAL and GAMEWINDOW_HEADLESS_CAPTURE_DIR, writes every n-th frame as PNG
+    long long captureInterval = 0;
+    std::string captureDir;
+    long long frame = 0;
+    std::atomic<bool> closeRequested = {false};
+    bool closed = false;
+
+    void (*glReadPixels)(int x, int y, int width, int height, unsigned int format, unsigned int type, void* pixels) = nullptr;
+
+    static EGLDisplay openDisplay();
+    void captureFrame();
+
+public:
+    HeadlessWindow(const std::string& title, int width, int height, GraphicsApi api);
+
+    ~HeadlessWindow() override;
+
+    void setIcon(std::string const& iconPath) override {}
+
+    void makeCurrent(bool active) override;
+
+    void show() override;
+
+    void close() override;
+
+    void pollEvents() override;
+
+    bool getCursorDisabled() override;
+
+    void setCursorDisabled(bool disabled) override;
+
+    bool getFullscreen() override;
+
+    void setFullscreen(bool fullscreen) override;
+
+    void getWindowSize(int& width, int& height) const override;
+
+    void setClipboardText(std::string const& text) override {}
+
+    void swapBuffers() override;
+
+    void setSwapInterval(int interval) override;
+};
@@ -0,0 +1,30 @@
+#include "window_manager_headless.h"
+#include "window_headless.h"
+
+static bool ReadEnvFlag(const char* name, bool def = false) {
+    auto val = getenv(name);
+    if(!val) {
+        return def;
+    }
+    std::string sval = val;
+    return sval == "true" || sval == "1" || sval == "on";
+}
+
+bool HeadlessWindowManager::isRequested() {
+    return ReadEnvFlag("GAMEWINDOW_SYSTEM_HEADLESS");
+}
+
+GameWindowManager::ProcAddrFunc HeadlessWindowManager::getProcAddrFunc() {
+    return (GameWindowManager::ProcAddrFunc) eglGetProcAddress;
+}
+
+std::shared_ptr<GameWindow> HeadlessWindowManager::createWindow(const std::string& title, int width, int height,
+                                                             GraphicsApi api) {
+    return std::shared_ptr<GameWindow>(new HeadlessWindow(title, width, height, api));
+}
+
+void HeadlessWindowManager::addGamepadMappingFile(const std::string &path) {
+}
+
+void HeadlessWindowManager::addGamePadMapping(const std::string &content) {
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "game_window_manager.h"
+
+class HeadlessWindowManager : public GameWindowManager {
+
+public:
+    // GAMEWINDOW_SYSTEM_HEADLESS replaces the window system of the build at runtime
+    static bool isRequested();
+
+    ProcAddrFunc getProcAddrFunc() override;
+
+    std::shared_ptr<GameWindow> createWindow(const std::string& title, int width, int height, GraphicsApi api) override;
+
+    void addGamepadMappingFile(const std::string& path) override;
+
+    void addGamePadMapping(const std::string &content) override;
+};
@@ -316,6 +316,7 @@ void SDL3GameWindow::pollEvents() {
             setRelativeScale();
             break;
         case SDL_EVENT_WINDOW_FOCUS_GAINED:
+            onFocusChanged(true);
             if(cursorDisabled) {
                 float x, y;
                 SDL_GetGlobalMouseState(&x, &y);
@@ -327,6 +328,7 @@ void SDL3GameWindow::pollEvents() {
             }
             break;
         case SDL_EVENT_WINDOW_FOCUS_LOST:
+            onFocusChanged(false);
             if(cursorDisabled) {
                 SDL_SetWindowRelativeMouseMode(window, false);
                 SDL_SetWindowMouseRect(window, NULL);
@@ -27,5 +27,20 @@ namespace shim {
     // Rewrite filesystem access
     extern std::vector<std::pair<std::string, std::string>> rewrite_filesystem_access;
 
+    // Maximum number of stat results cached for paths below the rewritten directories, 0 disables the cache (linux only)
+    extern size_t stat_cache_size;
+
+    // Serve REALTIME / MONOTONIC clock_gettime and gettimeofday from the tick based coarse clocks (~1-4ms resolution)
+    extern bool use_coarse_clocks;
+
+    // Android system properties served to the game, updating an existing property bumps its serial
+    void set_system_property(std::string const &name, std::string const &value);
+    // Loads name=value lines ('#' starts a comment), returns false if the file couldn't be opened
+    bool load_system_properties(std::string const &path);
+
+    // Describes where the memcpy bound for the game resolved to (symbol or library offset), the host dispatch mechanism
+    // and the cpu features it selects by
+    std::string describe_string_routines();
+
     [[noreturn]] void handle_runtime_error(const char* fmt, ...);
 }
\ No newline at end of file
@@ -0,0 +1,117 @@
+#include "no-fortify.h"
+#include "clock.h"
+
+#include <sys/time.h>
+#ifdef __APPLE__
+#if __MAC_OS_X_VERSION_MIN_REQUIRED < 101200
+// for macOS 10.10 - 10.11
+#include <mach/clock.h>
+#include <mach/mach.h>
+#endif
+#endif
+
+using namespace shim;
+
+bool shim::use_coarse_clocks = false;
+
+namespace {
+
+    using clock_table = clockid_t[bionic::clock_table_size];
+
+    /*
+     * Indexed by the bionic clock id. On linux the ids match the host, the precise table is the identity and the
+     * coarse one redirects REALTIME / MONOTONIC to the tick based variants which skip reading the TSC in the vDSO.
+     */
+#if defined(__APPLE__)
+    /*
+     * CLOCK_MONOTONIC_RAW_APPROX doesn't count while the system sleeps, unlike CLOCK_MONOTONIC. The MONOTONIC,
+     * MONOTONIC_COARSE and BOOTTIME ids therefore share one host clock in each table, so that timestamps taken through
+     * any of them can be compared.
+     */
+    constexpr clockid_t invalid_clock = (clockid_t) -1;
+    constexpr clock_table precise_clocks = {
+        CLOCK_REALTIME, CLOCK_MONOTONIC, CLOCK_PROCESS_CPUTIME_ID, CLOCK_THREAD_CPUTIME_ID, CLOCK_MONOTONIC_RAW,
+        CLOCK_REALTIME, CLOCK_MONOTONIC, CLOCK_MONOTONIC, CLOCK_REALTIME, CLOCK_MONOTONIC,
+        invalid_clock, invalid_clock, invalid_clock, invalid_clock, invalid_clock, invalid_clock
+    };
+    constexpr clock_table coarse_clocks = {
+        CLOCK_REALTIME, CLOCK_MONOTONIC_RAW_APPROX, CLOCK_PROCESS_CPUTIME_ID, CLOCK_THREAD_CPUTIME_ID, CLOCK_MONOTONIC_RAW,
+        CLOCK_REALTIME, CLOCK_MONOTONIC_RAW_APPROX, CLOCK_MONOTONIC_RAW_APPROX, CLOCK_REALTIME, CLOCK_MONOTONIC_RAW_APPROX,
+        invalid_clock, invalid_clock, invalid_clock, invalid_clock, invalid_clock, invalid_clock
+    };
+#elif defined(__FreeBSD__)
+    /*
+     * Like on macOS, BOOTTIME and BOOTTIME_ALARM use the MONOTONIC clock of each table instead of CLOCK_UPTIME, so the
+     * coarse table never mixes precise and _FAST reads of the monotonic clocks.
+     */
+    constexpr clockid_t invalid_clock = (clockid_t) -1;
+    constexpr clock_table precise_clocks = {
+        CLOCK_REALTIME, CLOCK_MONOTONIC, CLOCK_PROCESS_CPUTIME_ID, CLOCK_THREAD_CPUTIME_ID, CLOCK_MONOTONIC_PRECISE,
+        CLOCK_REALTIME_FAST, CLOCK_MONOTONIC_FAST, CLOCK_MONOTONIC, CLOCK_REALTIME, CLOCK_MONOTONIC,
+        invalid_clock, invalid_clock, invalid_clock, invalid_clock, invalid_clock, invalid_clock
+    };
+    constexpr clock_table coarse_clocks = {
+        CLOCK_REALTIME_FAST, CLOCK_MONOTONIC_FAST, CLOCK_PROCESS_CPUTIME_ID, CLOCK_THREAD_CPUTIME_ID, CLOCK_MONOTONIC_PRECISE,
+        CLOCK_REALTIME_FAST, CLOCK_MONOTONIC_FAST, CLOCK_MONOTONIC_FAST, CLOCK_REALTIME_FAST, CLOCK_MONOTONIC_FAST,
+        invalid_clock, invalid_clock, invalid_clock, invalid_clock, invalid_clock, invalid_clock
+    };
+#else
+    constexpr clock_table precise_clocks = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
+    constexpr clock_table coarse_clocks = {
+        CLOCK_REALTIME_COARSE, CLOCK_MONOTONIC_COARSE, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15
+    };
+#endif
+
+    inline clockid_t to_host_clock(bionic::clock_type clock) {
+        auto id = (uint32_t) clock;
+        const clockid_t *table = use_coarse_clocks ? coarse_clocks : precise_clocks;
+        return id < bionic::clock_table_size ? table[id] : (clockid_t) id;
+    }
+
+}
+
+clockid_t bionic::to_host_clock_type(bionic::clock_type type) {
+    auto id = (uint32_t) type;
+    return id < clock_table_size ? precise_clocks[id] : (clockid_t) id;
+}
+
+int shim::clock_gettime(bionic::clock_type clock, struct timespec *ts) {
+#if defined(__APPLE__) && __MAC_OS_X_VERSION_MIN_REQUIRED < 101200
+    if(::clock_gettime != NULL) {
+#endif
+    return ::clock_gettime(to_host_clock(clock), ts);
+#if defined(__APPLE__) && __MAC_OS_X_VERSION_MIN_REQUIRED < 101200
+    } else {
+        // fallback if weak symbol is nullptr < macOS 10.12
+        clock_serv_t cclock;
+        mach_timespec_t mts;
+        if (host_get_clock_service(mach_host_self(), clock == bionic::clock_type::MONOTONIC ? SYSTEM_CLOCK : CALENDAR_CLOCK, &cclock) != KERN_SUCCESS) {
+            return -1;
+        }
+        kern_return_t r = clock_get_time(cclock, &mts);
+        mach_port_deallocate(mach_task_self(), cclock);
+        if (r != KERN_SUCCESS) {
+            return -1;
+        }
+        ts->tv_sec = mts.tv_sec;
+        ts->tv_nsec = mts.tv_nsec;
+        return 0;
+    }
+#endif
+}
+
+int shim::clock_getres(bionic::clock_type clock, struct timespec *ts) {
+    return ::clock_getres(to_host_clock(clock), ts);
+}
+
+int shim::gettimeofday(bionic::timeval *tv, void *p) {
+    if (p)
+        handle_runtime_error("gettimeofday adtimezone is not supported");
+    if (!tv)
+        return 0;
+    timespec ts {};
+    int ret = shim::clock_gettime(bionic::clock_type::REALTIME, &ts);
+    tv->tv_sec = ts.tv_sec;
+    tv->tv_usec = ts.tv_nsec / 1000;
+    return ret;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <libc_shim.h>
+#include <ctime>
+#include "common.h"
+
+namespace shim {
+
+    namespace bionic {
+
+        // Size of the clock id translation tables, ids past the known ones are dynamic cpu clocks
+        constexpr uint32_t clock_table_size = 16;
+
+        // Host clock of a bionic clock id, ignoring use_coarse_clocks, e.g. for pthread_condattr_setclock
+        clockid_t to_host_clock_type(clock_type type);
+
+    }
+
+    int clock_gettime(bionic::clock_type clock, struct timespec *ts);
+
+    int clock_getres(bionic::clock_type clock, struct timespec *ts);
+
+    int gettimeofday(bionic::timeval *tv, void *p);
+
+}
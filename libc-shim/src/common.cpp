@@ -16,6 +16,7 @@
 #include "sysconf.h"
 #include "system_properties.h"
 #include "sched.h"
+#include "clock.h"
 #include <cmath>
 #include <unistd.h>
 #include <sys/time.h>
@@ -53,13 +54,6 @@
 #else
 #include <xlocale.h>
 #endif
-#ifdef __APPLE__
-#if __MAC_OS_X_VERSION_MIN_REQUIRED < 101200
-// for macOS 10.10 - 10.11
-#include <mach/clock.h>
-#include <mach/mach.h>
-#endif
-#endif
 #include <inttypes.h>
 #ifdef _WIN32
 #include <Processthreadsapi.h>
@@ -128,19 +122,6 @@ uintptr_t bionic::stack_chk_guard = []() {
 #endif
 }();
 
-clockid_t bionic::to_host_clock_type(bionic::clock_type type) {
-    switch (type) {
-        case clock_type::REALTIME: return CLOCK_REALTIME;
-        case clock_type::MONOTONIC: return CLOCK_MONOTONIC;
-#ifdef __APPLE__
-        case clock_type::BOOTTIME: return CLOCK_MONOTONIC;
-#else
-        case clock_type::BOOTTIME: return CLOCK_BOOTTIME;
-#endif
-        default: handle_runtime_error("Unexpected clock type %d", (int)type);
-    }
-}
-
 int bionic::to_host_mmap_flags(bionic::mmap_flags flags) {
     if (((uint32_t) flags & ~((uint32_t) mmap_flags::FIXED | (uint32_t) mmap_flags::ANON |
         (uint32_t) mmap_flags::NORESERVE | (uint32_t) mmap_flags::PRIVATE | (uint32_t) mmap_flags::SHARED)) != 0)
@@ -215,31 +196,6 @@ ssize_t shim::pwrite(int fd, const void *buf, size_t len, bionic::off_t off) {
 }
 #endif
 
-int shim::clock_gettime(bionic::clock_type clock, struct timespec *ts) {
-#if defined(__APPLE__) && __MAC_OS_X_VERSION_MIN_REQUIRED < 101200
-    if(::clock_gettime != NULL) {
-#endif
-    return ::clock_gettime(bionic::to_host_clock_type(clock), ts);
-#if defined(__APPLE__) && __MAC_OS_X_VERSION_MIN_REQUIRED < 101200
-    } else {
-        // fallback if weak symbol is nullptr < macOS 10.12
-        clock_serv_t cclock;
-        mach_timespec_t mts;
-        if (host_get_clock_service(mach_host_self(), clock == bionic::clock_type::MONOTONIC ? SYSTEM_CLOCK : CALENDAR_CLOCK, &cclock) != KERN_SUCCESS) {
-            return -1;
-        }
-        kern_return_t r = clock_get_time(cclock, &mts);
-        mach_port_deallocate(mach_task_self(), cclock);
-        if (r != KERN_SUCCESS) {
-            return -1;
-        }
-        ts->tv_sec = mts.tv_sec;
-        ts->tv_nsec = mts.tv_nsec;
-        return 0;
-    }
-#endif
-}
-
 bionic::mallinfo shim::mallinfo() {
     return { .ordblks = 8000000, .usmblks= 8000000, .fordblks= 8000000 };
 }
@@ -358,16 +314,6 @@ size_t shim::ctype_get_mb_cur_max() {
     return MB_CUR_MAX;
 }
 
-int shim::gettimeofday(bionic::timeval *tv, void *p) {
-    if (p)
-        handle_runtime_error("gettimeofday adtimezone is not supported");
-    timeval htv {};
-    int ret = ::gettimeofday(&htv, nullptr);
-    tv->tv_sec = htv.tv_sec;
-    tv->tv_usec = htv.tv_usec;
-    return ret;
-}
-
 ssize_t shim::__read_chk(int fd, void *buf, size_t count, size_t buf_size) {
     return read(fd, buf, count);
 }
@@ -680,6 +626,7 @@ void shim::add_time_shimmed_symbols(std::vector<shim::shimmed_symbol> &list) {
         {"timezone", &::timezone},
         {"nanosleep", ::nanosleep},
         {"clock_gettime", clock_gettime},
+        {"clock_getres", clock_getres},
     });
 }
 
@@ -16,11 +16,16 @@ namespace shim {
         enum class clock_type : uint32_t {
             REALTIME = 0,
             MONOTONIC = 1,
-            BOOTTIME = 7
+            PROCESS_CPUTIME_ID = 2,
+            THREAD_CPUTIME_ID = 3,
+            MONOTONIC_RAW = 4,
+            REALTIME_COARSE = 5,
+            MONOTONIC_COARSE = 6,
+            BOOTTIME = 7,
+            REALTIME_ALARM = 8,
+            BOOTTIME_ALARM = 9
         };
 
-        clockid_t to_host_clock_type(clock_type type);
-
         enum class mmap_flags : int {
             SHARED = 1,
             PRIVATE = 2,
@@ -96,8 +101,6 @@ namespace shim {
 
     int getrlimit(bionic::rlimit_resource res, bionic::rlimit *info);
 
-    int clock_gettime(bionic::clock_type clock, struct timespec *ts);
-
     int prctl(bionic::prctl_num opt, unsigned long a2, unsigned long a3, unsigned long a4, unsigned long a5);
 
     int sendfile(int src, int dst, bionic::off_t *offset, size_t count);
@@ -122,8 +125,6 @@ namespace shim {
 
     size_t ctype_get_mb_cur_max();
 
-    int gettimeofday(bionic::timeval *tv, void *p);
-
     ssize_t __read_chk(int fd, void* buf, size_t count, size_t buf_size);
 
     ssize_t __recvfrom_chk(int socket, void* buf, size_t len, size_t buf_size,
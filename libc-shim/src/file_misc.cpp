@@ -12,6 +12,11 @@
 #include <string.h>
 #include <sys/epoll.h>
 #include <sys/eventfd.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
 #include "network.h"
 #include "errno.h"
 #include "iorewrite.h"
@@ -189,35 +194,179 @@ int shim::fcntl(int fd, bionic::fcntl_index cmd, void *arg) {
     }
 }
 
-int shim::poll_via_select(pollfd *fds, nfds_t nfds, int timeout) {
-    // Mac OS has a broken poll implementation
-    struct timeval t;
-    t.tv_sec = timeout / 1000;
-    t.tv_usec = (timeout % 1000) * 1000;
-
-    fd_set r_fdset, w_fdset, e_fdset;
-    int maxfd = 0;
-    FD_ZERO(&r_fdset);
-    FD_ZERO(&w_fdset);
-    FD_ZERO(&e_fdset);
-    for (nfds_t i = 0; i < nfds; i++) {
-        if (fds[i].fd > maxfd)
-            maxfd = fds[i].fd;
-        if (fds[i].events & POLLIN || fds[i].events & POLLPRI)
-            FD_SET(fds[i].fd, &r_fdset);
-        if (fds[i].events & POLLOUT)
-            FD_SET(fds[i].fd, &w_fdset);
-        FD_SET(fds[i].fd, &e_fdset);
+namespace {
+
+    struct poll_interest {
+        uint32_t epoch = 0;
+        uint32_t wanted = 0;
+        // Stored in the upper half of the epoll data, events of a registration left behind by a closed fd don't match
+        uint32_t token = 0;
+        bool is_registered = false;
+        // epoll rejected the fd with EPERM, it's identified by device and inode until its number is reused
+        bool is_file = false;
+        dev_t file_dev = 0;
+        ino_t file_ino = 0;
+        nfds_t index = 0;
+    };
+
+    struct poll_state {
+        int epfd = -1;
+        uint32_t epoch = 0;
+        uint32_t next_token = 0;
+        std::unordered_map<int, poll_interest> interest;
+        std::vector<epoll_event> events;
+
+        ~poll_state() {
+            if (epfd >= 0)
+                ::close(epfd);
+        }
+
+        // Drops registrations that can't be addressed anymore, the fd number now refers to a different file
+        void reset() {
+            ::close(epfd);
+            epfd = -1;
+            interest.clear();
+        }
+    };
+
+    thread_local poll_state poll_thread_state;
+
+    uint32_t poll_to_epoll_events(short events) {
+        uint32_t ret = 0;
+        if (events & POLLIN) ret |= EPOLLIN;
+        if (events & POLLPRI) ret |= EPOLLPRI;
+        if (events & POLLOUT) ret |= EPOLLOUT;
+        return ret;
+    }
+
+    short epoll_to_poll_events(uint32_t events) {
+        short ret = 0;
+        if (events & EPOLLIN) ret |= POLLIN;
+        if (events & EPOLLPRI) ret |= POLLPRI;
+        if (events & EPOLLOUT) ret |= POLLOUT;
+        if (events & EPOLLERR) ret |= POLLERR;
+        if (events & EPOLLHUP) ret |= POLLHUP;
+        return ret;
+    }
+
+}
+
+int shim::poll_via_epoll(pollfd *fds, nfds_t nfds, int timeout) {
+    // Mac OS has a broken poll implementation, emulate it on top of a per thread epoll instance which keeps the
+    // interest set of the previous call, so fds polled again aren't added and removed every time
+    auto &st = poll_thread_state;
+    if (st.epfd < 0) {
+        st.epfd = epoll_create1(EPOLL_CLOEXEC);
+        if (st.epfd < 0)
+            return -1;
     }
-    int ret = select(maxfd + 1, &r_fdset, &w_fdset, &e_fdset, &t);
+    uint32_t epoch = ++st.epoch;
+    size_t touched = 0;
+    int immediate = 0;
+    bool duplicates = false;
     for (nfds_t i = 0; i < nfds; i++) {
         fds[i].revents = 0;
-        if (FD_ISSET(fds[i].fd, &r_fdset))
-            fds[i].revents |= POLLIN;
-        if (FD_ISSET(fds[i].fd, &w_fdset))
-            fds[i].revents |= POLLOUT;
-        if (FD_ISSET(fds[i].fd, &e_fdset))
-            fds[i].revents |= POLLERR;
+        if (fds[i].fd < 0)
+            continue;
+        auto &e = st.interest[fds[i].fd];
+        uint32_t events = poll_to_epoll_events(fds[i].events);
+        if (e.epoch == epoch) {
+            duplicates = true;
+            events |= e.wanted;
+        } else {
+            e.epoch = epoch;
+            e.index = i;
+            touched++;
+        }
+        e.wanted = events;
+        if (e.is_file) {
+            struct ::stat st_file;
+            if (::fstat(fds[i].fd, &st_file) == 0 && st_file.st_dev == e.file_dev && st_file.st_ino == e.file_ino) {
+                fds[i].revents = fds[i].events & (POLLIN | POLLOUT);
+                if (fds[i].revents)
+                    immediate++;
+                continue;
+            }
+            e.is_file = false;
+        }
+        epoll_event ev {};
+        ev.events = events;
+        int ret = -1;
+        // The fd may have been closed and its number reused without going through the shim (fclose, dup3,
+        // close_range, the host side), then the registration belongs to the old file and MOD fails with ENOENT
+        if (e.is_registered) {
+            ev.data.u64 = ((uint64_t) e.token << 32) | (uint32_t) fds[i].fd;
+            ret = epoll_ctl(st.epfd, EPOLL_CTL_MOD, fds[i].fd, &ev);
+        }
+        if (ret < 0) {
+            e.token = ++st.next_token;
+            ev.data.u64 = ((uint64_t) e.token << 32) | (uint32_t) fds[i].fd;
+            ret = epoll_ctl(st.epfd, EPOLL_CTL_ADD, fds[i].fd, &ev);
+            if (ret < 0 && errno == EEXIST)
+                ret = epoll_ctl(st.epfd, EPOLL_CTL_MOD, fds[i].fd, &ev);
+        }
+        e.is_registered = ret == 0;
+        if (ret == 0)
+            continue;
+        struct ::stat st_file;
+        if (errno == EPERM && ::fstat(fds[i].fd, &st_file) == 0) {
+            // Regular files can't be used with epoll and are always ready
+            e.is_file = true;
+            e.file_dev = st_file.st_dev;
+            e.file_ino = st_file.st_ino;
+            fds[i].revents = fds[i].events & (POLLIN | POLLOUT);
+        } else {
+            fds[i].revents = POLLNVAL;
+        }
+        if (fds[i].revents)
+            immediate++;
+    }
+    if (st.interest.size() != touched) {
+        for (auto it = st.interest.begin(); it != st.interest.end(); ) {
+            if (it->second.epoch != epoch) {
+                if (it->second.is_registered)
+                    epoll_ctl(st.epfd, EPOLL_CTL_DEL, it->first, nullptr);
+                it = st.interest.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    st.events.resize(std::max<size_t>(touched, 1));
+    int n = epoll_wait(st.epfd, st.events.data(), (int) st.events.size(), immediate ? 0 : timeout);
+    if (n < 0)
+        return immediate ? immediate : -1;
+    int ret = immediate;
+    bool stale = false;
+    for (int j = 0; j < n; j++) {
+        int fd = (int) (uint32_t) st.events[j].data.u64;
+        auto it = st.interest.find(fd);
+        if (it == st.interest.end() || !it->second.is_registered || it->second.token != (uint32_t) (st.events[j].data.u64 >> 32)) {
+            stale = true;
+            continue;
+        }
+        short revents = epoll_to_poll_events(st.events[j].events);
+        if (!duplicates) {
+            auto &pfd = fds[it->second.index];
+            pfd.revents = revents & (pfd.events | POLLERR | POLLHUP);
+            if (pfd.revents)
+                ret++;
+            continue;
+        }
+        for (nfds_t i = it->second.index; i < nfds; i++) {
+            if (fds[i].fd != fd)
+                continue;
+            fds[i].revents = revents & (fds[i].events | POLLERR | POLLHUP);
+            if (fds[i].revents)
+                ret++;
+        }
+    }
+    if (stale) {
+        // A file still open through a dup keeps its old registration, which would wake up every call
+        st.reset();
+        if (ret == 0)
+            return poll_via_epoll(fds, nfds, timeout);
     }
     return ret;
 }
@@ -254,7 +403,7 @@ void shim::add_fcntl_shimmed_symbols(std::vector<shim::shimmed_symbol> &list) {
 void shim::add_poll_select_shimmed_symbols(std::vector<shim::shimmed_symbol> &list) {
     list.insert(list.end(), {
 #ifdef __APPLE__
-        {"poll", poll_via_select},
+        {"poll", WithErrnoUpdate(poll_via_epoll)},
 #else
         {"poll", WithErrnoUpdate(::poll)},
 #endif
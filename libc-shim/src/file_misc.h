@@ -63,7 +63,7 @@ namespace shim {
 
     int fcntl(int fd, bionic::fcntl_index cmd, void *arg);
 
-    int poll_via_select(pollfd *fds, nfds_t nfds, int timeout);
+    int poll_via_epoll(pollfd *fds, nfds_t nfds, int timeout);
 
     int __FD_ISSET_chk(int fd, fd_set *set);
     void __FD_CLR_chk(int fd, fd_set *set);
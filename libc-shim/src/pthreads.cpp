@@ -4,6 +4,7 @@
 #include <mutex>
 #include <signal.h>
 #include "pthreads.h"
+#include "clock.h"
 #include "errno.h"
 #ifdef __FreeBSD__
 #include <pthread_np.h>
@@ -8,7 +8,7 @@
 #include <mach/mach.h>
 #if __MAC_OS_X_VERSION_MIN_REQUIRED < 101200
 // for shim::clock_gettime 10.10 - 10.12
-#include "common.h"
+#include "clock.h"
 #endif
 #endif
 
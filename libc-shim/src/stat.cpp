@@ -1,6 +1,7 @@
 #include "no-fortify.h"
 #include "stat.h"
 #include "iorewrite.h"
+#include "stat_cache.h"
 
 using namespace shim;
 
@@ -26,8 +27,11 @@ void bionic::from_host(struct ::stat64 const &info, stat &result) {
 }
 
 int shim::stat(const char *path, bionic::stat *s) {
+    int ret;
+    if (stat_cache::query(path, true, s, ret))
+        return ret;
     struct ::stat64 tmp = {};
-    int ret = ::stat64(path, &tmp);
+    ret = ::stat64(path, &tmp);
     bionic::from_host(tmp, *s);
     return ret;
 }
@@ -40,8 +44,11 @@ int shim::fstat(int fd, shim::bionic::stat *s) {
 }
 
 int shim::lstat(const char *path, bionic::stat *s) {
+    int ret;
+    if (stat_cache::query(path, false, s, ret))
+        return ret;
     struct ::stat64 tmp = {};
-    int ret = ::lstat64(path, &tmp);
+    ret = ::lstat64(path, &tmp);
     bionic::from_host(tmp, *s);
     return ret;
 }
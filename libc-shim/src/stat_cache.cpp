@@ -0,0 +1,274 @@
+#include "no-fortify.h"
+#include "stat_cache.h"
+
+size_t shim::stat_cache_size = 0;
+
+#ifdef __linux__
+
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace shim;
+
+namespace {
+
+    constexpr uint32_t watch_mask = IN_ATTRIB | IN_MODIFY | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |
+                                    IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR;
+
+    struct cache_entry {
+        int ret;
+        bionic::stat st;
+        // Watches of every directory between the rewrite target and the path, innermost first, preceded by the watch of
+        // the path itself for directories
+        std::vector<int> wds;
+        std::list<std::string>::iterator lru;
+    };
+
+    struct cache_watch {
+        std::string dir;
+        size_t refs;
+    };
+
+    struct cache_state {
+        std::mutex mutex;
+        int fd = -1;
+        bool failed = false;
+        std::unordered_map<std::string, cache_entry> entries;
+        std::list<std::string> lru;
+        std::unordered_map<int, cache_watch> watches;
+        std::unordered_map<std::string, int> watch_by_dir;
+
+        bool init() {
+            if (fd >= 0)
+                return true;
+            if (failed)
+                return false;
+            fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+            failed = fd < 0;
+            return !failed;
+        }
+
+        int acquire_watch(std::string const &dir) {
+            auto it = watch_by_dir.find(dir);
+            if (it != watch_by_dir.end()) {
+                watches[it->second].refs++;
+                return it->second;
+            }
+            int wd = inotify_add_watch(fd, dir.c_str(), watch_mask);
+            if (wd < 0)
+                return -1;
+            // The same inode is already watched via a different path (bind mount, symlink), don't cache through it
+            if (watches.count(wd))
+                return -1;
+            watches[wd] = {dir, 1};
+            watch_by_dir[dir] = wd;
+            return wd;
+        }
+
+        void release_watch(int wd) {
+            auto it = watches.find(wd);
+            if (it == watches.end() || --it->second.refs > 0)
+                return;
+            inotify_rm_watch(fd, wd);
+            watch_by_dir.erase(it->second.dir);
+            watches.erase(it);
+        }
+
+        void erase(std::string const &path) {
+            auto it = entries.find(path);
+            if (it == entries.end())
+                return;
+            for (int wd : it->second.wds)
+                release_watch(wd);
+            lru.erase(it->second.lru);
+            entries.erase(it);
+        }
+
+        // Drops every entry resolved through dir, which the entries hold a watch on
+        void erase_below(std::string const &dir) {
+            if (!watch_by_dir.count(dir))
+                return;
+            std::vector<std::string> victims;
+            for (auto &&e : entries) {
+                if (e.first.size() > dir.size() && e.first[dir.size()] == '/' && !e.first.compare(0, dir.size(), dir))
+                    victims.push_back(e.first);
+            }
+            for (auto &&v : victims)
+                erase(v);
+        }
+
+        void clear() {
+            for (auto &&w : watches)
+                inotify_rm_watch(fd, w.first);
+            entries.clear();
+            lru.clear();
+            watches.clear();
+            watch_by_dir.clear();
+        }
+
+        void process_events() {
+            alignas(inotify_event) char buf[4096];
+            while (true) {
+                ssize_t len = ::read(fd, buf, sizeof(buf));
+                if (len <= 0)
+                    return;
+                for (char *ptr = buf; ptr < buf + len; ) {
+                    auto ev = (inotify_event *) ptr;
+                    ptr += sizeof(inotify_event) + ev->len;
+                    if (ev->mask & IN_Q_OVERFLOW) {
+                        clear();
+                        continue;
+                    }
+                    auto w = watches.find(ev->wd);
+                    if (w == watches.end())
+                        continue; // IN_IGNORED of a watch we removed ourselves
+                    // Renaming or deleting directories invalidates everything below them, and the kernel dropping a
+                    // watch means its directory went away
+                    if ((ev->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) ||
+                        ((ev->mask & IN_ISDIR) && (ev->mask & (IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO)))) {
+                        clear();
+                        continue;
+                    }
+                    std::string dir = w->second.dir;
+                    if (ev->len > 0 && ev->name[0]) {
+                        std::string name = dir + "/" + ev->name;
+                        // Replacing a symlink to a directory doesn't set IN_ISDIR, but the watch below it followed the
+                        // old target
+                        if (ev->mask & (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO))
+                            erase_below(name);
+                        erase(name);
+                    }
+                    // mtime / nlink of the directory itself changed as well
+                    erase(dir);
+                }
+            }
+        }
+    };
+
+    cache_state &state() {
+        static cache_state s;
+        return s;
+    }
+
+    // Returns the length of the rewrite target containing path, 0 if the path isn't eligible for caching
+    size_t find_cache_root(const char *path, size_t len) {
+        if (len < 2 || path[0] != '/' || path[len - 1] == '/')
+            return 0;
+        for (size_t i = 0; i + 1 < len; i++) {
+            if (path[i] == '/' && (path[i + 1] == '/' || (path[i + 1] == '.' && (i + 2 == len || path[i + 2] == '/' ||
+                    (path[i + 2] == '.' && (i + 3 == len || path[i + 3] == '/'))))))
+                return 0;
+        }
+        size_t best = 0;
+        for (auto &&kv : rewrite_filesystem_access) {
+            auto &root = kv.second;
+            size_t rlen = root.size();
+            while (rlen > 1 && root[rlen - 1] == '/')
+                rlen--;
+            if (rlen > best && rlen < len && path[rlen] == '/' && !memcmp(path, root.data(), rlen))
+                best = rlen;
+        }
+        return best;
+    }
+
+}
+
+bool shim::stat_cache::query(const char *path, bool follow_links, bionic::stat *s, int &ret) {
+    size_t max_entries = stat_cache_size;
+    if (max_entries == 0 || path == nullptr)
+        return false;
+    size_t len = strlen(path);
+    size_t root_len = find_cache_root(path, len);
+    if (root_len == 0)
+        return false;
+
+    auto &c = state();
+    std::lock_guard<std::mutex> lock (c.mutex);
+    if (!c.init())
+        return false;
+    c.process_events();
+
+    std::string key (path, len);
+    auto it = c.entries.find(key);
+    if (it == c.entries.end()) {
+        // Watches have to be in place before querying the host, otherwise a concurrent change could be missed
+        std::vector<int> wds;
+        for (size_t end = key.rfind('/'); end >= root_len; end = key.rfind('/', end - 1)) {
+            int wd = c.acquire_watch(key.substr(0, end));
+            if (wd < 0)
+                break;
+            wds.push_back(wd);
+            if (end == root_len)
+                break;
+        }
+        size_t depth = 0;
+        for (size_t i = root_len; i < len; i++)
+            depth += path[i] == '/';
+        struct ::stat64 tmp = {};
+        int hret = ::lstat64(path, &tmp);
+        int herr = errno;
+        // mtime / nlink of a directory change with its entries, which only a watch on the directory itself reports
+        if (wds.size() == depth && hret == 0 && S_ISDIR(tmp.st_mode)) {
+            int wd = c.acquire_watch(key);
+            if (wd >= 0) {
+                wds.insert(wds.begin(), wd);
+                depth++;
+                hret = ::lstat64(path, &tmp);
+                herr = errno;
+            }
+        }
+        if (wds.size() != depth || (hret != 0 && herr != ENOENT)) {
+            for (int wd : wds)
+                c.release_watch(wd);
+            if (hret == 0 && !(follow_links && S_ISLNK(tmp.st_mode))) {
+                bionic::from_host(tmp, *s);
+                ret = hret;
+                return true;
+            }
+            return false;
+        }
+        while (c.entries.size() >= max_entries && !c.lru.empty()) {
+            std::string victim = c.lru.back();
+            c.erase(victim);
+        }
+        c.lru.push_front(key);
+        cache_entry &e = c.entries[key];
+        e.ret = hret;
+        e.st = {};
+        if (hret == 0)
+            bionic::from_host(tmp, e.st);
+        e.wds = std::move(wds);
+        e.lru = c.lru.begin();
+        it = c.entries.find(key);
+    } else {
+        c.lru.splice(c.lru.begin(), c.lru, it->second.lru);
+    }
+
+    auto &e = it->second;
+    if (e.ret != 0) {
+        errno = ENOENT;
+        ret = e.ret;
+        return true;
+    }
+    // stat() of a symlink has to resolve the target, which isn't covered by the watches
+    if (follow_links && S_ISLNK(e.st.st_mode))
+        return false;
+    *s = e.st;
+    ret = e.ret;
+    return true;
+}
+
+#else
+
+bool shim::stat_cache::query(const char *path, bool follow_links, bionic::stat *s, int &ret) {
+    return false;
+}
+
+#endif
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <libc_shim.h>
+#include "stat.h"
+
+namespace shim {
+
+    namespace stat_cache {
+
+        /*
+         * Looks up the metadata of an already rewritten path. Only paths below one of the rewrite_filesystem_access
+         * targets are served, positive and ENOENT results are cached until inotify reports a change in the parent
+         * directory, or for directories in the directory itself. Returns false if the caller has to query the host itself.
+         */
+        bool query(const char *path, bool follow_links, bionic::stat *s, int &ret);
+
+    }
+
+}
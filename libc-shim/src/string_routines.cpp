@@ -0,0 +1,85 @@
+#include "no-fortify.h"
+#include <libc_shim.h>
+
+#include <string>
+#include <cstring>
+#include <cstdio>
+#include <dlfcn.h>
+#if defined(__i386__) || defined(__x86_64__)
+#include <cpuid.h>
+#elif defined(__linux__) && (defined(__arm__) || defined(__aarch64__))
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+namespace {
+
+    void append_feature(std::string &features, const char *name) {
+        if (!features.empty())
+            features += ' ';
+        features += name;
+    }
+
+    // The symbol the host resolved memcpy to, glibc's ifunc targets are local symbols so those show up as an offset
+    std::string describe_bound_memcpy() {
+        void *(*volatile bound)(void *, const void *, size_t) = ::memcpy;
+        Dl_info info;
+        if (!dladdr((void *) bound, &info) || !info.dli_fname)
+            return "unknown";
+        const char *lib = strrchr(info.dli_fname, '/');
+        lib = lib ? lib + 1 : info.dli_fname;
+        if (info.dli_sname && info.dli_saddr == (void *) bound)
+            return std::string(info.dli_sname) + " in " + lib;
+        char offset[32];
+        snprintf(offset, sizeof(offset), "+0x%zx", (size_t) ((char *) bound - (char *) info.dli_fbase));
+        return lib + std::string(offset);
+    }
+
+}
+
+/*
+ * memcpy, memmove, memset, strlen, strcmp and memchr are bound straight to the host libc without a wrapper frame,
+ * the host already picks the implementation for the running cpu (glibc / FreeBSD ifunc, libsystem platform dispatch).
+ */
+std::string shim::describe_string_routines() {
+    std::string features;
+#if defined(__i386__) || defined(__x86_64__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse4.2"))
+        append_feature(features, "sse4.2");
+    if (__builtin_cpu_supports("avx2"))
+        append_feature(features, "avx2");
+    if (__builtin_cpu_supports("avx512f"))
+        append_feature(features, "avx512f");
+    unsigned int eax, ebx, ecx, edx;
+    if (__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+        // Enhanced / fast short rep movsb, preferred by the libc for medium and large copies
+        if (ebx & (1u << 9))
+            append_feature(features, "erms");
+        if (edx & (1u << 4))
+            append_feature(features, "fsrm");
+    }
+#elif defined(__aarch64__)
+    append_feature(features, "neon");
+#if defined(__linux__) && defined(HWCAP_SVE)
+    if (getauxval(AT_HWCAP) & HWCAP_SVE)
+        append_feature(features, "sve");
+#endif
+#elif defined(__arm__) && defined(__linux__)
+    if (getauxval(AT_HWCAP) & HWCAP_NEON)
+        append_feature(features, "neon");
+#endif
+
+#if defined(__GLIBC__)
+    std::string dispatch = "glibc ifunc";
+#elif defined(__APPLE__)
+    std::string dispatch = "libsystem_platform";
+#elif defined(__FreeBSD__)
+    std::string dispatch = "FreeBSD libc ifunc";
+#else
+    std::string dispatch = "host libc";
+#endif
+    if (!features.empty())
+        dispatch += ", cpu: " + features;
+    return "memcpy bound to " + describe_bound_memcpy() + " (" + dispatch + ")";
+}
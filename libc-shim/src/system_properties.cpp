@@ -3,24 +3,277 @@
 
 #include <unistd.h>
 #include <stdexcept>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <string_view>
+#include <thread>
+
+/*
+ * Properties live in a read only snapshot, a flat trie over the '.' separated name segments similar to bionic's
+ * prop_area. Children of a node are stored contiguously and sorted, so a lookup is a binary search per segment
+ * without taking any lock. prop_info objects are never freed, their values are updated in place guarded by the
+ * serial (odd while being written), adding new names publishes a new snapshot.
+ */
+struct prop_info {
+    std::atomic<uint32_t> serial;
+    char value[shim::bionic::prop_value_max];
+    std::string name;
+};
+
+namespace {
+
+    struct trie_node {
+        uint32_t name_offset;
+        uint32_t name_length;
+        uint32_t first_child;
+        uint32_t child_count;
+        prop_info *prop;
+    };
+
+    struct prop_trie {
+        std::vector<trie_node> nodes;
+        std::string names;
+        std::vector<prop_info *> props;
+
+        std::string_view segment(trie_node const &node) const {
+            return std::string_view(names).substr(node.name_offset, node.name_length);
+        }
+
+        prop_info *find(std::string_view name) const {
+            if (nodes.empty())
+                return nullptr;
+            trie_node const *node = &nodes[0];
+            while (true) {
+                auto end = name.find('.');
+                auto seg = name.substr(0, end);
+                auto first = nodes.begin() + node->first_child, last = first + node->child_count;
+                auto it = std::lower_bound(first, last, seg, [this](trie_node const &n, std::string_view s) {
+                    return segment(n) < s;
+                });
+                if (it == last || segment(*it) != seg)
+                    return nullptr;
+                node = &*it;
+                if (end == std::string_view::npos)
+                    return node->prop;
+                name.remove_prefix(end + 1);
+            }
+        }
+
+        // Appends the children of the nodes sharing the first `depth` segments of sorted[begin, end)
+        void build_children(size_t parent, std::vector<std::vector<std::string_view>> const &sorted, std::vector<prop_info *> const &values, size_t begin, size_t end, size_t depth) {
+            std::vector<std::pair<size_t, size_t>> groups;
+            for (size_t i = begin; i < end; ) {
+                if (sorted[i].size() <= depth) {
+                    nodes[parent].prop = values[i++];
+                    continue;
+                }
+                size_t j = i + 1;
+                while (j < end && sorted[j].size() > depth && sorted[j][depth] == sorted[i][depth])
+                    j++;
+                groups.emplace_back(i, j);
+                i = j;
+            }
+            nodes[parent].first_child = (uint32_t) nodes.size();
+            nodes[parent].child_count = (uint32_t) groups.size();
+            for (auto &&g : groups) {
+                auto seg = sorted[g.first][depth];
+                nodes.push_back({(uint32_t) names.size(), (uint32_t) seg.size(), 0, 0, nullptr});
+                names.append(seg);
+            }
+            for (size_t k = 0; k < groups.size(); k++)
+                build_children(nodes[parent].first_child + k, sorted, values, groups[k].first, groups[k].second, depth + 1);
+        }
+
+        explicit prop_trie(std::vector<prop_info *> p) : props(std::move(p)) {
+            std::vector<std::vector<std::string_view>> split;
+            for (auto pi : props) {
+                std::vector<std::string_view> segs;
+                std::string_view name = pi->name;
+                for (size_t pos; (pos = name.find('.')) != std::string_view::npos; name.remove_prefix(pos + 1))
+                    segs.push_back(name.substr(0, pos));
+                segs.push_back(name);
+                split.push_back(std::move(segs));
+            }
+            std::vector<size_t> order(props.size());
+            for (size_t i = 0; i < order.size(); i++)
+                order[i] = i;
+            std::sort(order.begin(), order.end(), [&split](size_t a, size_t b) { return split[a] < split[b]; });
+            std::vector<std::vector<std::string_view>> sorted;
+            std::vector<prop_info *> values;
+            for (auto i : order) {
+                sorted.push_back(split[i]);
+                values.push_back(props[i]);
+            }
+            nodes.push_back({0, 0, 0, 0, nullptr});
+            build_children(0, sorted, values, 0, sorted.size(), 0);
+        }
+    };
+
+    std::atomic<prop_trie const *> current_trie {nullptr};
+    std::atomic<uint32_t> area_serial {0};
+    // Serializes writers and wakes up __system_property_wait
+    std::mutex write_mutex;
+    std::condition_variable serial_changed;
+
+    void read_value(const prop_info *pi, char *value, uint32_t &serial) {
+        while (true) {
+            serial = pi->serial.load(std::memory_order_acquire);
+            if (serial & 1) {
+                std::this_thread::yield();
+                continue;
+            }
+            memcpy(value, pi->value, shim::bionic::prop_value_max);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (serial == pi->serial.load(std::memory_order_relaxed))
+                return;
+        }
+    }
+
+}
+
+void shim::set_system_property(std::string const &name, std::string const &value) {
+    if (name.empty() || value.size() >= bionic::prop_value_max)
+        return;
+    std::lock_guard<std::mutex> lock (write_mutex);
+    auto trie = current_trie.load(std::memory_order_acquire);
+    prop_info *pi = trie ? trie->find(name) : nullptr;
+    uint32_t len = (uint32_t) value.size();
+    if (pi) {
+        uint32_t serial = pi->serial.load(std::memory_order_relaxed);
+        pi->serial.store(serial | 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        memset(pi->value, 0, sizeof(pi->value));
+        memcpy(pi->value, value.data(), len);
+        pi->serial.store((len << 24) | ((serial + 2) & 0xfffffe), std::memory_order_release);
+    } else {
+        pi = new prop_info {};
+        pi->name = name;
+        memcpy(pi->value, value.data(), len);
+        pi->serial.store(len << 24, std::memory_order_relaxed);
+        auto props = trie ? trie->props : std::vector<prop_info *>();
+        props.push_back(pi);
+        // Readers may still walk the old snapshot, it is intentionally leaked like the prop_info objects
+        current_trie.store(new prop_trie(std::move(props)), std::memory_order_release);
+    }
+    area_serial.fetch_add(1, std::memory_order_release);
+    serial_changed.notify_all();
+}
+
+bool shim::load_system_properties(std::string const &path) {
+    std::ifstream file (path);
+    if (!file)
+        return false;
+    std::string line;
+    while (std::getline(file, line)) {
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+        auto start = line.find_first_not_of(" \t");
+        if (start == std::string::npos || line[start] == '#')
+            continue;
+        auto eq = line.find('=', start);
+        if (eq == std::string::npos)
+            continue;
+        auto name_end = line.find_last_not_of(" \t", eq - 1);
+        if (name_end == std::string::npos || name_end < start)
+            continue;
+        set_system_property(line.substr(start, name_end - start + 1), line.substr(eq + 1));
+    }
+    return true;
+}
 
 void shim::add_system_properties_shimmed_symbols(std::vector<shim::shimmed_symbol> &list) {
     list.push_back({"__system_property_find", __system_property_find});
     list.push_back({"__system_property_get", __system_property_get});
+    list.push_back({"__system_property_read", __system_property_read});
     list.push_back({"__system_property_read_callback", __system_property_read_callback});
+    list.push_back({"__system_property_foreach", __system_property_foreach});
+    list.push_back({"__system_property_serial", __system_property_serial});
+    list.push_back({"__system_property_area_serial", __system_property_area_serial});
+    list.push_back({"__system_property_wait", __system_property_wait});
 }
 
 const prop_info* shim::__system_property_find(const char *name) {
-    return 0;
+    auto trie = current_trie.load(std::memory_order_acquire);
+    if (!trie || !name)
+        return nullptr;
+    return trie->find(name);
 }
 
 int shim::__system_property_get(const char *name, char *value) {
-    value[0] = 0;
-    return 0;
+    auto pi = __system_property_find(name);
+    if (!pi) {
+        value[0] = 0;
+        return 0;
+    }
+    uint32_t serial;
+    read_value(pi, value, serial);
+    return (int) (serial >> 24);
+}
+
+int shim::__system_property_read(const prop_info *pi, char *name, char *value) {
+    uint32_t serial;
+    read_value(pi, value, serial);
+    if (name) {
+        // Legacy API, name buffers are PROP_NAME_MAX (32) bytes
+        strncpy(name, pi->name.c_str(), 32);
+        name[31] = 0;
+    }
+    return (int) (serial >> 24);
 }
 
 void shim::__system_property_read_callback(const prop_info *pi, void (*callback)(void *cookie, const char *name, const char *value, uint32_t serial), void *cookie) {
-    if(callback) {
+    if (!callback)
+        return;
+    if (!pi) {
         callback(cookie, "", "", 0);
+        return;
+    }
+    char value[bionic::prop_value_max];
+    uint32_t serial;
+    read_value(pi, value, serial);
+    callback(cookie, pi->name.c_str(), value, serial);
+}
+
+int shim::__system_property_foreach(void (*propfn)(const prop_info *pi, void *cookie), void *cookie) {
+    auto trie = current_trie.load(std::memory_order_acquire);
+    if (trie) {
+        for (auto pi : trie->props)
+            propfn(pi, cookie);
+    }
+    return 0;
+}
+
+uint32_t shim::__system_property_serial(const prop_info *pi) {
+    uint32_t serial = pi->serial.load(std::memory_order_acquire);
+    while (serial & 1) {
+        std::this_thread::yield();
+        serial = pi->serial.load(std::memory_order_acquire);
+    }
+    return serial;
+}
+
+uint32_t shim::__system_property_area_serial() {
+    return area_serial.load(std::memory_order_acquire);
+}
+
+bool shim::__system_property_wait(const prop_info *pi, uint32_t old_serial, uint32_t *new_serial_ptr, const timespec *relative_timeout) {
+    auto current = [pi]() { return pi ? __system_property_serial(pi) : __system_property_area_serial(); };
+    std::unique_lock<std::mutex> lock (write_mutex);
+    uint32_t serial;
+    auto changed = [&]() { serial = current(); return serial != old_serial; };
+    if (relative_timeout) {
+        auto timeout = std::chrono::seconds(relative_timeout->tv_sec) + std::chrono::nanoseconds(relative_timeout->tv_nsec);
+        if (!serial_changed.wait_for(lock, timeout, changed))
+            return false;
+    } else {
+        serial_changed.wait(lock, changed);
     }
+    if (new_serial_ptr)
+        *new_serial_ptr = serial;
+    return true;
 }
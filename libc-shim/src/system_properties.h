@@ -1,13 +1,26 @@
 #pragma once
 
 #include <libc_shim.h>
+#include <ctime>
 
 typedef struct prop_info prop_info;
 
 namespace shim {
+
+    namespace bionic {
+
+        constexpr size_t prop_value_max = 92;
+
+    }
+
     const prop_info *__system_property_find(const char *name);
     int __system_property_get(const char *name, char *value);
+    int __system_property_read(const prop_info *pi, char *name, char *value);
     void __system_property_read_callback(const prop_info* pi, void (* callback)(void* cookie, const char* name, const char* value, uint32_t serial), void* cookie);
+    int __system_property_foreach(void (*propfn)(const prop_info *pi, void *cookie), void *cookie);
+    uint32_t __system_property_serial(const prop_info *pi);
+    uint32_t __system_property_area_serial();
+    bool __system_property_wait(const prop_info *pi, uint32_t old_serial, uint32_t *new_serial_ptr, const timespec *relative_timeout);
 
     void add_system_properties_shimmed_symbols(std::vector<shimmed_symbol> &list);
 
@@ -0,0 +1,105 @@
+#include <gtest/gtest.h>
+#include <libc_shim.h>
+#include "../src/file_misc.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <poll.h>
+#include <string>
+#include <unistd.h>
+
+using namespace shim;
+
+namespace {
+
+class PollViaEpollTest : public ::testing::Test {
+protected:
+    std::vector<int> fds;
+
+    ~PollViaEpollTest() {
+        for (int fd : fds)
+            ::close(fd);
+    }
+
+    void makePipe(int &r, int &w) {
+        int p[2];
+        ASSERT_EQ(::pipe(p), 0);
+        r = p[0];
+        w = p[1];
+        fds.push_back(w);
+    }
+
+    int pollOne(int fd, int timeout) {
+        pollfd pfd {fd, POLLIN, 0};
+        int ret = poll_via_epoll(&pfd, 1, timeout);
+        return ret > 0 ? pfd.revents : ret;
+    }
+};
+
+}
+
+TEST_F(PollViaEpollTest, ReportsReadiness) {
+    int r, w;
+    makePipe(r, w);
+    fds.push_back(r);
+    ASSERT_EQ(pollOne(r, 0), 0);
+    ASSERT_EQ(::write(w, "x", 1), 1);
+    ASSERT_EQ(pollOne(r, 0), POLLIN);
+    ASSERT_EQ(pollOne(r, 0), POLLIN);
+    pollfd pfds[2] = {{r, POLLIN, 0}, {w, POLLOUT, 0}};
+    ASSERT_EQ(poll_via_epoll(pfds, 2, 0), 2);
+    ASSERT_EQ(pfds[0].revents, POLLIN);
+    ASSERT_EQ(pfds[1].revents, POLLOUT);
+}
+
+TEST_F(PollViaEpollTest, ReusedFdNumberIsRegistered) {
+    int r, w;
+    makePipe(r, w);
+    ASSERT_EQ(pollOne(r, 0), 0);
+    // Closed behind the shim's back, the number is handed out again by the next pipe
+    ::close(r);
+    int r2, w2;
+    makePipe(r2, w2);
+    fds.push_back(r2);
+    ASSERT_EQ(r2, r);
+    ASSERT_EQ(::write(w2, "x", 1), 1);
+    ASSERT_EQ(pollOne(r2, 1000), POLLIN);
+}
+
+TEST_F(PollViaEpollTest, IgnoresRegistrationOfDuplicatedFile) {
+    int r, w;
+    makePipe(r, w);
+    int dupfd = ::dup(r);
+    fds.push_back(dupfd);
+    ASSERT_EQ(pollOne(r, 0), 0);
+    ASSERT_EQ(::write(w, "x", 1), 1);
+    // The old pipe stays open through dupfd and keeps its epoll registration
+    ::close(r);
+    int r2, w2;
+    makePipe(r2, w2);
+    fds.push_back(r2);
+    ASSERT_EQ(r2, r);
+    ASSERT_EQ(pollOne(r2, 50), 0);
+    ASSERT_EQ(::write(w2, "x", 1), 1);
+    ASSERT_EQ(pollOne(r2, 0), POLLIN);
+}
+
+TEST_F(PollViaEpollTest, RegularFilesAreReady) {
+    char tmpl[] = "/tmp/libc-shim-poll-XXXXXX";
+    int fd = mkstemp(tmpl);
+    ASSERT_GE(fd, 0);
+    unlink(tmpl);
+    for (int i = 0; i < 2; i++) {
+        pollfd pfd {fd, POLLIN | POLLOUT, 0};
+        ASSERT_EQ(poll_via_epoll(&pfd, 1, -1), 1);
+        ASSERT_EQ(pfd.revents, POLLIN | POLLOUT);
+    }
+    // The number now refers to a pipe which isn't ready
+    ::close(fd);
+    int r, w;
+    makePipe(r, w);
+    fds.push_back(r);
+    ASSERT_EQ(r, fd);
+    ASSERT_EQ(pollOne(r, 0), 0);
+}
@@ -0,0 +1,158 @@
+#include <gtest/gtest.h>
+#include <libc_shim.h>
+#include "../src/stat.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <string>
+#include <unistd.h>
+
+using namespace shim;
+
+#ifdef __linux__
+
+static int hostLstatCalls = 0;
+
+// Counts the lookups the cache forwards to the host
+extern "C" int lstat64(const char *path, struct stat64 *buf) noexcept {
+    static auto next = (int (*)(const char *, struct stat64 *)) dlsym(RTLD_NEXT, "lstat64");
+    hostLstatCalls++;
+    return next(path, buf);
+}
+
+#endif
+
+namespace {
+
+class StatCacheTest : public ::testing::Test {
+protected:
+    std::string root;
+
+    StatCacheTest() {
+        char tmpl[] = "/tmp/libc-shim-stat-cache-XXXXXX";
+        root = mkdtemp(tmpl);
+        rewrite_filesystem_access = {{"/data/", root + "/"}};
+        stat_cache_size = 64;
+    }
+
+    ~StatCacheTest() {
+        stat_cache_size = 0;
+        rewrite_filesystem_access.clear();
+        system(("rm -rf '" + root + "'").c_str());
+    }
+
+    void writeFile(std::string const &path, std::string const &data) {
+        FILE *f = fopen(path.c_str(), "w");
+        ASSERT_NE(f, nullptr);
+        fwrite(data.data(), 1, data.size(), f);
+        fclose(f);
+    }
+};
+
+}
+
+#ifdef __linux__
+
+TEST_F(StatCacheTest, CreateAfterNegativeLookup) {
+    std::string path = root + "/file";
+    bionic::stat st;
+    errno = 0;
+    ASSERT_EQ(shim::stat(path.c_str(), &st), -1);
+    ASSERT_EQ(errno, ENOENT);
+    writeFile(path, "abc");
+    ASSERT_EQ(shim::stat(path.c_str(), &st), 0);
+    ASSERT_EQ(st.st_size, 3);
+}
+
+TEST_F(StatCacheTest, WriteAndDelete) {
+    std::string path = root + "/file";
+    writeFile(path, "abc");
+    bionic::stat st;
+    ASSERT_EQ(shim::stat(path.c_str(), &st), 0);
+    ASSERT_EQ(st.st_size, 3);
+    writeFile(path, "abcdef");
+    ASSERT_EQ(shim::stat(path.c_str(), &st), 0);
+    ASSERT_EQ(st.st_size, 6);
+    unlink(path.c_str());
+    ASSERT_EQ(shim::stat(path.c_str(), &st), -1);
+}
+
+TEST_F(StatCacheTest, RenameParentDirectory) {
+    mkdir((root + "/a").c_str(), 0755);
+    std::string path = root + "/a/file";
+    writeFile(path, "abc");
+    bionic::stat st;
+    ASSERT_EQ(shim::stat(path.c_str(), &st), 0);
+    rename((root + "/a").c_str(), (root + "/b").c_str());
+    ASSERT_EQ(shim::stat(path.c_str(), &st), -1);
+    ASSERT_EQ(shim::stat((root + "/b/file").c_str(), &st), 0);
+}
+
+TEST_F(StatCacheTest, DirectoryChangesWithItsEntries) {
+    std::string dir = root + "/dir";
+    mkdir(dir.c_str(), 0755);
+    bionic::stat before, after;
+    ASSERT_EQ(shim::stat(dir.c_str(), &before), 0);
+    mkdir((dir + "/child").c_str(), 0755);
+    ASSERT_EQ(shim::stat(dir.c_str(), &after), 0);
+    ASSERT_EQ(after.st_nlink, before.st_nlink + 1);
+}
+
+TEST_F(StatCacheTest, SymlinkTargetIsNotCached) {
+    writeFile(root + "/target", "abc");
+    symlink((root + "/target").c_str(), (root + "/link").c_str());
+    bionic::stat st;
+    ASSERT_EQ(shim::stat((root + "/link").c_str(), &st), 0);
+    ASSERT_EQ(st.st_size, 3);
+    writeFile(root + "/target", "abcdef");
+    ASSERT_EQ(shim::stat((root + "/link").c_str(), &st), 0);
+    ASSERT_EQ(st.st_size, 6);
+    ASSERT_EQ(shim::lstat((root + "/link").c_str(), &st), 0);
+    ASSERT_TRUE(S_ISLNK(st.st_mode));
+}
+
+TEST_F(StatCacheTest, HitDoesNotQueryTheHost) {
+    std::string path = root + "/file";
+    writeFile(path, "abc");
+    bionic::stat st;
+    ASSERT_EQ(shim::stat(path.c_str(), &st), 0);
+    int calls = hostLstatCalls;
+    ASSERT_GT(calls, 0);
+    for (int i = 0; i < 4; i++) {
+        ASSERT_EQ(shim::stat(path.c_str(), &st), 0);
+        ASSERT_EQ(st.st_size, 3);
+    }
+    ASSERT_EQ(hostLstatCalls, calls);
+    writeFile(path, "abcdef");
+    ASSERT_EQ(shim::stat(path.c_str(), &st), 0);
+    ASSERT_EQ(st.st_size, 6);
+    ASSERT_GT(hostLstatCalls, calls);
+}
+
+TEST_F(StatCacheTest, SymlinkedDirectoryRepointed) {
+    mkdir((root + "/real").c_str(), 0755);
+    mkdir((root + "/other").c_str(), 0755);
+    writeFile(root + "/real/file", "abc");
+    symlink("real", (root + "/a").c_str());
+    bionic::stat st;
+    ASSERT_EQ(shim::stat((root + "/a/file").c_str(), &st), 0);
+    ASSERT_EQ(st.st_size, 3);
+    unlink((root + "/a").c_str());
+    symlink("other", (root + "/a").c_str());
+    errno = 0;
+    ASSERT_EQ(shim::stat((root + "/a/file").c_str(), &st), -1);
+    ASSERT_EQ(errno, ENOENT);
+    // Atomically replaced through a rename
+    writeFile(root + "/other/file", "abcdef");
+    symlink("real", (root + "/tmp").c_str());
+    ASSERT_EQ(shim::stat((root + "/a/file").c_str(), &st), 0);
+    ASSERT_EQ(st.st_size, 6);
+    rename((root + "/tmp").c_str(), (root + "/a").c_str());
+    ASSERT_EQ(shim::stat((root + "/a/file").c_str(), &st), 0);
+    ASSERT_EQ(st.st_size, 3);
+}
+
+#endif
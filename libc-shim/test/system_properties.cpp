@@ -0,0 +1,148 @@
+#include <gtest/gtest.h>
+#include <libc_shim.h>
+#include "../src/system_properties.h"
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace shim;
+
+namespace {
+
+// Properties are process wide, every test uses names below its own prefix
+std::string getValue(std::string const &name) {
+    char value[bionic::prop_value_max];
+    __system_property_get(name.c_str(), value);
+    return value;
+}
+
+void collectName(const prop_info *pi, void *cookie) {
+    char name[32], value[bionic::prop_value_max];
+    __system_property_read(pi, name, value);
+    ((std::vector<std::string> *) cookie)->push_back(name);
+}
+
+}
+
+TEST(SystemPropertiesTest, TrieLookup) {
+    set_system_property("test.trie.a", "1");
+    set_system_property("test.trie.a.b", "2");
+    set_system_property("test.trie.ab", "3");
+    set_system_property("test.trie.b.c.d", "4");
+    set_system_property("test.trie.0", "5");
+    ASSERT_EQ(getValue("test.trie.a"), "1");
+    ASSERT_EQ(getValue("test.trie.a.b"), "2");
+    ASSERT_EQ(getValue("test.trie.ab"), "3");
+    ASSERT_EQ(getValue("test.trie.b.c.d"), "4");
+    ASSERT_EQ(getValue("test.trie.0"), "5");
+    // Inner nodes without a value, partial segments and longer names aren't properties
+    ASSERT_EQ(__system_property_find("test.trie"), nullptr);
+    ASSERT_EQ(__system_property_find("test.trie.b.c"), nullptr);
+    ASSERT_EQ(__system_property_find("test.trie.a.b.c"), nullptr);
+    ASSERT_EQ(__system_property_find("test.tri"), nullptr);
+    ASSERT_EQ(__system_property_find("test.trie.a."), nullptr);
+    ASSERT_EQ(__system_property_find(""), nullptr);
+    ASSERT_EQ(__system_property_find(nullptr), nullptr);
+    char value[bionic::prop_value_max] = "x";
+    ASSERT_EQ(__system_property_get("test.trie.missing", value), 0);
+    ASSERT_STREQ(value, "");
+    // The same prop_info is returned across snapshots
+    auto pi = __system_property_find("test.trie.a");
+    set_system_property("test.trie.aa", "6");
+    ASSERT_EQ(__system_property_find("test.trie.a"), pi);
+    ASSERT_EQ(getValue("test.trie.aa"), "6");
+    // Values that don't fit are rejected
+    set_system_property("test.trie.long", std::string(bionic::prop_value_max, 'x'));
+    ASSERT_EQ(__system_property_find("test.trie.long"), nullptr);
+}
+
+TEST(SystemPropertiesTest, ForeachVisitsInInsertionOrder) {
+    std::vector<std::string> before;
+    __system_property_foreach(collectName, &before);
+    set_system_property("test.order.z", "1");
+    set_system_property("test.order.a", "2");
+    set_system_property("test.order.m.x", "3");
+    set_system_property("test.order.b", "4");
+    // Updating a value keeps its position
+    set_system_property("test.order.z", "5");
+    std::vector<std::string> after;
+    __system_property_foreach(collectName, &after);
+    ASSERT_EQ(after.size(), before.size() + 4);
+    ASSERT_TRUE(std::equal(before.begin(), before.end(), after.begin()));
+    ASSERT_EQ(std::vector<std::string>(after.begin() + before.size(), after.end()), (std::vector<std::string>{"test.order.z", "test.order.a", "test.order.m.x", "test.order.b"}));
+}
+
+TEST(SystemPropertiesTest, SerialBumpsOnUpdate) {
+    set_system_property("test.serial", "ab");
+    auto pi = __system_property_find("test.serial");
+    ASSERT_NE(pi, nullptr);
+    uint32_t serial = __system_property_serial(pi);
+    ASSERT_EQ(serial >> 24, 2u);
+    ASSERT_EQ(serial & 1, 0u);
+    uint32_t area = __system_property_area_serial();
+
+    set_system_property("test.serial", "abcd");
+    uint32_t updated = __system_property_serial(pi);
+    // The low bits count the updates, the top byte holds the value length
+    ASSERT_EQ(updated & 0xffffff, (serial & 0xffffff) + 2);
+    ASSERT_EQ(updated >> 24, 4u);
+    ASSERT_EQ(__system_property_area_serial(), area + 1);
+    char value[bionic::prop_value_max];
+    ASSERT_EQ(__system_property_read(pi, nullptr, value), 4);
+    ASSERT_STREQ(value, "abcd");
+
+    // A shorter value replaces the old one completely
+    set_system_property("test.serial", "z");
+    ASSERT_EQ(__system_property_read(pi, nullptr, value), 1);
+    ASSERT_EQ(std::string(value, 4), std::string("z\0\0\0", 4));
+    struct result { std::string name, value; uint32_t serial; } r;
+    __system_property_read_callback(pi, [](void *cookie, const char *name, const char *value, uint32_t serial) {
+        *(result *) cookie = {name, value, serial};
+    }, &r);
+    ASSERT_EQ(r.name, "test.serial");
+    ASSERT_EQ(r.value, "z");
+    ASSERT_EQ(r.serial, __system_property_serial(pi));
+    ASSERT_EQ(r.serial & 0xffffff, (serial & 0xffffff) + 4);
+    // Adding a property bumps the area serial only
+    set_system_property("test.serial.other", "1");
+    ASSERT_EQ(__system_property_area_serial(), area + 3);
+    ASSERT_EQ(__system_property_serial(pi), r.serial);
+}
+
+TEST(SystemPropertiesTest, WaitWakesOnChange) {
+    set_system_property("test.wait", "0");
+    auto pi = __system_property_find("test.wait");
+    uint32_t serial = __system_property_serial(pi);
+    timespec shortTimeout {0, 20 * 1000 * 1000};
+    uint32_t newSerial = 0;
+    ASSERT_FALSE(__system_property_wait(pi, serial, &newSerial, &shortTimeout));
+    // An outdated serial returns right away
+    ASSERT_TRUE(__system_property_wait(pi, serial - 2, &newSerial, &shortTimeout));
+    ASSERT_EQ(newSerial, serial);
+
+    std::thread writer([]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        set_system_property("test.wait", "1");
+    });
+    timespec timeout {10, 0};
+    auto start = std::chrono::steady_clock::now();
+    ASSERT_TRUE(__system_property_wait(pi, serial, &newSerial, &timeout));
+    ASSERT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(5));
+    writer.join();
+    ASSERT_NE(newSerial, serial);
+    ASSERT_EQ(newSerial, __system_property_serial(pi));
+    ASSERT_EQ(getValue("test.wait"), "1");
+
+    // Without a prop_info any change to the area wakes up the waiter, without a timeout it waits indefinitely
+    uint32_t area = __system_property_area_serial();
+    writer = std::thread([]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        set_system_property("test.wait.new", "1");
+    });
+    ASSERT_TRUE(__system_property_wait(nullptr, area, &newSerial, nullptr));
+    writer.join();
+    ASSERT_EQ(newSerial, area + 1);
+}
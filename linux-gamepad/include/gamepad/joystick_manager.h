@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <functional>
 #include "callback_list.h"
 
@@ -20,6 +21,15 @@ public:
 
     virtual void poll() = 0;
 
+    // Reads the input on a background thread if supported, poll() then only dispatches the queued events.
+    // Has to be called before initialize()
+    virtual void setUseInputThread(bool use) {}
+
+    // CLOCK_MONOTONIC time in nanoseconds the event being dispatched was read at by the input thread, 0 if unknown
+    virtual uint64_t getCurrentEventTime() const {
+        return 0;
+    }
+
 };
 
 }
\ No newline at end of file
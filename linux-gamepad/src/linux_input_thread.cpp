@@ -0,0 +1,210 @@
+#include "linux_input_thread.h"
+#include <cerrno>
+#include <cstdio>
+#include <ctime>
+#include <stdexcept>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+using namespace gamepad;
+
+static uint64_t getMonotonicTime() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
+
+LinuxInputThread::LinuxInputThread() {
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epollFd == -1 || wakeFd == -1)
+        throw std::runtime_error("Failed to create the input thread fds");
+    struct epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.u64 = ((uint64_t) UINT32_MAX << 32) | (uint32_t) wakeFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &ev);
+}
+
+LinuxInputThread::~LinuxInputThread() {
+    if (thread.joinable()) {
+        stopping = true;
+        uint64_t v = 1;
+        (void) !write(wakeFd, &v, sizeof(v));
+        thread.join();
+    }
+    if (wakeFd != -1)
+        close(wakeFd);
+    if (epollFd != -1)
+        close(epollFd);
+}
+
+void LinuxInputThread::start() {
+    thread = std::thread(&LinuxInputThread::run, this);
+}
+
+void LinuxInputThread::addDevice(struct libevdev* edev, uint32_t source) {
+    addDevice({edev, libevdev_get_fd(edev)}, source);
+}
+
+void LinuxInputThread::addRawDevice(int fd, uint32_t source) {
+    addDevice({nullptr, fd}, source);
+}
+
+void LinuxInputThread::addDevice(Device device, uint32_t source) {
+    int fd = device.fd;
+    std::lock_guard<std::mutex> lock (devicesMutex);
+    devices[source] = std::move(device);
+    struct epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.u64 = ((uint64_t) source << 32) | (uint32_t) fd;
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) != 0)
+        printf("LinuxInputThread: failed to add fd %i\n", fd);
+}
+
+void LinuxInputThread::removeDevice(uint32_t source) {
+    std::lock_guard<std::mutex> lock (devicesMutex);
+    auto it = devices.find(source);
+    if (it == devices.end())
+        return;
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, it->second.fd, nullptr);
+    devices.erase(it);
+}
+
+void LinuxInputThread::addUdevFd(int fd) {
+    struct epoll_event ev = {};
+    ev.events = EPOLLIN | EPOLLONESHOT;
+    ev.data.u64 = (uint32_t) fd;
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) != 0)
+        printf("LinuxInputThread: failed to add the udev fd\n");
+}
+
+void LinuxInputThread::rearmUdevFd(int fd) {
+    struct epoll_event ev = {};
+    ev.events = EPOLLIN | EPOLLONESHOT;
+    ev.data.u64 = (uint32_t) fd;
+    epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &ev);
+}
+
+bool LinuxInputThread::push(Event const& e) {
+    size_t t = tail.load(std::memory_order_relaxed);
+    if (t - head.load(std::memory_order_acquire) >= CAPACITY) {
+        droppedCount.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    ring[t % CAPACITY] = e;
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+}
+
+bool LinuxInputThread::pop(Event& e) {
+    size_t h = head.load(std::memory_order_relaxed);
+    if (h == tail.load(std::memory_order_acquire))
+        return false;
+    e = ring[h % CAPACITY];
+    head.store(h + 1, std::memory_order_release);
+    return true;
+}
+
+void LinuxInputThread::handleEvent(Device& device, uint32_t source, uint64_t time, struct input_event const& e) {
+    if (e.type == EV_KEY || e.type == EV_ABS)
+        device.state[((uint32_t) e.type << 16) | e.code] = e.value;
+    if (device.resyncPending)
+        return;
+    if (!push({source, time, e})) {
+        device.resyncPending = true;
+        resyncPending = true;
+    }
+}
+
+bool LinuxInputThread::resync(Device& device, uint32_t source) {
+    size_t free = CAPACITY - (tail.load(std::memory_order_relaxed) - head.load(std::memory_order_acquire));
+    if (free < device.state.size() + 1)
+        return false;
+    Event e = {source, getMonotonicTime(), {}};
+    for (auto const& s : device.state) {
+        e.event.type = (uint16_t) (s.first >> 16);
+        e.event.code = (uint16_t) s.first;
+        e.event.value = s.second;
+        push(e);
+    }
+    e.event.type = EV_SYN;
+    e.event.code = SYN_REPORT;
+    e.event.value = 0;
+    push(e);
+    device.resyncPending = false;
+    return true;
+}
+
+void LinuxInputThread::readEvents(Device& device, uint32_t source) {
+    uint64_t time = getMonotonicTime();
+    struct input_event e;
+    if (!device.edev) {
+        ssize_t r;
+        while ((r = read(device.fd, &e, sizeof(e))) == sizeof(e))
+            handleEvent(device, source, time, e);
+        if (r == 0 || (r < 0 && errno != EAGAIN && errno != EINTR))
+            epoll_ctl(epollFd, EPOLL_CTL_DEL, device.fd, nullptr);
+        return;
+    }
+    unsigned int flags = LIBEVDEV_READ_FLAG_NORMAL;
+    while (true) {
+        int r = libevdev_next_event(device.edev, flags, &e);
+        if (r == -EAGAIN) {
+            if (flags == LIBEVDEV_READ_FLAG_SYNC) {
+                flags = LIBEVDEV_READ_FLAG_NORMAL;
+                continue;
+            }
+            return;
+        }
+        if (r < 0) {
+            // The device is gone, stop polling it until udev reports the removal
+            epoll_ctl(epollFd, EPOLL_CTL_DEL, device.fd, nullptr);
+            return;
+        }
+        if (r == LIBEVDEV_READ_STATUS_SYNC && flags == LIBEVDEV_READ_FLAG_NORMAL) {
+            // SYN_DROPPED, libevdev replays the changes missed since then as sync events
+            flags = LIBEVDEV_READ_FLAG_SYNC;
+            continue;
+        }
+        handleEvent(device, source, time, e);
+    }
+}
+
+void LinuxInputThread::run() {
+    struct epoll_event events[16];
+    while (!stopping) {
+        // pop() doesn't wake the thread, check for room in the ring periodically while a device waits for a resync
+        int n = epoll_wait(epollFd, events, 16, resyncPending ? 5 : -1);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            printf("LinuxInputThread: epoll_wait failed\n");
+            return;
+        }
+        for (int i = 0; i < n; i++) {
+            int fd = (int) (uint32_t) events[i].data.u64;
+            uint32_t source = (uint32_t) (events[i].data.u64 >> 32);
+            if (fd == wakeFd) {
+                uint64_t v;
+                (void) !read(wakeFd, &v, sizeof(v));
+            } else if (source == 0) {
+                udevPending.store(true, std::memory_order_release);
+            } else {
+                // Events fetched before the device was removed are dropped here, even if its fd got reused
+                std::lock_guard<std::mutex> lock (devicesMutex);
+                auto it = devices.find(source);
+                if (it != devices.end())
+                    readEvents(it->second, source);
+            }
+        }
+        if (resyncPending) {
+            std::lock_guard<std::mutex> lock (devicesMutex);
+            resyncPending = false;
+            for (auto& d : devices) {
+                if (d.second.resyncPending && !resync(d.second, d.first))
+                    resyncPending = true;
+            }
+        }
+    }
+}
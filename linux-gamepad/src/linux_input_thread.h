@@ -0,0 +1,98 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <linux/input.h>
+#include <libevdev-1.0/libevdev/libevdev.h>
+
+namespace gamepad {
+
+/**
+ * Waits for the udev monitor and evdev fds on a background thread using epoll, reads the devices through libevdev and
+ * passes the events to the thread calling pop() through a single producer, single consumer ring. Adding and removing
+ * devices may happen from any thread.
+ * If the ring is full, the events of the device are dropped until there is room to re-send the last value of every
+ * key and axis it reported, followed by a SYN_REPORT, so no button stays pressed.
+ */
+class LinuxInputThread {
+
+public:
+    struct Event {
+        uint32_t source;
+        // CLOCK_MONOTONIC time the event was read at, in nanoseconds
+        uint64_t time;
+        struct input_event event;
+    };
+
+    static constexpr size_t CAPACITY = 1024;
+
+private:
+    int epollFd = -1;
+    int wakeFd = -1;
+    std::thread thread;
+    std::atomic<bool> stopping {false};
+
+    Event ring[CAPACITY];
+    alignas(64) std::atomic<size_t> head {0};
+    alignas(64) std::atomic<size_t> tail {0};
+    std::atomic<size_t> droppedCount {0};
+    std::atomic<bool> udevPending {false};
+
+    struct Device {
+        // nullptr for fds read as plain input_event records
+        struct libevdev* edev;
+        int fd;
+        bool resyncPending = false;
+        // Last value of every key and axis read, indexed by type << 16 | code
+        std::unordered_map<uint32_t, int32_t> state;
+    };
+
+    // Held by the thread while it reads a device, so removeDevice can wait for it
+    std::mutex devicesMutex;
+    std::unordered_map<uint32_t, Device> devices;
+    bool resyncPending = false;
+
+    void run();
+    void addDevice(Device device, uint32_t source);
+    void readEvents(Device& device, uint32_t source);
+    void handleEvent(Device& device, uint32_t source, uint64_t time, struct input_event const& e);
+    bool resync(Device& device, uint32_t source);
+    bool push(Event const& e);
+
+public:
+    LinuxInputThread();
+    ~LinuxInputThread();
+
+    LinuxInputThread(LinuxInputThread const&) = delete;
+    LinuxInputThread& operator=(LinuxInputThread const&) = delete;
+
+    void start();
+
+    // Queues the events of the device tagged with source, which must be non-zero. Until removeDevice returns, the
+    // device is only read by this thread
+    void addDevice(struct libevdev* edev, uint32_t source);
+    // Same for a non-blocking fd delivering raw input_event records, e.g. a pipe
+    void addRawDevice(int fd, uint32_t source);
+    // Once this returns, the thread no longer touches the device and its fd may be closed
+    void removeDevice(uint32_t source);
+    // Sets the pending flag once the fd is readable, the fd has to be re-armed after it has been read
+    void addUdevFd(int fd);
+    void rearmUdevFd(int fd);
+
+    bool pop(Event& e);
+
+    bool takeUdevPending() {
+        return udevPending.exchange(false, std::memory_order_acquire);
+    }
+
+    size_t getDroppedCount() const {
+        return droppedCount.load(std::memory_order_relaxed);
+    }
+
+};
+
+}
@@ -87,51 +87,55 @@ void LinuxJoystick::poll() {
             printf("LinuxJoystick::pool error\n");
             break;
         }
-        if (e.type == EV_KEY) {
-            if (e.code >= KEY_CNT)
-                continue;
-            int btn = buttons[e.code];
-            if (btn == -1)
-                continue;
-            bool v = e.value != 0;
-            buttons[btn] = v;
-            if (mgr)
-                mgr->onJoystickButton(this, btn, v);
-        } else if (e.type == EV_ABS && isHat(e.code)) {
-            auto& a = axis[e.code];
-            if (a.index == -1)
-                continue;
-            const bool y = (bool) (e.code & 1);
-            int v = hatValues[a.index];
-            // v (left, down, right, up)
-            v &= ~(y ? 0b0101 : 0b1010);
-            if (e.value != 0) {
-                if (y)
-                    v |= (e.value > 0 ? 4 : 1);
-                else
-                    v |= (e.value > 0 ? 2 : 8);
-            }
-            hatValues[a.index] = v;
-            if (mgr)
-                mgr->onJoystickHat(this, a.index, v);
-        } else if (e.type == EV_ABS) {
-            if (e.code >= AXIS_COUNT)
-                continue;
-            auto& a = axis[e.code];
-            if (a.index == -1)
-                continue;
-            int iv = e.value - (a.min + a.max) / 2;
-            float v;
-            if (iv >= 0)
-                v = (float) iv / (a.max - (a.min + a.max) / 2);
+        handleEvent(e);
+    }
+}
+
+void LinuxJoystick::handleEvent(struct input_event const& e) {
+    if (e.type == EV_KEY) {
+        if (e.code >= KEY_CNT)
+            return;
+        int btn = buttons[e.code];
+        if (btn == -1)
+            return;
+        bool v = e.value != 0;
+        buttons[btn] = v;
+        if (mgr)
+            mgr->onJoystickButton(this, btn, v);
+    } else if (e.type == EV_ABS && isHat(e.code)) {
+        auto& a = axis[e.code];
+        if (a.index == -1)
+            return;
+        const bool y = (bool) (e.code & 1);
+        int v = hatValues[a.index];
+        // v (left, down, right, up)
+        v &= ~(y ? 0b0101 : 0b1010);
+        if (e.value != 0) {
+            if (y)
+                v |= (e.value > 0 ? 4 : 1);
             else
-                v = - (float) iv / (a.min - (a.min + a.max) / 2);
-            if (std::abs(iv) < a.flat)
-                v = 0.f;
-            v = std::min(std::max(v, -1.f), 1.f);
-            axisValues[a.index] = v;
-            if (mgr)
-                mgr->onJoystickAxis(this, a.index, v);
+                v |= (e.value > 0 ? 2 : 8);
         }
+        hatValues[a.index] = v;
+        if (mgr)
+            mgr->onJoystickHat(this, a.index, v);
+    } else if (e.type == EV_ABS) {
+        if (e.code >= AXIS_COUNT)
+            return;
+        auto& a = axis[e.code];
+        if (a.index == -1)
+            return;
+        int iv = e.value - (a.min + a.max) / 2;
+        float v;
+        if (iv >= 0)
+            v = (float) iv / (a.max - (a.min + a.max) / 2);
+        else
+            v = - (float) iv / (a.min - (a.min + a.max) / 2);
+        if (std::abs(iv) < a.flat)
+            v = 0.f;
+        v = std::min(std::max(v, -1.f), 1.f);
+        axisValues[a.index] = v;
+        if (mgr)
+            mgr->onJoystickAxis(this, a.index, v);
     }
 }
@@ -43,8 +43,14 @@ public:
         return devPath;
     }
 
+    struct libevdev* getDevice() const {
+        return edev;
+    }
+
     void poll();
 
+    void handleEvent(struct input_event const& e);
+
     std::string getGUID() const override;
 
     bool getButton(int index) const override {
@@ -8,6 +8,8 @@
 using namespace gamepad;
 
 LinuxJoystickManager::~LinuxJoystickManager() {
+    // Stop the thread before the joysticks owning the fds it reads
+    inputThread.reset();
 }
 
 void LinuxJoystickManager::initialize() {
@@ -22,6 +24,11 @@ void LinuxJoystickManager::initialize() {
     udev_monitor_enable_receiving(udevMonitor);
     udevMonitorFd = udev_monitor_get_fd(udevMonitor);
 
+    if (useInputThread) {
+        inputThread.reset(new LinuxInputThread());
+        inputThread->addUdevFd(udevMonitorFd);
+    }
+
     struct udev_enumerate* enumerate = udev_enumerate_new(udev);
     udev_enumerate_add_match_subsystem(enumerate, "input");
     udev_enumerate_scan_devices(enumerate);
@@ -36,30 +43,58 @@ void LinuxJoystickManager::initialize() {
         udev_device_unref(dev);
     }
     udev_enumerate_unref(enumerate);
+
+    if (inputThread)
+        inputThread->start();
+}
+
+void LinuxJoystickManager::receiveUdevEvents() {
+    while (true) {
+        struct timeval tv;
+        tv.tv_sec = tv.tv_usec = 0;
+        fd_set fds;
+        FD_ZERO(&fds);
+        FD_SET(udevMonitorFd, &fds);
+
+        int r = select(udevMonitorFd + 1, &fds, NULL, NULL, &tv);
+        if (r <= 0 || !FD_ISSET(udevMonitorFd, &fds))
+            break;
+        struct udev_device* dev = udev_monitor_receive_device(udevMonitor);
+        const char* action = udev_device_get_action(dev);
+        if (strcmp(action, "add") == 0)
+            onDeviceAdded(dev);
+        else if (strcmp(action, "remove") == 0)
+            onDeviceRemoved(dev);
+        udev_device_unref(dev);
+    }
+}
+
+void LinuxJoystickManager::dispatchQueuedEvents() {
+    if (inputThread->takeUdevPending()) {
+        receiveUdevEvents();
+        inputThread->rearmUdevFd(udevMonitorFd);
+    }
+    LinuxInputThread::Event e;
+    while (inputThread->pop(e)) {
+        // Events read before the device was removed
+        auto it = inputSources.find(e.source);
+        if (it == inputSources.end())
+            continue;
+        currentEventTime = e.time;
+        it->second->handleEvent(e.event);
+    }
+    currentEventTime = 0;
 }
 
 void LinuxJoystickManager::poll() {
-    if (udevMonitor != NULL) {
-        while (true) {
-            struct timeval tv;
-            tv.tv_sec = tv.tv_usec = 0;
-            fd_set fds;
-            FD_ZERO(&fds);
-            FD_SET(udevMonitorFd, &fds);
-
-            int r = select(udevMonitorFd + 1, &fds, NULL, NULL, &tv);
-            if (r <= 0 || !FD_ISSET(udevMonitorFd, &fds))
-                break;
-            struct udev_device* dev = udev_monitor_receive_device(udevMonitor);
-            const char* action = udev_device_get_action(dev);
-            if (strcmp(action, "add") == 0)
-                onDeviceAdded(dev);
-            else if (strcmp(action, "remove") == 0)
-                onDeviceRemoved(dev);
-            udev_device_unref(dev);
-        }
+    if (inputThread) {
+        dispatchQueuedEvents();
+        return;
     }
 
+    if (udevMonitor != NULL)
+        receiveUdevEvents();
+
     for (auto const& js : joysticks)
         js->poll();
 }
@@ -81,6 +116,11 @@ void LinuxJoystickManager::onDeviceAdded(struct udev_device* dev) {
         }
 
         std::unique_ptr<LinuxJoystick> js (new LinuxJoystick(this, devPath, edev));
+        if (inputThread) {
+            uint32_t source = nextInputSource++;
+            inputSources[source] = js.get();
+            inputThread->addDevice(edev, source);
+        }
         onJoystickConnected(js.get());
         joysticks.push_back(std::move(js));
     }
@@ -92,6 +132,16 @@ void LinuxJoystickManager::onDeviceRemoved(struct udev_device* dev) {
         return;
     for (auto it = joysticks.begin(); it != joysticks.end(); it++) {
         if (strcmp(it->get()->getPath().c_str(), devPath) == 0) {
+            if (inputThread) {
+                for (auto src = inputSources.begin(); src != inputSources.end(); src++) {
+                    if (src->second == it->get()) {
+                        // Waits for the thread to stop reading the device before it is destroyed
+                        inputThread->removeDevice(src->first);
+                        inputSources.erase(src);
+                        break;
+                    }
+                }
+            }
             onJoystickDisconnected(it->get());
             joysticks.erase(it);
             return;
@@ -2,8 +2,10 @@
 
 #include <gamepad/joystick_manager.h>
 #include <memory>
+#include <unordered_map>
 #include <libudev.h>
 #include "linux_joystick.h"
+#include "linux_input_thread.h"
 
 namespace gamepad {
 
@@ -15,14 +17,31 @@ private:
     int udevMonitorFd;
     std::vector<std::unique_ptr<LinuxJoystick>> joysticks;
 
+    bool useInputThread = false;
+    std::unique_ptr<LinuxInputThread> inputThread;
+    std::unordered_map<uint32_t, LinuxJoystick*> inputSources;
+    uint32_t nextInputSource = 1;
+    uint64_t currentEventTime = 0;
+
+    void receiveUdevEvents();
+    void dispatchQueuedEvents();
+
 public:
     LinuxJoystickManager() {}
     ~LinuxJoystickManager();
 
+    void setUseInputThread(bool use) override {
+        useInputThread = use;
+    }
+
     void initialize() override;
 
     void poll() override;
 
+    uint64_t getCurrentEventTime() const override {
+        return currentEventTime;
+    }
+
     void onDeviceAdded(struct udev_device* dev);
     void onDeviceRemoved(struct udev_device* dev);
 
@@ -0,0 +1,129 @@
+#include <gtest/gtest.h>
+#include "../src/linux_input_thread.h"
+
+#include <chrono>
+#include <fcntl.h>
+#include <map>
+#include <sys/ioctl.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace gamepad;
+using namespace std::chrono;
+
+namespace {
+
+class LinuxInputThreadTest : public ::testing::Test {
+protected:
+    LinuxInputThread thread;
+    int fds[2] = {-1, -1};
+
+    LinuxInputThreadTest() {
+        EXPECT_EQ(pipe2(fds, O_NONBLOCK), 0);
+    }
+
+    ~LinuxInputThreadTest() {
+        close(fds[0]);
+        close(fds[1]);
+    }
+
+    void write(uint16_t type, uint16_t code, int32_t value) {
+        struct input_event e = {};
+        e.type = type;
+        e.code = code;
+        e.value = value;
+        ASSERT_EQ(::write(fds[1], &e, sizeof(e)), (ssize_t) sizeof(e));
+    }
+
+    // Waits until the thread read everything written so far
+    void waitForRead() {
+        for (int i = 0; i < 1000; i++) {
+            int pending = 0;
+            ioctl(fds[0], FIONREAD, &pending);
+            if (pending == 0)
+                break;
+            std::this_thread::sleep_for(milliseconds(1));
+        }
+        std::this_thread::sleep_for(milliseconds(20));
+    }
+
+    // Pops until nothing arrives for a while
+    std::vector<LinuxInputThread::Event> drain() {
+        std::vector<LinuxInputThread::Event> ret;
+        auto idleSince = steady_clock::now();
+        while (steady_clock::now() - idleSince < milliseconds(100)) {
+            LinuxInputThread::Event e;
+            if (thread.pop(e)) {
+                ret.push_back(e);
+                idleSince = steady_clock::now();
+            } else {
+                std::this_thread::sleep_for(milliseconds(1));
+            }
+        }
+        return ret;
+    }
+};
+
+}
+
+TEST_F(LinuxInputThreadTest, DeliversEventsInOrder) {
+    thread.addRawDevice(fds[0], 7);
+    thread.start();
+    write(EV_KEY, BTN_A, 1);
+    write(EV_ABS, ABS_X, 100);
+    write(EV_SYN, SYN_REPORT, 0);
+    auto events = drain();
+    ASSERT_EQ(events.size(), 3);
+    ASSERT_EQ(events[0].event.type, EV_KEY);
+    ASSERT_EQ(events[0].event.code, BTN_A);
+    ASSERT_EQ(events[0].event.value, 1);
+    ASSERT_EQ(events[1].event.code, ABS_X);
+    ASSERT_EQ(events[1].event.value, 100);
+    ASSERT_EQ(events[2].event.type, EV_SYN);
+    for (auto const& e : events) {
+        ASSERT_EQ(e.source, 7);
+        ASSERT_GT(e.time, 0);
+    }
+    ASSERT_EQ(thread.getDroppedCount(), 0);
+}
+
+TEST_F(LinuxInputThreadTest, ResyncsStateAfterOverflow) {
+    thread.addRawDevice(fds[0], 1);
+    thread.start();
+    write(EV_KEY, BTN_A, 1);
+    write(EV_KEY, BTN_B, 1);
+    for (int i = 0; i < (int) LinuxInputThread::CAPACITY + 200; i++)
+        write(EV_ABS, ABS_X, i);
+    // Both lost in the overflow
+    write(EV_KEY, BTN_A, 0);
+    write(EV_ABS, ABS_X, -5);
+    write(EV_SYN, SYN_REPORT, 0);
+    waitForRead();
+    ASSERT_GT(thread.getDroppedCount(), 0);
+
+    std::map<std::pair<uint16_t, uint16_t>, int32_t> state;
+    auto events = drain();
+    ASSERT_GE(events.size(), LinuxInputThread::CAPACITY);
+    for (auto const& e : events)
+        state[{e.event.type, e.event.code}] = e.event.value;
+    ASSERT_EQ((state[{EV_KEY, BTN_A}]), 0);
+    ASSERT_EQ((state[{EV_KEY, BTN_B}]), 1);
+    ASSERT_EQ((state[{EV_ABS, ABS_X}]), -5);
+    ASSERT_EQ(events.back().event.type, EV_SYN);
+
+    // Events flow normally again
+    write(EV_KEY, BTN_B, 0);
+    events = drain();
+    ASSERT_EQ(events.size(), 1);
+    ASSERT_EQ(events[0].event.code, BTN_B);
+    ASSERT_EQ(events[0].event.value, 0);
+}
+
+TEST_F(LinuxInputThreadTest, RemovedDeviceIsNotRead) {
+    thread.addRawDevice(fds[0], 3);
+    thread.start();
+    thread.removeDevice(3);
+    write(EV_KEY, BTN_A, 1);
+    ASSERT_TRUE(drain().empty());
+}
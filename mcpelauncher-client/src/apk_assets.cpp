@@ -0,0 +1,362 @@
+#include "apk_assets.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <set>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <zlib.h>
+#include <log.h>
+
+namespace {
+
+constexpr uint32_t eocdSignature = 0x06054b50;
+constexpr uint32_t zip64EocdLocatorSignature = 0x07064b50;
+constexpr uint32_t zip64EocdSignature = 0x06064b50;
+constexpr uint32_t centralHeaderSignature = 0x02014b50;
+constexpr uint32_t localHeaderSignature = 0x04034b50;
+constexpr uint16_t methodStored = 0;
+constexpr uint16_t methodDeflated = 8;
+
+uint16_t read16(const char *p) {
+    auto u = (const unsigned char *)p;
+    return (uint16_t)(u[0] | (u[1] << 8));
+}
+
+uint32_t read32(const char *p) {
+    return read16(p) | ((uint32_t)read16(p + 2) << 16);
+}
+
+uint64_t read64(const char *p) {
+    return read32(p) | ((uint64_t)read32(p + 4) << 32);
+}
+
+}  // namespace
+
+std::unique_ptr<ApkAssets> ApkAssets::open(std::string const &path) {
+    std::unique_ptr<ApkAssets> ret(new ApkAssets);
+    ret->path = path;
+    ret->fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if(ret->fd == -1)
+        return nullptr;
+    struct stat st;
+    if(fstat(ret->fd, &st) != 0 || st.st_size <= 0) {
+        Log::error("ApkAssets", "Failed to stat %s", path.c_str());
+        return nullptr;
+    }
+    ret->size = (uint64_t)st.st_size;
+    if(!ret->readCentralDirectory()) {
+        Log::error("ApkAssets", "%s is not a valid zip archive", path.c_str());
+        return nullptr;
+    }
+    Log::info("ApkAssets", "Indexed %zu assets of %s", ret->entries.size(), path.c_str());
+    return ret;
+}
+
+ApkAssets::~ApkAssets() {
+    if(fd != -1)
+        close(fd);
+}
+
+bool ApkAssets::readAt(uint64_t offset, void *buf, size_t length) const {
+    if(offset > size || size - offset < length)
+        return false;
+    size_t done = 0;
+    while(done < length) {
+        ssize_t r = pread(fd, (char *)buf + done, length - done, (off_t)(offset + done));
+        if(r < 0 && errno == EINTR)
+            continue;
+        if(r <= 0)
+            return false;
+        done += (size_t)r;
+    }
+    return true;
+}
+
+bool ApkAssets::readCentralDirectory() {
+    // The end of central directory record is followed by a comment of up to 64KiB, preceded by the zip64 locator
+    if(size < 22)
+        return false;
+    uint64_t tailOffset = size > 20 + 22 + 0xffff ? size - 20 - 22 - 0xffff : 0;
+    std::string tail((size_t)(size - tailOffset), '\0');
+    if(!readAt(tailOffset, &tail[0], tail.size()))
+        return false;
+    const char *base = tail.data();
+    size_t eocd = tail.size() - 22;
+    size_t minEocd = tail.size() > 20 + 22 + 0xffff ? 20 : 0;
+    while(read32(base + eocd) != eocdSignature) {
+        if(eocd == minEocd)
+            return false;
+        eocd--;
+    }
+    uint64_t count = read16(base + eocd + 10);
+    uint64_t cdSize = read32(base + eocd + 12);
+    uint64_t cdOffset = read32(base + eocd + 16);
+    if(eocd >= 20 && read32(base + eocd - 20) == zip64EocdLocatorSignature) {
+        char zip64Eocd[56];
+        if(!readAt(read64(base + eocd - 20 + 8), zip64Eocd, sizeof(zip64Eocd)) || read32(zip64Eocd) != zip64EocdSignature)
+            return false;
+        count = read64(zip64Eocd + 32);
+        cdSize = read64(zip64Eocd + 40);
+        cdOffset = read64(zip64Eocd + 48);
+    }
+    if(cdOffset > size || cdSize > size - cdOffset)
+        return false;
+    std::string cd((size_t)cdSize, '\0');
+    if(!readAt(cdOffset, &cd[0], cd.size()))
+        return false;
+
+    dirs[""];
+    const char *p = cd.data(), *end = p + cd.size();
+    for(uint64_t i = 0; i < count; i++) {
+        if(end - p < 46 || read32(p) != centralHeaderSignature)
+            return false;
+        Entry e;
+        e.method = read16(p + 10);
+        e.compressedSize = read32(p + 20);
+        e.uncompressedSize = read32(p + 24);
+        uint16_t nameLength = read16(p + 28), extraLength = read16(p + 30), commentLength = read16(p + 32);
+        e.localHeaderOffset = read32(p + 42);
+        if(end - p < 46 + nameLength + extraLength + commentLength)
+            return false;
+        std::string name(p + 46, nameLength);
+        // Sizes and offset overflowing 32 bits are moved to the zip64 extra field, in this order
+        for(const char *x = p + 46 + nameLength, *xend = x + extraLength; xend - x >= 4;) {
+            uint16_t id = read16(x), len = read16(x + 2);
+            const char *field = x + 4, *fieldEnd = std::min(field + len, xend);
+            if(id == 1) {
+                if(e.uncompressedSize == 0xffffffff && fieldEnd - field >= 8) {
+                    e.uncompressedSize = read64(field);
+                    field += 8;
+                }
+                if(e.compressedSize == 0xffffffff && fieldEnd - field >= 8) {
+                    e.compressedSize = read64(field);
+                    field += 8;
+                }
+                if(e.localHeaderOffset == 0xffffffff && fieldEnd - field >= 8)
+                    e.localHeaderOffset = read64(field);
+            }
+            x = fieldEnd;
+        }
+        p += 46 + nameLength + extraLength + commentLength;
+        if(name.compare(0, 7, "assets/") != 0 || name.back() == '/')
+            continue;
+        if(e.method != methodStored && e.method != methodDeflated) {
+            Log::warn("ApkAssets", "Skipping %s, unsupported compression method %i", name.c_str(), e.method);
+            continue;
+        }
+        addEntry(name.substr(7), e);
+    }
+    for(auto &&d : dirs) {
+        std::set<std::string> unique(d.second.begin(), d.second.end());
+        d.second.assign(unique.begin(), unique.end());
+    }
+    return true;
+}
+
+void ApkAssets::addEntry(std::string name, Entry entry) {
+    entry.index = entries.size();
+    for(size_t pos = name.size(); pos != std::string::npos && pos > 0;) {
+        size_t slash = name.rfind('/', pos - 1);
+        std::string dir = slash == std::string::npos ? std::string() : name.substr(0, slash);
+        std::string child = name.substr(slash == std::string::npos ? 0 : slash + 1, pos - (slash == std::string::npos ? 0 : slash + 1));
+        auto &children = dirs[dir];
+        bool known = !children.empty();
+        children.push_back(std::move(child));
+        // Parents were registered by an earlier entry of the same directory
+        if(known)
+            break;
+        pos = slash;
+    }
+    entries.emplace(std::move(name), entry);
+}
+
+ApkAssets::Entry const *ApkAssets::find(std::string const &name) const {
+    auto it = entries.find(name);
+    return it != entries.end() ? &it->second : nullptr;
+}
+
+std::vector<std::string> const *ApkAssets::list(std::string const &dir) const {
+    std::string key = dir;
+    while(!key.empty() && key.back() == '/')
+        key.pop_back();
+    auto it = dirs.find(key);
+    return it != dirs.end() ? &it->second : nullptr;
+}
+
+off64_t ApkAssets::getDataOffset(Entry const &entry) const {
+    char header[30];
+    if(!readAt(entry.localHeaderOffset, header, sizeof(header)) || read32(header) != localHeaderSignature)
+        return -1;
+    uint64_t data = entry.localHeaderOffset + 30 + read16(header + 26) + read16(header + 28);
+    if(data > size || size - data < entry.compressedSize)
+        return -1;
+    return (off64_t)data;
+}
+
+ApkAssets::Mapping ApkAssets::map(Entry const &entry) const {
+    Mapping ret;
+    off64_t off = getDataOffset(entry);
+    if(off == -1)
+        return ret;
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    uint64_t start = (uint64_t)off & ~(uint64_t)(page - 1);
+    size_t fileLength = (size_t)((uint64_t)off - start + entry.compressedSize);
+    // The zero byte lands in the anonymous reservation if the data ends on a page boundary, otherwise the write copies
+    // the last page of the private file mapping
+    size_t total = (fileLength + 1 + page - 1) / page * page;
+    void *ptr = mmap(nullptr, total, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(ptr == MAP_FAILED) {
+        Log::error("ApkAssets", "Failed to reserve %zu bytes for an asset of %s", total, path.c_str());
+        return ret;
+    }
+    if(fileLength > 0 && mmap(ptr, fileLength, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, (off_t)start) == MAP_FAILED) {
+        Log::error("ApkAssets", "Failed to map an asset of %s", path.c_str());
+        munmap(ptr, total);
+        return ret;
+    }
+    ((char *)ptr)[fileLength] = 0;
+    mprotect(ptr, total, PROT_READ);
+    ret.address = ptr;
+    ret.length = total;
+    ret.data = (const char *)ptr + ((uint64_t)off - start);
+    return ret;
+}
+
+ApkAssets::Mapping::Mapping(Mapping &&other) noexcept : address(other.address), length(other.length), data(other.data) {
+    other.address = nullptr;
+    other.data = nullptr;
+}
+
+ApkAssets::Mapping &ApkAssets::Mapping::operator=(Mapping &&other) noexcept {
+    std::swap(address, other.address);
+    std::swap(length, other.length);
+    std::swap(data, other.data);
+    return *this;
+}
+
+ApkAssets::Mapping::~Mapping() {
+    if(address)
+        munmap(address, length);
+}
+
+void ApkAssets::willNeed(Entry const &entry) const {
+    off64_t off = getDataOffset(entry);
+    if(off == -1 || entry.compressedSize == 0)
+        return;
+#ifdef __APPLE__
+    struct radvisory ra;
+    ra.ra_offset = (off_t)off;
+    ra.ra_count = (int)std::min<uint64_t>(entry.compressedSize, INT32_MAX);
+    fcntl(fd, F_RDADVISE, &ra);
+#else
+    posix_fadvise(fd, (off_t)off, (off_t)entry.compressedSize, POSIX_FADV_WILLNEED);
+#endif
+}
+
+std::shared_ptr<std::string> ApkAssets::findBlock(size_t entry, uint64_t block) {
+    std::lock_guard<std::mutex> lock(blockMutex);
+    for(auto it = blockLru.begin(); it != blockLru.end(); it++) {
+        if(it->first.first == entry && it->first.second == block) {
+            blockLru.splice(blockLru.begin(), blockLru, it);
+            return it->second;
+        }
+    }
+    return nullptr;
+}
+
+void ApkAssets::storeBlock(size_t entry, uint64_t block, std::shared_ptr<std::string> data) {
+    std::lock_guard<std::mutex> lock(blockMutex);
+    blockLru.emplace_front(std::make_pair(entry, block), std::move(data));
+    if(blockLru.size() > maxCachedBlocks)
+        blockLru.pop_back();
+}
+
+ApkAssets::Inflater::Inflater(ApkAssets &apk, Entry const &entry) : apk(apk), entry(entry), inputMapping(apk.map(entry)) {
+    input = inputMapping.getData();
+}
+
+ApkAssets::Inflater::~Inflater() {
+    if(stream) {
+        inflateEnd((z_stream *)stream);
+        delete(z_stream *)stream;
+    }
+}
+
+bool ApkAssets::Inflater::reset() {
+    if(!input)
+        return false;
+    if(!stream) {
+        auto z = new z_stream{};
+        if(inflateInit2(z, -MAX_WBITS) != Z_OK) {
+            delete z;
+            return false;
+        }
+        stream = z;
+    } else if(inflateReset((z_stream *)stream) != Z_OK) {
+        return false;
+    }
+    auto z = (z_stream *)stream;
+    z->next_in = (Bytef *)input;
+    z->avail_in = 0;
+    produced = 0;
+    return true;
+}
+
+std::shared_ptr<std::string> ApkAssets::Inflater::inflateBlock() {
+    auto z = (z_stream *)stream;
+    auto block = std::make_shared<std::string>();
+    block->resize((size_t)std::min<uint64_t>(blockSize, entry.uncompressedSize - produced));
+    z->next_out = (Bytef *)&(*block)[0];
+    z->avail_out = (uInt)block->size();
+    while(z->avail_out > 0) {
+        uint64_t consumed = (uint64_t)((const char *)z->next_in - input);
+        if(z->avail_in == 0)
+            z->avail_in = (uInt)std::min<uint64_t>(entry.compressedSize - consumed, 1024 * 1024);
+        int ret = inflate(z, Z_NO_FLUSH);
+        if(ret == Z_STREAM_END)
+            break;
+        if(ret != Z_OK)
+            return nullptr;
+    }
+    if(z->avail_out > 0)
+        return nullptr;
+    produced += block->size();
+    return block;
+}
+
+ssize_t ApkAssets::Inflater::read(uint64_t pos, char *buf, size_t count) {
+    size_t done = 0;
+    while(done < count && pos + done < entry.uncompressedSize) {
+        uint64_t off = pos + done;
+        uint64_t blockIndex = off / blockSize;
+        auto block = apk.findBlock(entry.index, blockIndex);
+        if(!block) {
+            // Deflate streams can only be decoded front to back, restart when seeking backwards
+            if(!stream || produced > blockIndex * blockSize) {
+                if(!reset())
+                    return done ? (ssize_t)done : -1;
+            }
+            while(!block) {
+                uint64_t current = produced / blockSize;
+                auto data = inflateBlock();
+                if(!data) {
+                    Log::error("ApkAssets", "Corrupt deflate stream in %s", apk.path.c_str());
+                    return done ? (ssize_t)done : -1;
+                }
+                apk.storeBlock(entry.index, current, data);
+                if(current == blockIndex)
+                    block = std::move(data);
+            }
+        }
+        size_t inBlock = (size_t)(off - blockIndex * blockSize);
+        size_t n = std::min(count - done, block->size() - inBlock);
+        memcpy(buf + done, block->data() + inBlock, n);
+        done += n;
+    }
+    return (ssize_t)done;
+}
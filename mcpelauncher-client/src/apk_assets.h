@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <sys/types.h>
+#include <android/compat.h>
+
+/*
+ * Read-only view of the assets/ folder of an APK. The central directory is read once and indexed by asset path, the
+ * data of an entry is only mapped while an asset of it is open, which keeps the address space used by a large APK
+ * small on 32 bit hosts. Stored entries are served straight from their mapping and deflated ones through
+ * ApkAssets::Inflater.
+ */
+class ApkAssets {
+public:
+    struct Entry {
+        uint16_t method;
+        uint64_t compressedSize;
+        uint64_t uncompressedSize;
+        uint64_t localHeaderOffset;
+        size_t index;
+    };
+
+    // Private read-only mapping of the data of an entry as stored in the archive, followed by a zero byte
+    class Mapping {
+        void *address = nullptr;
+        size_t length = 0;
+        const char *data = nullptr;
+
+        friend class ApkAssets;
+
+    public:
+        Mapping() = default;
+        Mapping(Mapping &&other) noexcept;
+        Mapping &operator=(Mapping &&other) noexcept;
+        ~Mapping();
+
+        // nullptr if the entry couldn't be mapped
+        const char *getData() const {
+            return data;
+        }
+    };
+
+    // Sequential inflater of one deflated entry, decompressed blocks are shared between all readers of the archive
+    class Inflater {
+        ApkAssets &apk;
+        Entry const &entry;
+        void *stream = nullptr;
+        Mapping inputMapping;
+        const char *input;
+        uint64_t produced = 0;
+
+        bool reset();
+        std::shared_ptr<std::string> inflateBlock();
+
+    public:
+        Inflater(ApkAssets &apk, Entry const &entry);
+        ~Inflater();
+
+        // False if the compressed data couldn't be mapped
+        bool isValid() const {
+            return input != nullptr;
+        }
+
+        Inflater(Inflater const &) = delete;
+        Inflater &operator=(Inflater const &) = delete;
+
+        ssize_t read(uint64_t pos, char *buf, size_t count);
+    };
+
+    static constexpr size_t blockSize = 64 * 1024;
+    static constexpr size_t maxCachedBlocks = 32;
+
+private:
+    std::string path;
+    int fd = -1;
+    uint64_t size = 0;
+    std::unordered_map<std::string, Entry> entries;
+    std::unordered_map<std::string, std::vector<std::string>> dirs;
+
+    std::mutex blockMutex;
+    std::list<std::pair<std::pair<size_t, uint64_t>, std::shared_ptr<std::string>>> blockLru;
+
+    bool readAt(uint64_t offset, void *buf, size_t length) const;
+    bool readCentralDirectory();
+    void addEntry(std::string name, Entry entry);
+
+    std::shared_ptr<std::string> findBlock(size_t entry, uint64_t block);
+    void storeBlock(size_t entry, uint64_t block, std::shared_ptr<std::string> data);
+
+public:
+    ~ApkAssets();
+
+    static std::unique_ptr<ApkAssets> open(std::string const &path);
+
+    std::string const &getPath() const {
+        return path;
+    }
+
+    Entry const *find(std::string const &name) const;
+
+    // Entry names (files and directories) directly below dir, nullptr if there is no such directory
+    std::vector<std::string> const *list(std::string const &dir) const;
+
+    // Maps the data of an entry as stored in the archive, the mapping has no data if the local header is corrupt or
+    // mmap failed
+    Mapping map(Entry const &entry) const;
+    off64_t getDataOffset(Entry const &entry) const;
+
+    // Asks the kernel to read the data of an entry ahead
+    void willNeed(Entry const &entry) const;
+};
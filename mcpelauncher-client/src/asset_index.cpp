@@ -0,0 +1,179 @@
+#include "asset_index.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <log.h>
+
+namespace {
+
+constexpr char indexMagic[8] = {'M', 'C', 'A', 'I', 'D', 'X', '0', '1'};
+
+bool statDir(std::string const &path, struct stat &st) {
+    return stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+void getMtime(struct stat const &st, int64_t &sec, int64_t &nsec) {
+#ifdef __APPLE__
+    sec = st.st_mtimespec.tv_sec;
+    nsec = st.st_mtimespec.tv_nsec;
+#else
+    sec = st.st_mtim.tv_sec;
+    nsec = st.st_mtim.tv_nsec;
+#endif
+}
+
+template <typename T>
+void writeValue(std::ostream &s, T v) {
+    s.write((const char *)&v, sizeof(v));
+}
+
+template <typename T>
+bool readValue(std::istream &s, T &v) {
+    return (bool)s.read((char *)&v, sizeof(v));
+}
+
+void writeString(std::ostream &s, std::string const &str) {
+    writeValue<uint32_t>(s, (uint32_t)str.size());
+    s.write(str.data(), str.size());
+}
+
+bool readString(std::istream &s, std::string &str) {
+    uint32_t len;
+    if(!readValue(s, len) || len > 4096)
+        return false;
+    str.resize(len);
+    return len == 0 || (bool)s.read(&str[0], len);
+}
+
+}  // namespace
+
+std::unique_ptr<AssetDirIndex> AssetDirIndex::load(std::string const &rootDir, std::string const &indexPath) {
+    std::unique_ptr<AssetDirIndex> ret(new AssetDirIndex);
+    ret->rootDir = rootDir;
+    if(!indexPath.empty() && ret->read(indexPath) && ret->isValid()) {
+        Log::trace("AssetDirIndex", "Using asset index %s", indexPath.c_str());
+        return ret;
+    }
+    ret->dirs.clear();
+    std::set<std::pair<dev_t, ino_t>> visited;
+    if(!ret->scan("", 0, visited))
+        return nullptr;
+    if(!indexPath.empty())
+        ret->write(indexPath);
+    Log::info("AssetDirIndex", "Indexed %zu asset directories of %s", ret->dirs.size(), rootDir.c_str());
+    return ret;
+}
+
+bool AssetDirIndex::scan(std::string const &dir, int depth, std::set<std::pair<dev_t, ino_t>> &visited) {
+    // Bounds the recursion, symlink loops are caught by visited
+    if(depth > 64)
+        return true;
+    std::string path = rootDir + dir;
+    struct stat st;
+    if(!statDir(path, st))
+        return false;
+    // A directory reached again through a symlink is left out, its listing falls back to the host
+    if(!visited.emplace(st.st_dev, st.st_ino).second)
+        return true;
+    Dir entry;
+    getMtime(st, entry.mtimeSec, entry.mtimeNsec);
+    DIR *d = opendir(path.c_str());
+    if(!d)
+        return false;
+    std::vector<std::string> subdirs;
+    while(dirent *ent = readdir(d)) {
+        std::string name = ent->d_name;
+        if(name == "." || name == "..")
+            continue;
+        bool isDir = ent->d_type == DT_DIR;
+        if(ent->d_type == DT_UNKNOWN || ent->d_type == DT_LNK) {
+            struct stat st;
+            isDir = stat((path + "/" + name).c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+        }
+        if(isDir)
+            subdirs.push_back(dir.empty() ? name : dir + "/" + name);
+        entry.entries.push_back(std::move(name));
+    }
+    closedir(d);
+    std::sort(entry.entries.begin(), entry.entries.end());
+    dirs[dir] = std::move(entry);
+    for(auto &&sub : subdirs)
+        scan(sub, depth + 1, visited);
+    return true;
+}
+
+bool AssetDirIndex::isValid() const {
+    // Adding, removing or renaming an entry updates the mtime of its parent directory
+    for(auto &&d : dirs) {
+        struct stat st;
+        int64_t sec, nsec;
+        if(!statDir(rootDir + d.first, st))
+            return false;
+        getMtime(st, sec, nsec);
+        if(sec != d.second.mtimeSec || nsec != d.second.mtimeNsec)
+            return false;
+    }
+    return !dirs.empty();
+}
+
+bool AssetDirIndex::read(std::string const &indexPath) {
+    std::ifstream s(indexPath, std::ios::binary);
+    char magic[sizeof(indexMagic)];
+    std::string root;
+    uint32_t dirCount;
+    if(!s.read(magic, sizeof(magic)) || !std::equal(magic, magic + sizeof(magic), indexMagic) || !readString(s, root) ||
+       root != rootDir || !readValue(s, dirCount))
+        return false;
+    for(uint32_t i = 0; i < dirCount; i++) {
+        std::string name;
+        Dir d;
+        uint32_t entryCount;
+        if(!readString(s, name) || !readValue(s, d.mtimeSec) || !readValue(s, d.mtimeNsec) || !readValue(s, entryCount))
+            return false;
+        d.entries.resize(entryCount);
+        for(auto &&e : d.entries) {
+            if(!readString(s, e))
+                return false;
+        }
+        dirs[std::move(name)] = std::move(d);
+    }
+    return dirs.size() == dirCount;
+}
+
+void AssetDirIndex::write(std::string const &indexPath) const {
+    std::string tmpPath = indexPath + ".tmp";
+    {
+        std::ofstream s(tmpPath, std::ios::binary | std::ios::trunc);
+        if(!s)
+            return;
+        s.write(indexMagic, sizeof(indexMagic));
+        writeString(s, rootDir);
+        writeValue<uint32_t>(s, (uint32_t)dirs.size());
+        for(auto &&d : dirs) {
+            writeString(s, d.first);
+            writeValue(s, d.second.mtimeSec);
+            writeValue(s, d.second.mtimeNsec);
+            writeValue<uint32_t>(s, (uint32_t)d.second.entries.size());
+            for(auto &&e : d.second.entries)
+                writeString(s, e);
+        }
+        if(!s) {
+            s.close();
+            remove(tmpPath.c_str());
+            return;
+        }
+    }
+    if(rename(tmpPath.c_str(), indexPath.c_str()) != 0)
+        remove(tmpPath.c_str());
+}
+
+std::vector<std::string> const *AssetDirIndex::list(std::string const &dir) const {
+    std::string key = dir;
+    while(!key.empty() && key.back() == '/')
+        key.pop_back();
+    auto it = dirs.find(key);
+    return it != dirs.end() ? &it->second.entries : nullptr;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <sys/types.h>
+
+/*
+ * Immutable listing of an extracted asset tree. It is built once per game directory and persisted as a sidecar file,
+ * which is reused as long as the number of directories and the mtime of every directory match.
+ */
+class AssetDirIndex {
+    struct Dir {
+        int64_t mtimeSec;
+        int64_t mtimeNsec;
+        std::vector<std::string> entries;
+    };
+
+    std::string rootDir;
+    std::unordered_map<std::string, Dir> dirs;
+
+    bool scan(std::string const &dir, int depth, std::set<std::pair<dev_t, ino_t>> &visited);
+    bool isValid() const;
+    bool read(std::string const &indexPath);
+    void write(std::string const &indexPath) const;
+
+public:
+    // rootDir has to end with a '/', indexPath may be empty to not persist the index
+    static std::unique_ptr<AssetDirIndex> load(std::string const &rootDir, std::string const &indexPath);
+
+    // Entry names (files and directories) directly below dir, nullptr if there is no such directory
+    std::vector<std::string> const *list(std::string const &dir) const;
+};
@@ -0,0 +1,122 @@
+#include "asset_prefetcher.h"
+
+#include <cstdio>
+#include <fstream>
+#include <log.h>
+
+AssetPrefetcher::AssetPrefetcher(std::string tracePath, std::function<void(std::string const &)> prefetch,
+                                 size_t threadCount, std::chrono::steady_clock::duration recordDuration)
+    : tracePath(std::move(tracePath)), prefetch(std::move(prefetch)), recordDuration(recordDuration) {
+    std::ifstream s(this->tracePath);
+    std::string line;
+    while(std::getline(s, line)) {
+        if(!line.empty() && states.emplace(line, State::Pending).second)
+            trace.push_back(line);
+    }
+    if(trace.empty())
+        return;
+    Log::info("AssetPrefetcher", "Prefetching %zu assets using %zu threads", trace.size(), threadCount);
+    for(size_t i = 0; i < threadCount; i++)
+        threads.emplace_back(&AssetPrefetcher::worker, this);
+}
+
+AssetPrefetcher::~AssetPrefetcher() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    stopCondition.notify_all();
+    for(auto &&t : threads)
+        t.join();
+    if(recordTimer.joinable())
+        recordTimer.join();
+    std::lock_guard<std::mutex> lock(mutex);
+    // Exiting before the record duration passed, don't drop what the previous launch opened later
+    if(recording && recordStarted)
+        finishRecording(false);
+}
+
+void AssetPrefetcher::worker() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while(!stopping && nextIndex < trace.size()) {
+        auto &name = trace[nextIndex++];
+        auto &state = states[name];
+        // The game got there first
+        if(state != State::Pending)
+            continue;
+        state = State::Running;
+        lock.unlock();
+        prefetch(name);
+        lock.lock();
+        states[name] = State::Done;
+    }
+}
+
+void AssetPrefetcher::recordTimeout() {
+    std::unique_lock<std::mutex> lock(mutex);
+    if(stopCondition.wait_until(lock, recordStart + recordDuration, [this] { return stopping || !recording; }))
+        return;
+    finishRecording();
+}
+
+void AssetPrefetcher::onOpen(std::string const &name) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if(opened.insert(name).second) {
+        auto it = states.find(name);
+        if(it == states.end()) {
+            stats.misses++;
+        } else if(it->second == State::Done) {
+            stats.hits++;
+        } else {
+            stats.late++;
+            if(it->second == State::Pending)
+                it->second = State::Opened;
+        }
+    }
+
+    if(!recording)
+        return;
+    auto now = std::chrono::steady_clock::now();
+    if(!recordStarted) {
+        recordStarted = true;
+        recordStart = now;
+        recordTimer = std::thread(&AssetPrefetcher::recordTimeout, this);
+    }
+    if(recordedSet.insert(name).second)
+        recorded.push_back(name);
+    if(now - recordStart >= recordDuration)
+        finishRecording();
+}
+
+void AssetPrefetcher::finishRecording(bool complete) {
+    recording = false;
+    stopCondition.notify_all();
+    Log::info("AssetPrefetcher", "Recorded %zu assets%s, %zu prefetch hits, %zu late, %zu misses", recorded.size(),
+              complete ? "" : " before exiting", stats.hits, stats.late, stats.misses);
+    if(!complete) {
+        for(auto &&name : trace) {
+            if(recordedSet.insert(name).second)
+                recorded.push_back(name);
+        }
+    }
+    std::string tmpPath = tracePath + ".tmp";
+    {
+        std::ofstream s(tmpPath, std::ios::trunc);
+        for(auto &&name : recorded)
+            s << name << '\n';
+        if(!s) {
+            s.close();
+            remove(tmpPath.c_str());
+            return;
+        }
+    }
+    if(rename(tmpPath.c_str(), tracePath.c_str()) != 0)
+        remove(tmpPath.c_str());
+    recorded.clear();
+    recordedSet.clear();
+}
+
+AssetPrefetcher::Stats AssetPrefetcher::getStats() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
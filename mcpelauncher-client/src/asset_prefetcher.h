@@ -0,0 +1,73 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+/*
+ * Records the order in which assets are opened during startup and replays it on the next launch, warming up the page
+ * cache from background threads before the game's loading thread blocks on the reads.
+ */
+class AssetPrefetcher {
+public:
+    // Only the first open of every asset is counted
+    struct Stats {
+        // Opened after the prefetch completed
+        size_t hits = 0;
+        // Listed in the trace, but the prefetch didn't complete in time
+        size_t late = 0;
+        // Not listed in the trace
+        size_t misses = 0;
+    };
+
+private:
+    // Opened: the game opened it before a worker got to it
+    enum class State { Pending, Running, Done, Opened };
+
+    std::string tracePath;
+    std::function<void(std::string const &)> prefetch;
+    std::chrono::steady_clock::duration recordDuration;
+
+    std::mutex mutex;
+    std::vector<std::string> trace;
+    std::unordered_map<std::string, State> states;
+    size_t nextIndex = 0;
+    std::vector<std::thread> threads;
+    std::atomic<bool> stopping{false};
+    std::condition_variable stopCondition;
+    // Writes the trace once the record duration passed, even if the game stops opening assets before
+    std::thread recordTimer;
+
+    bool recording = true;
+    bool recordStarted = false;
+    std::chrono::steady_clock::time_point recordStart;
+    std::vector<std::string> recorded;
+    std::unordered_set<std::string> recordedSet;
+    std::unordered_set<std::string> opened;
+    Stats stats;
+
+    void worker();
+    void recordTimeout();
+    // An incomplete recording keeps the rest of the previous trace after the assets recorded so far
+    void finishRecording(bool complete = true);
+
+public:
+    AssetPrefetcher(std::string tracePath, std::function<void(std::string const &)> prefetch, size_t threadCount,
+                    std::chrono::steady_clock::duration recordDuration = std::chrono::seconds(60));
+    ~AssetPrefetcher();
+
+    AssetPrefetcher(AssetPrefetcher const &) = delete;
+    AssetPrefetcher &operator=(AssetPrefetcher const &) = delete;
+
+    // Called for every asset opened by the game
+    void onOpen(std::string const &name);
+
+    Stats getStats();
+};
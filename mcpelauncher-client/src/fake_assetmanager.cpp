@@ -1,33 +1,190 @@
 #include <cstdio>
 #include <cstring>
 #include <cerrno>
-#include <FileUtil.h>
 #include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <dirent.h>
+#include <algorithm>
+#include <climits>
+#include <memory>
 #include <log.h>
 #include <libc_shim.h>
 #include <android/compat.h>
 #include "fake_assetmanager.h"
+#include "apk_assets.h"
+#include "asset_index.h"
+#include "asset_prefetcher.h"
 
+// Access modes of AAssetManager_open, android/asset_manager.h can't be included next to the hooks
+enum {
+    AASSET_MODE_UNKNOWN = 0,
+    AASSET_MODE_RANDOM = 1,
+    AASSET_MODE_STREAMING = 2,
+    AASSET_MODE_BUFFER = 3
+};
+
+/*
+ * AAssets opened with AASSET_MODE_STREAMING keep the file descriptor and read through a small buffer, every other mode
+ * maps the file read-only so AAsset_getBuffer and AAsset_read are served straight from the page cache.
+ * Assets of an APK map their entry if stored, deflated ones are read through an inflater. Entries that are missing
+ * from the APK or can't be mapped are opened from the extracted assets instead.
+ */
 struct AAsset {
-    std::string buffer;
+    std::string path;
+    int fd = -1;
+    off64_t start = 0;
+    off64_t length = 0;
     off64_t offset = 0;
+    const char *data = nullptr;
+    size_t mappingLength = 0;
+    ApkAssets::Mapping apkMapping;
+    std::unique_ptr<char[]> streamBuffer;
+    off64_t streamBufferStart = 0;
+    size_t streamBufferFill = 0;
+    std::unique_ptr<ApkAssets::Inflater> inflater;
+    std::string inflated;
+
+    static constexpr size_t streamBufferSize = 16 * 1024;
+
+    ~AAsset() {
+        if(mappingLength)
+            munmap((void *)data, mappingLength);
+        if(fd != -1)
+            close(fd);
+    }
+
+    bool map() {
+        if(data)
+            return true;
+        if(length == 0) {
+            data = "";
+            return true;
+        }
+        if(inflater) {
+            inflated.resize((size_t)length);
+            if(inflater->read(0, &inflated[0], inflated.size()) != length)
+                return false;
+            data = inflated.data();
+            return true;
+        }
+        // AAsset_getBuffer hands out NUL terminated data like the std::string it used to return. The kernel zero fills
+        // the rest of the last page, only files ending on a page boundary need an extra zero page behind the mapping
+        size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+        size_t total = ((size_t)length + 1 + pageSize - 1) / pageSize * pageSize;
+        void *ptr = mmap(nullptr, total, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(ptr == MAP_FAILED)
+            return false;
+        if(mmap(ptr, (size_t)length, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+            munmap(ptr, total);
+            return false;
+        }
+        data = (const char *)ptr;
+        mappingLength = total;
+        return true;
+    }
+
+    ssize_t readStreaming(char *buf, size_t count) {
+        size_t done = 0;
+        while(done < count) {
+            off64_t pos = offset + (off64_t)done;
+            if(pos >= streamBufferStart && pos < streamBufferStart + (off64_t)streamBufferFill) {
+                size_t n = std::min(count - done, (size_t)(streamBufferStart + streamBufferFill - pos));
+                memcpy(buf + done, streamBuffer.get() + (pos - streamBufferStart), n);
+                done += n;
+                continue;
+            }
+            // Large reads bypass the buffer
+            bool direct = count - done >= streamBufferSize;
+            if(!direct && !streamBuffer)
+                streamBuffer.reset(new char[streamBufferSize]);
+            ssize_t r = direct ? pread(fd, buf + done, count - done, pos) : pread(fd, streamBuffer.get(), streamBufferSize, pos);
+            if(r < 0 && errno == EINTR)
+                continue;
+            if(r < 0)
+                return done ? (ssize_t)done : -1;
+            if(r == 0)
+                break;
+            if(direct) {
+                done += r;
+            } else {
+                streamBufferStart = pos;
+                streamBufferFill = (size_t)r;
+            }
+        }
+        return (ssize_t)done;
+    }
 };
 struct AAssetDir {
     DIR *dir;
     dirent *ent;
+    // Listing of the APK or the directory index, dir is only used if neither has the directory
+    std::vector<std::string> const *entries;
+    size_t next;
     std::string dirname;
     std::string currentFileName;
 };
 
-FakeAssetManager::FakeAssetManager(std::string rootDir) {
+FakeAssetManager::FakeAssetManager(std::string rootDir, std::string const &apkPath, std::string const &indexPath) {
     if(!rootDir.empty() && *rootDir.rbegin() != '/')
         rootDir += '/';
     this->rootDir = std::move(rootDir);
+    if(!apkPath.empty())
+        apk = ApkAssets::open(apkPath);
+    if(!apk)
+        dirIndex = AssetDirIndex::load(this->rootDir, indexPath);
+}
+
+void FakeAssetManager::prefetch(std::string const &filename) const {
+    if(apk) {
+        auto entry = apk->find(filename);
+        if(entry)
+            apk->willNeed(*entry);
+        return;
+    }
+    int fd = open((rootDir + filename).c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd == -1)
+        return;
+#ifdef __APPLE__
+    struct radvisory ra;
+    ra.ra_offset = 0;
+    struct stat st;
+    ra.ra_count = fstat(fd, &st) == 0 ? (int)std::min<off_t>(st.st_size, INT32_MAX) : 0;
+    fcntl(fd, F_RDADVISE, &ra);
+#else
+    posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+#endif
+    close(fd);
 }
 
 namespace fake_assetmanager {
 
+// Returns nullptr and sets found if the entry exists but couldn't be mapped
+static AAsset *openApkAsset(ApkAssets &apk, const char *filename, bool &found) {
+    auto entry = apk.find(filename);
+    found = entry != nullptr;
+    if(!entry)
+        return nullptr;
+    std::unique_ptr<AAsset> ret(new AAsset);
+    ret->path = apk.getPath();
+    ret->length = (off64_t)entry->uncompressedSize;
+    if(entry->method == 0) {
+        ret->start = apk.getDataOffset(*entry);
+        ret->apkMapping = apk.map(*entry);
+        ret->data = ret->apkMapping.getData();
+        if(!ret->data)
+            return nullptr;
+    } else {
+        ret->start = -1;
+        ret->inflater.reset(new ApkAssets::Inflater(apk, *entry));
+        if(!ret->inflater->isValid())
+            return nullptr;
+    }
+    return ret.release();
+}
+
 AAsset *AAssetManager_open(FakeAssetManager *amgr, const char *filename, int mode) {
     std::string fullPath;
     if(filename == NULL) {
@@ -48,13 +205,38 @@ AAsset *AAssetManager_open(FakeAssetManager *amgr, const char *filename, int mod
     Log::trace("AAssetManager", "Opening file '%s' as '%s'\n", filename, fullPath.c_str());
 #endif
 
-    std::string content;
-    if(!FileUtil::readFile(fullPath, content))
+    if(amgr->prefetcher)
+        amgr->prefetcher->onOpen(filename);
+    if(amgr->apk) {
+        bool found;
+        if(auto asset = openApkAsset(*amgr->apk, filename, found))
+            return asset;
+        // Assets missing from the APK are looked up in the extracted tree as well
+        if(found)
+            Log::warn("AAssetManager", "Failed to map %s from the APK, opening the extracted asset", filename);
+    }
+
+    int fd = open(fullPath.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd == -1)
         return nullptr;
+    struct stat st;
+    if(fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return nullptr;
+    }
 
-    auto ret = new AAsset;
-    ret->buffer = content;
-    return ret;
+    std::unique_ptr<AAsset> ret(new AAsset);
+    ret->path = std::move(fullPath);
+    ret->fd = fd;
+    ret->length = st.st_size;
+    if(mode != AASSET_MODE_STREAMING) {
+        if(!ret->map())
+            return nullptr;
+        // The mapping keeps the file alive, don't hold on to a descriptor per open asset
+        close(ret->fd);
+        ret->fd = -1;
+    }
+    return ret.release();
 }
 
 AAssetDir *AAssetManager_openDir(FakeAssetManager *amgr, const char *dirname) {
@@ -77,13 +259,24 @@ AAssetDir *AAssetManager_openDir(FakeAssetManager *amgr, const char *dirname) {
     Log::trace("AAssetManager", "Opening directory '%s' as '%s'\n", dirname, fullPath.c_str());
 #endif
 
-    DIR *d = opendir(fullPath.c_str());
-    if(!d)
-        return nullptr;
+    DIR *d = nullptr;
+    std::vector<std::string> const *entries = nullptr;
+    if(amgr->apk)
+        entries = amgr->apk->list(dirname);
+    else if(amgr->dirIndex)
+        entries = amgr->dirIndex->list(dirname);
+    // The listings only know normalized paths ("a/./b", "a//b" miss), the host resolves those
+    if(!entries) {
+        d = opendir(fullPath.c_str());
+        if(!d)
+            return nullptr;
+    }
 
     auto ret = new AAssetDir;
     ret->dir = d;
     ret->ent = nullptr;
+    ret->entries = entries;
+    ret->next = 0;
     ret->dirname = dirname;
     return ret;
 }
@@ -93,28 +286,37 @@ void AAsset_close(AAsset *asset) {
 }
 
 int AAsset_isAllocated(AAsset *asset) {
-    return true;
+    return !asset->inflated.empty();
 }
 
 ssize_t AAsset_read(AAsset *asset, void *buf, size_t count) {
-    if(asset->offset > asset->buffer.size()) {
+    if(asset->offset >= asset->length) {
         return 0;
     }
-    size_t max_len = asset->buffer.size() - asset->offset;
+    size_t max_len = (size_t)(asset->length - asset->offset);
     if(count > max_len) {
         count = max_len;
     }
     if(count == 0) {
         return 0;
     }
-    memcpy(buf, &asset->buffer[asset->offset], count);
-    asset->offset += count;
-    return (ssize_t)count;
+    ssize_t ret;
+    if(asset->data) {
+        memcpy(buf, asset->data + asset->offset, count);
+        ret = (ssize_t)count;
+    } else if(asset->inflater) {
+        ret = asset->inflater->read((uint64_t)asset->offset, (char *)buf, count);
+    } else {
+        ret = asset->readStreaming((char *)buf, count);
+    }
+    if(ret > 0)
+        asset->offset += ret;
+    return ret;
 }
 
 off64_t AAsset_seek64(AAsset *asset, off64_t offset, int whence) {
     off64_t cur_pos = asset->offset;
-    off64_t max_pos = asset->buffer.size();
+    off64_t max_pos = asset->length;
     off64_t new_offset;
 
     if(whence == SEEK_SET) {
@@ -123,6 +325,8 @@ off64_t AAsset_seek64(AAsset *asset, off64_t offset, int whence) {
         new_offset = cur_pos + offset;
     } else if(whence == SEEK_END) {
         new_offset = max_pos + offset;
+    } else {
+        return -1;
     }
     if(new_offset < 0 || new_offset > max_pos)
         return -1;
@@ -135,38 +339,70 @@ off_t AAsset_seek(AAsset *asset, off_t offset, int whence) {
 }
 
 off64_t AAsset_getLength64(AAsset *asset) {
-    return (off64_t)asset->buffer.size();
+    return asset->length;
 }
 
 off_t AAsset_getLength(AAsset *asset) {
-    return (off_t)asset->buffer.size();
+    return (off_t)asset->length;
 }
 
 off64_t AAsset_getRemainingLength64(AAsset *asset) {
-    return (off64_t)(asset->buffer.size() - asset->offset);
+    return asset->length - asset->offset;
 }
 
 off_t AAsset_getRemainingLength(AAsset *asset) {
-    return (off_t)(asset->buffer.size() - asset->offset);
+    return (off_t)(asset->length - asset->offset);
 }
 
 const void *AAsset_getBuffer(AAsset *asset) {
-    return asset->buffer.c_str();
+    // Streaming assets are mapped on demand
+    if(!asset->map())
+        return nullptr;
+    return asset->data;
+}
+
+int AAsset_openFileDescriptor64(AAsset *asset, off64_t *outStart, off64_t *outLength) {
+    // Compressed assets have no file representation
+    if(asset->start == -1)
+        return -1;
+    int fd = open(asset->path.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd == -1)
+        return -1;
+    *outStart = asset->start;
+    *outLength = asset->length;
+    return fd;
+}
+
+int AAsset_openFileDescriptor(AAsset *asset, off_t *outStart, off_t *outLength) {
+    off64_t start, length;
+    int fd = AAsset_openFileDescriptor64(asset, &start, &length);
+    if(fd == -1)
+        return -1;
+    *outStart = (off_t)start;
+    *outLength = (off_t)length;
+    return fd;
 }
 
 void AAssetDir_close(AAssetDir *assetDir) {
-    if(assetDir)
+    if(assetDir && assetDir->dir)
         closedir(assetDir->dir);
     delete assetDir;
 }
 
 void AAssetDir_rewind(AAssetDir *assetDir) {
-    rewinddir(assetDir->dir);
+    if(assetDir->dir)
+        rewinddir(assetDir->dir);
+    assetDir->next = 0;
 }
 
 const char *AAssetDir_getNextFileName(AAssetDir *assetDir) {
     if(!assetDir)
         return nullptr;
+    if(assetDir->entries) {
+        if(assetDir->next >= assetDir->entries->size())
+            return nullptr;
+        return (*assetDir->entries)[assetDir->next++].data();
+    }
     assetDir->ent = readdir(assetDir->dir);
     if(!assetDir->ent)
         return nullptr;
@@ -197,6 +433,8 @@ void FakeAssetManager::initHybrisHooks(std::unordered_map<std::string, void *> &
     syms["AAsset_getRemainingLength64"] = (void *)AAsset_getRemainingLength64;
     syms["AAsset_getRemainingLength"] = (void *)AAsset_getRemainingLength;
     syms["AAsset_getBuffer"] = (void *)AAsset_getBuffer;
+    syms["AAsset_openFileDescriptor"] = (void *)AAsset_openFileDescriptor;
+    syms["AAsset_openFileDescriptor64"] = (void *)AAsset_openFileDescriptor64;
     syms["AAssetDir_close"] = (void *)AAssetDir_close;
     syms["AAssetDir_rewind"] = (void *)AAssetDir_rewind;
     syms["AAssetDir_getNextFileName"] = (void *)AAssetDir_getNextFileName;
@@ -6,11 +6,23 @@
 #include <utility>
 
 struct AAssetManager;
+class ApkAssets;
+class AssetDirIndex;
+class AssetPrefetcher;
 
 struct FakeAssetManager {
     std::string rootDir;
+    // Serves the assets from the APK instead of rootDir if set
+    std::shared_ptr<ApkAssets> apk;
+    // Directory listings of rootDir
+    std::shared_ptr<AssetDirIndex> dirIndex;
+    // Records the opened assets and prefetches those of the last launch if set
+    std::shared_ptr<AssetPrefetcher> prefetcher;
 
-    FakeAssetManager(std::string rootDir);
+    FakeAssetManager(std::string rootDir, std::string const &apkPath = std::string(), std::string const &indexPath = std::string());
+
+    // Warms up the page cache for an asset without reading it
+    void prefetch(std::string const &filename) const;
 
     static void initHybrisHooks(std::unordered_map<std::string, void *> &syms);
 
@@ -1,7 +1,15 @@
 #include "fake_egl.h"
 #include "gl_core_patch.h"
+#include "gl_state_cache.h"
+#include "gl_proc_table.h"
 #include "settings.h"
 #include "imgui_ui.h"
+#include "frame_pacer.h"
+#include "frame_stats.h"
+#include "texture_patch.h"
+#include "texture_uploader.h"
+#include "resolution_scaler.h"
+#include "gl_trace.h"
 #include <map>
 
 #define __ANDROID__
@@ -23,6 +31,9 @@ namespace fake_egl {
 static thread_local EGLSurface currentDrawSurface;
 static void *(*hostProcAddrFn)(const char *);
 static std::unordered_map<std::string, void *> hostProcOverrides;
+static GLProcTable procTable;
+// Last interval passed to eglSwapInterval
+static EGLint gameSwapInterval = 1;
 
 EGLBoolean eglInitialize(EGLDisplay display, EGLint *major, EGLint *minor) {
     if(major)
@@ -100,6 +111,10 @@ EGLBoolean eglDestroyContext(EGLDisplay display, EGLContext context) {
 EGLBoolean eglMakeCurrent(EGLDisplay display, EGLSurface draw, EGLSurface read, EGLContext context) {
     if(draw != nullptr) {
         ((GameWindow *)draw)->makeCurrent(true);
+        GLStateCache::invalidate();
+        int w, h;
+        ((GameWindow *)draw)->getWindowSize(w, h);
+        ResolutionScaler::beginFrame(w, h - Settings::menubarsize, 0);
 #ifdef USE_IMGUI
         ImGuiUIInit((GameWindow *)draw);
 #endif
@@ -118,15 +133,30 @@ EGLBoolean eglSwapBuffers(EGLDisplay display, EGLSurface surface) {
         FakeEGL::swapBuffersCallbacksLock.unlock();
     }
     //    Log::trace("FakeEGL", "eglSwapBuffers");
+    ResolutionScaler::present();
 #ifdef USE_IMGUI
     ImGuiUIDrawFrame((GameWindow *)surface);
 #endif
-    ((GameWindow *)surface)->swapBuffers();
+    auto &pacer = FramePacer::instance;
+    pacer.setTargetFps(Settings::fps_limit);
+    pacer.setUnfocusedFps(Settings::fps_limit_unfocused);
+    pacer.present([surface]() {
+        ((GameWindow *)surface)->swapBuffers();
+    });
+    FrameStats::instance.onFrame(FramePacer::Clock::now(), pacer.getLastFrameTiming().cpuTime);
+    GLTrace::instance.onFrame();
+    TextureUploader::onFrame();
+    int w, h;
+    ((GameWindow *)surface)->getWindowSize(w, h);
+    auto timing = pacer.getLastFrameTiming();
+    ResolutionScaler::beginFrame(w, h - Settings::menubarsize, std::chrono::duration<double, std::milli>(timing.cpuTime + timing.swapTime).count());
     return EGL_TRUE;
 }
 
 EGLBoolean eglSwapInterval(EGLDisplay display, EGLint interval) {
-    //((GameWindow *)currentDrawSurface)->setSwapInterval(interval);
+    gameSwapInterval = interval;
+    if(currentDrawSurface)
+        ((GameWindow *)currentDrawSurface)->setSwapInterval(FakeEGL::getWindowSwapInterval());
     return EGL_TRUE;
 }
 
@@ -141,11 +171,14 @@ EGLBoolean eglQuerySurface(EGLDisplay display, EGLSurface surface, EGLint attrib
     return EGL_TRUE;
 }
 
-void *eglGetProcAddress(const char *name) {
+static void *resolveProc(const char *name) {
     auto it = hostProcOverrides.find(name);
-    if(it != hostProcOverrides.end())
-        return it->second;
-    return hostProcAddrFn(name);
+    void *ret = it != hostProcOverrides.end() ? it->second : hostProcAddrFn(name);
+    return GLTrace::instance.wrap(name, ret);
+}
+
+void *eglGetProcAddress(const char *name) {
+    return procTable.get(name, resolveProc);
 }
 
 }  // namespace fake_egl
@@ -162,6 +195,12 @@ void FakeEGL::addSwapBuffersCallback(void *user, void (*callback)(void *user, EG
     swapBuffersCallbacksLock.unlock();
 }
 
+int FakeEGL::getWindowSwapInterval() {
+    if(!Settings::vsync)
+        return 0;
+    return fake_egl::gameSwapInterval > 1 ? fake_egl::gameSwapInterval : 1;
+}
+
 void FakeEGL::installLibrary() {
     std::unordered_map<std::string, void *> syms;
     syms["eglInitialize"] = (void *)fake_egl::eglInitialize;
@@ -189,6 +228,10 @@ void FakeEGL::installLibrary() {
 }
 
 void FakeEGL::setupGLOverrides() {
+    GLTrace::instance.init();
+    // The overrides below resolve the functions they wrap through eglGetProcAddress, which has to see the ones
+    // installed before them
+    fake_egl::procTable.clear();
 #ifdef USE_ARMHF_SUPPORT
     ArmhfSupport::install(fake_egl::hostProcOverrides);
 #endif
@@ -208,92 +251,19 @@ void FakeEGL::setupGLOverrides() {
     fake_egl::hostProcOverrides["glVertexAttribDivisorOES"] = nullptr;
     // MESA 23.1 blackscreen Workaround End
     fake_egl::hostProcOverrides["glInvalidateFramebuffer"] = (void *)+[]() {};  // Stub for a NVIDIA bug
+    TextureUploader::installGL(fake_egl::hostProcOverrides, fake_egl::eglGetProcAddress);
     if(FakeEGL::enableTexturePatch) {
-        // Minecraft Intel/Amd Texture Bug 1.16.210-1.17.2 and beyond
-        // This patch reduces the visual glitch of blocks, does not work with high resolution textures
-        // TODO improve Bugdetection
+        // Patches the client memory, so it has to run before the upload is staged
+        static void (*glTexSubImage2D_next)(unsigned int target, int level, int xoffset, int yoffset, int width, int height, unsigned int format, unsigned int type, const void *data);
+        glTexSubImage2D_next = (decltype(glTexSubImage2D_next))fake_egl::eglGetProcAddress("glTexSubImage2D");
         fake_egl::hostProcOverrides["glTexSubImage2D"] = (void *)+[](unsigned int target, int level, int xoffset, int yoffset, int width, int height, unsigned int format, unsigned int type, const void *data) {
-            if(width == 1024 && height == 1024) {
-                size_t z = 0;
-                for(long long y = 0; y < height; ++y) {
-                    if(*((int32_t *)data + 987 + y * width) == *((int32_t *)data + 988 + y * width) && *((int32_t *)data + 988 + y * width) == *((int32_t *)data + 989 + y * width) && *((int32_t *)data + 989 + y * width) == *((int32_t *)data + 990 + y * width) && *((int32_t *)data + 990 + y * width) != *((int32_t *)data + 991 + y * width)) {
-                        z++;
-                    }
-                }
-                if(z >= 64) {
-                    for(long long y = 0; y < 32; ++y) {
-                        memmove((char *)data + y * width * 4 + 32 * 4, (char *)data + y * width * 4 + 31 * 4, width * 4 - 32 * 4);
-                    }
-                    for(long long y = height - 2; y >= 31; --y) {
-                        memcpy((char *)data + (y + 1) * width * 4 + 32 * 4, (char *)data + y * width * 4 + 31 * 4, width * 4 - 32 * 4);
-                        memcpy((char *)data + (y + 1) * width * 4, (char *)data + y * width * 4, 32 * 4);
-                    }
-                }
-            }
-            if(width == 2048 && height == 1024) {
-                if(*((int32_t *)data + 989 + 1024) == *((int32_t *)data + 990 + 1024) && *((int32_t *)data + 990 + 1024) != *((int32_t *)data + 991 + 1024)) {
-                    for(long long y = 0; y < 32; ++y) {
-                        memmove((char *)data + y * width * 4 + 32 * 4, (char *)data + y * width * 4 + 31 * 4, width * 4 - 32 * 4);
-                    }
-                    for(long long y = height - 2; y >= 31; --y) {
-                        memcpy((char *)data + (y + 1) * width * 4 + 32 * 4, (char *)data + y * width * 4 + 31 * 4, width * 4 - 32 * 4);
-                        memcpy((char *)data + (y + 1) * width * 4, (char *)data + y * width * 4, 32 * 4);
-                    }
-                }
-            }
-
-            if(width == 512 && height == 512) {
-                size_t uscore = 0;
-                size_t itemscorea = 0, itemscoreb = 0, itemscorec = 0, itemscored = 0;
-                for(int y = 0; y < height; ++y) {
-                    if(*((uint32_t *)data + y * width + 511 - 14) != 0) {
-                        ++itemscorea;
-                    }
-                    if(*((uint32_t *)data + y * width + 511 - 13) != 0) {
-                        ++itemscoreb;
-                    }
-                    if(*((uint32_t *)data + y * width + 511 - 12) != 0) {
-                        ++itemscorec;
-                    }
-                    if(*((uint32_t *)data + y * width + 511 - 11) == 0) {
-                        ++itemscored;
-                    }
-                }
-                for(int x = 0; x < width; ++x) {
-                    if(*((uint32_t *)data + 1 * width + x) != 0) {
-                        ++uscore;
-                    }
-                }
-                size_t z = 0;
-                for(long long y = 0; y < height; ++y) {
-                    if(*((int32_t *)data + 511 - 20 + y * width) == *((int32_t *)data + 511 - 19 + y * width) && *((int32_t *)data + 511 - 19 + y * width) == *((int32_t *)data + 511 - 18 + y * width) && *((int32_t *)data + 511 - 18 + y * width) == *((int32_t *)data + 511 - 17 + y * width) && *((int32_t *)data + 511 - 17 + y * width) != *((int32_t *)data + 511 - 16 + y * width)) {
-                        z++;
-                    }
-                }
-                if(z >= 64 || (itemscorea > 64 && itemscoreb > 64 && itemscorec > 64 && itemscored > 64)) {
-                    if(z >= 64 || uscore < 16) {
-                        for(long long y = 0; y < 16; ++y) {
-                            memmove((char *)data + y * width * 4 + 16 * 4, (char *)data + y * width * 4 + 15 * 4, width * 4 - 16 * 4);
-                        }
-                    } else {
-                        for(long long y = 15; y >= 0; --y) {
-                            memcpy((char *)data + (y + 1) * width * 4 + 16 * 4, (char *)data + y * width * 4 + 15 * 4, width * 4 - 16 * 4);
-                        }
-                    }
-                    if(z >= 64) {
-                        for(long long y = height - 2; y >= 16; --y) {
-                            memcpy((char *)data + (y + 1) * width * 4 + 16 * 4, (char *)data + y * width * 4 + 15 * 4, width * 4 - 16 * 4);
-                            memcpy((char *)data + (y + 1) * width * 4, (char *)data + y * width * 4, 16 * 4);
-                        }
-                    } else {
-                        for(long long y = height - 2; y >= 16; --y) {
-                            memcpy((char *)data + (y + 1) * width * 4 + 4, (char *)data + y * width * 4 + 0, width * 4 - 4);
-                        }
-                    }
-                }
-            }
-            ((void (*)(unsigned int target, int level, int xoffset, int yoffset, int width, int height, unsigned int format, unsigned int type, const void *data))(fake_egl::hostProcAddrFn("glTexSubImage2D")))(target, level, xoffset, yoffset, width, height, format, type, data);
+            TexturePatch::apply(width, height, (void *)data);
+            glTexSubImage2D_next(target, level, xoffset, yoffset, width, height, format, type, data);
         };
     }
+    // Before GLCorePatch, so that the binds of its VAO emulation go through the cache
+    GLStateCache::installGL(fake_egl::hostProcOverrides, fake_egl::eglGetProcAddress);
     GLCorePatch::installGL(fake_egl::hostProcOverrides, fake_egl::eglGetProcAddress);
+    ResolutionScaler::installGL(fake_egl::hostProcOverrides, fake_egl::eglGetProcAddress);
+    fake_egl::procTable.fill(fake_egl::resolveProc);
 }
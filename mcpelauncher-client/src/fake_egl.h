@@ -44,6 +44,10 @@ struct FakeEGL {
 
     static void addSwapBuffersCallback(void *user, void (*callback)(void *user, EGLDisplay display, EGLSurface surface));
 
+    // The interval the game asked for through eglSwapInterval while VSync is enabled, but at least 1 so the setting
+    // stays in effect, 0 otherwise
+    static int getWindowSwapInterval();
+
     static void installLibrary();
 
     static void setupGLOverrides();
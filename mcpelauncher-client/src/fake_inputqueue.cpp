@@ -1,27 +1,38 @@
 #include "fake_inputqueue.h"
 
 #include <stdexcept>
+#include <thread>
+#include <ctime>
+#include <unistd.h>
 #include "armhfrewrite.h"
 
 static float _AMotionEvent_getX(const AInputEvent *event, size_t pointerIndex) {
-    return ((const FakeMotionEvent *)(const void *)event)->x;
+    return ((const FakeMotionEvent *)(const void *)event)->getAxisValue(AMOTION_EVENT_AXIS_X, pointerIndex);
 }
 
 static float _AMotionEvent_getY(const AInputEvent *event, size_t pointerIndex) {
-    return ((const FakeMotionEvent *)(const void *)event)->y;
+    return ((const FakeMotionEvent *)(const void *)event)->getAxisValue(AMOTION_EVENT_AXIS_Y, pointerIndex);
 }
 
 static float _AMotionEvent_getAxisValue(const AInputEvent *event, int32_t axis, size_t pointerIndex) {
-    auto axisFunction = ((const FakeMotionEvent *)(const void *)event)->axisFunction;
-    if(axisFunction) {
-        return axisFunction(axis);
-    }
-    int32_t dy = ((const FakeMotionEvent *)(const void *)event)->dy;
-    if(dy)
-        return dy;
-    return 0;
+    auto motionEvent = (const FakeMotionEvent *)(const void *)event;
+    // Pointer events answer every axis with their scroll delta, 0 outside of scroll events
+    if(motionEvent->source != AINPUT_SOURCE_GAMEPAD)
+        return motionEvent->getAxisValue(AMOTION_EVENT_AXIS_VSCROLL, 0);
+    return motionEvent->getAxisValue(axis, pointerIndex);
+}
+
+static float _AMotionEvent_getHistoricalX(const AInputEvent *event, size_t pointerIndex, size_t historyIndex) {
+    return ((const FakeMotionEvent *)(const void *)event)->getHistoricalAxisValue(AMOTION_EVENT_AXIS_X, pointerIndex, historyIndex);
 }
 
+static float _AMotionEvent_getHistoricalY(const AInputEvent *event, size_t pointerIndex, size_t historyIndex) {
+    return ((const FakeMotionEvent *)(const void *)event)->getHistoricalAxisValue(AMOTION_EVENT_AXIS_Y, pointerIndex, historyIndex);
+}
+
+static float _AMotionEvent_getHistoricalAxisValue(const AInputEvent *event, int32_t axis, size_t pointerIndex, size_t historyIndex) {
+    return ((const FakeMotionEvent *)(const void *)event)->getHistoricalAxisValue(axis, pointerIndex, historyIndex);
+}
 
 void FakeInputQueue::initHybrisHooks(std::unordered_map<std::string, void *> &syms) {
     syms["AInputQueue_getEvent"] = (void *)+[](AInputQueue *queue, AInputEvent **outEvent) {
@@ -51,6 +62,12 @@ void FakeInputQueue::initHybrisHooks(std::unordered_map<std::string, void *> &sy
     syms["AKeyEvent_getRepeatCount"] = (void *)+[](const AInputEvent *event) {
         return (int32_t)0;
     };
+    syms["AKeyEvent_getEventTime"] = (void *)+[](const AInputEvent *event) {
+        return ((const FakeInputEvent *)(const void *)event)->eventTime;
+    };
+    syms["AMotionEvent_getEventTime"] = (void *)+[](const AInputEvent *event) {
+        return ((const FakeInputEvent *)(const void *)event)->eventTime;
+    };
     syms["AKeyEvent_getMetaState"] = (void *)+[](const AInputEvent *event) {
         return ((const FakeKeyEvent *)(const void *)event)->metaState;
     };
@@ -58,19 +75,20 @@ void FakeInputQueue::initHybrisHooks(std::unordered_map<std::string, void *> &sy
         return ((const FakeMotionEvent *)(const void *)event)->action;
     };
     syms["AMotionEvent_getPointerCount"] = (void *)+[](const AInputEvent *event) {
-        return 1;
+        return ((const FakeMotionEvent *)(const void *)event)->pointerCount;
     };
     syms["AMotionEvent_getButtonState"] = (void *)+[](const AInputEvent *event) {
-        if(((const FakeMotionEvent *)(const void *)event)->btn)
-            return ((const FakeMotionEvent *)(const void *)event)->btn;
-        return 0;
+        return ((const FakeMotionEvent *)(const void *)event)->btn;
     };
-    syms["AMotionEvent_getPointerId"] = (void *)+[](const AInputEvent *event) {
-        return ((const FakeMotionEvent *)(const void *)event)->pointerId;
+    syms["AMotionEvent_getPointerId"] = (void *)+[](const AInputEvent *event, size_t pointerIndex) {
+        return ((const FakeMotionEvent *)(const void *)event)->getPointer(pointerIndex).id;
     };
     
     syms["AMotionEvent_getHistorySize"] = (void *)+[](const AInputEvent *event) {
-        return 0;
+        return ((const FakeMotionEvent *)(const void *)event)->historySize;
+    };
+    syms["AMotionEvent_getHistoricalEventTime"] = (void *)+[](const AInputEvent *event, size_t historyIndex) {
+        return ((const FakeMotionEvent *)(const void *)event)->getHistoricalEventTime(historyIndex);
     };
 
     syms["AMotionEvent_getX"] = reinterpret_cast<void *>(ARMHFREWRITE(_AMotionEvent_getX));
@@ -78,36 +96,128 @@ void FakeInputQueue::initHybrisHooks(std::unordered_map<std::string, void *> &sy
     syms["AMotionEvent_getRawX"] = reinterpret_cast<void *>(ARMHFREWRITE(_AMotionEvent_getX));
     syms["AMotionEvent_getRawY"] = reinterpret_cast<void *>(ARMHFREWRITE(_AMotionEvent_getY));
     syms["AMotionEvent_getAxisValue"] = reinterpret_cast<void *>(ARMHFREWRITE(_AMotionEvent_getAxisValue));
+    syms["AMotionEvent_getHistoricalX"] = reinterpret_cast<void *>(ARMHFREWRITE(_AMotionEvent_getHistoricalX));
+    syms["AMotionEvent_getHistoricalY"] = reinterpret_cast<void *>(ARMHFREWRITE(_AMotionEvent_getHistoricalY));
+    syms["AMotionEvent_getHistoricalRawX"] = reinterpret_cast<void *>(ARMHFREWRITE(_AMotionEvent_getHistoricalX));
+    syms["AMotionEvent_getHistoricalRawY"] = reinterpret_cast<void *>(ARMHFREWRITE(_AMotionEvent_getHistoricalY));
+    syms["AMotionEvent_getHistoricalAxisValue"] = reinterpret_cast<void *>(ARMHFREWRITE(_AMotionEvent_getHistoricalAxisValue));
+}
+
+static int64_t getMonotonicTime() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// Keeps the time the event was read at if the window knows it
+static int64_t getEventTime(FakeInputEvent const &event) {
+    return event.eventTime != 0 ? event.eventTime : getMonotonicTime();
 }
 
 int FakeInputQueue::getEvent(FakeInputEvent **event) {
-    if(!keyEvents.empty()) {
-        *event = &keyEvents.front();
-        return 0;
-    }
-    if(!motionEvents.empty()) {
-        *event = &motionEvents.front();
-        return 0;
+    size_t h = head.load(std::memory_order_relaxed);
+    if(h == tail.load(std::memory_order_acquire))
+        return -1;
+    auto &slot = slots[h % capacity];
+    int state = SLOT_READY;
+    // Wait for the producer to finish merging a move into this slot, getEvent may be called again before finishEvent
+    while(!slot.state.compare_exchange_weak(state, SLOT_CLAIMED, std::memory_order_acquire) && state != SLOT_CLAIMED) {
+        if(state == SLOT_WRITING)
+            std::this_thread::yield();
+        state = SLOT_READY;
     }
-    return -1;
+    *event = &slot.event;
+    return 0;
 }
 
 void FakeInputQueue::finishEvent(FakeInputEvent *event) {
-    if(!keyEvents.empty() && &keyEvents.front() == event) {
-        keyEvents.pop_front();
+    size_t h = head.load(std::memory_order_relaxed);
+    auto &slot = slots[h % capacity];
+    if(h == tail.load(std::memory_order_acquire) || &slot.event != event || slot.state.load(std::memory_order_relaxed) != SLOT_CLAIMED)
+        throw std::runtime_error("finishEvent: the event is not the event on the front of queue");
+    slot.state.store(SLOT_FREE, std::memory_order_relaxed);
+    head.store(h + 1, std::memory_order_release);
+}
+
+void FakeInputQueue::notify(size_t t) {
+    // The looper only sleeps once it has seen the queue empty, so later events don't have to signal it again
+    int fd = notifyFd.load(std::memory_order_relaxed);
+    if(fd == -1 || head.load(std::memory_order_acquire) != t)
         return;
-    }
-    if(!motionEvents.empty() && &motionEvents.front() == event) {
-        motionEvents.pop_front();
+    uint64_t value = 1;
+    (void)!write(fd, &value, sizeof(value));
+}
+
+void FakeInputQueue::addEvent(FakeKeyEvent event) {
+    size_t t = tail.load(std::memory_order_relaxed);
+    if(t - head.load(std::memory_order_acquire) >= capacity) {
+        overflowCount.fetch_add(1, std::memory_order_relaxed);
         return;
     }
-    throw std::runtime_error("finishEvent: the event is not the event on the front of queue");
+    auto &slot = slots[t % capacity];
+    slot.keyEvent = event;
+    slot.keyEvent.eventTime = getEventTime(event);
+    slot.state.store(SLOT_READY, std::memory_order_relaxed);
+    tail.store(t + 1, std::memory_order_release);
+    notify(t);
 }
 
-void FakeInputQueue::addEvent(FakeKeyEvent event) {
-    keyEvents.push_back(event);
+bool FakeInputQueue::tryCoalesce(FakeMotionEvent const &event, bool force, bool keepHistory) {
+    size_t t = tail.load(std::memory_order_relaxed);
+    size_t h = head.load(std::memory_order_acquire);
+    // Only merge if the game is behind, unless the caller asks for it
+    if(t == h || (!force && t - h < (capacity - keyReserve) / 2))
+        return false;
+    auto &slot = slots[(t - 1) % capacity];
+    int state = SLOT_READY;
+    if(!slot.state.compare_exchange_strong(state, SLOT_WRITING, std::memory_order_acquire))
+        return false;
+    auto &last = slot.motionEvent;
+    bool isMove = event.action == AMOTION_EVENT_ACTION_MOVE || event.action == AMOTION_EVENT_ACTION_HOVER_MOVE;
+    bool merge = last.type == AINPUT_EVENT_TYPE_MOTION && isMove && last.action == event.action && last.source == event.source &&
+                 last.deviceId == event.deviceId && last.btn == event.btn && last.pointerCount == event.pointerCount;
+    for(size_t i = 0; merge && i < event.pointerCount; i++)
+        merge = last.pointers[i].id == event.pointers[i].id;
+    if(merge) {
+        if(keepHistory) {
+            last.pushHistory();
+            last.pointerCount = event.pointerCount;
+            for(size_t i = 0; i < event.pointerCount; i++)
+                last.pointers[i] = event.pointers[i];
+        } else {
+            float dx = last.pointers[0].axisValues[AMOTION_EVENT_AXIS_X], dy = last.pointers[0].axisValues[AMOTION_EVENT_AXIS_Y];
+            last = event;
+            // Relative moves are deltas, everything else carries absolute values
+            if(event.source == AINPUT_SOURCE_MOUSE_RELATIVE) {
+                last.pointers[0].axisValues[AMOTION_EVENT_AXIS_X] += dx;
+                last.pointers[0].axisValues[AMOTION_EVENT_AXIS_Y] += dy;
+            }
+        }
+        last.eventTime = getEventTime(event);
+        coalescedCount.fetch_add(1, std::memory_order_relaxed);
+    }
+    slot.state.store(SLOT_READY, std::memory_order_release);
+    return merge;
 }
 
-void FakeInputQueue::addEvent(FakeMotionEvent event) {
-    motionEvents.push_back(std::move(event));
+void FakeInputQueue::addEvent(FakeMotionEvent const &event, bool coalesce) {
+    // Like Android, absolute pointer moves are always batched. Relative moves are deltas and the game only reads the
+    // current sample, they are summed up instead
+    bool isMove = event.action == AMOTION_EVENT_ACTION_MOVE || event.action == AMOTION_EVENT_ACTION_HOVER_MOVE;
+    bool relative = isMove && event.source == AINPUT_SOURCE_MOUSE_RELATIVE;
+    bool batch = isMove && event.source != AINPUT_SOURCE_MOUSE_RELATIVE && event.source != AINPUT_SOURCE_GAMEPAD && !coalesce;
+    if(tryCoalesce(event, coalesce || batch || relative, batch))
+        return;
+    size_t t = tail.load(std::memory_order_relaxed);
+    if(t - head.load(std::memory_order_acquire) >= capacity - keyReserve) {
+        overflowCount.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    auto &slot = slots[t % capacity];
+    slot.motionEvent = event;
+    slot.motionEvent.eventTime = getEventTime(event);
+    slot.motionEvent.historySize = 0;
+    slot.state.store(SLOT_READY, std::memory_order_relaxed);
+    tail.store(t + 1, std::memory_order_release);
+    notify(t);
 }
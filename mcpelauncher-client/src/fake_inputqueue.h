@@ -1,14 +1,17 @@
 #pragma once
 
 #include <android/input.h>
-#include <deque>
-#include <functional>
+#include <atomic>
+#include <cstddef>
 #include <string>
+#include <type_traits>
 #include <unordered_map>
 
 struct FakeInputEvent {
     int32_t source, type;
     int32_t deviceId = 0;
+    // CLOCK_MONOTONIC in nanoseconds, set when the event is queued unless the caller already knows it
+    int64_t eventTime = 0;
 
     FakeInputEvent(int32_t source, int32_t type, int32_t deviceId = 0) : source(source), type(type), deviceId(deviceId) {}
 };
@@ -21,39 +24,141 @@ struct FakeKeyEvent : FakeInputEvent {
     FakeKeyEvent() : FakeKeyEvent(0, 0, 0) {}
 };
 
+// Values of AMOTION_EVENT_AXIS_X up to AMOTION_EVENT_AXIS_GENERIC_1 (exclusive), indexed by the axis id
+struct FakeMotionPointer {
+    static constexpr int32_t axisCount = AMOTION_EVENT_AXIS_GENERIC_1;
+
+    int32_t id = 0;
+    float axisValues[axisCount] = {};
+};
+
 struct FakeMotionEvent : FakeInputEvent {
-    int32_t action;
-    int32_t pointerId;
-    float x, y;
-    std::function<float(int32_t axis)> axisFunction;
-    int32_t btn = 0, dy = 0;
+    static constexpr size_t maxPointers = 8;
+    static constexpr size_t maxHistory = 16;
 
-    FakeMotionEvent(int32_t source, int32_t action, int32_t pointerId, float x, float y) : FakeInputEvent(source, AINPUT_EVENT_TYPE_MOTION), action(action), pointerId(pointerId), x(x), y(y) {}
+    // Position of every pointer at an earlier move batched into this event
+    struct HistorySample {
+        int64_t eventTime;
+        float x[maxPointers];
+        float y[maxPointers];
+    };
 
-    FakeMotionEvent(int32_t source, int32_t action, int32_t pointerId, float x, float y, int32_t btn, int32_t dy) : FakeInputEvent(source, AINPUT_EVENT_TYPE_MOTION), action(action), pointerId(pointerId), x(x), y(y), btn(btn), dy(dy) {}
+    int32_t action;
+    int32_t btn = 0;
+    size_t pointerCount = 1;
+    FakeMotionPointer pointers[maxPointers];
+    // Oldest first, like Android
+    size_t historySize = 0;
+    HistorySample history[maxHistory];
+
+    FakeMotionEvent(int32_t source, int32_t action, int32_t pointerId, float x, float y) : FakeInputEvent(source, AINPUT_EVENT_TYPE_MOTION), action(action) {
+        pointers[0].id = pointerId;
+        pointers[0].axisValues[AMOTION_EVENT_AXIS_X] = x;
+        pointers[0].axisValues[AMOTION_EVENT_AXIS_Y] = y;
+    }
+
+    FakeMotionEvent(int32_t source, int32_t action, int32_t pointerId, float x, float y, int32_t btn, int32_t dy) : FakeMotionEvent(source, action, pointerId, x, y) {
+        this->btn = btn;
+        pointers[0].axisValues[AMOTION_EVENT_AXIS_VSCROLL] = (float)dy;
+    }
 
-    FakeMotionEvent(int32_t source, int32_t deviceId, int32_t action, int32_t pointerId, float x, float y, std::function<float(int32_t axis)> axisFunction) : FakeInputEvent(source, AINPUT_EVENT_TYPE_MOTION, deviceId), action(action), pointerId(pointerId), x(x), y(y), axisFunction(std::move(axisFunction)) {}
+    // Axis values are filled in by the caller
+    FakeMotionEvent(int32_t source, int32_t deviceId, int32_t action) : FakeInputEvent(source, AINPUT_EVENT_TYPE_MOTION, deviceId), action(action) {}
 
     FakeMotionEvent() : FakeMotionEvent(0, 0, 0, 0, 0) {}
+
+    FakeMotionPointer const &getPointer(size_t pointerIndex) const {
+        return pointers[pointerIndex < pointerCount ? pointerIndex : 0];
+    }
+
+    float getAxisValue(int32_t axis, size_t pointerIndex) const {
+        if(axis < 0 || axis >= FakeMotionPointer::axisCount)
+            return 0.f;
+        return getPointer(pointerIndex).axisValues[axis];
+    }
+
+    // Only X and Y are recorded per sample, other axes report their current value
+    float getHistoricalAxisValue(int32_t axis, size_t pointerIndex, size_t historyIndex) const {
+        if(historyIndex >= historySize || (axis != AMOTION_EVENT_AXIS_X && axis != AMOTION_EVENT_AXIS_Y))
+            return getAxisValue(axis, pointerIndex);
+        if(pointerIndex >= pointerCount)
+            pointerIndex = 0;
+        auto &sample = history[historyIndex];
+        return axis == AMOTION_EVENT_AXIS_X ? sample.x[pointerIndex] : sample.y[pointerIndex];
+    }
+
+    int64_t getHistoricalEventTime(size_t historyIndex) const {
+        return historyIndex < historySize ? history[historyIndex].eventTime : eventTime;
+    }
+
+    // Moves this event's current position into the history before it is replaced by a newer move
+    void pushHistory() {
+        if(historySize == maxHistory) {
+            for(size_t i = 1; i < maxHistory; i++)
+                history[i - 1] = history[i];
+            historySize--;
+        }
+        auto &sample = history[historySize++];
+        sample.eventTime = eventTime;
+        for(size_t i = 0; i < pointerCount; i++) {
+            sample.x[i] = pointers[i].axisValues[AMOTION_EVENT_AXIS_X];
+            sample.y[i] = pointers[i].axisValues[AMOTION_EVENT_AXIS_Y];
+        }
+    }
 };
 
+static_assert(std::is_trivially_copyable<FakeKeyEvent>::value && std::is_trivially_copyable<FakeMotionEvent>::value, "input events are copied around as plain data");
+
+/*
+ * Bounded single producer (window callbacks) / single consumer (game thread) ring of input events. Events stay in the
+ * order they were added, the slot handed out by getEvent is owned by the game until finishEvent. Absolute pointer moves
+ * arriving before the game picked up the previous one are batched into it and exposed as historical samples, relative
+ * mouse moves are added to its delta. If the game falls behind, other pointer and axis moves are merged into the last
+ * queued event, events that don't fit anymore are dropped.
+ */
 class FakeInputQueue {
+public:
+    static constexpr size_t capacity = 256;
+    // Slots only usable by key events, so a motion flood can't drop key releases
+    static constexpr size_t keyReserve = 32;
+
 private:
-    std::deque<FakeKeyEvent> keyEvents;
-    std::deque<FakeMotionEvent> motionEvents;
+    enum SlotState { SLOT_FREE, SLOT_READY, SLOT_WRITING, SLOT_CLAIMED };
+
+    struct Slot {
+        std::atomic<int> state{SLOT_FREE};
+        union {
+            FakeInputEvent event;
+            FakeKeyEvent keyEvent;
+            FakeMotionEvent motionEvent;
+        };
+
+        Slot() : motionEvent() {}
+    };
+
+    Slot slots[capacity];
+    alignas(64) std::atomic<size_t> head{0};
+    alignas(64) std::atomic<size_t> tail{0};
+    std::atomic<size_t> overflowCount{0};
+    std::atomic<size_t> coalescedCount{0};
+    std::atomic<int> notifyFd{-1};
+
+    bool tryCoalesce(FakeMotionEvent const &event, bool force, bool keepHistory);
+    void notify(size_t t);
 
 public:
     static void initHybrisHooks(std::unordered_map<std::string, void *> &syms);
 
-    FakeInputQueue() {
-        // Should avoid a crash caused by a lot of events from gamepad's analog sticks
-        motionEvents.resize(100);
-        motionEvents.clear();
-        keyEvents.resize(100);
-        keyEvents.clear();
-    }
+    bool hasEvents() const { return head.load(std::memory_order_acquire) != tail.load(std::memory_order_acquire); }
+
+    size_t getSize() const { return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire); }
+
+    size_t getOverflowCount() const { return overflowCount.load(std::memory_order_relaxed); }
+
+    size_t getCoalescedCount() const { return coalescedCount.load(std::memory_order_relaxed); }
 
-    bool hasEvents() const { return !keyEvents.empty() || !motionEvents.empty(); }
+    // An eventfd signaled when an event is added to the empty queue
+    void setNotifyFd(int fd) { notifyFd.store(fd, std::memory_order_relaxed); }
 
     int getEvent(FakeInputEvent **event);
 
@@ -61,5 +166,6 @@ public:
 
     void addEvent(FakeKeyEvent event);
 
-    void addEvent(FakeMotionEvent event);
+    // If coalesce is set, a queued ACTION_MOVE of the same device and source is replaced instead of adding another one
+    void addEvent(FakeMotionEvent const &event, bool coalesce = false);
 };
@@ -6,7 +6,14 @@
 #include "core_patches.h"
 #include "fake_egl.h"
 
-#include <sys/poll.h>
+#include <sys/epoll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
+#include <cerrno>
+#include <chrono>
 
 #include <game_window_manager.h>
 #include <log.h>
@@ -36,15 +43,33 @@ void FakeLooper::initHybrisHooks(std::unordered_map<std::string, void *> &syms)
         currentLooper->prepare();
         return (ALooper *)(void *)currentLooper.get();
     };
+    syms["ALooper_forThread"] = (void *)+[]() {
+        return (ALooper *)(void *)currentLooper.get();
+    };
+    syms["ALooper_acquire"] = (void *)+[](ALooper *looper) {};
+    syms["ALooper_release"] = (void *)+[](ALooper *looper) {};
     syms["ALooper_addFd"] = (void *)+[](ALooper *looper, int fd, int ident, int events, ALooper_callbackFunc callback, void *data) {
         return ((FakeLooper *)(void *)looper)->addFd(fd, ident, events, callback, data);
     };
+    syms["ALooper_removeFd"] = (void *)+[](ALooper *looper, int fd) {
+        return ((FakeLooper *)(void *)looper)->removeFd(fd);
+    };
+    syms["ALooper_wake"] = (void *)+[](ALooper *looper) {
+        ((FakeLooper *)(void *)looper)->wake();
+    };
+    syms["ALooper_pollOnce"] = (void *)+[](int timeoutMillis, int *outFd, int *outEvents, void **outData) {
+        return currentLooper->pollOnce(timeoutMillis, outFd, outEvents, outData);
+    };
     syms["ALooper_pollAll"] = (void *)+[](int timeoutMillis, int *outFd, int *outEvents, void **outData) {
         return currentLooper->pollAll(timeoutMillis, outFd, outEvents, outData);
     };
     syms["AInputQueue_attachLooper"] = (void *)+[](AInputQueue *queue, ALooper *looper, int ident, ALooper_callbackFunc callback, void *data) {
         ((FakeLooper *)(void *)looper)->attachInputQueue(ident, callback, data);
     };
+    syms["AInputQueue_detachLooper"] = (void *)+[](AInputQueue *queue) {
+        if(currentLooper)
+            currentLooper->detachInputQueue();
+    };
 
     syms["ANativeActivity_finish"] = (void *)+[](ANativeActivity *native) {
         FakeJni::JniEnvContext ctx(*(FakeJni::Jvm *)native->vm);
@@ -93,30 +118,154 @@ void FakeLooper::prepare() {
     associatedWindow->makeCurrent(false);
 }
 
+// Read and write end of a non-blocking notification channel, an eventfd where available and a pipe otherwise
+static bool createWakeFds(int fds[2]) {
+#ifdef __linux__
+    fds[0] = fds[1] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    return fds[0] != -1;
+#else
+    if(pipe(fds) != 0)
+        return false;
+    for(int i = 0; i < 2; i++) {
+        fcntl(fds[i], F_SETFL, fcntl(fds[i], F_GETFL) | O_NONBLOCK);
+        fcntl(fds[i], F_SETFD, FD_CLOEXEC);
+    }
+    return true;
+#endif
+}
+
+static void closeWakeFds(int fds[2]) {
+    if(fds[1] != fds[0] && fds[1] != -1)
+        close(fds[1]);
+    if(fds[0] != -1)
+        close(fds[0]);
+}
+
+static void drainWakeFd(int fd) {
+    uint64_t value;
+    while(read(fd, &value, sizeof(value)) > 0) {
+    }
+}
+
+FakeLooper::FakeLooper() {
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if(epollFd == -1 || !createWakeFds(wakeFds) || !createWakeFds(inputFds))
+        throw std::runtime_error("Failed to create the looper fds");
+    for(int fd : {wakeFds[0], inputFds[0]}) {
+        epoll_event ev = {};
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev);
+    }
+    fakeInputQueue.setNotifyFd(inputFds[1]);
+}
+
 FakeLooper::~FakeLooper() {
     CorePatches::setGameWindow(nullptr);
     associatedWindow.reset();
     associatedWindowCallbacks.reset();
+    closeWakeFds(inputFds);
+    closeWakeFds(wakeFds);
+    if(epollFd != -1)
+        close(epollFd);
+}
+
+static int toLooperEvents(uint32_t epollEvents) {
+    int events = 0;
+    if(epollEvents & EPOLLIN)
+        events |= ALOOPER_EVENT_INPUT;
+    if(epollEvents & EPOLLOUT)
+        events |= ALOOPER_EVENT_OUTPUT;
+    if(epollEvents & EPOLLERR)
+        events |= ALOOPER_EVENT_ERROR;
+    if(epollEvents & EPOLLHUP)
+        events |= ALOOPER_EVENT_HANGUP;
+    return events;
 }
 
 int FakeLooper::addFd(int fd, int ident, int events, ALooper_callbackFunc callback, void *data) {
-    if(androidEvent)
+    if(fd < 0 || (callback == nullptr && ident < 0))
         return -1;
     if(callback != nullptr)
-        throw std::runtime_error("callback is not supported");
-    androidEvent = EventEntry(fd, ident, events, data);
+        ident = ALOOPER_POLL_CALLBACK;
+    epoll_event ev = {};
+    ev.events = ((events & ALOOPER_EVENT_INPUT) ? EPOLLIN : 0) | ((events & ALOOPER_EVENT_OUTPUT) ? EPOLLOUT : 0);
+    ev.data.fd = fd;
+    bool replace = fdEntries.count(fd) != 0;
+    if(epoll_ctl(epollFd, replace ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, fd, &ev) != 0)
+        return -1;
+    fdEntries[fd] = EventEntry(fd, ident, events, data, callback);
+    return 1;
+}
+
+int FakeLooper::removeFd(int fd) {
+    if(!fdEntries.erase(fd))
+        return 0;
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+    for(auto it = pendingResponses.begin(); it != pendingResponses.end();) {
+        if(it->entry.fd == fd)
+            it = pendingResponses.erase(it);
+        else
+            it++;
+    }
     return 1;
 }
 
+void FakeLooper::wake() {
+    uint64_t value = 1;
+    if(write(wakeFds[1], &value, sizeof(value)) != sizeof(value) && errno != EAGAIN)
+        Log::warn("Looper", "Failed to wake the looper");
+}
+
 void FakeLooper::attachInputQueue(int ident, ALooper_callbackFunc callback, void *data) {
     if(inputEntry)
         throw std::runtime_error("attachInputQueue already called on this looper");
     if(callback != nullptr)
         throw std::runtime_error("callback is not supported");
-    inputEntry = EventEntry(-1, ident, 0, data);
+    inputEntry = EventEntry(-1, ident, ALOOPER_EVENT_INPUT, data);
 }
 
-int FakeLooper::pollAll(int timeoutMillis, int *outFd, int *outEvents, void **outData) {
+void FakeLooper::detachInputQueue() {
+    inputEntry = EventEntry();
+}
+
+int FakeLooper::waitForEvents(int timeoutMillis) {
+    epoll_event events[16];
+    int count = epoll_wait(epollFd, events, 16, timeoutMillis);
+    if(count < 0)
+        return errno == EINTR ? ALOOPER_POLL_TIMEOUT : ALOOPER_POLL_ERROR;
+    bool woken = false, callbacks = false;
+    for(int i = 0; i < count; i++) {
+        int fd = events[i].data.fd;
+        if(fd == wakeFds[0]) {
+            drainWakeFd(fd);
+            woken = true;
+            continue;
+        }
+        if(fd == inputFds[0]) {
+            // Pending input is checked through the queue itself
+            drainWakeFd(fd);
+            continue;
+        }
+        auto it = fdEntries.find(fd);
+        if(it == fdEntries.end())
+            continue;
+        int looperEvents = toLooperEvents(events[i].events);
+        if(it->second.callback) {
+            auto entry = it->second;
+            if(entry.callback(fd, looperEvents, entry.data) == 0)
+                removeFd(fd);
+            callbacks = true;
+        } else {
+            pendingResponses.push_back({it->second, looperEvents});
+        }
+    }
+    if(callbacks)
+        return ALOOPER_POLL_CALLBACK;
+    return woken ? ALOOPER_POLL_WAKE : ALOOPER_POLL_TIMEOUT;
+}
+
+int FakeLooper::pollOnce(int timeoutMillis, int *outFd, int *outEvents, void **outData) {
     associatedWindowCallbacks->startSendEvents();
     if(textInput != jniSupport->getTextInputHandler().isEnabled()) {
         textInput = jniSupport->getTextInputHandler().isEnabled();
@@ -126,25 +275,53 @@ int FakeLooper::pollAll(int timeoutMillis, int *outFd, int *outEvents, void **ou
             associatedWindow->stopTextInput();
         }
     }
-    
-    if(androidEvent) {
-        pollfd f;
-        f.fd = androidEvent.fd;
-        f.events = androidEvent.events;
-        if(poll(&f, 1, 0) > 0) {
-            androidEvent.fill(outFd, outData);
+
+    auto start = std::chrono::steady_clock::now();
+    int waitMillis = 0;
+    while(true) {
+        // Like Android, hand out the fds found by the last wait before polling again. epoll is level triggered and would
+        // report an fd the caller hasn't read yet a second time
+        if(!pendingResponses.empty()) {
+            auto response = pendingResponses.front();
+            pendingResponses.pop_front();
+            response.entry.fill(outFd, outData);
             if(outEvents)
-                *outEvents = f.revents;
-            return androidEvent.ident;
+                *outEvents = response.events;
+            return response.entry.ident;
         }
-    }
+        int result = waitForEvents(waitMillis);
+        if(!pendingResponses.empty())
+            continue;
+        if(result != ALOOPER_POLL_TIMEOUT)
+            return result;
+
+        if(inputEntry && fakeInputQueue.hasEvents()) {
+            inputEntry.fill(outFd, outData);
+            if(outEvents)
+                *outEvents = ALOOPER_EVENT_INPUT;
+            return inputEntry.ident;
+        }
+        associatedWindow->pollEvents();
+        associatedWindowCallbacks->replayInput();
+        if(inputEntry && fakeInputQueue.hasEvents())
+            continue;
 
-    if(inputEntry && fakeInputQueue.hasEvents()) {
-        inputEntry.fill(outFd, outData);
-        return inputEntry.ident;
+        if(timeoutMillis == 0)
+            return ALOOPER_POLL_TIMEOUT;
+        waitMillis = windowPollIntervalMs;
+        if(timeoutMillis > 0) {
+            auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+            if(elapsed >= timeoutMillis)
+                return ALOOPER_POLL_TIMEOUT;
+            waitMillis = std::min<int>(waitMillis, (int)(timeoutMillis - elapsed));
+        }
     }
+}
 
-    associatedWindow->pollEvents();
-    associatedWindowCallbacks->markRequeueGamepadInput();
-    return ALOOPER_POLL_TIMEOUT;
+int FakeLooper::pollAll(int timeoutMillis, int *outFd, int *outEvents, void **outData) {
+    while(true) {
+        int result = pollOnce(timeoutMillis, outFd, outEvents, outData);
+        if(result != ALOOPER_POLL_CALLBACK)
+            return result;
+    }
 }
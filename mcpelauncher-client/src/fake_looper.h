@@ -1,16 +1,24 @@
 #pragma once
 
 #include <android/looper.h>
+#include <deque>
 #include <memory>
+#include <unordered_map>
 #include <game_window.h>
 #include "jni/jni_support.h"
 #include "window_callbacks.h"
 #include "fake_inputqueue.h"
 
+/*
+ * ALooper on top of epoll. ALooper_wake and the input queue signal through eventfds (pipes on macOS), so polling without pending
+ * events doesn't cost anything beyond the window's event pump. Timeouts are honored by waiting in slices of
+ * windowPollIntervalMs, because the window events have to be pumped from this thread as well.
+ */
 class FakeLooper {
 private:
     static JniSupport *jniSupport;
     static thread_local std::unique_ptr<FakeLooper> currentLooper;
+    static constexpr int windowPollIntervalMs = 10;
     bool prepared = false;
     bool textInput = false;
     int menuSize = 0;
@@ -18,9 +26,10 @@ private:
     struct EventEntry {
         int fd, ident, events;
         void *data;
+        ALooper_callbackFunc callback = nullptr;
 
         EventEntry() : ident(-1) {}
-        EventEntry(int fd, int ident, int events, void *data) : fd(fd), ident(ident), events(events), data(data) {}
+        EventEntry(int fd, int ident, int events, void *data, ALooper_callbackFunc callback = nullptr) : fd(fd), ident(ident), events(events), data(data), callback(callback) {}
 
         void fill(int *outFd, void **outData) const {
             if(outFd)
@@ -33,7 +42,18 @@ private:
             return ident != -1;
         }
     };
-    EventEntry androidEvent;
+    // Ready fds returned by epoll but not yet reported to the caller
+    struct Response {
+        EventEntry entry;
+        int events;
+    };
+
+    int epollFd = -1;
+    // Read and write ends, both are the same eventfd on Linux
+    int wakeFds[2] = {-1, -1};
+    int inputFds[2] = {-1, -1};
+    std::unordered_map<int, EventEntry> fdEntries;
+    std::deque<Response> pendingResponses;
     EventEntry inputEntry;
     FakeInputQueue fakeInputQueue;
 
@@ -42,19 +62,31 @@ private:
 
     void initializeWindow();
 
+    // Collects ready fds into pendingResponses and runs callbacks, returns ALOOPER_POLL_WAKE/CALLBACK/TIMEOUT
+    int waitForEvents(int timeoutMillis);
+
 public:
     static void setJniSupport(JniSupport *support) {
         jniSupport = support;
     }
 
+    FakeLooper();
     ~FakeLooper();
 
     void prepare();
 
     int addFd(int fd, int ident, int events, ALooper_callbackFunc callback, void *data);
 
+    int removeFd(int fd);
+
+    void wake();
+
     void attachInputQueue(int ident, ALooper_callbackFunc callback, void *data);
 
+    void detachInputQueue();
+
+    int pollOnce(int timeoutMillis, int *outFd, int *outEvents, void **outData);
+
     int pollAll(int timeoutMillis, int *outFd, int *outEvents, void **outData);
 
     static void initWindow();
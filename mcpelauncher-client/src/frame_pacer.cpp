@@ -0,0 +1,43 @@
+#include "frame_pacer.h"
+
+#include <thread>
+
+FramePacer FramePacer::instance;
+
+FramePacer::Clock::duration FramePacer::getFramePeriod() const {
+    int fps = !focused && unfocusedFps > 0 ? unfocusedFps : targetFps;
+    if(fps <= 0)
+        return Clock::duration::zero();
+    return std::chrono::duration_cast<Clock::duration>(std::chrono::nanoseconds(1000000000LL / fps));
+}
+
+void FramePacer::waitUntil(Clock::time_point time) {
+    auto now = Clock::now();
+    if(time - now > spinThreshold)
+        std::this_thread::sleep_for(time - now - spinThreshold);
+    while(Clock::now() < time)
+        std::this_thread::yield();
+}
+
+void FramePacer::present(std::function<void()> const &swap) {
+    auto swapStart = Clock::now();
+    if(started)
+        lastFrame.cpuTime = swapStart - frameStart;
+    swap();
+    auto swapEnd = Clock::now();
+    lastFrame.swapTime = swapEnd - swapStart;
+
+    auto period = getFramePeriod();
+    if(period == Clock::duration::zero() || !started) {
+        deadline = swapEnd + period;
+    } else {
+        deadline += period;
+        // Don't try to catch up after a long frame, that would render a burst of frames
+        if(deadline < swapEnd)
+            deadline = swapEnd;
+        waitUntil(deadline);
+    }
+    started = true;
+    frameStart = Clock::now();
+    lastFrame.waitTime = frameStart - swapEnd;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+
+/*
+ * Software frame limiter behind eglSwapBuffers. The wait happens after the swap, right before control returns to
+ * the game, so the next frame samples input as late as possible. Long waits sleep and the last spinThreshold of the
+ * wait is spun, as sleeping is only accurate to about a millisecond.
+ */
+class FramePacer {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct FrameTiming {
+        // Time the game spent on the frame, from the end of the previous present to the start of this one
+        Clock::duration cpuTime{0};
+        // Time spent in the window swap, includes blocking on vsync
+        Clock::duration swapTime{0};
+        // Time spent waiting for the frame limit
+        Clock::duration waitTime{0};
+    };
+
+private:
+    int targetFps = 0;
+    int unfocusedFps = 0;
+    bool focused = true;
+    Clock::duration spinThreshold = std::chrono::microseconds(1500);
+
+    bool started = false;
+    Clock::time_point frameStart;
+    Clock::time_point deadline;
+    FrameTiming lastFrame;
+
+    void waitUntil(Clock::time_point time);
+
+public:
+    static FramePacer instance;
+
+    // 0 disables the limit
+    void setTargetFps(int fps) {
+        targetFps = fps;
+    }
+
+    // Limit used while the window isn't focused, 0 keeps using the target FPS
+    void setUnfocusedFps(int fps) {
+        unfocusedFps = fps;
+    }
+
+    void setFocused(bool focused) {
+        this->focused = focused;
+    }
+
+    void setSpinThreshold(Clock::duration threshold) {
+        spinThreshold = threshold;
+    }
+
+    // Frame period for the current limit, zero if unlimited
+    Clock::duration getFramePeriod() const;
+
+    // Runs swap and waits for the next frame slot
+    void present(std::function<void()> const &swap);
+
+    FrameTiming const &getLastFrameTiming() const {
+        return lastFrame;
+    }
+};
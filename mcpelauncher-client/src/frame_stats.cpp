@@ -0,0 +1,112 @@
+#include "frame_stats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+FrameStats FrameStats::instance;
+
+size_t FrameStats::getBucket(float ms) {
+    if(!(ms > minBucketMs))
+        return 0;
+    auto bucket = (size_t)(std::log(ms / minBucketMs) / std::log(maxBucketMs / minBucketMs) * bucketCount);
+    return std::min(bucket, bucketCount - 1);
+}
+
+float FrameStats::getBucketValue(size_t bucket) {
+    // Geometric center of the bucket
+    return minBucketMs * std::pow(maxBucketMs / minBucketMs, (bucket + 0.5f) / bucketCount);
+}
+
+void FrameStats::onFrame(Clock::time_point time, Clock::duration cpuTime) {
+    if(hasLastFrame)
+        addFrameTime(std::chrono::duration<float, std::milli>(time - lastFrame).count(), std::chrono::duration<float, std::milli>(cpuTime).count());
+    hasLastFrame = true;
+    lastFrame = time;
+}
+
+void FrameStats::addFrameTime(float ms, float cpuMs) {
+    frameTimes[historyPos] = ms;
+    cpuTimes[historyPos] = cpuMs;
+    historyPos = (historyPos + 1) % historySize;
+    historyCount = std::min(historyCount + 1, historySize);
+
+    buckets[getBucket(ms)]++;
+    if(frames > 0 && ms > recentAverageMs * hitchFactor)
+        hitches++;
+    recentAverageMs = frames > 0 ? recentAverageMs * 0.9f + ms * 0.1f : ms;
+    frames++;
+    totalMs += ms;
+    maxMs = std::max(maxMs, ms);
+}
+
+void FrameStats::reset() {
+    historyPos = historyCount = 0;
+    std::fill(std::begin(buckets), std::end(buckets), 0);
+    frames = hitches = 0;
+    totalMs = 0;
+    maxMs = recentAverageMs = 0;
+    hasLastFrame = false;
+}
+
+float FrameStats::getPercentile(double p) const {
+    if(frames == 0)
+        return 0.f;
+    auto rank = (uint64_t)std::ceil(p * frames);
+    uint64_t seen = 0;
+    for(size_t i = 0; i < bucketCount; i++) {
+        seen += buckets[i];
+        if(seen >= rank && buckets[i] > 0)
+            return std::min(getBucketValue(i), maxMs);
+    }
+    return maxMs;
+}
+
+FrameStats::Summary FrameStats::getSummary() const {
+    Summary s;
+    s.frames = frames;
+    if(frames == 0)
+        return s;
+    s.averageMs = (float)(totalMs / frames);
+    s.p50Ms = getPercentile(0.5);
+    s.p95Ms = getPercentile(0.95);
+    s.p99Ms = getPercentile(0.99);
+    s.p999Ms = getPercentile(0.999);
+    s.maxMs = maxMs;
+    s.low1Fps = s.p99Ms > 0 ? 1000.f / s.p99Ms : 0.f;
+    s.low01Fps = s.p999Ms > 0 ? 1000.f / s.p999Ms : 0.f;
+    s.hitches = hitches;
+    return s;
+}
+
+bool FrameStats::exportCsv(std::string const &path) const {
+    FILE *file = fopen(path.c_str(), "w");
+    if(!file)
+        return false;
+    fprintf(file, "frame,frame_ms,cpu_ms\n");
+    size_t offset = getHistoryOffset();
+    for(size_t i = 0; i < historyCount; i++) {
+        size_t idx = (offset + i) % historySize;
+        fprintf(file, "%zu,%.3f,%.3f\n", i, frameTimes[idx], cpuTimes[idx]);
+    }
+    return fclose(file) == 0;
+}
+
+bool FrameStats::exportJson(std::string const &path) const {
+    FILE *file = fopen(path.c_str(), "w");
+    if(!file)
+        return false;
+    auto s = getSummary();
+    fprintf(file, "{\n  \"summary\": {\"frames\": %llu, \"average_ms\": %.3f, \"p50_ms\": %.3f, \"p95_ms\": %.3f, \"p99_ms\": %.3f, "
+                  "\"p999_ms\": %.3f, \"max_ms\": %.3f, \"low1_fps\": %.1f, \"low01_fps\": %.1f, \"hitches\": %llu},\n",
+            (unsigned long long)s.frames, s.averageMs, s.p50Ms, s.p95Ms, s.p99Ms, s.p999Ms, s.maxMs, s.low1Fps, s.low01Fps,
+            (unsigned long long)s.hitches);
+    fprintf(file, "  \"frames\": [");
+    size_t offset = getHistoryOffset();
+    for(size_t i = 0; i < historyCount; i++) {
+        size_t idx = (offset + i) % historySize;
+        fprintf(file, "%s\n    {\"frame_ms\": %.3f, \"cpu_ms\": %.3f}", i ? "," : "", frameTimes[idx], cpuTimes[idx]);
+    }
+    fprintf(file, "\n  ]\n}\n");
+    return fclose(file) == 0;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/*
+ * Frame time statistics fed from eglSwapBuffers. The last historySize frames are kept for the graph and exports,
+ * percentiles cover every frame since the last reset and come from a log-scale histogram, so recording a frame
+ * never allocates and the error stays within half a bucket (about 1%).
+ */
+class FrameStats {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr size_t historySize = 2048;
+
+    struct Summary {
+        uint64_t frames = 0;
+        float averageMs = 0;
+        float p50Ms = 0, p95Ms = 0, p99Ms = 0, p999Ms = 0;
+        float maxMs = 0;
+        // Frame rate at the 99th and 99.9th percentile frame time
+        float low1Fps = 0, low01Fps = 0;
+        uint64_t hitches = 0;
+    };
+
+private:
+    static constexpr size_t bucketCount = 512;
+    static constexpr float minBucketMs = 0.05f;
+    static constexpr float maxBucketMs = 5000.f;
+    // A frame taking hitchFactor times the recent average
+    static constexpr float hitchFactor = 2.f;
+
+    float frameTimes[historySize] = {};
+    float cpuTimes[historySize] = {};
+    size_t historyPos = 0;
+    size_t historyCount = 0;
+
+    uint32_t buckets[bucketCount] = {};
+    uint64_t frames = 0;
+    uint64_t hitches = 0;
+    double totalMs = 0;
+    float maxMs = 0;
+    float recentAverageMs = 0;
+
+    bool hasLastFrame = false;
+    Clock::time_point lastFrame;
+
+    static size_t getBucket(float ms);
+    static float getBucketValue(size_t bucket);
+    float getPercentile(double p) const;
+
+public:
+    static FrameStats instance;
+
+    // Records the frame presented at time, the first call only sets the reference point
+    void onFrame(Clock::time_point time, Clock::duration cpuTime);
+
+    void addFrameTime(float ms, float cpuMs = 0.f);
+
+    void reset();
+
+    Summary getSummary() const;
+
+    // Frame times in ms in ring buffer order, the oldest one is at getHistoryOffset() once the history is full
+    float const *getHistory() const {
+        return frameTimes;
+    }
+    size_t getHistoryCount() const {
+        return historyCount;
+    }
+    size_t getHistoryOffset() const {
+        return historyCount == historySize ? historyPos : 0;
+    }
+
+    bool exportCsv(std::string const &path) const;
+    bool exportJson(std::string const &path) const;
+};
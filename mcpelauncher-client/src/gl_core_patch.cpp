@@ -1,18 +1,25 @@
 #include "gl_core_patch.h"
+#include "program_binary_cache.h"
+#include "util.h"
 
 #include <cstring>
 #include <mcpelauncher/linker.h>
 #include <log.h>
 #include <mcpelauncher/minecraft_version.h>
 #include <mcpelauncher/patch_utils.h>
+#include <mcpelauncher/path_helper.h>
 #include <stdexcept>
 
 bool GLCorePatch::enabled = false;
 std::unordered_map<unsigned int, unsigned int> GLCorePatch::vaoMap;
 std::pair<int, unsigned int> GLCorePatch::buffers[2] = {{0x8892, 0}, {0x8893, 0}};
+std::unique_ptr<ProgramBinaryCache> GLCorePatch::programCache;
 void (*GLCorePatch::glGenVertexArrays)(int n, unsigned int *arrays);
 void (*GLCorePatch::glBindVertexArray)(unsigned int array);
 void (*GLCorePatch::glShaderSource_orig)(unsigned int shader, unsigned int count, const char **string, int *length);
+void (*GLCorePatch::glAttachShader_orig)(unsigned int program, unsigned int shader);
+void (*GLCorePatch::glBindAttribLocation_orig)(unsigned int program, unsigned int index, const char *name);
+void (*GLCorePatch::glDeleteProgram_orig)(unsigned int program);
 void (*GLCorePatch::glLinkProgram_orig)(unsigned int program);
 void (*GLCorePatch::glUseProgram_orig)(unsigned int program);
 void (*GLCorePatch::glBindBuffer_orig)(int target, unsigned int buffer);
@@ -59,6 +66,16 @@ void GLCorePatch::installGL(std::unordered_map<std::string, void *> &overrides,
     overrides["glLinkProgram"] = (void *)glLinkProgram;
     overrides["glUseProgram"] = (void *)glUseProgram;
     overrides["glBindBuffer"] = (void *)glBindBuffer;
+
+    if(ReadEnvFlag("MCPELAUNCHER_GL_PROGRAM_CACHE", true)) {
+        programCache = std::make_unique<ProgramBinaryCache>(PathHelper::getCacheDirectory() + "program-cache/", resolver);
+        glAttachShader_orig = (void (*)(unsigned int, unsigned int))resolver("glAttachShader");
+        glBindAttribLocation_orig = (void (*)(unsigned int, unsigned int, const char *))resolver("glBindAttribLocation");
+        glDeleteProgram_orig = (void (*)(unsigned int))resolver("glDeleteProgram");
+        overrides["glAttachShader"] = (void *)glAttachShader;
+        overrides["glBindAttribLocation"] = (void *)glBindAttribLocation;
+        overrides["glDeleteProgram"] = (void *)glDeleteProgram;
+    }
 }
 
 void GLCorePatch::glShaderSource(unsigned int shader, unsigned int count, const char **string, int *length) {
@@ -66,11 +83,31 @@ void GLCorePatch::glShaderSource(unsigned int shader, unsigned int count, const
         string[0] = "#version 410\n";
         length[0] = strlen("#version 410\n");
     }
+    if(programCache)
+        programCache->onShaderSource(shader, count, string, length);
     glShaderSource_orig(shader, count, string, length);
 }
 
+void GLCorePatch::glAttachShader(unsigned int program, unsigned int shader) {
+    programCache->onAttachShader(program, shader);
+    glAttachShader_orig(program, shader);
+}
+
+void GLCorePatch::glBindAttribLocation(unsigned int program, unsigned int index, const char *name) {
+    programCache->onBindAttribLocation(program, index, name);
+    glBindAttribLocation_orig(program, index, name);
+}
+
+void GLCorePatch::glDeleteProgram(unsigned int program) {
+    programCache->onDeleteProgram(program);
+    glDeleteProgram_orig(program);
+}
+
 void GLCorePatch::glLinkProgram(unsigned int program) {
-    glLinkProgram_orig(program);
+    if(programCache)
+        programCache->linkProgram(program, glLinkProgram_orig);
+    else
+        glLinkProgram_orig(program);
 
     unsigned int vertexArr;
     glGenVertexArrays(1, &vertexArr);
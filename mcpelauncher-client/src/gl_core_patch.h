@@ -1,14 +1,18 @@
 #pragma once
 
 #include <cstddef>
+#include <memory>
 #include <unordered_map>
 #include <string>
 
+class ProgramBinaryCache;
+
 class GLCorePatch {
 private:
     static bool enabled;
     static std::unordered_map<unsigned int, unsigned int> vaoMap;
     static std::pair<int, unsigned int> buffers[2];
+    static std::unique_ptr<ProgramBinaryCache> programCache;
 
     static void (*glGenVertexArrays)(int n, unsigned int *arrays);
     static void (*glBindVertexArray)(unsigned int array);
@@ -16,6 +20,15 @@ private:
     static void (*glShaderSource_orig)(unsigned int shader, unsigned int count, const char **string, int *length);
     static void glShaderSource(unsigned int shader, unsigned int count, const char **string, int *length);
 
+    static void (*glAttachShader_orig)(unsigned int program, unsigned int shader);
+    static void glAttachShader(unsigned int program, unsigned int shader);
+
+    static void (*glBindAttribLocation_orig)(unsigned int program, unsigned int index, const char *name);
+    static void glBindAttribLocation(unsigned int program, unsigned int index, const char *name);
+
+    static void (*glDeleteProgram_orig)(unsigned int program);
+    static void glDeleteProgram(unsigned int program);
+
     static void (*glLinkProgram_orig)(unsigned int program);
     static void glLinkProgram(unsigned int program);
 
@@ -0,0 +1,498 @@
+#include "gl_proc_table.h"
+
+#include <cstdint>
+#include <cstring>
+
+namespace {
+
+constexpr const char *knownNames[] = {
+        // OpenGL ES 2.0 - 3.2
+        "glActiveTexture",
+        "glAttachShader",
+        "glBindAttribLocation",
+        "glBindBuffer",
+        "glBindFramebuffer",
+        "glBindRenderbuffer",
+        "glBindTexture",
+        "glBlendColor",
+        "glBlendEquation",
+        "glBlendEquationSeparate",
+        "glBlendFunc",
+        "glBlendFuncSeparate",
+        "glBufferData",
+        "glBufferSubData",
+        "glCheckFramebufferStatus",
+        "glClear",
+        "glClearColor",
+        "glClearDepthf",
+        "glClearStencil",
+        "glColorMask",
+        "glCompileShader",
+        "glCompressedTexImage2D",
+        "glCompressedTexSubImage2D",
+        "glCopyTexImage2D",
+        "glCopyTexSubImage2D",
+        "glCreateProgram",
+        "glCreateShader",
+        "glCullFace",
+        "glDeleteBuffers",
+        "glDeleteFramebuffers",
+        "glDeleteProgram",
+        "glDeleteRenderbuffers",
+        "glDeleteShader",
+        "glDeleteTextures",
+        "glDepthFunc",
+        "glDepthMask",
+        "glDepthRangef",
+        "glDetachShader",
+        "glDisable",
+        "glDisableVertexAttribArray",
+        "glDrawArrays",
+        "glDrawElements",
+        "glEnable",
+        "glEnableVertexAttribArray",
+        "glFinish",
+        "glFlush",
+        "glFramebufferRenderbuffer",
+        "glFramebufferTexture2D",
+        "glFrontFace",
+        "glGenBuffers",
+        "glGenerateMipmap",
+        "glGenFramebuffers",
+        "glGenRenderbuffers",
+        "glGenTextures",
+        "glGetActiveAttrib",
+        "glGetActiveUniform",
+        "glGetAttachedShaders",
+        "glGetAttribLocation",
+        "glGetBooleanv",
+        "glGetBufferParameteriv",
+        "glGetError",
+        "glGetFloatv",
+        "glGetFramebufferAttachmentParameteriv",
+        "glGetIntegerv",
+        "glGetProgramiv",
+        "glGetProgramInfoLog",
+        "glGetRenderbufferParameteriv",
+        "glGetShaderiv",
+        "glGetShaderInfoLog",
+        "glGetShaderPrecisionFormat",
+        "glGetShaderSource",
+        "glGetString",
+        "glGetTexParameterfv",
+        "glGetTexParameteriv",
+        "glGetUniformfv",
+        "glGetUniformiv",
+        "glGetUniformLocation",
+        "glGetVertexAttribfv",
+        "glGetVertexAttribiv",
+        "glGetVertexAttribPointerv",
+        "glHint",
+        "glIsBuffer",
+        "glIsEnabled",
+        "glIsFramebuffer",
+        "glIsProgram",
+        "glIsRenderbuffer",
+        "glIsShader",
+        "glIsTexture",
+        "glLineWidth",
+        "glLinkProgram",
+        "glPixelStorei",
+        "glPolygonOffset",
+        "glReadPixels",
+        "glReleaseShaderCompiler",
+        "glRenderbufferStorage",
+        "glSampleCoverage",
+        "glScissor",
+        "glShaderBinary",
+        "glShaderSource",
+        "glStencilFunc",
+        "glStencilFuncSeparate",
+        "glStencilMask",
+        "glStencilMaskSeparate",
+        "glStencilOp",
+        "glStencilOpSeparate",
+        "glTexImage2D",
+        "glTexParameterf",
+        "glTexParameterfv",
+        "glTexParameteri",
+        "glTexParameteriv",
+        "glTexSubImage2D",
+        "glUniform1f",
+        "glUniform1fv",
+        "glUniform1i",
+        "glUniform1iv",
+        "glUniform2f",
+        "glUniform2fv",
+        "glUniform2i",
+        "glUniform2iv",
+        "glUniform3f",
+        "glUniform3fv",
+        "glUniform3i",
+        "glUniform3iv",
+        "glUniform4f",
+        "glUniform4fv",
+        "glUniform4i",
+        "glUniform4iv",
+        "glUniformMatrix2fv",
+        "glUniformMatrix3fv",
+        "glUniformMatrix4fv",
+        "glUseProgram",
+        "glValidateProgram",
+        "glVertexAttrib1f",
+        "glVertexAttrib1fv",
+        "glVertexAttrib2f",
+        "glVertexAttrib2fv",
+        "glVertexAttrib3f",
+        "glVertexAttrib3fv",
+        "glVertexAttrib4f",
+        "glVertexAttrib4fv",
+        "glVertexAttribPointer",
+        "glViewport",
+        "glReadBuffer",
+        "glDrawRangeElements",
+        "glTexImage3D",
+        "glTexSubImage3D",
+        "glCopyTexSubImage3D",
+        "glCompressedTexImage3D",
+        "glCompressedTexSubImage3D",
+        "glGenQueries",
+        "glDeleteQueries",
+        "glIsQuery",
+        "glBeginQuery",
+        "glEndQuery",
+        "glGetQueryiv",
+        "glGetQueryObjectuiv",
+        "glUnmapBuffer",
+        "glGetBufferPointerv",
+        "glDrawBuffers",
+        "glUniformMatrix2x3fv",
+        "glUniformMatrix3x2fv",
+        "glUniformMatrix2x4fv",
+        "glUniformMatrix4x2fv",
+        "glUniformMatrix3x4fv",
+        "glUniformMatrix4x3fv",
+        "glBlitFramebuffer",
+        "glRenderbufferStorageMultisample",
+        "glFramebufferTextureLayer",
+        "glMapBufferRange",
+        "glFlushMappedBufferRange",
+        "glBindVertexArray",
+        "glDeleteVertexArrays",
+        "glGenVertexArrays",
+        "glIsVertexArray",
+        "glGetIntegeri_v",
+        "glBeginTransformFeedback",
+        "glEndTransformFeedback",
+        "glBindBufferRange",
+        "glBindBufferBase",
+        "glTransformFeedbackVaryings",
+        "glGetTransformFeedbackVarying",
+        "glVertexAttribIPointer",
+        "glGetVertexAttribIiv",
+        "glGetVertexAttribIuiv",
+        "glVertexAttribI4i",
+        "glVertexAttribI4ui",
+        "glVertexAttribI4iv",
+        "glVertexAttribI4uiv",
+        "glGetUniformuiv",
+        "glGetFragDataLocation",
+        "glUniform1ui",
+        "glUniform2ui",
+        "glUniform3ui",
+        "glUniform4ui",
+        "glUniform1uiv",
+        "glUniform2uiv",
+        "glUniform3uiv",
+        "glUniform4uiv",
+        "glClearBufferiv",
+        "glClearBufferuiv",
+        "glClearBufferfv",
+        "glClearBufferfi",
+        "glGetStringi",
+        "glCopyBufferSubData",
+        "glGetUniformIndices",
+        "glGetActiveUniformsiv",
+        "glGetUniformBlockIndex",
+        "glGetActiveUniformBlockiv",
+        "glGetActiveUniformBlockName",
+        "glUniformBlockBinding",
+        "glDrawArraysInstanced",
+        "glDrawElementsInstanced",
+        "glFenceSync",
+        "glIsSync",
+        "glDeleteSync",
+        "glClientWaitSync",
+        "glWaitSync",
+        "glGetInteger64v",
+        "glGetSynciv",
+        "glGetInteger64i_v",
+        "glGetBufferParameteri64v",
+        "glGenSamplers",
+        "glDeleteSamplers",
+        "glIsSampler",
+        "glBindSampler",
+        "glSamplerParameteri",
+        "glSamplerParameteriv",
+        "glSamplerParameterf",
+        "glSamplerParameterfv",
+        "glGetSamplerParameteriv",
+        "glGetSamplerParameterfv",
+        "glVertexAttribDivisor",
+        "glBindTransformFeedback",
+        "glDeleteTransformFeedbacks",
+        "glGenTransformFeedbacks",
+        "glIsTransformFeedback",
+        "glPauseTransformFeedback",
+        "glResumeTransformFeedback",
+        "glGetProgramBinary",
+        "glProgramBinary",
+        "glProgramParameteri",
+        "glInvalidateFramebuffer",
+        "glInvalidateSubFramebuffer",
+        "glTexStorage2D",
+        "glTexStorage3D",
+        "glGetInternalformativ",
+        "glDispatchCompute",
+        "glDispatchComputeIndirect",
+        "glDrawArraysIndirect",
+        "glDrawElementsIndirect",
+        "glFramebufferParameteri",
+        "glGetFramebufferParameteriv",
+        "glGetProgramInterfaceiv",
+        "glGetProgramResourceIndex",
+        "glGetProgramResourceName",
+        "glGetProgramResourceiv",
+        "glGetProgramResourceLocation",
+        "glUseProgramStages",
+        "glActiveShaderProgram",
+        "glCreateShaderProgramv",
+        "glBindProgramPipeline",
+        "glDeleteProgramPipelines",
+        "glGenProgramPipelines",
+        "glIsProgramPipeline",
+        "glGetProgramPipelineiv",
+        "glProgramUniform1i",
+        "glProgramUniform2i",
+        "glProgramUniform3i",
+        "glProgramUniform4i",
+        "glProgramUniform1ui",
+        "glProgramUniform2ui",
+        "glProgramUniform3ui",
+        "glProgramUniform4ui",
+        "glProgramUniform1f",
+        "glProgramUniform2f",
+        "glProgramUniform3f",
+        "glProgramUniform4f",
+        "glProgramUniform1iv",
+        "glProgramUniform2iv",
+        "glProgramUniform3iv",
+        "glProgramUniform4iv",
+        "glProgramUniform1uiv",
+        "glProgramUniform2uiv",
+        "glProgramUniform3uiv",
+        "glProgramUniform4uiv",
+        "glProgramUniform1fv",
+        "glProgramUniform2fv",
+        "glProgramUniform3fv",
+        "glProgramUniform4fv",
+        "glProgramUniformMatrix2fv",
+        "glProgramUniformMatrix3fv",
+        "glProgramUniformMatrix4fv",
+        "glProgramUniformMatrix2x3fv",
+        "glProgramUniformMatrix3x2fv",
+        "glProgramUniformMatrix2x4fv",
+        "glProgramUniformMatrix4x2fv",
+        "glProgramUniformMatrix3x4fv",
+        "glProgramUniformMatrix4x3fv",
+        "glValidateProgramPipeline",
+        "glGetProgramPipelineInfoLog",
+        "glBindImageTexture",
+        "glGetBooleani_v",
+        "glMemoryBarrier",
+        "glMemoryBarrierByRegion",
+        "glTexStorage2DMultisample",
+        "glGetMultisamplefv",
+        "glSampleMaski",
+        "glGetTexLevelParameteriv",
+        "glGetTexLevelParameterfv",
+        "glBindVertexBuffer",
+        "glVertexAttribFormat",
+        "glVertexAttribIFormat",
+        "glVertexAttribBinding",
+        "glVertexBindingDivisor",
+        "glBlendBarrier",
+        "glCopyImageSubData",
+        "glDebugMessageControl",
+        "glDebugMessageInsert",
+        "glDebugMessageCallback",
+        "glGetDebugMessageLog",
+        "glPushDebugGroup",
+        "glPopDebugGroup",
+        "glObjectLabel",
+        "glGetObjectLabel",
+        "glObjectPtrLabel",
+        "glGetObjectPtrLabel",
+        "glGetPointerv",
+        "glEnablei",
+        "glDisablei",
+        "glBlendEquationi",
+        "glBlendEquationSeparatei",
+        "glBlendFunci",
+        "glBlendFuncSeparatei",
+        "glColorMaski",
+        "glIsEnabledi",
+        "glDrawElementsBaseVertex",
+        "glDrawRangeElementsBaseVertex",
+        "glDrawElementsInstancedBaseVertex",
+        "glFramebufferTexture",
+        "glPrimitiveBoundingBox",
+        "glGetGraphicsResetStatus",
+        "glReadnPixels",
+        "glGetnUniformfv",
+        "glGetnUniformiv",
+        "glGetnUniformuiv",
+        "glMinSampleShading",
+        "glPatchParameteri",
+        "glTexParameterIiv",
+        "glTexParameterIuiv",
+        "glGetTexParameterIiv",
+        "glGetTexParameterIuiv",
+        "glSamplerParameterIiv",
+        "glSamplerParameterIuiv",
+        "glGetSamplerParameterIiv",
+        "glGetSamplerParameterIuiv",
+        "glTexBuffer",
+        "glTexBufferRange",
+        "glTexStorage3DMultisample",
+        // OpenGL ES 1 functions the game imports from libGLESv2.so
+        "glAlphaFunc",
+        "glShadeModel",
+        "glEnableClientState",
+        "glLightModelf",
+        "glColor4f",
+        "glPushMatrix",
+        "glTranslatef",
+        "glPopMatrix",
+        "glDisableClientState",
+        "glMatrixMode",
+        "glScalef",
+        "glRotatef",
+        "glLoadIdentity",
+        "glLightfv",
+        "glOrthof",
+        "glVertexPointer",
+        "glTexCoordPointer",
+        "glColorPointer",
+        "glNormalPointer",
+        "glFogfv",
+        "glFogx",
+        "glFogf",
+        "glMultMatrixf",
+        // Extensions looked up by the game or overridden by the launcher
+        "glDrawArraysInstancedOES",
+        "glDrawElementsInstancedOES",
+        "glVertexAttribDivisorOES",
+        "glGenVertexArraysOES",
+        "glBindVertexArrayOES",
+        "glDeleteVertexArraysOES",
+        "glIsVertexArrayOES",
+        "glMapBufferOES",
+        "glUnmapBufferOES",
+        "glGetProgramBinaryOES",
+        "glProgramBinaryOES",
+        "glDiscardFramebufferEXT",
+        "glTexStorage2DEXT",
+        "glDrawBuffersEXT",
+        "glInsertEventMarkerEXT",
+        "glPushGroupMarkerEXT",
+        "glPopGroupMarkerEXT",
+        "glObjectLabelKHR",
+        "glDebugMessageCallbackKHR",
+        "glDebugMessageControlKHR",
+        "glQueryCounterEXT",
+        "glGetQueryObjectui64vEXT",
+};
+
+constexpr size_t knownCount = sizeof(knownNames) / sizeof(*knownNames);
+// Power of two, kept at a load factor of about 0.2 so that no lookup probes more than a few slots
+constexpr size_t tableSize = 2048;
+constexpr uint16_t emptySlot = 0xFFFF;
+
+static_assert(knownCount * 4 <= tableSize, "GLProcTable is too full, grow tableSize");
+
+// FNV-1a
+constexpr uint32_t hashName(const char *name) {
+    uint32_t hash = 2166136261u;
+    for(; *name; name++) {
+        hash ^= (unsigned char)*name;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+struct HashTable {
+    uint16_t index[tableSize] = {};
+    uint32_t hash[tableSize] = {};
+    size_t maxProbes = 0;
+};
+
+constexpr HashTable buildTable() {
+    HashTable table;
+    for(size_t i = 0; i < tableSize; i++)
+        table.index[i] = emptySlot;
+    for(size_t i = 0; i < knownCount; i++) {
+        uint32_t hash = hashName(knownNames[i]);
+        size_t slot = hash & (tableSize - 1);
+        size_t probes = 1;
+        for(; table.index[slot] != emptySlot; probes++)
+            slot = (slot + 1) & (tableSize - 1);
+        table.index[slot] = (uint16_t)i;
+        table.hash[slot] = hash;
+        if(probes > table.maxProbes)
+            table.maxProbes = probes;
+    }
+    return table;
+}
+
+constexpr HashTable hashTable = buildTable();
+
+static_assert(hashTable.maxProbes <= 4, "GLProcTable probe sequences got long, change tableSize");
+
+}  // namespace
+
+size_t GLProcTable::find(const char *name) {
+    uint32_t hash = hashName(name);
+    for(size_t slot = hash & (tableSize - 1);; slot = (slot + 1) & (tableSize - 1)) {
+        uint16_t index = hashTable.index[slot];
+        if(index == emptySlot)
+            return npos;
+        if(hashTable.hash[slot] == hash && strcmp(knownNames[index], name) == 0)
+            return index;
+    }
+}
+
+const char *GLProcTable::getName(size_t index) {
+    return knownNames[index];
+}
+
+size_t GLProcTable::size() {
+    return knownCount;
+}
+
+void GLProcTable::fill(void *(*resolver)(const char *)) {
+    procs.resize(knownCount);
+    for(size_t i = 0; i < knownCount; i++)
+        procs[i] = resolver(knownNames[i]);
+}
+
+void GLProcTable::clear() {
+    procs.clear();
+}
+
+void *GLProcTable::get(const char *name, void *(*resolver)(const char *)) const {
+    if(procs.empty())
+        return resolver(name);
+    size_t index = find(name);
+    return index != npos ? procs[index] : resolver(name);
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+/*
+ * Flat resolution table for the GLES entry points the game and the launcher know about. The names are hashed into an
+ * open addressing table at compile time, so looking one up neither allocates nor builds a std::string.
+ * fill() resolves all of them in a single pass once the overrides are installed for a context, get() only reads the
+ * table afterwards and falls back to the resolver for names outside of it.
+ */
+class GLProcTable {
+public:
+    static constexpr size_t npos = (size_t)-1;
+
+private:
+    std::vector<void *> procs;
+
+public:
+    // Index of name among the known entry points, npos if it is not one of them
+    static size_t find(const char *name);
+    static const char *getName(size_t index);
+    static size_t size();
+
+    // Resolves every known entry point with resolver, replacing the previous pointers
+    void fill(void *(*resolver)(const char *));
+    // Drops all pointers, get() forwards every name to its resolver until the next fill()
+    void clear();
+
+    bool isFilled() const {
+        return !procs.empty();
+    }
+
+    void *get(const char *name, void *(*resolver)(const char *)) const;
+};
@@ -0,0 +1,378 @@
+#include "gl_state_cache.h"
+#include "util.h"
+
+#include <algorithm>
+#include <cstring>
+#include <log.h>
+
+bool GLStateCache::enabled = false;
+bool GLStateCache::debug = false;
+uint64_t GLStateCache::elided = 0;
+
+uint32_t GLStateCache::currentProgram;
+uint32_t GLStateCache::currentVertexArray;
+uint32_t GLStateCache::boundBuffers[bufferTargetCount];
+uint32_t GLStateCache::currentActiveTexture;
+uint32_t GLStateCache::boundTextures[maxTextureUnits][textureTargetCount];
+uint32_t GLStateCache::capStates[capCount];
+uint32_t GLStateCache::blendFactors[4];
+uint32_t GLStateCache::currentDepthFunc, GLStateCache::currentDepthMask;
+uint32_t GLStateCache::currentCullFace, GLStateCache::currentFrontFace;
+bool GLStateCache::viewportValid, GLStateCache::scissorValid;
+int GLStateCache::currentViewport[4], GLStateCache::currentScissor[4];
+
+void (*GLStateCache::glGetIntegerv)(unsigned int pname, int *data);
+unsigned char (*GLStateCache::glIsEnabled)(unsigned int cap);
+void (*GLStateCache::glUseProgram_orig)(unsigned int program);
+void (*GLStateCache::glDeleteProgram_orig)(unsigned int program);
+void (*GLStateCache::glBindVertexArray_orig)(unsigned int array);
+void (*GLStateCache::glDeleteVertexArrays_orig)(int n, const unsigned int *arrays);
+void (*GLStateCache::glBindVertexArrayOES_orig)(unsigned int array);
+void (*GLStateCache::glDeleteVertexArraysOES_orig)(int n, const unsigned int *arrays);
+void (*GLStateCache::glBindVertexArrayAPPLE_orig)(unsigned int array);
+void (*GLStateCache::glDeleteVertexArraysAPPLE_orig)(int n, const unsigned int *arrays);
+void (*GLStateCache::glBindBuffer_orig)(unsigned int target, unsigned int buffer);
+void (*GLStateCache::glBindBufferBase_orig)(unsigned int target, unsigned int index, unsigned int buffer);
+void (*GLStateCache::glBindBufferRange_orig)(unsigned int target, unsigned int index, unsigned int buffer, intptr_t offset, intptr_t size);
+void (*GLStateCache::glDeleteBuffers_orig)(int n, const unsigned int *buffers);
+void (*GLStateCache::glActiveTexture_orig)(unsigned int unit);
+void (*GLStateCache::glBindTexture_orig)(unsigned int target, unsigned int texture);
+void (*GLStateCache::glDeleteTextures_orig)(int n, const unsigned int *textures);
+void (*GLStateCache::glEnable_orig)(unsigned int cap);
+void (*GLStateCache::glDisable_orig)(unsigned int cap);
+void (*GLStateCache::glBlendFunc_orig)(unsigned int sfactor, unsigned int dfactor);
+void (*GLStateCache::glBlendFuncSeparate_orig)(unsigned int srcRGB, unsigned int dstRGB, unsigned int srcAlpha, unsigned int dstAlpha);
+void (*GLStateCache::glDepthFunc_orig)(unsigned int func);
+void (*GLStateCache::glDepthMask_orig)(unsigned char flag);
+void (*GLStateCache::glCullFace_orig)(unsigned int mode);
+void (*GLStateCache::glFrontFace_orig)(unsigned int mode);
+void (*GLStateCache::glViewport_orig)(int x, int y, int width, int height);
+void (*GLStateCache::glScissor_orig)(int x, int y, int width, int height);
+
+// GL_ARRAY_BUFFER, GL_ELEMENT_ARRAY_BUFFER, GL_UNIFORM_BUFFER, GL_PIXEL_PACK_BUFFER, GL_PIXEL_UNPACK_BUFFER,
+// GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, GL_TRANSFORM_FEEDBACK_BUFFER and their binding queries
+static const unsigned int bufferTargets[] = {0x8892, 0x8893, 0x8A11, 0x88EB, 0x88EC, 0x8F36, 0x8F37, 0x8C8E};
+static const unsigned int bufferBindings[] = {0x8894, 0x8895, 0x8A28, 0x88ED, 0x88EF, 0x8F36, 0x8F37, 0x8C8F};
+static const int elementArraySlot = 1;
+// GL_TEXTURE_2D, GL_TEXTURE_CUBE_MAP, GL_TEXTURE_3D, GL_TEXTURE_2D_ARRAY and their binding queries
+static const unsigned int textureTargets[] = {0x0DE1, 0x8513, 0x806F, 0x8C1A};
+static const unsigned int textureBindings[] = {0x8069, 0x8514, 0x806A, 0x8C1D};
+// GL_BLEND, GL_DEPTH_TEST, GL_CULL_FACE, GL_SCISSOR_TEST, GL_STENCIL_TEST, GL_POLYGON_OFFSET_FILL
+static const unsigned int capNames[] = {0x0BE2, 0x0B71, 0x0B44, 0x0C11, 0x0B90, 0x8037};
+static const unsigned int textureUnit0 = 0x84C0;
+
+void GLStateCache::installGL(std::unordered_map<std::string, void *> &overrides, void *(*resolver)(const char *)) {
+    enabled = ReadEnvFlag("MCPELAUNCHER_GL_STATE_CACHE");
+    if(!enabled)
+        return;
+    debug = ReadEnvFlag("MCPELAUNCHER_GL_STATE_CACHE_DEBUG");
+    invalidate();
+
+    glGetIntegerv = (void (*)(unsigned int, int *))resolver("glGetIntegerv");
+    glIsEnabled = (unsigned char (*)(unsigned int))resolver("glIsEnabled");
+    if(debug && (!glGetIntegerv || !glIsEnabled))
+        debug = false;
+
+    // Functions the driver doesn't provide stay unhooked
+#define HOOK(name)                                             \
+    name##_orig = (decltype(name##_orig))resolver(#name);      \
+    if(name##_orig)                                            \
+        overrides[#name] = (void *)name;
+    HOOK(glUseProgram)
+    HOOK(glDeleteProgram)
+    HOOK(glBindVertexArray)
+    HOOK(glDeleteVertexArrays)
+    HOOK(glBindVertexArrayOES)
+    HOOK(glDeleteVertexArraysOES)
+    HOOK(glBindVertexArrayAPPLE)
+    HOOK(glDeleteVertexArraysAPPLE)
+    HOOK(glBindBuffer)
+    HOOK(glBindBufferBase)
+    HOOK(glBindBufferRange)
+    HOOK(glDeleteBuffers)
+    HOOK(glActiveTexture)
+    HOOK(glBindTexture)
+    HOOK(glDeleteTextures)
+    HOOK(glEnable)
+    HOOK(glDisable)
+    HOOK(glBlendFunc)
+    HOOK(glBlendFuncSeparate)
+    HOOK(glDepthFunc)
+    HOOK(glDepthMask)
+    HOOK(glCullFace)
+    HOOK(glFrontFace)
+    HOOK(glViewport)
+    HOOK(glScissor)
+#undef HOOK
+    Log::info("GLStateCache", "Enabled%s", debug ? " with driver state checks" : "");
+}
+
+void GLStateCache::invalidate() {
+    currentProgram = currentVertexArray = currentActiveTexture = unknown;
+    std::fill(std::begin(boundBuffers), std::end(boundBuffers), unknown);
+    std::fill(&boundTextures[0][0], &boundTextures[0][0] + maxTextureUnits * textureTargetCount, unknown);
+    std::fill(std::begin(capStates), std::end(capStates), unknown);
+    std::fill(std::begin(blendFactors), std::end(blendFactors), unknown);
+    currentDepthFunc = currentDepthMask = currentCullFace = currentFrontFace = unknown;
+    viewportValid = scissorValid = false;
+}
+
+int GLStateCache::getBufferSlot(unsigned int target) {
+    auto it = std::find(std::begin(bufferTargets), std::end(bufferTargets), target);
+    return it != std::end(bufferTargets) ? (int)(it - std::begin(bufferTargets)) : -1;
+}
+
+int GLStateCache::getTextureSlot(unsigned int target) {
+    auto it = std::find(std::begin(textureTargets), std::end(textureTargets), target);
+    return it != std::end(textureTargets) ? (int)(it - std::begin(textureTargets)) : -1;
+}
+
+int GLStateCache::getCapSlot(unsigned int cap) {
+    auto it = std::find(std::begin(capNames), std::end(capNames), cap);
+    return it != std::end(capNames) ? (int)(it - std::begin(capNames)) : -1;
+}
+
+bool GLStateCache::elide(const char *name, std::initializer_list<std::pair<unsigned int, int>> expected) {
+    if(debug) {
+        for(auto &&e : expected) {
+            int value = 0;
+            glGetIntegerv(e.first, &value);
+            if(value != e.second) {
+                Log::warn("GLStateCache", "%s: shadow state 0x%x, driver 0x%x (pname 0x%x)", name, e.second, value, e.first);
+                return false;
+            }
+        }
+    }
+    elided++;
+    return true;
+}
+
+bool GLStateCache::elideRect(const char *name, unsigned int pname, const int *expected) {
+    if(debug) {
+        int value[4] = {};
+        glGetIntegerv(pname, value);
+        if(memcmp(value, expected, sizeof(value)) != 0) {
+            Log::warn("GLStateCache", "%s: shadow state %d,%d %dx%d, driver %d,%d %dx%d", name, expected[0], expected[1], expected[2], expected[3], value[0], value[1], value[2], value[3]);
+            return false;
+        }
+    }
+    elided++;
+    return true;
+}
+
+bool GLStateCache::elideCap(unsigned int cap, bool enabled) {
+    if(debug && (glIsEnabled(cap) != 0) != enabled) {
+        Log::warn("GLStateCache", "%s(0x%x): shadow state %d, driver %d", enabled ? "glEnable" : "glDisable", cap, enabled, !enabled);
+        return false;
+    }
+    elided++;
+    return true;
+}
+
+void GLStateCache::glUseProgram(unsigned int program) {
+    if(program == currentProgram && elide("glUseProgram", {{0x8B8D, (int)program}}))
+        return;
+    currentProgram = program;
+    glUseProgram_orig(program);
+}
+
+void GLStateCache::glDeleteProgram(unsigned int program) {
+    // A program in use is only flagged for deletion, but don't rely on that
+    if(program == currentProgram)
+        currentProgram = unknown;
+    glDeleteProgram_orig(program);
+}
+
+void GLStateCache::bindVertexArray(const char *name, void (*orig)(unsigned int), unsigned int array) {
+    if(array == currentVertexArray && elide(name, {{0x85B5, (int)array}}))
+        return;
+    currentVertexArray = array;
+    // The element array buffer binding is part of the vertex array
+    boundBuffers[elementArraySlot] = unknown;
+    orig(array);
+}
+
+void GLStateCache::deleteVertexArrays(void (*orig)(int, const unsigned int *), int n, const unsigned int *arrays) {
+    if(arrays && std::find(arrays, arrays + n, currentVertexArray) != arrays + n) {
+        // Deleting the bound vertex array binds 0
+        currentVertexArray = 0;
+        boundBuffers[elementArraySlot] = unknown;
+    }
+    orig(n, arrays);
+}
+
+void GLStateCache::glBindVertexArray(unsigned int array) {
+    bindVertexArray("glBindVertexArray", glBindVertexArray_orig, array);
+}
+
+void GLStateCache::glDeleteVertexArrays(int n, const unsigned int *arrays) {
+    deleteVertexArrays(glDeleteVertexArrays_orig, n, arrays);
+}
+
+void GLStateCache::glBindVertexArrayOES(unsigned int array) {
+    bindVertexArray("glBindVertexArrayOES", glBindVertexArrayOES_orig, array);
+}
+
+void GLStateCache::glDeleteVertexArraysOES(int n, const unsigned int *arrays) {
+    deleteVertexArrays(glDeleteVertexArraysOES_orig, n, arrays);
+}
+
+void GLStateCache::glBindVertexArrayAPPLE(unsigned int array) {
+    bindVertexArray("glBindVertexArrayAPPLE", glBindVertexArrayAPPLE_orig, array);
+}
+
+void GLStateCache::glDeleteVertexArraysAPPLE(int n, const unsigned int *arrays) {
+    deleteVertexArrays(glDeleteVertexArraysAPPLE_orig, n, arrays);
+}
+
+void GLStateCache::glBindBuffer(unsigned int target, unsigned int buffer) {
+    int slot = getBufferSlot(target);
+    if(slot >= 0 && boundBuffers[slot] == buffer && elide("glBindBuffer", {{bufferBindings[slot], (int)buffer}}))
+        return;
+    if(slot >= 0)
+        boundBuffers[slot] = buffer;
+    glBindBuffer_orig(target, buffer);
+}
+
+void GLStateCache::glBindBufferBase(unsigned int target, unsigned int index, unsigned int buffer) {
+    // Also binds the buffer to the generic binding point of target
+    int slot = getBufferSlot(target);
+    if(slot >= 0)
+        boundBuffers[slot] = buffer;
+    glBindBufferBase_orig(target, index, buffer);
+}
+
+void GLStateCache::glBindBufferRange(unsigned int target, unsigned int index, unsigned int buffer, intptr_t offset, intptr_t size) {
+    int slot = getBufferSlot(target);
+    if(slot >= 0)
+        boundBuffers[slot] = buffer;
+    glBindBufferRange_orig(target, index, buffer, offset, size);
+}
+
+void GLStateCache::glDeleteBuffers(int n, const unsigned int *buffers) {
+    // Deleted buffers are unbound from every target of the current context
+    for(int i = 0; buffers && i < n; i++) {
+        for(auto &b : boundBuffers) {
+            if(b == buffers[i])
+                b = 0;
+        }
+    }
+    glDeleteBuffers_orig(n, buffers);
+}
+
+void GLStateCache::glActiveTexture(unsigned int unit) {
+    if(unit == currentActiveTexture && elide("glActiveTexture", {{0x84E0, (int)unit}}))
+        return;
+    currentActiveTexture = unit;
+    glActiveTexture_orig(unit);
+}
+
+void GLStateCache::glBindTexture(unsigned int target, unsigned int texture) {
+    int slot = getTextureSlot(target);
+    uint32_t unit = currentActiveTexture - textureUnit0;
+    if(slot < 0 || unit >= maxTextureUnits) {
+        glBindTexture_orig(target, texture);
+        return;
+    }
+    if(boundTextures[unit][slot] == texture && elide("glBindTexture", {{textureBindings[slot], (int)texture}}))
+        return;
+    boundTextures[unit][slot] = texture;
+    glBindTexture_orig(target, texture);
+}
+
+void GLStateCache::glDeleteTextures(int n, const unsigned int *textures) {
+    for(int i = 0; textures && i < n; i++) {
+        for(auto &unit : boundTextures) {
+            for(auto &t : unit) {
+                if(t == textures[i])
+                    t = 0;
+            }
+        }
+    }
+    glDeleteTextures_orig(n, textures);
+}
+
+void GLStateCache::glEnable(unsigned int cap) {
+    int slot = getCapSlot(cap);
+    if(slot >= 0 && capStates[slot] == 1 && elideCap(cap, true))
+        return;
+    if(slot >= 0)
+        capStates[slot] = 1;
+    glEnable_orig(cap);
+}
+
+void GLStateCache::glDisable(unsigned int cap) {
+    int slot = getCapSlot(cap);
+    if(slot >= 0 && capStates[slot] == 0 && elideCap(cap, false))
+        return;
+    if(slot >= 0)
+        capStates[slot] = 0;
+    glDisable_orig(cap);
+}
+
+void GLStateCache::glBlendFunc(unsigned int sfactor, unsigned int dfactor) {
+    if(blendFactors[0] == sfactor && blendFactors[1] == dfactor && blendFactors[2] == sfactor && blendFactors[3] == dfactor &&
+       elide("glBlendFunc", {{0x80C9, (int)sfactor}, {0x80C8, (int)dfactor}, {0x80CB, (int)sfactor}, {0x80CA, (int)dfactor}}))
+        return;
+    blendFactors[0] = blendFactors[2] = sfactor;
+    blendFactors[1] = blendFactors[3] = dfactor;
+    glBlendFunc_orig(sfactor, dfactor);
+}
+
+void GLStateCache::glBlendFuncSeparate(unsigned int srcRGB, unsigned int dstRGB, unsigned int srcAlpha, unsigned int dstAlpha) {
+    if(blendFactors[0] == srcRGB && blendFactors[1] == dstRGB && blendFactors[2] == srcAlpha && blendFactors[3] == dstAlpha &&
+       elide("glBlendFuncSeparate", {{0x80C9, (int)srcRGB}, {0x80C8, (int)dstRGB}, {0x80CB, (int)srcAlpha}, {0x80CA, (int)dstAlpha}}))
+        return;
+    blendFactors[0] = srcRGB;
+    blendFactors[1] = dstRGB;
+    blendFactors[2] = srcAlpha;
+    blendFactors[3] = dstAlpha;
+    glBlendFuncSeparate_orig(srcRGB, dstRGB, srcAlpha, dstAlpha);
+}
+
+void GLStateCache::glDepthFunc(unsigned int func) {
+    if(func == currentDepthFunc && elide("glDepthFunc", {{0x0B74, (int)func}}))
+        return;
+    currentDepthFunc = func;
+    glDepthFunc_orig(func);
+}
+
+void GLStateCache::glDepthMask(unsigned char flag) {
+    uint32_t mask = flag ? 1 : 0;
+    if(mask == currentDepthMask && elide("glDepthMask", {{0x0B72, (int)mask}}))
+        return;
+    currentDepthMask = mask;
+    glDepthMask_orig(flag);
+}
+
+void GLStateCache::glCullFace(unsigned int mode) {
+    if(mode == currentCullFace && elide("glCullFace", {{0x0B45, (int)mode}}))
+        return;
+    currentCullFace = mode;
+    glCullFace_orig(mode);
+}
+
+void GLStateCache::glFrontFace(unsigned int mode) {
+    if(mode == currentFrontFace && elide("glFrontFace", {{0x0B46, (int)mode}}))
+        return;
+    currentFrontFace = mode;
+    glFrontFace_orig(mode);
+}
+
+void GLStateCache::glViewport(int x, int y, int width, int height) {
+    int rect[4] = {x, y, width, height};
+    if(viewportValid && !memcmp(rect, currentViewport, sizeof(rect)) && elideRect("glViewport", 0x0BA2, rect))
+        return;
+    memcpy(currentViewport, rect, sizeof(rect));
+    viewportValid = true;
+    glViewport_orig(x, y, width, height);
+}
+
+void GLStateCache::glScissor(int x, int y, int width, int height) {
+    int rect[4] = {x, y, width, height};
+    if(scissorValid && !memcmp(rect, currentScissor, sizeof(rect)) && elideRect("glScissor", 0x0C10, rect))
+        return;
+    memcpy(currentScissor, rect, sizeof(rect));
+    scissorValid = true;
+    glScissor_orig(x, y, width, height);
+}
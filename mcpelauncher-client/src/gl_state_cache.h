@@ -0,0 +1,141 @@
+#pragma once
+
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+/*
+ * Shadows the GL binding and fixed function state the game changes most often and drops calls that set the value
+ * already set. Installed before GLCorePatch, so the binds issued by its VAO emulation are filtered too.
+ * Enabled with MCPELAUNCHER_GL_STATE_CACHE=1, MCPELAUNCHER_GL_STATE_CACHE_DEBUG=1 additionally compares every dropped
+ * call against glGet* and logs mismatches.
+ */
+class GLStateCache {
+private:
+    static constexpr int maxTextureUnits = 32;
+    static constexpr int textureTargetCount = 4;
+    static constexpr int bufferTargetCount = 8;
+    static constexpr int capCount = 6;
+    static constexpr uint32_t unknown = 0xFFFFFFFF;
+
+    static bool enabled;
+    static bool debug;
+    static uint64_t elided;
+
+    // unknown until the game sets a value through the cache
+    static uint32_t currentProgram;
+    static uint32_t currentVertexArray;
+    static uint32_t boundBuffers[bufferTargetCount];
+    static uint32_t currentActiveTexture;
+    static uint32_t boundTextures[maxTextureUnits][textureTargetCount];
+    static uint32_t capStates[capCount];
+    static uint32_t blendFactors[4];
+    static uint32_t currentDepthFunc, currentDepthMask;
+    static uint32_t currentCullFace, currentFrontFace;
+    static bool viewportValid, scissorValid;
+    static int currentViewport[4], currentScissor[4];
+
+    static void (*glGetIntegerv)(unsigned int pname, int *data);
+    static unsigned char (*glIsEnabled)(unsigned int cap);
+
+    static void (*glUseProgram_orig)(unsigned int program);
+    static void glUseProgram(unsigned int program);
+
+    static void (*glDeleteProgram_orig)(unsigned int program);
+    static void glDeleteProgram(unsigned int program);
+
+    static void (*glBindVertexArray_orig)(unsigned int array);
+    static void glBindVertexArray(unsigned int array);
+
+    static void (*glDeleteVertexArrays_orig)(int n, const unsigned int *arrays);
+    static void glDeleteVertexArrays(int n, const unsigned int *arrays);
+
+    static void (*glBindVertexArrayOES_orig)(unsigned int array);
+    static void glBindVertexArrayOES(unsigned int array);
+
+    static void (*glDeleteVertexArraysOES_orig)(int n, const unsigned int *arrays);
+    static void glDeleteVertexArraysOES(int n, const unsigned int *arrays);
+
+    static void (*glBindVertexArrayAPPLE_orig)(unsigned int array);
+    static void glBindVertexArrayAPPLE(unsigned int array);
+
+    static void (*glDeleteVertexArraysAPPLE_orig)(int n, const unsigned int *arrays);
+    static void glDeleteVertexArraysAPPLE(int n, const unsigned int *arrays);
+
+    static void (*glBindBuffer_orig)(unsigned int target, unsigned int buffer);
+    static void glBindBuffer(unsigned int target, unsigned int buffer);
+
+    static void (*glBindBufferBase_orig)(unsigned int target, unsigned int index, unsigned int buffer);
+    static void glBindBufferBase(unsigned int target, unsigned int index, unsigned int buffer);
+
+    static void (*glBindBufferRange_orig)(unsigned int target, unsigned int index, unsigned int buffer, intptr_t offset, intptr_t size);
+    static void glBindBufferRange(unsigned int target, unsigned int index, unsigned int buffer, intptr_t offset, intptr_t size);
+
+    static void (*glDeleteBuffers_orig)(int n, const unsigned int *buffers);
+    static void glDeleteBuffers(int n, const unsigned int *buffers);
+
+    static void (*glActiveTexture_orig)(unsigned int unit);
+    static void glActiveTexture(unsigned int unit);
+
+    static void (*glBindTexture_orig)(unsigned int target, unsigned int texture);
+    static void glBindTexture(unsigned int target, unsigned int texture);
+
+    static void (*glDeleteTextures_orig)(int n, const unsigned int *textures);
+    static void glDeleteTextures(int n, const unsigned int *textures);
+
+    static void (*glEnable_orig)(unsigned int cap);
+    static void glEnable(unsigned int cap);
+
+    static void (*glDisable_orig)(unsigned int cap);
+    static void glDisable(unsigned int cap);
+
+    static void (*glBlendFunc_orig)(unsigned int sfactor, unsigned int dfactor);
+    static void glBlendFunc(unsigned int sfactor, unsigned int dfactor);
+
+    static void (*glBlendFuncSeparate_orig)(unsigned int srcRGB, unsigned int dstRGB, unsigned int srcAlpha, unsigned int dstAlpha);
+    static void glBlendFuncSeparate(unsigned int srcRGB, unsigned int dstRGB, unsigned int srcAlpha, unsigned int dstAlpha);
+
+    static void (*glDepthFunc_orig)(unsigned int func);
+    static void glDepthFunc(unsigned int func);
+
+    static void (*glDepthMask_orig)(unsigned char flag);
+    static void glDepthMask(unsigned char flag);
+
+    static void (*glCullFace_orig)(unsigned int mode);
+    static void glCullFace(unsigned int mode);
+
+    static void (*glFrontFace_orig)(unsigned int mode);
+    static void glFrontFace(unsigned int mode);
+
+    static void (*glViewport_orig)(int x, int y, int width, int height);
+    static void glViewport(int x, int y, int width, int height);
+
+    static void (*glScissor_orig)(int x, int y, int width, int height);
+    static void glScissor(int x, int y, int width, int height);
+
+    // Shared by the core, OES and APPLE vertex array entry points, which all switch the same binding
+    static void bindVertexArray(const char *name, void (*orig)(unsigned int), unsigned int array);
+    static void deleteVertexArrays(void (*orig)(int, const unsigned int *), int n, const unsigned int *arrays);
+
+    static int getBufferSlot(unsigned int target);
+    static int getTextureSlot(unsigned int target);
+    static int getCapSlot(unsigned int cap);
+
+    // Counts a dropped call. In debug mode the driver state is checked first, on a mismatch it is logged and false is
+    // returned, so that the call is forwarded after all
+    static bool elide(const char *name, std::initializer_list<std::pair<unsigned int, int>> expected);
+    static bool elideRect(const char *name, unsigned int pname, const int *expected);
+    static bool elideCap(unsigned int cap, bool enabled);
+
+public:
+    static void installGL(std::unordered_map<std::string, void *> &overrides, void *(*resolver)(const char *));
+
+    // Forgets all shadowed state, e.g. when the context changes
+    static void invalidate();
+
+    static uint64_t getElidedCount() {
+        return elided;
+    }
+};
@@ -0,0 +1,304 @@
+#include "gl_trace.h"
+#include "util.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <log.h>
+
+// Traced entry points with their signature, GLenum / GLuint / GLbitfield are unsigned int, GLsizei is int
+#define GL_TRACE_FUNCTIONS(X)                                                                                                              \
+    X(glDrawArrays, void(unsigned int, int, int))                                                                                          \
+    X(glDrawElements, void(unsigned int, int, unsigned int, const void *))                                                                 \
+    X(glDrawArraysInstanced, void(unsigned int, int, int, int))                                                                            \
+    X(glDrawElementsInstanced, void(unsigned int, int, unsigned int, const void *, int))                                                   \
+    X(glDrawRangeElements, void(unsigned int, unsigned int, unsigned int, int, unsigned int, const void *))                                \
+    X(glClear, void(unsigned int))                                                                                                         \
+    X(glBlitFramebuffer, void(int, int, int, int, int, int, int, int, unsigned int, unsigned int))                                         \
+    X(glInvalidateFramebuffer, void(unsigned int, int, const unsigned int *))                                                              \
+    X(glUseProgram, void(unsigned int))                                                                                                    \
+    X(glActiveTexture, void(unsigned int))                                                                                                 \
+    X(glBindTexture, void(unsigned int, unsigned int))                                                                                     \
+    X(glBindBuffer, void(unsigned int, unsigned int))                                                                                      \
+    X(glBindBufferBase, void(unsigned int, unsigned int, unsigned int))                                                                    \
+    X(glBindBufferRange, void(unsigned int, unsigned int, unsigned int, intptr_t, intptr_t))                                               \
+    X(glBindFramebuffer, void(unsigned int, unsigned int))                                                                                 \
+    X(glBindRenderbuffer, void(unsigned int, unsigned int))                                                                                \
+    X(glBindVertexArray, void(unsigned int))                                                                                               \
+    X(glBindSampler, void(unsigned int, unsigned int))                                                                                     \
+    X(glDeleteTextures, void(int, const unsigned int *))                                                                                   \
+    X(glDeleteBuffers, void(int, const unsigned int *))                                                                                    \
+    X(glDeleteFramebuffers, void(int, const unsigned int *))                                                                               \
+    X(glDeleteRenderbuffers, void(int, const unsigned int *))                                                                              \
+    X(glDeleteVertexArrays, void(int, const unsigned int *))                                                                               \
+    X(glDeleteProgram, void(unsigned int))                                                                                                 \
+    X(glEnable, void(unsigned int))                                                                                                        \
+    X(glDisable, void(unsigned int))                                                                                                       \
+    X(glBlendFunc, void(unsigned int, unsigned int))                                                                                       \
+    X(glBlendFuncSeparate, void(unsigned int, unsigned int, unsigned int, unsigned int))                                                   \
+    X(glDepthFunc, void(unsigned int))                                                                                                     \
+    X(glDepthMask, void(unsigned char))                                                                                                    \
+    X(glColorMask, void(unsigned char, unsigned char, unsigned char, unsigned char))                                                       \
+    X(glCullFace, void(unsigned int))                                                                                                      \
+    X(glViewport, void(int, int, int, int))                                                                                                \
+    X(glScissor, void(int, int, int, int))                                                                                                 \
+    X(glStencilFunc, void(unsigned int, int, unsigned int))                                                                                \
+    X(glStencilOp, void(unsigned int, unsigned int, unsigned int))                                                                         \
+    X(glStencilMask, void(unsigned int))                                                                                                   \
+    X(glPolygonOffset, void(float, float))                                                                                                 \
+    X(glPixelStorei, void(unsigned int, int))                                                                                              \
+    X(glTexParameteri, void(unsigned int, unsigned int, int))                                                                              \
+    X(glVertexAttribPointer, void(unsigned int, int, unsigned int, unsigned char, int, const void *))                                       \
+    X(glEnableVertexAttribArray, void(unsigned int))                                                                                       \
+    X(glDisableVertexAttribArray, void(unsigned int))                                                                                      \
+    X(glVertexAttribDivisor, void(unsigned int, unsigned int))                                                                             \
+    X(glUniform1i, void(int, int))                                                                                                         \
+    X(glUniform1f, void(int, float))                                                                                                       \
+    X(glUniform1iv, void(int, int, const int *))                                                                                           \
+    X(glUniform1fv, void(int, int, const float *))                                                                                         \
+    X(glUniform2fv, void(int, int, const float *))                                                                                         \
+    X(glUniform3fv, void(int, int, const float *))                                                                                         \
+    X(glUniform4fv, void(int, int, const float *))                                                                                         \
+    X(glUniformMatrix3fv, void(int, int, unsigned char, const float *))                                                                    \
+    X(glUniformMatrix4fv, void(int, int, unsigned char, const float *))                                                                    \
+    X(glUniformBlockBinding, void(unsigned int, unsigned int, unsigned int))                                                               \
+    X(glGetUniformLocation, int(unsigned int, const char *))                                                                               \
+    X(glBufferData, void(unsigned int, intptr_t, const void *, unsigned int))                                                              \
+    X(glBufferSubData, void(unsigned int, intptr_t, intptr_t, const void *))                                                               \
+    X(glMapBufferRange, void *(unsigned int, intptr_t, intptr_t, unsigned int))                                                            \
+    X(glUnmapBuffer, unsigned char(unsigned int))                                                                                          \
+    X(glTexImage2D, void(unsigned int, int, int, int, int, int, unsigned int, unsigned int, const void *))                                 \
+    X(glTexSubImage2D, void(unsigned int, int, int, int, int, int, unsigned int, unsigned int, const void *))                              \
+    X(glCompressedTexImage2D, void(unsigned int, int, unsigned int, int, int, int, int, const void *))                                     \
+    X(glCompressedTexSubImage2D, void(unsigned int, int, int, int, int, int, unsigned int, int, const void *))                             \
+    X(glGenerateMipmap, void(unsigned int))                                                                                                \
+    X(glShaderSource, void(unsigned int, int, const char *const *, const int *))                                                           \
+    X(glCompileShader, void(unsigned int))                                                                                                 \
+    X(glLinkProgram, void(unsigned int))                                                                                                   \
+    X(glReadPixels, void(int, int, int, int, unsigned int, unsigned int, void *))                                                          \
+    X(glFenceSync, void *(unsigned int, unsigned int))                                                                                     \
+    X(glClientWaitSync, unsigned int(void *, unsigned int, uint64_t))                                                                      \
+    X(glGetError, unsigned int())                                                                                                          \
+    X(glGetIntegerv, void(unsigned int, int *))                                                                                            \
+    X(glFlush, void())                                                                                                                     \
+    X(glFinish, void())
+
+enum GLTraceId : size_t {
+#define X(name, ...) GLTraceId_##name,
+    GL_TRACE_FUNCTIONS(X)
+#undef X
+    GLTraceId_Count
+};
+
+static const char *const traceNames[] = {
+#define X(name, ...) #name,
+    GL_TRACE_FUNCTIONS(X)
+#undef X
+};
+
+static const unsigned int textureUnit0 = 0x84C0;  // GL_TEXTURE0
+
+// Hooks running before the call, only the binds look at the arguments
+template <size_t Id, typename... Args>
+inline void onBeforeCall(Args...) {}
+
+template <>
+inline void onBeforeCall<GLTraceId_glUseProgram, unsigned int>(unsigned int program) {
+    GLTrace::instance.onBind(GLTraceId_glUseProgram, 0, program);
+}
+template <>
+inline void onBeforeCall<GLTraceId_glActiveTexture, unsigned int>(unsigned int unit) {
+    GLTrace::instance.onBind(GLTraceId_glActiveTexture, 0, unit);
+    GLTrace::instance.onActiveTexture(unit);
+}
+template <>
+inline void onBeforeCall<GLTraceId_glBindTexture, unsigned int, unsigned int>(unsigned int target, unsigned int texture) {
+    GLTrace::instance.onBind(GLTraceId_glBindTexture, (GLTrace::instance.getActiveTexture() - textureUnit0) << 16 | (target & 0xFFFF), texture);
+}
+template <>
+inline void onBeforeCall<GLTraceId_glBindBuffer, unsigned int, unsigned int>(unsigned int target, unsigned int buffer) {
+    GLTrace::instance.onBind(GLTraceId_glBindBuffer, target, buffer);
+}
+template <>
+inline void onBeforeCall<GLTraceId_glBindBufferBase, unsigned int, unsigned int, unsigned int>(unsigned int target, unsigned int index, unsigned int buffer) {
+    GLTrace::instance.onBind(GLTraceId_glBindBufferBase, index << 16 | (target & 0xFFFF), buffer);
+}
+template <>
+inline void onBeforeCall<GLTraceId_glBindFramebuffer, unsigned int, unsigned int>(unsigned int target, unsigned int framebuffer) {
+    GLTrace::instance.onBind(GLTraceId_glBindFramebuffer, target, framebuffer);
+}
+template <>
+inline void onBeforeCall<GLTraceId_glBindRenderbuffer, unsigned int, unsigned int>(unsigned int target, unsigned int renderbuffer) {
+    GLTrace::instance.onBind(GLTraceId_glBindRenderbuffer, target, renderbuffer);
+}
+template <>
+inline void onBeforeCall<GLTraceId_glBindVertexArray, unsigned int>(unsigned int array) {
+    GLTrace::instance.onBind(GLTraceId_glBindVertexArray, 0, array);
+}
+template <>
+inline void onBeforeCall<GLTraceId_glBindSampler, unsigned int, unsigned int>(unsigned int unit, unsigned int sampler) {
+    GLTrace::instance.onBind(GLTraceId_glBindSampler, unit, sampler);
+}
+
+// Deleting a bound object resets the binding, forget them instead of reporting false redundant binds
+#define X(name)                                                                        \
+    template <>                                                                        \
+    inline void onBeforeCall<GLTraceId_##name, int, const unsigned int *>(int, const unsigned int *) { \
+        GLTrace::instance.forgetBindings();                                            \
+    }
+X(glDeleteTextures)
+X(glDeleteBuffers)
+X(glDeleteFramebuffers)
+X(glDeleteRenderbuffers)
+X(glDeleteVertexArrays)
+#undef X
+template <>
+inline void onBeforeCall<GLTraceId_glDeleteProgram, unsigned int>(unsigned int) {
+    GLTrace::instance.forgetBindings();
+}
+
+template <size_t Id, typename Fn>
+struct GLTraceThunk;
+
+template <size_t Id, typename R, typename... Args>
+struct GLTraceThunk<Id, R(Args...)> {
+    static R (*real)(Args...);
+
+    static R call(Args... args) {
+        onBeforeCall<Id>(args...);
+        struct Done {
+            GLTrace::Clock::time_point begin = GLTrace::Clock::now();
+            ~Done() {
+                GLTrace::instance.onCall(Id, begin, GLTrace::Clock::now());
+            }
+        } done;
+        return real(args...);
+    }
+};
+
+template <size_t Id, typename R, typename... Args>
+R (*GLTraceThunk<Id, R(Args...)>::real)(Args...);
+
+GLTrace GLTrace::instance;
+
+GLTrace::~GLTrace() {
+    closeChromeTrace();
+}
+
+void GLTrace::init() {
+    if(enabled)
+        return;
+    enabled = ReadEnvFlag("MCPELAUNCHER_GL_TRACE");
+    if(!enabled)
+        return;
+    current.resize(GLTraceId_Count);
+    last.resize(GLTraceId_Count);
+    logInterval = ReadEnvInt("MCPELAUNCHER_GL_TRACE_LOG_INTERVAL");
+    start = frameStart = Clock::now();
+    if(auto path = getenv("MCPELAUNCHER_GL_TRACE_CHROME")) {
+        chromeTraceFrames = ReadEnvInt("MCPELAUNCHER_GL_TRACE_CHROME_FRAMES", 300);
+        chromeTrace = fopen(path, "w");
+        if(chromeTrace)
+            fprintf(chromeTrace, "[\n");
+        else
+            Log::error("GLTrace", "Failed to open %s", path);
+    }
+    Log::info("GLTrace", "Tracing %zu GL entry points", (size_t)GLTraceId_Count);
+}
+
+void *GLTrace::wrap(const char *name, void *fn) {
+    if(!enabled || !fn)
+        return fn;
+    struct Thunk {
+        void **real;
+        void *call;
+    };
+    static const std::unordered_map<std::string, Thunk> thunks = {
+#define X(name, ...) {#name, {(void **)&GLTraceThunk<GLTraceId_##name, __VA_ARGS__>::real, (void *)&GLTraceThunk<GLTraceId_##name, __VA_ARGS__>::call}},
+        GL_TRACE_FUNCTIONS(X)
+#undef X
+    };
+    auto it = thunks.find(name);
+    if(it == thunks.end() || fn == it->second.call)
+        return fn;
+    // The first resolved implementation is traced. A later, different one is an override wrapping it (e.g.
+    // GLCorePatch) and already calls into the thunk, pointing the thunk at it would make the override call itself.
+    if(*it->second.real && *it->second.real != fn)
+        return fn;
+    *it->second.real = fn;
+    return it->second.call;
+}
+
+void GLTrace::onBind(size_t id, uint32_t target, uint32_t object) {
+    auto key = (uint64_t)id << 32 | target;
+    auto it = bindings.find(key);
+    if(it != bindings.end() && it->second == object) {
+        current[id].redundant++;
+        return;
+    }
+    bindings[key] = object;
+}
+
+const char *GLTrace::getName(size_t id) {
+    return id < GLTraceId_Count ? traceNames[id] : "?";
+}
+
+void GLTrace::writeChromeEvent(const char *name, Clock::time_point begin, Clock::time_point end) {
+    fprintf(chromeTrace, "{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":1},\n", name,
+            std::chrono::duration<double, std::micro>(begin - start).count(), std::chrono::duration<double, std::micro>(end - begin).count());
+}
+
+void GLTrace::closeChromeTrace() {
+    if(!chromeTrace)
+        return;
+    // Every event ends with a comma, close the array with one more
+    fprintf(chromeTrace, "{\"name\":\"end\",\"ph\":\"i\",\"ts\":%.3f,\"pid\":1,\"tid\":1}\n]\n",
+            std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+    fclose(chromeTrace);
+    chromeTrace = nullptr;
+    Log::info("GLTrace", "Chrome trace written");
+}
+
+void GLTrace::onFrame() {
+    if(!enabled)
+        return;
+    last.swap(current);
+    std::fill(current.begin(), current.end(), EntryStats());
+    frame++;
+
+    auto now = Clock::now();
+    if(chromeTrace) {
+        writeChromeEvent("frame", frameStart, now);
+        if(--chromeTraceFrames <= 0)
+            closeChromeTrace();
+    }
+    frameStart = now;
+
+    if(logInterval > 0 && frame % logInterval == 0) {
+        auto total = getLastFrameTotal();
+        Log::info("GLTrace", "Frame %llu: %u calls, %.3f ms in GL, %u redundant binds", (unsigned long long)frame, total.calls, total.nanos / 1e6, total.redundant);
+        for(auto &&e : getLastFrame(8))
+            Log::info("GLTrace", "  %-28s %6u calls %8.3f ms %6u redundant", e.name, e.stats.calls, e.stats.nanos / 1e6, e.stats.redundant);
+    }
+}
+
+std::vector<GLTrace::EntrySummary> GLTrace::getLastFrame(size_t maxEntries) const {
+    std::vector<EntrySummary> ret;
+    for(size_t i = 0; i < last.size(); i++) {
+        if(last[i].calls)
+            ret.push_back({traceNames[i], last[i]});
+    }
+    std::sort(ret.begin(), ret.end(), [](EntrySummary const &a, EntrySummary const &b) { return a.stats.nanos > b.stats.nanos; });
+    if(ret.size() > maxEntries)
+        ret.resize(maxEntries);
+    return ret;
+}
+
+GLTrace::EntryStats GLTrace::getLastFrameTotal() const {
+    EntryStats total;
+    for(auto &&e : last) {
+        total.calls += e.calls;
+        total.redundant += e.redundant;
+        total.nanos += e.nanos;
+    }
+    return total;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * Opt-in GL instrumentation enabled with MCPELAUNCHER_GL_TRACE=1. fake_egl::eglGetProcAddress hands out typed thunks
+ * for the entry points listed in gl_trace.cpp, which count calls and time spent in the driver per frame and flag
+ * binds of the object that is already bound. Everything runs on the render thread, so nothing is locked.
+ *
+ * MCPELAUNCHER_GL_TRACE_LOG_INTERVAL=n logs the most expensive entry points every n frames,
+ * MCPELAUNCHER_GL_TRACE_CHROME=path writes every call of the first MCPELAUNCHER_GL_TRACE_CHROME_FRAMES (300) frames
+ * as a Chrome trace (chrome://tracing, Perfetto).
+ */
+class GLTrace {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct EntryStats {
+        uint32_t calls = 0;
+        // Binds of the object already bound to the same target, as far as the traced calls tell
+        uint32_t redundant = 0;
+        uint64_t nanos = 0;
+    };
+
+    struct EntrySummary {
+        const char *name;
+        EntryStats stats;
+    };
+
+private:
+    bool enabled = false;
+    std::vector<EntryStats> current, last;
+    std::unordered_map<uint64_t, uint32_t> bindings;
+    uint32_t activeTexture = 0;
+    uint64_t frame = 0;
+    int logInterval = 0;
+
+    FILE *chromeTrace = nullptr;
+    int chromeTraceFrames = 0;
+    Clock::time_point start, frameStart;
+
+    void writeChromeEvent(const char *name, Clock::time_point begin, Clock::time_point end);
+    void closeChromeTrace();
+
+public:
+    static GLTrace instance;
+
+    ~GLTrace();
+
+    // Reads the environment, must run before the game resolves its GL functions
+    void init();
+
+    bool isEnabled() const {
+        return enabled;
+    }
+
+    // Returns a thunk calling fn if name is a traced entry point, fn otherwise
+    void *wrap(const char *name, void *fn);
+
+    void onCall(size_t id, Clock::time_point begin, Clock::time_point end) {
+        auto &e = current[id];
+        e.calls++;
+        e.nanos += std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count();
+        if(chromeTrace)
+            writeChromeEvent(getName(id), begin, end);
+    }
+
+    void onBind(size_t id, uint32_t target, uint32_t object);
+    void onActiveTexture(uint32_t unit) {
+        activeTexture = unit;
+    }
+    void forgetBindings() {
+        bindings.clear();
+    }
+    uint32_t getActiveTexture() const {
+        return activeTexture;
+    }
+
+    // Called once per eglSwapBuffers, publishes the statistics of the finished frame
+    void onFrame();
+
+    static const char *getName(size_t id);
+
+    // Entry points of the last frame, sorted by time spent in the driver
+    std::vector<EntrySummary> getLastFrame(size_t maxEntries) const;
+    EntryStats getLastFrameTotal() const;
+};
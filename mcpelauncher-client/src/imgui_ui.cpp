@@ -19,6 +19,11 @@
 #include <sstream>
 #include "window_callbacks.h"
 #include "core_patches.h"
+#include "fake_egl.h"
+#include "frame_stats.h"
+#include "gl_trace.h"
+#include "texture_uploader.h"
+#include "resolution_scaler.h"
 #include <mutex>
 #include <mcpelauncher/linker.h>
 
@@ -291,7 +296,7 @@ bool canShowHud(int visibilityOption) {
 }
 
 void ImGuiUIInit(GameWindow* window) {
-    window->setSwapInterval(Settings::vsync ? 1 : 0);
+    window->setSwapInterval(FakeEGL::getWindowSwapInterval());
     if(!glGetString) {
         return;
     }
@@ -349,6 +354,18 @@ static void CenterText(int x, int yPos, std::string text) {
     ImGui::RenderTextWrapped(start, text.c_str(), NULL, 999);
 }
 
+static void exportFrameStats(bool json) {
+    char name[64];
+    time_t now = time(nullptr);
+    strftime(name, sizeof(name), "frametimes-%Y%m%d-%H%M%S", localtime(&now));
+    std::string path = PathHelper::getPrimaryDataDirectory() + name + (json ? ".json" : ".csv");
+    bool success = json ? FrameStats::instance.exportJson(path) : FrameStats::instance.exportCsv(path);
+    if(success)
+        Log::info("FrameStats", "Exported frame times to %s", path.c_str());
+    else
+        Log::error("FrameStats", "Failed to export frame times to %s", path.c_str());
+}
+
 void ImGuiUIDrawFrame(GameWindow* window) {
     if(!Settings::enable_imgui.value_or(allowGPU) || !glViewport) {
         return;
@@ -394,6 +411,9 @@ void ImGuiUIDrawFrame(GameWindow* window) {
     static auto show_confirm_popup = false;
     static auto show_about = false;
     auto wantfocusnextframe = Settings::menubarFocusKey == "alt" && ImGui::IsKeyPressed(ImGuiKey_ModAlt) || Settings::menubarFocusKey == "shift+m+p" && ImGui::IsKeyPressed(ImGuiKey_LeftShift) && ImGui::IsKeyPressed(ImGuiKey_M) && ImGui::IsKeyPressed(ImGuiKey_P);
+    if(ImGui::IsKeyDown(ImGuiKey_ModCtrl) && ImGui::IsKeyPressed(ImGuiKey_F9, false)) {
+        exportFrameStats(false);
+    }
     if(wantfocusnextframe) {
         ImGui::SetNextFrameWantCaptureKeyboard(true);
     }
@@ -472,6 +492,20 @@ void ImGuiUIDrawFrame(GameWindow* window) {
                     Settings::enable_fps_hud = 2;
                     Settings::save();
                 }
+                ImGui::Separator();
+                if(ImGui::MenuItem("Show Frame Time Statistics", nullptr, Settings::fps_hud_details)) {
+                    Settings::fps_hud_details = !Settings::fps_hud_details;
+                    Settings::save();
+                }
+                if(ImGui::MenuItem("Reset Frame Time Statistics")) {
+                    FrameStats::instance.reset();
+                }
+                if(ImGui::MenuItem("Export Frame Times (CSV)", "Ctrl+F9")) {
+                    exportFrameStats(false);
+                }
+                if(ImGui::MenuItem("Export Frame Times (JSON)")) {
+                    exportFrameStats(true);
+                }
                 ImGui::EndMenu();
             }
             if(ImGui::BeginMenu("Show Keystroke-Mouse-Hud")) {
@@ -513,7 +547,54 @@ void ImGuiUIDrawFrame(GameWindow* window) {
             if(ImGui::MenuItem("Use VSync", nullptr, Settings::vsync)) {
                 Settings::vsync = !Settings::vsync;
                 Settings::save();
-                window->setSwapInterval(Settings::vsync ? 1 : 0);
+                window->setSwapInterval(FakeEGL::getWindowSwapInterval());
+            }
+            if(ImGui::BeginMenu("Frame Limit")) {
+                for(int fps : {0, 30, 60, 75, 120, 144, 165, 240}) {
+                    if(ImGui::MenuItem(fps ? std::to_string(fps).data() : "Unlimited", nullptr, Settings::fps_limit == fps)) {
+                        Settings::fps_limit = fps;
+                        Settings::save();
+                    }
+                }
+                ImGui::EndMenu();
+            }
+            if(ImGui::BeginMenu("Frame Limit when unfocused")) {
+                for(int fps : {0, 5, 15, 30, 60}) {
+                    if(ImGui::MenuItem(fps ? std::to_string(fps).data() : "Same as focused", nullptr, Settings::fps_limit_unfocused == fps)) {
+                        Settings::fps_limit_unfocused = fps;
+                        Settings::save();
+                    }
+                }
+                ImGui::EndMenu();
+            }
+            if(ImGui::BeginMenu("Dynamic Resolution")) {
+                if(ImGui::MenuItem("Enabled", nullptr, Settings::dynamic_resolution)) {
+                    Settings::dynamic_resolution = !Settings::dynamic_resolution;
+                    Settings::save();
+                }
+                if(ImGui::BeginMenu("Target FPS")) {
+                    for(int fps : {0, 30, 45, 60, 75, 120, 144}) {
+                        if(ImGui::MenuItem(fps ? std::to_string(fps).data() : "Frame Limit", nullptr, Settings::dynamic_resolution_target_fps == fps)) {
+                            Settings::dynamic_resolution_target_fps = fps;
+                            Settings::save();
+                        }
+                    }
+                    ImGui::EndMenu();
+                }
+                if(ImGui::BeginMenu("Minimum Scale")) {
+                    for(int percent : {25, 33, 50, 75}) {
+                        if(ImGui::MenuItem((std::to_string(percent) + "%").data(), nullptr, (int)(Settings::dynamic_resolution_min_scale * 100 + 0.5f) == percent)) {
+                            Settings::dynamic_resolution_min_scale = percent / 100.f;
+                            Settings::save();
+                        }
+                    }
+                    ImGui::EndMenu();
+                }
+                if(ImGui::MenuItem("Sharpen", nullptr, Settings::dynamic_resolution_sharpen)) {
+                    Settings::dynamic_resolution_sharpen = !Settings::dynamic_resolution_sharpen;
+                    Settings::save();
+                }
+                ImGui::EndMenu();
             }
 
             auto modes = window->getFullscreenModes();
@@ -662,6 +743,27 @@ void ImGuiUIDrawFrame(GameWindow* window) {
                 Settings::fps_hud_y = (pos.y - work_pos.y) / (work_size.y - windowSize.y);
             }
             ImGui::Text("%.3f ms/frame (%.1f FPS)", 1000.0f / io.Framerate, io.Framerate);
+            if(Settings::fps_hud_details) {
+                auto stats = FrameStats::instance.getSummary();
+                ImGui::Text("p50 %.2f  p95 %.2f  p99 %.2f ms", stats.p50Ms, stats.p95Ms, stats.p99Ms);
+                ImGui::Text("1%% low %.1f  0.1%% low %.1f FPS", stats.low1Fps, stats.low01Fps);
+                ImGui::Text("%llu hitches, max %.2f ms", (unsigned long long)stats.hitches, stats.maxMs);
+                auto& frameStats = FrameStats::instance;
+                ImGui::PlotLines("##frametimes", frameStats.getHistory(), (int)frameStats.getHistoryCount(), (int)frameStats.getHistoryOffset(), nullptr, 0.f, std::max(stats.p99Ms * 2.f, 1.f), ImVec2(textSizeNoPad.x, 60.f * Settings::scale));
+                if(GLTrace::instance.isEnabled()) {
+                    auto total = GLTrace::instance.getLastFrameTotal();
+                    ImGui::Text("GL %u calls %.2f ms, %u redundant binds", total.calls, total.nanos / 1e6f, total.redundant);
+                    for(auto&& e : GLTrace::instance.getLastFrame(5))
+                        ImGui::Text("%s %u (%.2f ms)", e.name, e.stats.calls, e.stats.nanos / 1e6f);
+                }
+                if(TextureUploader::isEnabled()) {
+                    auto uploads = TextureUploader::getLastFrame();
+                    ImGui::Text("PBO uploads %u (%.2f MiB), %u forwarded, %.2f ms stalled", uploads.uploads, uploads.bytes / 1048576.f, uploads.forwarded, uploads.stallNanos / 1e6f);
+                }
+                if(ResolutionScaler::isActive()) {
+                    ImGui::Text("Render scale %.2f (%dx%d), GPU %.2f ms", ResolutionScaler::getScale(), ResolutionScaler::getRenderWidth(), ResolutionScaler::getRenderHeight(), ResolutionScaler::getGpuMs());
+                }
+            }
         }
         ImGui::End();
     }
@@ -0,0 +1,181 @@
+#include "input_recorder.h"
+#include "window_callbacks.h"
+#include "fake_inputqueue.h"
+
+#include <cstring>
+#include <log.h>
+
+namespace {
+
+constexpr char recordMagic[8] = {'M', 'C', 'I', 'R', 'E', 'C', '0', '1'};
+
+struct RecordLayout {
+    uint8_t ints;
+    uint8_t floats;
+    bool text;
+};
+
+constexpr RecordLayout recordLayouts[(size_t)InputRecord::Type::Count] = {
+    {2, 2, false},  // MouseButton: button, action, x, y
+    {0, 2, false},  // MousePosition: x, y
+    {0, 2, false},  // MouseRelativePosition: x, y
+    {0, 4, false},  // MouseScroll: x, y, dx, dy
+    {1, 2, false},  // TouchStart: id, x, y
+    {1, 2, false},  // TouchUpdate: id, x, y
+    {1, 2, false},  // TouchEnd: id, x, y
+    {3, 0, false},  // Keyboard: key, action, mods
+    {0, 0, true},   // KeyboardText
+    {2, 0, false},  // GamepadState: gamepad, connected
+    {3, 0, false},  // GamepadButton: gamepad, button, pressed
+    {2, 1, false},  // GamepadAxis: gamepad, axis, value
+};
+
+void writeVarint(std::string &out, uint64_t v) {
+    while(v >= 0x80) {
+        out.push_back((char)(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back((char)v);
+}
+
+bool readVarint(FILE *file, uint64_t &v) {
+    v = 0;
+    for(int shift = 0; shift < 64; shift += 7) {
+        int c = fgetc(file);
+        if(c == EOF)
+            return false;
+        v |= (uint64_t)(c & 0x7f) << shift;
+        if(!(c & 0x80))
+            return true;
+    }
+    return false;
+}
+
+}  // namespace
+
+InputRecorder::InputRecorder(FILE *file) : file(file), start(std::chrono::steady_clock::now()) {
+}
+
+std::unique_ptr<InputRecorder> InputRecorder::open(std::string const &path) {
+    FILE *file = fopen(path.c_str(), "wb");
+    if(!file) {
+        Log::error("InputRecorder", "Failed to open %s", path.c_str());
+        return nullptr;
+    }
+    fwrite(recordMagic, 1, sizeof(recordMagic), file);
+    Log::info("InputRecorder", "Recording input to %s", path.c_str());
+    return std::unique_ptr<InputRecorder>(new InputRecorder(file));
+}
+
+InputRecorder::~InputRecorder() {
+    fclose(file);
+}
+
+void InputRecorder::record(InputRecord::Type type, std::initializer_list<int32_t> i, std::initializer_list<float> f, std::string const &text) {
+    auto &layout = recordLayouts[(size_t)type];
+    std::string out;
+    out.push_back((char)type);
+    std::lock_guard<std::mutex> lock(mutex);
+    uint64_t time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    writeVarint(out, time - lastTime);
+    lastTime = time;
+    auto iv = i.begin();
+    for(size_t n = 0; n < layout.ints; n++, iv++) {
+        int32_t v = iv != i.end() ? *iv : 0;
+        writeVarint(out, ((uint32_t)v << 1) ^ (uint32_t)(v >> 31));
+    }
+    auto fv = f.begin();
+    for(size_t n = 0; n < layout.floats; n++, fv++) {
+        float v = fv != f.end() ? *fv : 0.f;
+        out.append((const char *)&v, sizeof(v));
+    }
+    if(layout.text) {
+        writeVarint(out, text.size());
+        out.append(text);
+    }
+    fwrite(out.data(), 1, out.size(), file);
+}
+
+std::unique_ptr<InputReplayer> InputReplayer::open(std::string const &path, double speed) {
+    FILE *file = fopen(path.c_str(), "rb");
+    if(!file) {
+        Log::error("InputReplayer", "Failed to open %s", path.c_str());
+        return nullptr;
+    }
+    char magic[sizeof(recordMagic)];
+    if(fread(magic, 1, sizeof(magic), file) != sizeof(magic) || memcmp(magic, recordMagic, sizeof(magic)) != 0) {
+        Log::error("InputReplayer", "%s is not an input recording", path.c_str());
+        fclose(file);
+        return nullptr;
+    }
+    std::vector<InputRecord> records;
+    uint64_t time = 0;
+    // A recording cut off by a crash ends in a partial record, everything before it is still usable
+    while(true) {
+        int type = fgetc(file);
+        uint64_t delta;
+        if(type == EOF || type >= (int)InputRecord::Type::Count || !readVarint(file, delta))
+            break;
+        InputRecord record;
+        record.type = (InputRecord::Type)type;
+        time += delta;
+        record.time = time;
+        auto &layout = recordLayouts[type];
+        bool complete = true;
+        for(size_t n = 0; n < layout.ints && complete; n++) {
+            uint64_t v;
+            complete = readVarint(file, v);
+            record.i[n] = (int32_t)((uint32_t)(v >> 1) ^ -(uint32_t)(v & 1));
+        }
+        for(size_t n = 0; n < layout.floats && complete; n++)
+            complete = fread(&record.f[n], sizeof(float), 1, file) == 1;
+        if(complete && layout.text) {
+            uint64_t len;
+            complete = readVarint(file, len) && len <= 4096;
+            if(complete) {
+                record.text.resize(len);
+                complete = len == 0 || fread(&record.text[0], 1, len, file) == len;
+            }
+        }
+        if(!complete)
+            break;
+        records.push_back(std::move(record));
+    }
+    fclose(file);
+    Log::info("InputReplayer", "Replaying %zu input events from %s", records.size(), path.c_str());
+    return std::unique_ptr<InputReplayer>(new InputReplayer(std::move(records), speed));
+}
+
+void InputReplayer::dispatch(WindowCallbacks &callbacks, FakeInputQueue *queue) {
+    if(isFinished())
+        return;
+    auto now = std::chrono::steady_clock::now();
+    if(!started) {
+        started = true;
+        start = now;
+    }
+    uint64_t elapsed = (uint64_t)(std::chrono::duration_cast<std::chrono::microseconds>(now - start).count() * speed);
+    size_t sent = 0;
+    while(!isFinished()) {
+        auto &record = records[next];
+        if(speed > 0 ? record.time > elapsed : queue ? queue->getSize() > 0 : sent > 0)
+            break;
+        auto before = std::chrono::steady_clock::now();
+        dispatchRecord(callbacks, record);
+        auto processingTime = std::chrono::steady_clock::now() - before;
+        size_t depth = queue ? queue->getSize() : 0;
+        totalProcessingTime += processingTime;
+        maxProcessingTime = std::max<std::chrono::nanoseconds>(maxProcessingTime, processingTime);
+        maxQueueDepth = std::max(maxQueueDepth, depth);
+        if(reportCallback)
+            reportCallback(record, depth, processingTime);
+        next++;
+        sent++;
+    }
+    if(isFinished()) {
+        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+        Log::info("InputReplayer", "Replayed %zu events in %lli ms, processing time avg %lli ns max %lli ns, max queue depth %zu, %zu events dropped",
+                  records.size(), (long long)duration, (long long)(totalProcessingTime.count() / std::max<size_t>(records.size(), 1)),
+                  (long long)maxProcessingTime.count(), maxQueueDepth, queue ? queue->getOverflowCount() : (size_t)0);
+    }
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class WindowCallbacks;
+class FakeInputQueue;
+
+struct InputRecord {
+    enum class Type : uint8_t {
+        MouseButton,
+        MousePosition,
+        MouseRelativePosition,
+        MouseScroll,
+        TouchStart,
+        TouchUpdate,
+        TouchEnd,
+        Keyboard,
+        KeyboardText,
+        GamepadState,
+        GamepadButton,
+        GamepadAxis,
+        Count
+    };
+
+    Type type;
+    // Microseconds since the recording started
+    uint64_t time = 0;
+    // Ids, buttons, keys and actions in the order of the callback arguments
+    int32_t i[3] = {};
+    // Positions, deltas and axis values in the order of the callback arguments
+    float f[4] = {};
+    std::string text;
+};
+
+/*
+ * Writes every window input callback with its timestamp to a compact binary log: a type byte, the time delta as a
+ * varint, zigzag varints for the integer arguments and raw floats.
+ */
+class InputRecorder {
+    FILE *file;
+    std::mutex mutex;
+    std::chrono::steady_clock::time_point start;
+    uint64_t lastTime = 0;
+
+    explicit InputRecorder(FILE *file);
+
+public:
+    static std::unique_ptr<InputRecorder> open(std::string const &path);
+    ~InputRecorder();
+
+    void record(InputRecord::Type type, std::initializer_list<int32_t> i, std::initializer_list<float> f, std::string const &text = std::string());
+};
+
+/*
+ * Feeds a log written by InputRecorder back through the WindowCallbacks entry points from the looper thread. With a
+ * speed of 0 the next events are only sent once the game drained its input queue, which measures throughput.
+ */
+class InputReplayer {
+public:
+    using ReportCallback = std::function<void(InputRecord const &record, size_t queueDepth, std::chrono::nanoseconds processingTime)>;
+
+private:
+    std::vector<InputRecord> records;
+    size_t next = 0;
+    double speed;
+    bool started = false;
+    std::chrono::steady_clock::time_point start;
+    ReportCallback reportCallback;
+
+    std::chrono::nanoseconds totalProcessingTime{0};
+    std::chrono::nanoseconds maxProcessingTime{0};
+    size_t maxQueueDepth = 0;
+
+    void dispatchRecord(WindowCallbacks &callbacks, InputRecord const &record);
+
+public:
+    InputReplayer(std::vector<InputRecord> records, double speed) : records(std::move(records)), speed(speed) {}
+
+    static std::unique_ptr<InputReplayer> open(std::string const &path, double speed);
+
+    // Called after every dispatched record, the default only collects the summary logged at the end
+    void setReportCallback(ReportCallback callback) {
+        reportCallback = std::move(callback);
+    }
+
+    bool isFinished() const {
+        return next == records.size();
+    }
+
+    // Sends the records which are due. queue is null on GameActivity builds, where events bypass it and the depth can't
+    // be watched, a speed of 0 then sends one record per call
+    void dispatch(WindowCallbacks &callbacks, FakeInputQueue *queue);
+};
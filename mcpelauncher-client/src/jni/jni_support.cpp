@@ -1,5 +1,6 @@
 #include <log.h>
 #include <mcpelauncher/path_helper.h>
+#include <FileUtil.h>
 #include <mcpelauncher/linker.h>
 #include "jni_support.h"
 #include "xbox_live.h"
@@ -32,7 +33,10 @@
 #endif
 #include "securerandom.h"
 #include "../settings.h"
+#include "../asset_prefetcher.h"
+#include "../util.h"
 #include "../main.h"
+#include <cstdlib>
 #include <thread>
 #include <iostream>
 #include <fstream>
@@ -232,7 +236,18 @@ void JniSupport::startGame(ANativeActivity_createFunc *activityOnCreate, GameAct
     activity->stbi_load_from_memory = (decltype(activity->stbi_load_from_memory))stbiLoadFromMemory;
     activity->stbi_image_free = (decltype(activity->stbi_image_free))stbiImageFree;
 
-    assetManager = std::make_unique<FakeAssetManager>(PathHelper::getGameDir() + "assets");
+    // With MCPELAUNCHER_APK set the AAssetManager reads from the APK, but the extracted assets are still needed: the game
+    // opens some of them through plain file access (vanilla_music), and assets missing from the APK fall back to them
+    const char *apkPath = getenv("MCPELAUNCHER_APK");
+    auto assetIndexPath = PathHelper::getCacheDirectory() + "asset-index-" + std::to_string(std::hash<std::string>()(PathHelper::getGameDir())) + ".bin";
+    FileUtil::mkdirRecursive(PathHelper::getCacheDirectory());
+    assetManager = std::make_unique<FakeAssetManager>(PathHelper::getGameDir() + "assets", apkPath ? apkPath : "", assetIndexPath);
+    int prefetchThreads = ReadEnvInt("MCPELAUNCHER_ASSET_PREFETCH_THREADS", 0);
+    if(prefetchThreads > 0) {
+        auto tracePath = PathHelper::getCacheDirectory() + "asset-trace-" + std::to_string(std::hash<std::string>()(PathHelper::getGameDir())) + ".txt";
+        auto manager = assetManager.get();
+        assetManager->prefetcher = std::make_shared<AssetPrefetcher>(tracePath, [manager](std::string const &name) { manager->prefetch(name); }, (size_t)prefetchThreads);
+    }
 
     XboxLiveHelper::getInstance().setJvm(&vm);
 
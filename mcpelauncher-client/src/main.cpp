@@ -39,6 +39,7 @@
 #include "symbols.h"
 #include "core_patches.h"
 #include "thread_mover.h"
+#include "util.h"
 #include <FileUtil.h>
 #include <properties/property.h>
 #include <fstream>
@@ -316,6 +317,15 @@ Hardware	: Qualcomm Technologies, Inc MSM8998
     for(auto&& redir : shim::rewrite_filesystem_access) {
         Log::trace("REDIRECT", "%s to %s", redir.first.data(), redir.second.data());
     }
+    // Cache metadata lookups of the game below the redirected directories, invalidated via inotify
+    int statCacheSize = ReadEnvInt("MCPELAUNCHER_STAT_CACHE_SIZE", 0);
+    shim::stat_cache_size = statCacheSize > 0 ? (size_t)statCacheSize : 0;
+    shim::use_coarse_clocks = ReadEnvFlag("MCPELAUNCHER_COARSE_CLOCKS");
+    Log::info("Launcher", "String routines: %s", shim::describe_string_routines().data());
+    auto systemPropertiesPath = PathHelper::getPrimaryDataDirectory() + "mcpelauncher-system-properties.txt";
+    if(shim::load_system_properties(systemPropertiesPath)) {
+        Log::info("Launcher", "Loaded system properties from %s", systemPropertiesPath.data());
+    }
     auto libC = MinecraftUtils::getLibCSymbols();
     ThreadMover::hookLibC(libC);
 
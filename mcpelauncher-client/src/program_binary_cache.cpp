@@ -0,0 +1,201 @@
+#include "program_binary_cache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <dirent.h>
+#include <log.h>
+#include <FileUtil.h>
+#include <build_info.h>
+
+static const char cacheMagic[8] = {'M', 'C', 'P', 'G', 'L', 'B', '0', '1'};
+
+// GL_NUM_PROGRAM_BINARY_FORMATS, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_LINK_STATUS, GL_PROGRAM_BINARY_LENGTH
+static const unsigned int numProgramBinaryFormats = 0x87FE;
+static const unsigned int programBinaryRetrievableHint = 0x8257;
+static const unsigned int linkStatus = 0x8B82;
+static const unsigned int programBinaryLength = 0x8741;
+
+static uint64_t hashBytes(uint64_t hash, const void *data, size_t size) {
+    // FNV-1a
+    auto bytes = (const unsigned char *)data;
+    for(size_t i = 0; i < size; i++)
+        hash = (hash ^ bytes[i]) * 0x100000001b3ULL;
+    return hash;
+}
+
+static uint64_t hashString(uint64_t hash, const char *str) {
+    // Hash the terminator too, so that consecutive strings can't run into each other
+    return hashBytes(hash, str ? str : "", (str ? strlen(str) : 0) + 1);
+}
+
+static const uint64_t hashSeed = 0xcbf29ce484222325ULL;
+// Second, independent hash stored inside the file to catch collisions of the name
+static const uint64_t checkSeed = 0x84222325cbf29ce4ULL;
+
+ProgramBinaryCache::ProgramBinaryCache(std::string directory, void *(*resolver)(const char *)) : directory(std::move(directory)) {
+    glGetIntegerv = (void (*)(unsigned int, int *))resolver("glGetIntegerv");
+    glGetString = (const unsigned char *(*)(unsigned int))resolver("glGetString");
+    glGetProgramiv = (void (*)(unsigned int, unsigned int, int *))resolver("glGetProgramiv");
+    glProgramParameteri = (void (*)(unsigned int, unsigned int, int))resolver("glProgramParameteri");
+    glGetProgramBinary = (void (*)(unsigned int, int, int *, unsigned int *, void *))resolver("glGetProgramBinary");
+    glProgramBinary = (void (*)(unsigned int, unsigned int, const void *, int))resolver("glProgramBinary");
+}
+
+void ProgramBinaryCache::initialize() {
+    // Needs a current context, so this runs on the first link instead of at install time
+    initialized = true;
+    if(!glGetIntegerv || !glGetString || !glGetProgramiv || !glGetProgramBinary || !glProgramBinary)
+        return;
+    int formats = 0;
+    glGetIntegerv(numProgramBinaryFormats, &formats);
+    if(formats <= 0) {
+        Log::info("ProgramBinaryCache", "The driver doesn't support any program binary formats");
+        return;
+    }
+
+    driverHash = hashSeed;
+    for(unsigned int name : {0x1F00u, 0x1F01u, 0x1F02u})  // GL_VENDOR, GL_RENDERER, GL_VERSION
+        driverHash = hashString(driverHash, (const char *)glGetString(name));
+    driverHash = hashString(driverHash, CLIENT_GIT_COMMIT_HASH);
+
+    FileUtil::mkdirRecursive(directory);
+    char prefix[20];
+    snprintf(prefix, sizeof(prefix), "%016llx-", (unsigned long long)driverHash);
+    if(auto dir = opendir(directory.c_str())) {
+        size_t removed = 0;
+        while(auto ent = readdir(dir)) {
+            if(ent->d_name[0] == '.' || !strncmp(ent->d_name, prefix, strlen(prefix)))
+                continue;
+            if(remove((directory + ent->d_name).c_str()) == 0)
+                removed++;
+        }
+        closedir(dir);
+        if(removed > 0)
+            Log::info("ProgramBinaryCache", "Removed %zu program binaries of a different driver or launcher version", removed);
+    }
+    supported = true;
+}
+
+std::string ProgramBinaryCache::getPath(uint64_t key) const {
+    char name[40];
+    snprintf(name, sizeof(name), "%016llx-%016llx.bin", (unsigned long long)driverHash, (unsigned long long)key);
+    return directory + name;
+}
+
+uint64_t ProgramBinaryCache::getProgramKey(unsigned int program, uint64_t seed) const {
+    auto &info = programs.at(program);
+    uint64_t key = hashBytes(seed, &driverHash, sizeof(driverHash));
+    for(auto shader : info.shaders) {
+        auto hash = shaderHashes.at(shader);
+        key = hashBytes(key, &hash, sizeof(hash));
+    }
+    return hashBytes(key, info.attribLocations.data(), info.attribLocations.size());
+}
+
+void ProgramBinaryCache::onShaderSource(unsigned int shader, unsigned int count, const char *const *string, const int *length) {
+    uint64_t hash = hashSeed;
+    for(unsigned int i = 0; i < count; i++) {
+        size_t len = length && length[i] >= 0 ? (size_t)length[i] : strlen(string[i]);
+        hash = hashBytes(hash, string[i], len);
+    }
+    shaderHashes[shader] = hash;
+}
+
+void ProgramBinaryCache::onAttachShader(unsigned int program, unsigned int shader) {
+    programs[program].shaders.push_back(shader);
+}
+
+void ProgramBinaryCache::onBindAttribLocation(unsigned int program, unsigned int index, const char *name) {
+    auto &locations = programs[program].attribLocations;
+    locations += std::to_string(index) + "=" + name + ";";
+}
+
+void ProgramBinaryCache::onDeleteProgram(unsigned int program) {
+    programs.erase(program);
+}
+
+bool ProgramBinaryCache::load(unsigned int program, uint64_t key, uint64_t check) {
+    std::ifstream s(getPath(key), std::ios::binary);
+    if(!s)
+        return false;
+    char magic[sizeof(cacheMagic)];
+    uint64_t fileCheck;
+    uint32_t format, size;
+    if(!s.read(magic, sizeof(magic)) || memcmp(magic, cacheMagic, sizeof(magic)) || !s.read((char *)&fileCheck, sizeof(fileCheck)) ||
+       fileCheck != check || !s.read((char *)&format, sizeof(format)) || !s.read((char *)&size, sizeof(size)))
+        return false;
+    std::vector<char> binary(size);
+    if(!s.read(binary.data(), size))
+        return false;
+    glProgramBinary(program, format, binary.data(), (int)size);
+    int status = 0;
+    glGetProgramiv(program, linkStatus, &status);
+    return status != 0;
+}
+
+void ProgramBinaryCache::store(unsigned int program, uint64_t key, uint64_t check) {
+    int size = 0;
+    glGetProgramiv(program, programBinaryLength, &size);
+    if(size <= 0)
+        return;
+    std::vector<char> binary(size);
+    unsigned int format = 0;
+    int length = 0;
+    glGetProgramBinary(program, size, &length, &format, binary.data());
+    if(length <= 0)
+        return;
+
+    auto path = getPath(key);
+    std::string tmpPath = path + ".tmp";
+    {
+        std::ofstream s(tmpPath, std::ios::binary | std::ios::trunc);
+        if(!s)
+            return;
+        uint32_t format32 = format, size32 = (uint32_t)length;
+        s.write(cacheMagic, sizeof(cacheMagic));
+        s.write((const char *)&check, sizeof(check));
+        s.write((const char *)&format32, sizeof(format32));
+        s.write((const char *)&size32, sizeof(size32));
+        s.write(binary.data(), length);
+        if(!s) {
+            s.close();
+            remove(tmpPath.c_str());
+            return;
+        }
+    }
+    if(rename(tmpPath.c_str(), path.c_str()) != 0)
+        remove(tmpPath.c_str());
+}
+
+void ProgramBinaryCache::linkProgram(unsigned int program, void (*link)(unsigned int program)) {
+    if(!initialized)
+        initialize();
+    auto info = programs.find(program);
+    bool cacheable = supported && info != programs.end() && !info->second.shaders.empty();
+    if(cacheable) {
+        for(auto shader : info->second.shaders) {
+            if(!shaderHashes.count(shader)) {
+                cacheable = false;
+                break;
+            }
+        }
+    }
+    if(!cacheable) {
+        link(program);
+        return;
+    }
+
+    auto key = getProgramKey(program, hashSeed);
+    auto check = getProgramKey(program, checkSeed);
+    if(load(program, key, check))
+        return;
+    // Missing, or rejected by the driver, in which case the link below replaces the failed binary
+    if(glProgramParameteri)
+        glProgramParameteri(program, programBinaryRetrievableHint, 1);
+    link(program);
+    int status = 0;
+    glGetProgramiv(program, linkStatus, &status);
+    if(status)
+        store(program, key, check);
+}
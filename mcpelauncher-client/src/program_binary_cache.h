@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * Caches linked GL programs on disk with glGetProgramBinary. Programs are keyed by a hash of their (already
+ * rewritten) shader sources and attribute bindings, files are named after a hash of the driver strings and the
+ * launcher version, and files of any other driver are deleted when the cache is opened.
+ */
+class ProgramBinaryCache {
+private:
+    struct ProgramInfo {
+        std::vector<unsigned int> shaders;
+        std::string attribLocations;
+    };
+
+    void (*glGetIntegerv)(unsigned int pname, int *data);
+    const unsigned char *(*glGetString)(unsigned int name);
+    void (*glGetProgramiv)(unsigned int program, unsigned int pname, int *params);
+    void (*glProgramParameteri)(unsigned int program, unsigned int pname, int value);
+    void (*glGetProgramBinary)(unsigned int program, int bufSize, int *length, unsigned int *binaryFormat, void *binary);
+    void (*glProgramBinary)(unsigned int program, unsigned int binaryFormat, const void *binary, int length);
+
+    std::string directory;
+    bool initialized = false;
+    bool supported = false;
+    uint64_t driverHash = 0;
+    std::unordered_map<unsigned int, uint64_t> shaderHashes;
+    std::unordered_map<unsigned int, ProgramInfo> programs;
+
+    void initialize();
+    std::string getPath(uint64_t key) const;
+    uint64_t getProgramKey(unsigned int program, uint64_t seed) const;
+    bool load(unsigned int program, uint64_t key, uint64_t check);
+    void store(unsigned int program, uint64_t key, uint64_t check);
+
+public:
+    ProgramBinaryCache(std::string directory, void *(*resolver)(const char *));
+
+    void onShaderSource(unsigned int shader, unsigned int count, const char *const *string, const int *length);
+    void onAttachShader(unsigned int program, unsigned int shader);
+    void onBindAttribLocation(unsigned int program, unsigned int index, const char *name);
+    void onDeleteProgram(unsigned int program);
+
+    // Loads the program from the cache, or links it with link and stores the result
+    void linkProgram(unsigned int program, void (*link)(unsigned int program));
+};
@@ -0,0 +1,47 @@
+#include "resolution_scale_controller.h"
+
+#include <algorithm>
+#include <cmath>
+
+void ResolutionScaleController::setConfig(Config const &config) {
+    this->config = config;
+    scale = std::min(std::max(scale, config.minScale), config.maxScale);
+}
+
+void ResolutionScaleController::reset() {
+    scale = config.maxScale;
+    smoothedMs = 0;
+    settling = 0;
+    withinBudget = 0;
+}
+
+float ResolutionScaleController::update(double ms, bool gpu) {
+    if(ms <= 0)
+        return scale;
+    smoothedMs = smoothedMs > 0 ? smoothedMs + (ms - smoothedMs) * smoothing : ms;
+    if(settling > 0) {
+        settling--;
+        return scale;
+    }
+
+    double load = smoothedMs / config.targetMs;
+    float next = scale;
+    if(load > 1 + hysteresis) {
+        // The cost of a frame grows with the pixel count, the square of the scale
+        next = scale * (float)std::sqrt(targetLoad / load);
+        withinBudget = 0;
+    } else if(gpu) {
+        if(load < lowLoad)
+            next = scale * (float)std::sqrt(targetLoad / load);
+    } else if(++withinBudget >= probeFrames) {
+        next = scale + maxStepUp;
+        withinBudget = 0;
+    }
+    next = std::min(std::max(next, scale - maxStepDown), scale + maxStepUp);
+    next = std::min(std::max(std::round(next * 100) / 100, config.minScale), config.maxScale);
+    if(next != scale) {
+        scale = next;
+        settling = settleFrames;
+    }
+    return scale;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+/*
+ * Picks the render scale that keeps the frame within the budget of the target FPS. The measured time is smoothed
+ * before it is compared against the budget, each adjustment moves the scale by at most one step and is followed by a
+ * few frames to settle, so that single slow frames don't change the resolution.
+ * GPU time shows the headroom directly. Frame time doesn't while a frame limit or vsync caps it, so without GPU time
+ * the scale is probed upwards after a while without frames over budget.
+ */
+class ResolutionScaleController {
+public:
+    struct Config {
+        float minScale = 0.5f;
+        float maxScale = 1.0f;
+        double targetMs = 1000.0 / 60;
+    };
+
+private:
+    static constexpr double smoothing = 0.1;
+    // Over budget above 1 + hysteresis, with GPU time room to grow below lowLoad, adjustments aim for targetLoad
+    static constexpr double hysteresis = 0.05;
+    static constexpr double lowLoad = 0.75;
+    static constexpr double targetLoad = 0.9;
+    static constexpr float maxStepDown = 0.1f;
+    static constexpr float maxStepUp = 0.05f;
+    static constexpr int settleFrames = 20;
+    static constexpr int probeFrames = 180;
+
+    Config config;
+    float scale = 1.0f;
+    double smoothedMs = 0;
+    int settling = 0;
+    int withinBudget = 0;
+
+public:
+    void setConfig(Config const &config);
+
+    Config const &getConfig() const {
+        return config;
+    }
+
+    // Starts over at the maximum scale
+    void reset();
+
+    // Feeds the time of the last frame, gpu tells whether it is GPU time. Returns the scale for the next frame
+    float update(double ms, bool gpu);
+
+    float getScale() const {
+        return scale;
+    }
+};
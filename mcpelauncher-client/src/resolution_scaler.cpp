@@ -0,0 +1,590 @@
+#include "resolution_scaler.h"
+#include "settings.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <log.h>
+
+bool ResolutionScaler::initialized = false;
+bool ResolutionScaler::supported = false;
+bool ResolutionScaler::active = false;
+bool ResolutionScaler::presenting = false;
+ResolutionScaleController ResolutionScaler::controller;
+float ResolutionScaler::scale = 1.0f;
+int ResolutionScaler::width, ResolutionScaler::height;
+int ResolutionScaler::renderWidth, ResolutionScaler::renderHeight;
+int ResolutionScaler::targetWidth, ResolutionScaler::targetHeight;
+unsigned int ResolutionScaler::framebuffer, ResolutionScaler::colorTexture, ResolutionScaler::depthStencil;
+unsigned int ResolutionScaler::program, ResolutionScaler::vertexArray;
+int ResolutionScaler::uvScaleLocation, ResolutionScaler::texelLocation, ResolutionScaler::sharpnessLocation;
+unsigned int ResolutionScaler::gameDrawFramebuffer, ResolutionScaler::gameReadFramebuffer;
+bool ResolutionScaler::viewportSet, ResolutionScaler::scissorSet;
+int ResolutionScaler::gameViewport[4], ResolutionScaler::gameScissor[4];
+bool ResolutionScaler::hasTimer, ResolutionScaler::timerDisjoint;
+unsigned int ResolutionScaler::queries[queryFrames];
+bool ResolutionScaler::queryPending[queryFrames];
+bool ResolutionScaler::queryActive;
+int ResolutionScaler::queryFrame;
+double ResolutionScaler::lastGpuMs;
+
+void (*ResolutionScaler::glGetBooleanv)(unsigned int pname, unsigned char *data);
+const unsigned char *(*ResolutionScaler::glGetString)(unsigned int name);
+const unsigned char *(*ResolutionScaler::glGetStringi)(unsigned int name, unsigned int index);
+unsigned char (*ResolutionScaler::glIsEnabled)(unsigned int cap);
+void (*ResolutionScaler::glEnable)(unsigned int cap);
+void (*ResolutionScaler::glDisable)(unsigned int cap);
+void (*ResolutionScaler::glColorMask)(unsigned char r, unsigned char g, unsigned char b, unsigned char a);
+void (*ResolutionScaler::glGenFramebuffers)(int n, unsigned int *framebuffers);
+void (*ResolutionScaler::glFramebufferTexture2D)(unsigned int target, unsigned int attachment, unsigned int textarget, unsigned int texture, int level);
+void (*ResolutionScaler::glFramebufferRenderbuffer)(unsigned int target, unsigned int attachment, unsigned int renderbuffertarget, unsigned int renderbuffer);
+unsigned int (*ResolutionScaler::glCheckFramebufferStatus)(unsigned int target);
+void (*ResolutionScaler::glGenRenderbuffers)(int n, unsigned int *renderbuffers);
+void (*ResolutionScaler::glDeleteRenderbuffers)(int n, const unsigned int *renderbuffers);
+void (*ResolutionScaler::glBindRenderbuffer)(unsigned int target, unsigned int renderbuffer);
+void (*ResolutionScaler::glRenderbufferStorage)(unsigned int target, unsigned int internalformat, int width, int height);
+void (*ResolutionScaler::glGenTextures)(int n, unsigned int *textures);
+void (*ResolutionScaler::glDeleteTextures)(int n, const unsigned int *textures);
+void (*ResolutionScaler::glBindTexture)(unsigned int target, unsigned int texture);
+void (*ResolutionScaler::glTexImage2D)(unsigned int target, int level, int internalformat, int width, int height, int border, unsigned int format, unsigned int type, const void *data);
+void (*ResolutionScaler::glTexParameteri)(unsigned int target, unsigned int pname, int param);
+void (*ResolutionScaler::glActiveTexture)(unsigned int texture);
+void (*ResolutionScaler::glBindSampler)(unsigned int unit, unsigned int sampler);
+unsigned int (*ResolutionScaler::glCreateShader)(unsigned int type);
+void (*ResolutionScaler::glShaderSource)(unsigned int shader, int count, const char **string, int *length);
+void (*ResolutionScaler::glCompileShader)(unsigned int shader);
+void (*ResolutionScaler::glGetShaderiv)(unsigned int shader, unsigned int pname, int *params);
+void (*ResolutionScaler::glGetShaderInfoLog)(unsigned int shader, int bufSize, int *length, char *infoLog);
+void (*ResolutionScaler::glDeleteShader)(unsigned int shader);
+unsigned int (*ResolutionScaler::glCreateProgram)();
+void (*ResolutionScaler::glAttachShader)(unsigned int program, unsigned int shader);
+void (*ResolutionScaler::glLinkProgram)(unsigned int program);
+void (*ResolutionScaler::glGetProgramiv)(unsigned int program, unsigned int pname, int *params);
+int (*ResolutionScaler::glGetUniformLocation)(unsigned int program, const char *name);
+void (*ResolutionScaler::glUseProgram)(unsigned int program);
+void (*ResolutionScaler::glUniform2f)(int location, float v0, float v1);
+void (*ResolutionScaler::glUniform1f)(int location, float v0);
+void (*ResolutionScaler::glGenVertexArrays)(int n, unsigned int *arrays);
+void (*ResolutionScaler::glBindVertexArray)(unsigned int array);
+void (*ResolutionScaler::glDrawArrays)(unsigned int mode, int first, int count);
+void (*ResolutionScaler::glGenQueries)(int n, unsigned int *ids);
+void (*ResolutionScaler::glEndQuery)(unsigned int target);
+void (*ResolutionScaler::glGetQueryObjectuiv)(unsigned int id, unsigned int pname, unsigned int *params);
+void (*ResolutionScaler::glGetQueryObjectui64v)(unsigned int id, unsigned int pname, uint64_t *params);
+void (*ResolutionScaler::glGetIntegerv_orig)(unsigned int pname, int *data);
+void (*ResolutionScaler::glBeginQuery_orig)(unsigned int target, unsigned int id);
+void (*ResolutionScaler::glBeginQueryEXT_orig)(unsigned int target, unsigned int id);
+void (*ResolutionScaler::glBindFramebuffer_orig)(unsigned int target, unsigned int framebuffer);
+void (*ResolutionScaler::glViewport_orig)(int x, int y, int width, int height);
+void (*ResolutionScaler::glScissor_orig)(int x, int y, int width, int height);
+void (*ResolutionScaler::glBlitFramebuffer_orig)(int srcX0, int srcY0, int srcX1, int srcY1, int dstX0, int dstY0, int dstX1, int dstY1, unsigned int mask, unsigned int filter);
+void (*ResolutionScaler::glReadPixels_orig)(int x, int y, int width, int height, unsigned int format, unsigned int type, void *pixels);
+
+// GL_FRAMEBUFFER, GL_READ_FRAMEBUFFER, GL_DRAW_FRAMEBUFFER
+static const unsigned int framebufferTarget = 0x8D40, readFramebufferTarget = 0x8CA8, drawFramebufferTarget = 0x8CA9;
+static const unsigned int texture2D = 0x0DE1;  // GL_TEXTURE_2D
+// GL_BLEND, GL_DEPTH_TEST, GL_CULL_FACE, GL_SCISSOR_TEST, GL_STENCIL_TEST
+static const unsigned int upscaleCaps[] = {0x0BE2, 0x0B71, 0x0B44, 0x0C11, 0x0B90};
+// Only counts the time the GPU spent on the commands in between, unlike a difference of GL_TIMESTAMP values it
+// doesn't grow while the GPU idles waiting for a CPU bound game
+static const unsigned int timeElapsed = 0x88BF;  // GL_TIME_ELAPSED
+
+// Written as GLES 3 shaders, GLCorePatch swaps the version line on desktop GL
+static const char *upscaleVersion = "#version 300 es\n";
+static const char *upscaleVertexShader = R"(
+uniform vec2 uvScale;
+out vec2 uv;
+void main() {
+    vec2 pos = vec2(float((gl_VertexID << 1) & 2), float(gl_VertexID & 2));
+    uv = pos * uvScale;
+    gl_Position = vec4(pos * 2.0 - 1.0, 0.0, 1.0);
+}
+)";
+static const char *upscaleFragmentShader = R"(
+precision mediump float;
+uniform sampler2D source;
+// Shared with the vertex shader, the precision has to match
+uniform highp vec2 uvScale;
+uniform vec2 texel;
+uniform float sharpness;
+in vec2 uv;
+out vec4 fragColor;
+// Stays within the scaled area, the rest of the texture holds stale pixels
+vec3 fetch(vec2 p) {
+    return texture(source, clamp(p, texel * 0.5, uvScale - texel * 0.5)).rgb;
+}
+void main() {
+    vec4 c = texture(source, clamp(uv, texel * 0.5, uvScale - texel * 0.5));
+    vec3 n = fetch(uv + vec2(texel.x, 0.0)) + fetch(uv - vec2(texel.x, 0.0)) + fetch(uv + vec2(0.0, texel.y)) + fetch(uv - vec2(0.0, texel.y));
+    fragColor = vec4(clamp(c.rgb + sharpness * (4.0 * c.rgb - n), 0.0, 1.0), c.a);
+}
+)";
+
+void ResolutionScaler::installGL(std::unordered_map<std::string, void *> &overrides, void *(*resolver)(const char *)) {
+    initialized = supported = active = presenting = false;
+    viewportSet = scissorSet = false;
+    gameDrawFramebuffer = gameReadFramebuffer = 0;
+    framebuffer = colorTexture = depthStencil = 0;
+    targetWidth = targetHeight = 0;
+
+#define RESOLVE(name) name = (decltype(name))resolver(#name);
+    RESOLVE(glGetBooleanv)
+    RESOLVE(glGetString)
+    RESOLVE(glGetStringi)
+    RESOLVE(glIsEnabled)
+    RESOLVE(glEnable)
+    RESOLVE(glDisable)
+    RESOLVE(glColorMask)
+    RESOLVE(glGenFramebuffers)
+    RESOLVE(glFramebufferTexture2D)
+    RESOLVE(glFramebufferRenderbuffer)
+    RESOLVE(glCheckFramebufferStatus)
+    RESOLVE(glGenRenderbuffers)
+    RESOLVE(glDeleteRenderbuffers)
+    RESOLVE(glBindRenderbuffer)
+    RESOLVE(glRenderbufferStorage)
+    RESOLVE(glGenTextures)
+    RESOLVE(glDeleteTextures)
+    RESOLVE(glBindTexture)
+    RESOLVE(glTexImage2D)
+    RESOLVE(glTexParameteri)
+    RESOLVE(glActiveTexture)
+    RESOLVE(glBindSampler)
+    RESOLVE(glCreateShader)
+    RESOLVE(glShaderSource)
+    RESOLVE(glCompileShader)
+    RESOLVE(glGetShaderiv)
+    RESOLVE(glGetShaderInfoLog)
+    RESOLVE(glDeleteShader)
+    RESOLVE(glCreateProgram)
+    RESOLVE(glAttachShader)
+    RESOLVE(glLinkProgram)
+    RESOLVE(glGetProgramiv)
+    RESOLVE(glGetUniformLocation)
+    RESOLVE(glUseProgram)
+    RESOLVE(glUniform2f)
+    RESOLVE(glUniform1f)
+    RESOLVE(glGenVertexArrays)
+    RESOLVE(glBindVertexArray)
+    RESOLVE(glDrawArrays)
+    RESOLVE(glGenQueries)
+    RESOLVE(glEndQuery)
+    RESOLVE(glGetQueryObjectuiv)
+    RESOLVE(glGetQueryObjectui64v)
+#undef RESOLVE
+    // GL_EXT_disjoint_timer_query only has suffixed entry points on GLES
+    if(auto fn = resolver("glEndQueryEXT"))
+        glEndQuery = (decltype(glEndQuery))fn;
+    if(auto fn = resolver("glGetQueryObjectui64vEXT"))
+        glGetQueryObjectui64v = (decltype(glGetQueryObjectui64v))fn;
+
+    glGetIntegerv_orig = (decltype(glGetIntegerv_orig))resolver("glGetIntegerv");
+    glBeginQuery_orig = (decltype(glBeginQuery_orig))resolver("glBeginQuery");
+    glBeginQueryEXT_orig = (decltype(glBeginQueryEXT_orig))resolver("glBeginQueryEXT");
+    glBindFramebuffer_orig = (decltype(glBindFramebuffer_orig))resolver("glBindFramebuffer");
+    glViewport_orig = (decltype(glViewport_orig))resolver("glViewport");
+    glScissor_orig = (decltype(glScissor_orig))resolver("glScissor");
+    glBlitFramebuffer_orig = (decltype(glBlitFramebuffer_orig))resolver("glBlitFramebuffer");
+    glReadPixels_orig = (decltype(glReadPixels_orig))resolver("glReadPixels");
+    if(!glGetIntegerv_orig || !glBindFramebuffer_orig || !glViewport_orig || !glScissor_orig || !glBlitFramebuffer_orig || !glReadPixels_orig)
+        return;
+    // Installed even while disabled, so that it can be turned on from the menu
+    overrides["glGetIntegerv"] = (void *)glGetIntegerv;
+    if(glBeginQuery_orig)
+        overrides["glBeginQuery"] = (void *)glBeginQuery;
+    if(glBeginQueryEXT_orig)
+        overrides["glBeginQueryEXT"] = (void *)glBeginQueryEXT;
+    overrides["glBindFramebuffer"] = (void *)glBindFramebuffer;
+    overrides["glViewport"] = (void *)glViewport;
+    overrides["glScissor"] = (void *)glScissor;
+    overrides["glBlitFramebuffer"] = (void *)glBlitFramebuffer;
+    overrides["glReadPixels"] = (void *)glReadPixels;
+}
+
+bool ResolutionScaler::hasExtension(const char *name) {
+    int count = 0;
+    glGetIntegerv_orig(0x821D /* GL_NUM_EXTENSIONS */, &count);
+    for(int i = 0; i < count; i++) {
+        auto ext = (const char *)glGetStringi(0x1F03 /* GL_EXTENSIONS */, i);
+        if(ext && strcmp(ext, name) == 0)
+            return true;
+    }
+    return false;
+}
+
+unsigned int ResolutionScaler::compileShader(unsigned int type, const char *source) {
+    unsigned int shader = glCreateShader(type);
+    const char *sources[] = {upscaleVersion, source};
+    int lengths[] = {(int)strlen(upscaleVersion), (int)strlen(source)};
+    glShaderSource(shader, 2, sources, lengths);
+    glCompileShader(shader);
+    int status = 0;
+    glGetShaderiv(shader, 0x8B81 /* GL_COMPILE_STATUS */, &status);
+    if(!status) {
+        char log[1024] = {};
+        glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+        Log::error("ResolutionScaler", "Failed to compile the upscale shader: %s", log);
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+bool ResolutionScaler::init() {
+    initialized = true;
+    // GL_VERSION is "OpenGL ES x.y ..." on GLES and starts with the version on desktop GL
+    auto version = glGetString ? (const char *)glGetString(0x1F02 /* GL_VERSION */) : nullptr;
+    bool gles = version && strncmp(version, "OpenGL ES ", 10) == 0;
+    if(gles)
+        version += 10;
+    double versionNumber = version ? atof(version) : 0;
+    if(versionNumber < (gles ? 3.0 : 3.3) || !glGetStringi || !glGenFramebuffers || !glGenRenderbuffers || !glCreateShader || !glGenVertexArrays || !glBindSampler || !glGetBooleanv) {
+        Log::warn("ResolutionScaler", "Dynamic resolution needs GLES 3 or GL 3.3");
+        return false;
+    }
+
+    unsigned int vertex = compileShader(0x8B31 /* GL_VERTEX_SHADER */, upscaleVertexShader);
+    unsigned int fragment = compileShader(0x8B30 /* GL_FRAGMENT_SHADER */, upscaleFragmentShader);
+    if(!vertex || !fragment)
+        return false;
+    program = glCreateProgram();
+    glAttachShader(program, vertex);
+    glAttachShader(program, fragment);
+    glLinkProgram(program);
+    glDeleteShader(vertex);
+    glDeleteShader(fragment);
+    int status = 0;
+    glGetProgramiv(program, 0x8B82 /* GL_LINK_STATUS */, &status);
+    if(!status) {
+        Log::error("ResolutionScaler", "Failed to link the upscale shader");
+        return false;
+    }
+    uvScaleLocation = glGetUniformLocation(program, "uvScale");
+    texelLocation = glGetUniformLocation(program, "texel");
+    sharpnessLocation = glGetUniformLocation(program, "sharpness");
+    // Attribute-less draw, the VAO only keeps the arrays the game enabled out of it
+    glGenVertexArrays(1, &vertexArray);
+    glGenFramebuffers(1, &framebuffer);
+
+    hasTimer = glGenQueries && (glBeginQuery_orig || glBeginQueryEXT_orig) && glEndQuery && glGetQueryObjectuiv && glGetQueryObjectui64v;
+    timerDisjoint = hasTimer && hasExtension("GL_EXT_disjoint_timer_query");
+    hasTimer = hasTimer && (timerDisjoint || hasExtension("GL_ARB_timer_query") || (!gles && versionNumber >= 3.3));
+    if(hasTimer) {
+        glGenQueries(queryFrames, queries);
+        std::fill(std::begin(queryPending), std::end(queryPending), false);
+        queryActive = false;
+    }
+    Log::info("ResolutionScaler", "Dynamic resolution available, driven by %s time", hasTimer ? "GPU" : "frame");
+    return true;
+}
+
+bool ResolutionScaler::allocateTarget() {
+    auto config = controller.getConfig();
+    int w = std::max((int)std::ceil(width * config.maxScale), 1);
+    int h = std::max((int)std::ceil(height * config.maxScale), 1);
+    if(w == targetWidth && h == targetHeight)
+        return true;
+
+    int texture = 0, renderbuffer = 0;
+    glGetIntegerv_orig(0x8069 /* GL_TEXTURE_BINDING_2D */, &texture);
+    glGetIntegerv_orig(0x8CA7 /* GL_RENDERBUFFER_BINDING */, &renderbuffer);
+    if(colorTexture) {
+        glDeleteTextures(1, &colorTexture);
+        glDeleteRenderbuffers(1, &depthStencil);
+    }
+    glGenTextures(1, &colorTexture);
+    glBindTexture(texture2D, colorTexture);
+    glTexImage2D(texture2D, 0, 0x8058 /* GL_RGBA8 */, w, h, 0, 0x1908 /* GL_RGBA */, 0x1401 /* GL_UNSIGNED_BYTE */, nullptr);
+    glTexParameteri(texture2D, 0x2801 /* GL_TEXTURE_MIN_FILTER */, 0x2601 /* GL_LINEAR */);
+    glTexParameteri(texture2D, 0x2800 /* GL_TEXTURE_MAG_FILTER */, 0x2601 /* GL_LINEAR */);
+    glTexParameteri(texture2D, 0x2802 /* GL_TEXTURE_WRAP_S */, 0x812F /* GL_CLAMP_TO_EDGE */);
+    glTexParameteri(texture2D, 0x2803 /* GL_TEXTURE_WRAP_T */, 0x812F /* GL_CLAMP_TO_EDGE */);
+    glGenRenderbuffers(1, &depthStencil);
+    glBindRenderbuffer(0x8D41 /* GL_RENDERBUFFER */, depthStencil);
+    glRenderbufferStorage(0x8D41 /* GL_RENDERBUFFER */, 0x88F0 /* GL_DEPTH24_STENCIL8 */, w, h);
+    glBindTexture(texture2D, texture);
+    glBindRenderbuffer(0x8D41 /* GL_RENDERBUFFER */, renderbuffer);
+
+    glBindFramebuffer_orig(framebufferTarget, framebuffer);
+    glFramebufferTexture2D(framebufferTarget, 0x8CE0 /* GL_COLOR_ATTACHMENT0 */, texture2D, colorTexture, 0);
+    glFramebufferRenderbuffer(framebufferTarget, 0x821A /* GL_DEPTH_STENCIL_ATTACHMENT */, 0x8D41 /* GL_RENDERBUFFER */, depthStencil);
+    bool complete = glCheckFramebufferStatus(framebufferTarget) == 0x8CD5 /* GL_FRAMEBUFFER_COMPLETE */;
+    glBindFramebuffer_orig(framebufferTarget, 0);
+    if(!complete) {
+        Log::error("ResolutionScaler", "Offscreen framebuffer of %dx%d is incomplete", w, h);
+        return false;
+    }
+    targetWidth = w;
+    targetHeight = h;
+    return true;
+}
+
+bool ResolutionScaler::readGpuTime() {
+    if(!hasTimer)
+        return false;
+    if(timerDisjoint) {
+        int disjoint = 0;
+        glGetIntegerv_orig(0x8FBB /* GL_GPU_DISJOINT_EXT */, &disjoint);
+        if(disjoint)
+            std::fill(std::begin(queryPending), std::end(queryPending), false);
+    }
+    // Results arrive a few frames late, never wait for them
+    auto &pending = queryPending[queryFrame];
+    bool updated = false;
+    if(pending) {
+        unsigned int available = 0;
+        glGetQueryObjectuiv(queries[queryFrame], 0x8867 /* GL_QUERY_RESULT_AVAILABLE */, &available);
+        if(available) {
+            uint64_t elapsed = 0;
+            glGetQueryObjectui64v(queries[queryFrame], 0x8866 /* GL_QUERY_RESULT */, &elapsed);
+            // Mesa's llvmpipe returns garbage for the first query, no frame takes a second of GPU time
+            if(elapsed > 0 && elapsed < 1000000000) {
+                lastGpuMs = elapsed / 1e6;
+                updated = true;
+            }
+        }
+        pending = false;
+    }
+    return updated;
+}
+
+void ResolutionScaler::endGpuQuery(bool valid) {
+    if(!queryActive)
+        return;
+    glEndQuery(timeElapsed);
+    queryActive = false;
+    queryPending[queryFrame] = valid;
+    queryFrame = (queryFrame + 1) % queryFrames;
+}
+
+void ResolutionScaler::beginFrame(int width, int height, double frameMs) {
+    bool wasActive = active;
+    // Left open if the frame wasn't presented through present()
+    endGpuQuery(false);
+    presenting = false;
+    if(Settings::dynamic_resolution && !initialized)
+        supported = init();
+    active = Settings::dynamic_resolution && supported && width > 0 && height > 0;
+    if(active) {
+        ResolutionScaleController::Config config;
+        config.maxScale = std::max(Settings::dynamic_resolution_max_scale, 0.1f);
+        config.minScale = std::min(std::max(Settings::dynamic_resolution_min_scale, 0.1f), config.maxScale);
+        int fps = Settings::dynamic_resolution_target_fps > 0 ? Settings::dynamic_resolution_target_fps : Settings::fps_limit > 0 ? Settings::fps_limit : 60;
+        config.targetMs = 1000.0 / fps;
+        controller.setConfig(config);
+        if(!wasActive)
+            controller.reset();
+
+        if(hasTimer) {
+            if(readGpuTime())
+                controller.update(lastGpuMs, true);
+        } else {
+            controller.update(frameMs, false);
+        }
+        scale = controller.getScale();
+
+        ResolutionScaler::width = width;
+        ResolutionScaler::height = height;
+        if(!viewportSet) {
+            gameViewport[0] = gameViewport[1] = 0;
+            gameViewport[2] = width;
+            gameViewport[3] = height;
+        }
+        if(!scissorSet) {
+            gameScissor[0] = gameScissor[1] = 0;
+            gameScissor[2] = width;
+            gameScissor[3] = height;
+        }
+        active = allocateTarget();
+        renderWidth = std::min(std::max(scaleCoord(width), 1), targetWidth);
+        renderHeight = std::min(std::max(scaleCoord(height), 1), targetHeight);
+    }
+    if(!active)
+        scale = 1.0f;
+    if(active || wasActive)
+        applyState();
+    if(active && hasTimer) {
+        (glBeginQueryEXT_orig ? glBeginQueryEXT_orig : glBeginQuery_orig)(timeElapsed, queries[queryFrame]);
+        queryActive = true;
+    }
+}
+
+void ResolutionScaler::present() {
+    if(!active || presenting)
+        return;
+    endGpuQuery(true);
+    drawUpscale();
+    presenting = true;
+}
+
+void ResolutionScaler::drawUpscale() {
+    int currentProgram = 0, currentVertexArray = 0, currentActiveTexture = 0, currentTexture = 0, currentSampler = 0;
+    unsigned char colorMask[4];
+    bool caps[sizeof(upscaleCaps) / sizeof(*upscaleCaps)];
+    glGetIntegerv_orig(0x8B8D /* GL_CURRENT_PROGRAM */, &currentProgram);
+    glGetIntegerv_orig(0x85B5 /* GL_VERTEX_ARRAY_BINDING */, &currentVertexArray);
+    glGetIntegerv_orig(0x84E0 /* GL_ACTIVE_TEXTURE */, &currentActiveTexture);
+    glActiveTexture(0x84C0 /* GL_TEXTURE0 */);
+    glGetIntegerv_orig(0x8069 /* GL_TEXTURE_BINDING_2D */, &currentTexture);
+    glGetIntegerv_orig(0x8919 /* GL_SAMPLER_BINDING */, &currentSampler);
+    glGetBooleanv(0x0C23 /* GL_COLOR_WRITEMASK */, colorMask);
+    for(size_t i = 0; i < sizeof(upscaleCaps) / sizeof(*upscaleCaps); i++) {
+        caps[i] = glIsEnabled(upscaleCaps[i]);
+        if(caps[i])
+            glDisable(upscaleCaps[i]);
+    }
+
+    glBindFramebuffer_orig(framebufferTarget, 0);
+    glViewport_orig(0, 0, width, height);
+    glColorMask(1, 1, 1, 1);
+    glUseProgram(program);
+    glBindVertexArray(vertexArray);
+    glBindTexture(texture2D, colorTexture);
+    glBindSampler(0, 0);
+    glUniform2f(uvScaleLocation, (float)renderWidth / targetWidth, (float)renderHeight / targetHeight);
+    glUniform2f(texelLocation, 1.0f / targetWidth, 1.0f / targetHeight);
+    glUniform1f(sharpnessLocation, Settings::dynamic_resolution_sharpen ? 0.25f : 0.0f);
+    glDrawArrays(0x0004 /* GL_TRIANGLES */, 0, 3);
+
+    glUseProgram(currentProgram);
+    glBindVertexArray(currentVertexArray);
+    glBindSampler(0, currentSampler);
+    glBindTexture(texture2D, currentTexture);
+    glActiveTexture(currentActiveTexture);
+    glColorMask(colorMask[0], colorMask[1], colorMask[2], colorMask[3]);
+    for(size_t i = 0; i < sizeof(upscaleCaps) / sizeof(*upscaleCaps); i++) {
+        if(caps[i])
+            glEnable(upscaleCaps[i]);
+    }
+}
+
+void ResolutionScaler::applyRect(void (*fn)(int, int, int, int), int const *rect) {
+    if(active && gameDrawFramebuffer == 0) {
+        int x = scaleCoord(rect[0]), y = scaleCoord(rect[1]);
+        fn(x, y, scaleCoord(rect[0] + rect[2]) - x, scaleCoord(rect[1] + rect[3]) - y);
+    } else {
+        fn(rect[0], rect[1], rect[2], rect[3]);
+    }
+}
+
+void ResolutionScaler::applyState() {
+    unsigned int offscreen = active ? framebuffer : 0;
+    glBindFramebuffer_orig(drawFramebufferTarget, gameDrawFramebuffer ? gameDrawFramebuffer : offscreen);
+    glBindFramebuffer_orig(readFramebufferTarget, gameReadFramebuffer ? gameReadFramebuffer : offscreen);
+    if(viewportSet || active)
+        applyRect(glViewport_orig, gameViewport);
+    if(scissorSet || active)
+        applyRect(glScissor_orig, gameScissor);
+}
+
+void ResolutionScaler::glBindFramebuffer(unsigned int target, unsigned int fb) {
+    if(presenting) {
+        glBindFramebuffer_orig(target, fb);
+        return;
+    }
+    // The game may have queried the binding while the offscreen framebuffer stood in for the default one
+    if(fb == framebuffer && framebuffer != 0)
+        fb = 0;
+    bool wasDefault = gameDrawFramebuffer == 0;
+    if(target == framebufferTarget || target == drawFramebufferTarget)
+        gameDrawFramebuffer = fb;
+    if(target == framebufferTarget || target == readFramebufferTarget)
+        gameReadFramebuffer = fb;
+    glBindFramebuffer_orig(target, fb == 0 && active ? framebuffer : fb);
+    // Viewport and scissor are not part of the framebuffer, rescale them when the game moves between the default
+    // framebuffer and its own ones
+    if(active && wasDefault != (gameDrawFramebuffer == 0)) {
+        applyRect(glViewport_orig, gameViewport);
+        applyRect(glScissor_orig, gameScissor);
+    }
+}
+
+void ResolutionScaler::glGetIntegerv(unsigned int pname, int *data) {
+    glGetIntegerv_orig(pname, data);
+    if(!active || presenting)
+        return;
+    // The game would scale the values again when it restores them
+    switch(pname) {
+    case 0x0BA2:  // GL_VIEWPORT
+        std::copy(gameViewport, gameViewport + 4, data);
+        break;
+    case 0x0C10:  // GL_SCISSOR_BOX
+        std::copy(gameScissor, gameScissor + 4, data);
+        break;
+    case 0x8CA6:  // GL_FRAMEBUFFER_BINDING, GL_DRAW_FRAMEBUFFER_BINDING
+        *data = (int)gameDrawFramebuffer;
+        break;
+    case 0x8CAA:  // GL_READ_FRAMEBUFFER_BINDING
+        *data = (int)gameReadFramebuffer;
+        break;
+    }
+}
+
+void ResolutionScaler::glBeginQuery(unsigned int target, unsigned int id) {
+    if(target == timeElapsed)
+        endGpuQuery(false);
+    glBeginQuery_orig(target, id);
+}
+
+void ResolutionScaler::glBeginQueryEXT(unsigned int target, unsigned int id) {
+    if(target == timeElapsed)
+        endGpuQuery(false);
+    glBeginQueryEXT_orig(target, id);
+}
+
+void ResolutionScaler::glViewport(int x, int y, int width, int height) {
+    if(presenting) {
+        glViewport_orig(x, y, width, height);
+        return;
+    }
+    gameViewport[0] = x;
+    gameViewport[1] = y;
+    gameViewport[2] = width;
+    gameViewport[3] = height;
+    viewportSet = true;
+    applyRect(glViewport_orig, gameViewport);
+}
+
+void ResolutionScaler::glScissor(int x, int y, int width, int height) {
+    if(presenting) {
+        glScissor_orig(x, y, width, height);
+        return;
+    }
+    gameScissor[0] = x;
+    gameScissor[1] = y;
+    gameScissor[2] = width;
+    gameScissor[3] = height;
+    scissorSet = true;
+    applyRect(glScissor_orig, gameScissor);
+}
+
+void ResolutionScaler::glBlitFramebuffer(int srcX0, int srcY0, int srcX1, int srcY1, int dstX0, int dstY0, int dstX1, int dstY1, unsigned int mask, unsigned int filter) {
+    if(active && !presenting) {
+        if(gameReadFramebuffer == 0) {
+            srcX0 = scaleCoord(srcX0);
+            srcY0 = scaleCoord(srcY0);
+            srcX1 = scaleCoord(srcX1);
+            srcY1 = scaleCoord(srcY1);
+        }
+        if(gameDrawFramebuffer == 0) {
+            dstX0 = scaleCoord(dstX0);
+            dstY0 = scaleCoord(dstY0);
+            dstX1 = scaleCoord(dstX1);
+            dstY1 = scaleCoord(dstY1);
+        }
+    }
+    glBlitFramebuffer_orig(srcX0, srcY0, srcX1, srcY1, dstX0, dstY0, dstX1, dstY1, mask, filter);
+}
+
+void ResolutionScaler::glReadPixels(int x, int y, int width, int height, unsigned int format, unsigned int type, void *pixels) {
+    if(!active || presenting || gameReadFramebuffer != 0) {
+        glReadPixels_orig(x, y, width, height, format, type, pixels);
+        return;
+    }
+    // Reads of the default framebuffer (screenshots) see the frame at window resolution, the upscaled frame goes to
+    // the real default framebuffer, which the present overwrites completely anyway
+    drawUpscale();
+    glReadPixels_orig(x, y, width, height, format, type, pixels);
+    applyState();
+}
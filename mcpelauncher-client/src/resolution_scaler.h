@@ -0,0 +1,165 @@
+#pragma once
+
+#include "resolution_scale_controller.h"
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+/*
+ * Dynamic resolution: while Settings::dynamic_resolution is set, the game renders into an offscreen framebuffer in
+ * place of the default one and viewport, scissor and blits targeting it are scaled by the scale the controller picks.
+ * present() upscales the result to the window before the launcher UI is drawn, bilinear or with a light sharpening.
+ * Queries of the viewport, scissor box and framebuffer bindings return the values the game set.
+ * GPU time is measured with GL_TIME_ELAPSED queries around the game's rendering where available
+ * (GL_EXT_disjoint_timer_query, GL_ARB_timer_query), otherwise the frame time excluding the frame limiter is used.
+ * Needs GLES 3 or desktop GL 3.3.
+ */
+class ResolutionScaler {
+private:
+    static constexpr int queryFrames = 4;
+
+    static bool initialized;
+    static bool supported;
+    static bool active;
+    // Between present() and the next beginFrame() the launcher UI draws to the real default framebuffer
+    static bool presenting;
+    static ResolutionScaleController controller;
+    static float scale;
+
+    // Size the game renders at as reported by eglQuerySurface, the size of the scaled area and of the allocation
+    static int width, height;
+    static int renderWidth, renderHeight;
+    static int targetWidth, targetHeight;
+    static unsigned int framebuffer, colorTexture, depthStencil;
+    static unsigned int program, vertexArray;
+    static int uvScaleLocation, texelLocation, sharpnessLocation;
+
+    // State as the game set it, framebuffer 0 is the default one
+    static unsigned int gameDrawFramebuffer, gameReadFramebuffer;
+    static bool viewportSet, scissorSet;
+    static int gameViewport[4], gameScissor[4];
+
+    static bool hasTimer, timerDisjoint;
+    static unsigned int queries[queryFrames];
+    static bool queryPending[queryFrames];
+    // Only one GL_TIME_ELAPSED query can be active, a query started by the game ends ours for the frame
+    static bool queryActive;
+    static int queryFrame;
+    static double lastGpuMs;
+
+    static void (*glGetBooleanv)(unsigned int pname, unsigned char *data);
+    static const unsigned char *(*glGetString)(unsigned int name);
+    static const unsigned char *(*glGetStringi)(unsigned int name, unsigned int index);
+    static unsigned char (*glIsEnabled)(unsigned int cap);
+    static void (*glEnable)(unsigned int cap);
+    static void (*glDisable)(unsigned int cap);
+    static void (*glColorMask)(unsigned char r, unsigned char g, unsigned char b, unsigned char a);
+    static void (*glGenFramebuffers)(int n, unsigned int *framebuffers);
+    static void (*glFramebufferTexture2D)(unsigned int target, unsigned int attachment, unsigned int textarget, unsigned int texture, int level);
+    static void (*glFramebufferRenderbuffer)(unsigned int target, unsigned int attachment, unsigned int renderbuffertarget, unsigned int renderbuffer);
+    static unsigned int (*glCheckFramebufferStatus)(unsigned int target);
+    static void (*glGenRenderbuffers)(int n, unsigned int *renderbuffers);
+    static void (*glDeleteRenderbuffers)(int n, const unsigned int *renderbuffers);
+    static void (*glBindRenderbuffer)(unsigned int target, unsigned int renderbuffer);
+    static void (*glRenderbufferStorage)(unsigned int target, unsigned int internalformat, int width, int height);
+    static void (*glGenTextures)(int n, unsigned int *textures);
+    static void (*glDeleteTextures)(int n, const unsigned int *textures);
+    static void (*glBindTexture)(unsigned int target, unsigned int texture);
+    static void (*glTexImage2D)(unsigned int target, int level, int internalformat, int width, int height, int border, unsigned int format, unsigned int type, const void *data);
+    static void (*glTexParameteri)(unsigned int target, unsigned int pname, int param);
+    static void (*glActiveTexture)(unsigned int texture);
+    static void (*glBindSampler)(unsigned int unit, unsigned int sampler);
+    static unsigned int (*glCreateShader)(unsigned int type);
+    static void (*glShaderSource)(unsigned int shader, int count, const char **string, int *length);
+    static void (*glCompileShader)(unsigned int shader);
+    static void (*glGetShaderiv)(unsigned int shader, unsigned int pname, int *params);
+    static void (*glGetShaderInfoLog)(unsigned int shader, int bufSize, int *length, char *infoLog);
+    static void (*glDeleteShader)(unsigned int shader);
+    static unsigned int (*glCreateProgram)();
+    static void (*glAttachShader)(unsigned int program, unsigned int shader);
+    static void (*glLinkProgram)(unsigned int program);
+    static void (*glGetProgramiv)(unsigned int program, unsigned int pname, int *params);
+    static int (*glGetUniformLocation)(unsigned int program, const char *name);
+    static void (*glUseProgram)(unsigned int program);
+    static void (*glUniform2f)(int location, float v0, float v1);
+    static void (*glUniform1f)(int location, float v0);
+    static void (*glGenVertexArrays)(int n, unsigned int *arrays);
+    static void (*glBindVertexArray)(unsigned int array);
+    static void (*glDrawArrays)(unsigned int mode, int first, int count);
+    static void (*glGenQueries)(int n, unsigned int *ids);
+    static void (*glEndQuery)(unsigned int target);
+    static void (*glGetQueryObjectuiv)(unsigned int id, unsigned int pname, unsigned int *params);
+    static void (*glGetQueryObjectui64v)(unsigned int id, unsigned int pname, uint64_t *params);
+
+    static void (*glGetIntegerv_orig)(unsigned int pname, int *data);
+    static void glGetIntegerv(unsigned int pname, int *data);
+
+    static void (*glBeginQuery_orig)(unsigned int target, unsigned int id);
+    static void glBeginQuery(unsigned int target, unsigned int id);
+    static void (*glBeginQueryEXT_orig)(unsigned int target, unsigned int id);
+    static void glBeginQueryEXT(unsigned int target, unsigned int id);
+
+    static void (*glBindFramebuffer_orig)(unsigned int target, unsigned int framebuffer);
+    static void glBindFramebuffer(unsigned int target, unsigned int framebuffer);
+
+    static void (*glViewport_orig)(int x, int y, int width, int height);
+    static void glViewport(int x, int y, int width, int height);
+
+    static void (*glScissor_orig)(int x, int y, int width, int height);
+    static void glScissor(int x, int y, int width, int height);
+
+    static void (*glBlitFramebuffer_orig)(int srcX0, int srcY0, int srcX1, int srcY1, int dstX0, int dstY0, int dstX1, int dstY1, unsigned int mask, unsigned int filter);
+    static void glBlitFramebuffer(int srcX0, int srcY0, int srcX1, int srcY1, int dstX0, int dstY0, int dstX1, int dstY1, unsigned int mask, unsigned int filter);
+
+    static void (*glReadPixels_orig)(int x, int y, int width, int height, unsigned int format, unsigned int type, void *pixels);
+    static void glReadPixels(int x, int y, int width, int height, unsigned int format, unsigned int type, void *pixels);
+
+    static bool init();
+    static bool hasExtension(const char *name);
+    static unsigned int compileShader(unsigned int type, const char *source);
+    static bool allocateTarget();
+    // Collects the oldest query, returns whether a new result arrived
+    static bool readGpuTime();
+    static void endGpuQuery(bool valid);
+
+    static int scaleCoord(int value) {
+        return (int)(value * scale + 0.5f);
+    }
+    static void applyState();
+    static void applyRect(void (*fn)(int, int, int, int), int const *rect);
+    // Upscales the offscreen framebuffer into the default one, leaves the default framebuffer bound and everything
+    // else as it was
+    static void drawUpscale();
+
+public:
+    static void installGL(std::unordered_map<std::string, void *> &overrides, void *(*resolver)(const char *));
+
+    // Called after every swap and when the context is made current, with the size eglQuerySurface reports. Applies
+    // the settings, picks the scale for the next frame and binds the offscreen framebuffer
+    static void beginFrame(int width, int height, double frameMs);
+
+    // Called before the launcher UI is drawn into the frame
+    static void present();
+
+    static bool isActive() {
+        return active;
+    }
+
+    static float getScale() {
+        return scale;
+    }
+
+    static int getRenderWidth() {
+        return renderWidth;
+    }
+
+    static int getRenderHeight() {
+        return renderHeight;
+    }
+
+    // GPU time of the most recent frame with a query result, 0 without timer queries
+    static double getGpuMs() {
+        return lastGpuMs;
+    }
+};
@@ -15,6 +15,7 @@ bool Settings::enable_menubar = true;
 int Settings::enable_fps_hud;
 float Settings::fps_hud_x;
 float Settings::fps_hud_y;
+bool Settings::fps_hud_details;
 
 int Settings::enable_keystroke_hud;
 float Settings::keystroke_hud_x;
@@ -25,6 +26,13 @@ float Settings::scale;
 std::string Settings::menubarFocusKey;
 bool Settings::fullscreen;
 bool Settings::vsync;
+int Settings::fps_limit;
+int Settings::fps_limit_unfocused;
+bool Settings::dynamic_resolution;
+int Settings::dynamic_resolution_target_fps;
+float Settings::dynamic_resolution_min_scale = 0.5f;
+float Settings::dynamic_resolution_max_scale = 1.0f;
+bool Settings::dynamic_resolution_sharpen;
 
 char GameOptions::leftKey = 'A';
 char GameOptions::downKey = 'S';
@@ -48,6 +56,7 @@ static properties::property<bool> enable_menubar(settings, "enable_menubar", /*
 static properties::property<int> enable_fps_hud(settings, "enable_fps_hud", /* default if not defined*/ false);
 static properties::property<float> fps_hud_x(settings, "fps_hud_x", /* default if not defined*/ 0);
 static properties::property<float> fps_hud_y(settings, "fps_hud_y", /* default if not defined*/ 0);
+static properties::property<bool> fps_hud_details(settings, "fps_hud_details", /* default if not defined*/ false);
 
 static properties::property<int> enable_keystroke_hud(settings, "enable_keystroke_hud", /* default if not defined*/ false);
 static properties::property<float> keystroke_hud_x(settings, "keystroke_hud_x", /* default if not defined*/ 0);
@@ -58,6 +67,13 @@ static properties::property<float> scale(settings, "scale", 1);
 static properties::property<std::string> menubarFocusKey(settings, "menubarFocusKey", "");
 static properties::property<bool> fullscreen(settings, "fullscreen", /* default if not defined*/ false);
 static properties::property<bool> vsync(settings, "vsync", /* default if not defined*/ true);
+static properties::property<int> fps_limit(settings, "fps_limit", /* default if not defined*/ 0);
+static properties::property<int> fps_limit_unfocused(settings, "fps_limit_unfocused", /* default if not defined*/ 0);
+static properties::property<bool> dynamic_resolution(settings, "dynamic_resolution", /* default if not defined*/ false);
+static properties::property<int> dynamic_resolution_target_fps(settings, "dynamic_resolution_target_fps", /* default if not defined*/ 0);
+static properties::property<float> dynamic_resolution_min_scale(settings, "dynamic_resolution_min_scale", /* default if not defined*/ 0.5f);
+static properties::property<float> dynamic_resolution_max_scale(settings, "dynamic_resolution_max_scale", /* default if not defined*/ 1.0f);
+static properties::property<bool> dynamic_resolution_sharpen(settings, "dynamic_resolution_sharpen", /* default if not defined*/ false);
 
 std::string Settings::getPath() {
     return PathHelper::getPrimaryDataDirectory() + "mcpelauncher-client-settings.txt";
@@ -82,6 +98,7 @@ void Settings::load() {
     Settings::enable_fps_hud = ::enable_fps_hud.get();
     Settings::fps_hud_x = ::fps_hud_x.get();
     Settings::fps_hud_y = ::fps_hud_y.get();
+    Settings::fps_hud_details = ::fps_hud_details.get();
 
     Settings::enable_keystroke_hud = ::enable_keystroke_hud.get();
     Settings::keystroke_hud_x = ::keystroke_hud_x.get();
@@ -92,6 +109,13 @@ void Settings::load() {
     Settings::menubarFocusKey = ::menubarFocusKey.get();
     Settings::fullscreen = ::fullscreen.get();
     Settings::vsync = ::vsync.get();
+    Settings::fps_limit = ::fps_limit.get();
+    Settings::fps_limit_unfocused = ::fps_limit_unfocused.get();
+    Settings::dynamic_resolution = ::dynamic_resolution.get();
+    Settings::dynamic_resolution_target_fps = ::dynamic_resolution_target_fps.get();
+    Settings::dynamic_resolution_min_scale = ::dynamic_resolution_min_scale.get();
+    Settings::dynamic_resolution_max_scale = ::dynamic_resolution_max_scale.get();
+    Settings::dynamic_resolution_sharpen = ::dynamic_resolution_sharpen.get();
 }
 
 void Settings::save() {
@@ -108,6 +132,7 @@ void Settings::save() {
     ::enable_fps_hud.set(Settings::enable_fps_hud);
     ::fps_hud_x.set(Settings::fps_hud_x);
     ::fps_hud_y.set(Settings::fps_hud_y);
+    ::fps_hud_details.set(Settings::fps_hud_details);
 
     ::enable_keystroke_hud.set(Settings::enable_keystroke_hud);
     ::keystroke_hud_x.set(Settings::keystroke_hud_x);
@@ -119,6 +144,13 @@ void Settings::save() {
     std::ofstream propertiesFile(getPath());
     ::fullscreen.set(Settings::fullscreen);
     ::vsync.set(Settings::vsync);
+    ::fps_limit.set(Settings::fps_limit);
+    ::fps_limit_unfocused.set(Settings::fps_limit_unfocused);
+    ::dynamic_resolution.set(Settings::dynamic_resolution);
+    ::dynamic_resolution_target_fps.set(Settings::dynamic_resolution_target_fps);
+    ::dynamic_resolution_min_scale.set(Settings::dynamic_resolution_min_scale);
+    ::dynamic_resolution_max_scale.set(Settings::dynamic_resolution_max_scale);
+    ::dynamic_resolution_sharpen.set(Settings::dynamic_resolution_sharpen);
     if(propertiesFile) {
         settings.save(propertiesFile);
     }
@@ -14,6 +14,7 @@ struct Settings {
     static int enable_fps_hud;
     static float fps_hud_x;
     static float fps_hud_y;
+    static bool fps_hud_details;
 
     static int enable_keystroke_hud;
     static float keystroke_hud_x;
@@ -25,6 +26,14 @@ struct Settings {
 
     static bool fullscreen;
     static bool vsync;
+    static int fps_limit;
+    static int fps_limit_unfocused;
+
+    static bool dynamic_resolution;
+    static int dynamic_resolution_target_fps;
+    static float dynamic_resolution_min_scale;
+    static float dynamic_resolution_max_scale;
+    static bool dynamic_resolution_sharpen;
 
     static std::string getPath();
     static void load();
@@ -0,0 +1,135 @@
+#include "texture_patch.h"
+
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+// TEXTURE_PATCH_SCALAR builds the portable checks only, the tests compare them with the vectorized ones
+#if defined(__SSE2__) && !defined(TEXTURE_PATCH_SCALAR)
+#define TEXTURE_PATCH_SSE2
+#include <emmintrin.h>
+#elif defined(__aarch64__) && !defined(TEXTURE_PATCH_SCALAR)
+#define TEXTURE_PATCH_NEON
+#include <arm_neon.h>
+#endif
+
+// Number of matching rows / columns after which an atlas is considered detected
+static const size_t detectThreshold = 64;
+
+// p[0] == p[1] == p[2] == p[3] != p[4], the right edge of a tile whose last 4 pixels were duplicated
+static inline bool isRunEnd(const uint32_t *p) {
+#if defined(TEXTURE_PATCH_SSE2)
+    __m128i v = _mm_loadu_si128((const __m128i *)p);
+    __m128i eq = _mm_cmpeq_epi32(v, _mm_shuffle_epi32(v, 0));
+    return _mm_movemask_epi8(eq) == 0xFFFF && p[3] != p[4];
+#elif defined(TEXTURE_PATCH_NEON)
+    uint32x4_t v = vld1q_u32(p);
+    return vminvq_u32(vceqq_u32(v, vdupq_n_u32(p[0]))) != 0 && p[3] != p[4];
+#else
+    return p[0] == p[1] && p[1] == p[2] && p[2] == p[3] && p[3] != p[4];
+#endif
+}
+
+// Bit i is set if p[i] is zero
+static inline unsigned zeroMask(const uint32_t *p) {
+#if defined(TEXTURE_PATCH_SSE2)
+    __m128i eq = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)p), _mm_setzero_si128());
+    return (unsigned)_mm_movemask_ps(_mm_castsi128_ps(eq));
+#elif defined(TEXTURE_PATCH_NEON)
+    static const uint32_t bits[4] = {1, 2, 4, 8};
+    return vaddvq_u32(vandq_u32(vceqzq_u32(vld1q_u32(p)), vld1q_u32(bits)));
+#else
+    return (p[0] == 0) | (p[1] == 0) << 1 | (p[2] == 0) << 2 | (p[3] == 0) << 3;
+#endif
+}
+
+// Number of rows with a run end at column x, stops counting at limit
+static size_t countRunEnds(const uint32_t *px, int width, int height, int x, size_t limit) {
+    size_t z = 0;
+    for(int y = 0; y < height && z < limit; ++y) {
+        if(isRunEnd(px + (size_t)y * width + x))
+            z++;
+    }
+    return z;
+}
+
+// Moves the atlas one pixel right and one pixel down, keeping the first border columns and rows at their place,
+// rows above firstRow are only shifted right
+static void shiftAtlas(uint32_t *px, int width, int height, int border, int firstRow) {
+    size_t rowSize = (size_t)width * 4;
+    size_t shiftSize = rowSize - border * 4;
+    for(int y = 0; y < border; ++y)
+        memmove(px + (size_t)y * width + border, px + (size_t)y * width + border - 1, shiftSize);
+    // Bottom up, so every source row is still unmodified when it is copied
+    for(int y = height - 2; y >= firstRow; --y) {
+        memcpy(px + (size_t)(y + 1) * width + border, px + (size_t)y * width + border - 1, shiftSize);
+        memcpy(px + (size_t)(y + 1) * width, px + (size_t)y * width, border * 4);
+    }
+}
+
+static bool applyBlockAtlas(uint32_t *px, int width, int height) {
+    if(countRunEnds(px, width, height, 987, detectThreshold) < detectThreshold)
+        return false;
+    shiftAtlas(px, width, height, 32, 31);
+    return true;
+}
+
+static bool applyWideAtlas(uint32_t *px, int width, int height) {
+    const uint32_t *p = px + 1024 + 989;
+    if(!(p[0] == p[1] && p[1] != p[2]))
+        return false;
+    shiftAtlas(px, width, height, 32, 31);
+    return true;
+}
+
+static bool applyItemAtlas(uint32_t *px, int width, int height) {
+    size_t rowSize = (size_t)width * 4;
+    if(countRunEnds(px, width, height, 511 - 20, detectThreshold) >= detectThreshold) {
+        shiftAtlas(px, width, height, 16, 16);
+        return true;
+    }
+
+    // Columns 497, 498 and 499 are set and column 500 is empty in more than detectThreshold rows
+    size_t scores[4] = {};
+    for(int y = 0; y < height; ++y) {
+        unsigned zero = zeroMask(px + (size_t)y * width + 511 - 14);
+        for(int i = 0; i < 4; i++)
+            scores[i] += (i < 3) != ((zero >> i) & 1);
+        if(scores[0] > detectThreshold && scores[1] > detectThreshold && scores[2] > detectThreshold && scores[3] > detectThreshold)
+            break;
+    }
+    for(auto score : scores) {
+        if(score <= detectThreshold)
+            return false;
+    }
+
+    // Fewer than 16 pixels set in the second row
+    size_t uscore = 0;
+    const uint32_t *row = px + width;
+    int x = 0;
+    for(; x + 4 <= width && uscore < 16; x += 4)
+        uscore += 4 - __builtin_popcount(zeroMask(row + x));
+    for(; x < width && uscore < 16; ++x)
+        uscore += row[x] != 0;
+
+    if(uscore < 16) {
+        for(int y = 0; y < 16; ++y)
+            memmove(px + (size_t)y * width + 16, px + (size_t)y * width + 15, rowSize - 16 * 4);
+    } else {
+        for(int y = 15; y >= 0; --y)
+            memcpy(px + (size_t)(y + 1) * width + 16, px + (size_t)y * width + 15, rowSize - 16 * 4);
+    }
+    for(int y = height - 2; y >= 16; --y)
+        memcpy(px + (size_t)(y + 1) * width + 1, px + (size_t)y * width, rowSize - 4);
+    return true;
+}
+
+bool TexturePatch::apply(int width, int height, void *data) {
+    auto px = (uint32_t *)data;
+    if(width == 1024 && height == 1024)
+        return applyBlockAtlas(px, width, height);
+    if(width == 2048 && height == 1024)
+        return applyWideAtlas(px, width, height);
+    if(width == 512 && height == 512)
+        return applyItemAtlas(px, width, height);
+    return false;
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+/*
+ * Minecraft Intel/Amd Texture Bug 1.16.210-1.17.2 and beyond
+ * Detects the misaligned block and item atlases uploaded through glTexSubImage2D and shifts them back in place.
+ * This reduces the visual glitch of blocks, does not work with high resolution textures.
+ */
+class TexturePatch {
+public:
+    // Patches an RGBA8 upload of width x height pixels in place, returns true if the data was changed
+    static bool apply(int width, int height, void *data);
+};
@@ -0,0 +1,321 @@
+#include "texture_uploader.h"
+#include "util.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <log.h>
+
+bool TextureUploader::enabled = false;
+bool TextureUploader::allowPersistent = true;
+TextureUploader::Mode TextureUploader::mode = TextureUploader::Mode::Unknown;
+size_t TextureUploader::ringSize;
+size_t TextureUploader::head;
+size_t TextureUploader::currentSegment;
+unsigned int TextureUploader::buffer;
+unsigned char *TextureUploader::mapped;
+void *TextureUploader::fences[segmentCount];
+
+int TextureUploader::unpackAlignment = 4;
+int TextureUploader::unpackRowLength;
+int TextureUploader::unpackSkipRows;
+int TextureUploader::unpackSkipPixels;
+
+TextureUploader::Stats TextureUploader::current, TextureUploader::last;
+
+void (*TextureUploader::glGetIntegerv)(unsigned int pname, int *data);
+const unsigned char *(*TextureUploader::glGetString)(unsigned int name);
+const unsigned char *(*TextureUploader::glGetStringi)(unsigned int name, unsigned int index);
+void (*TextureUploader::glGenBuffers)(int n, unsigned int *buffers);
+void (*TextureUploader::glDeleteBuffers)(int n, const unsigned int *buffers);
+void (*TextureUploader::glBindBuffer)(unsigned int target, unsigned int buffer);
+void (*TextureUploader::glBufferData)(unsigned int target, intptr_t size, const void *data, unsigned int usage);
+void (*TextureUploader::glBufferStorage)(unsigned int target, intptr_t size, const void *data, unsigned int flags);
+void *(*TextureUploader::glMapBufferRange)(unsigned int target, intptr_t offset, intptr_t length, unsigned int access);
+unsigned char (*TextureUploader::glUnmapBuffer)(unsigned int target);
+void *(*TextureUploader::glFenceSync)(unsigned int condition, unsigned int flags);
+unsigned int (*TextureUploader::glClientWaitSync)(void *sync, unsigned int flags, uint64_t timeout);
+void (*TextureUploader::glDeleteSync)(void *sync);
+void (*TextureUploader::glPixelStorei_orig)(unsigned int pname, int param);
+void (*TextureUploader::glTexImage2D_orig)(unsigned int target, int level, int internalformat, int width, int height, int border, unsigned int format, unsigned int type, const void *data);
+void (*TextureUploader::glTexSubImage2D_orig)(unsigned int target, int level, int xoffset, int yoffset, int width, int height, unsigned int format, unsigned int type, const void *data);
+
+static const unsigned int pixelUnpackBuffer = 0x88EC;         // GL_PIXEL_UNPACK_BUFFER
+static const unsigned int pixelUnpackBufferBinding = 0x88EF;  // GL_PIXEL_UNPACK_BUFFER_BINDING
+// GL_MAP_WRITE_BIT, GL_MAP_INVALIDATE_RANGE_BIT, GL_MAP_UNSYNCHRONIZED_BIT, GL_MAP_PERSISTENT_BIT, GL_MAP_COHERENT_BIT
+static const unsigned int mapWrite = 0x0002, mapInvalidateRange = 0x0004, mapUnsynchronized = 0x0020, mapPersistent = 0x0040, mapCoherent = 0x0080;
+// GL_SYNC_GPU_COMMANDS_COMPLETE, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_EXPIRED
+static const unsigned int syncGpuCommandsComplete = 0x9117, syncFlushCommands = 0x0001, timeoutExpired = 0x911B;
+static const size_t stagingAlignment = 64;
+
+void TextureUploader::installGL(std::unordered_map<std::string, void *> &overrides, void *(*resolver)(const char *)) {
+    enabled = ReadEnvFlag("MCPELAUNCHER_GL_PBO_UPLOAD");
+    if(!enabled)
+        return;
+    allowPersistent = ReadEnvFlag("MCPELAUNCHER_GL_PBO_UPLOAD_PERSISTENT", true);
+    size_t segmentSize = (size_t)std::max(ReadEnvInt("MCPELAUNCHER_GL_PBO_UPLOAD_SIZE", 32), 1) * 1024 * 1024 / segmentCount;
+    ringSize = segmentSize * segmentCount;
+    mode = Mode::Unknown;
+    mapped = nullptr;
+    head = currentSegment = 0;
+    std::fill(std::begin(fences), std::end(fences), nullptr);
+
+    glGetIntegerv = (void (*)(unsigned int, int *))resolver("glGetIntegerv");
+    glGetString = (const unsigned char *(*)(unsigned int))resolver("glGetString");
+    glGetStringi = (const unsigned char *(*)(unsigned int, unsigned int))resolver("glGetStringi");
+    glGenBuffers = (void (*)(int, unsigned int *))resolver("glGenBuffers");
+    glDeleteBuffers = (void (*)(int, const unsigned int *))resolver("glDeleteBuffers");
+    glBindBuffer = (void (*)(unsigned int, unsigned int))resolver("glBindBuffer");
+    glBufferData = (void (*)(unsigned int, intptr_t, const void *, unsigned int))resolver("glBufferData");
+    glBufferStorage = (void (*)(unsigned int, intptr_t, const void *, unsigned int))resolver("glBufferStorageEXT");
+    if(!glBufferStorage)
+        glBufferStorage = (void (*)(unsigned int, intptr_t, const void *, unsigned int))resolver("glBufferStorage");
+    glMapBufferRange = (void *(*)(unsigned int, intptr_t, intptr_t, unsigned int))resolver("glMapBufferRange");
+    glUnmapBuffer = (unsigned char (*)(unsigned int))resolver("glUnmapBuffer");
+    glFenceSync = (void *(*)(unsigned int, unsigned int))resolver("glFenceSync");
+    glClientWaitSync = (unsigned int (*)(void *, unsigned int, uint64_t))resolver("glClientWaitSync");
+    glDeleteSync = (void (*)(void *))resolver("glDeleteSync");
+
+    glPixelStorei_orig = (void (*)(unsigned int, int))resolver("glPixelStorei");
+    glTexImage2D_orig = (void (*)(unsigned int, int, int, int, int, int, unsigned int, unsigned int, const void *))resolver("glTexImage2D");
+    glTexSubImage2D_orig = (void (*)(unsigned int, int, int, int, int, int, unsigned int, unsigned int, const void *))resolver("glTexSubImage2D");
+    if(!glPixelStorei_orig || !glTexImage2D_orig || !glTexSubImage2D_orig) {
+        enabled = false;
+        return;
+    }
+    overrides["glPixelStorei"] = (void *)glPixelStorei;
+    overrides["glTexImage2D"] = (void *)glTexImage2D;
+    overrides["glTexSubImage2D"] = (void *)glTexSubImage2D;
+    Log::info("TextureUploader", "Enabled with a %zu MiB staging ring", ringSize / 1024 / 1024);
+}
+
+bool TextureUploader::hasExtension(const char *name) {
+    int count = 0;
+    glGetIntegerv(0x821D /* GL_NUM_EXTENSIONS */, &count);
+    for(int i = 0; i < count; i++) {
+        auto ext = (const char *)glGetStringi(0x1F03 /* GL_EXTENSIONS */, i);
+        if(ext && strcmp(ext, name) == 0)
+            return true;
+    }
+    return false;
+}
+
+bool TextureUploader::initBuffer() {
+    mode = Mode::Unsupported;
+    // GL_VERSION is "OpenGL ES x.y ..." on GLES and starts with the version on desktop GL, GL_MAJOR_VERSION would
+    // leave a GL_INVALID_ENUM for the game to find on GLES 2
+    auto version = glGetString ? (const char *)glGetString(0x1F02 /* GL_VERSION */) : nullptr;
+    if(version && strncmp(version, "OpenGL ES ", 10) == 0)
+        version += 10;
+    if(!version || atoi(version) < 3 || !glGetStringi || !glGenBuffers || !glDeleteBuffers || !glBindBuffer || !glBufferData || !glMapBufferRange || !glUnmapBuffer || !glFenceSync || !glClientWaitSync || !glDeleteSync) {
+        Log::warn("TextureUploader", "Pixel unpack buffers need GLES 3, forwarding uploads unchanged");
+        return false;
+    }
+
+    // The game may have its own unpack buffer bound, it has to stay bound for the check in stage and the state cache
+    int previousBuffer = 0;
+    glGetIntegerv(pixelUnpackBufferBinding, &previousBuffer);
+    glGenBuffers(1, &buffer);
+    glBindBuffer(pixelUnpackBuffer, buffer);
+    if(allowPersistent && glBufferStorage && (hasExtension("GL_EXT_buffer_storage") || hasExtension("GL_ARB_buffer_storage"))) {
+        glBufferStorage(pixelUnpackBuffer, ringSize, nullptr, mapWrite | mapPersistent | mapCoherent);
+        mapped = (unsigned char *)glMapBufferRange(pixelUnpackBuffer, 0, ringSize, mapWrite | mapPersistent | mapCoherent);
+        if(mapped) {
+            mode = Mode::Persistent;
+        } else {
+            // Storage created with glBufferStorage is immutable, start over with a new buffer
+            glBindBuffer(pixelUnpackBuffer, 0);
+            glDeleteBuffers(1, &buffer);
+            glGenBuffers(1, &buffer);
+            glBindBuffer(pixelUnpackBuffer, buffer);
+        }
+    }
+    if(mode != Mode::Persistent) {
+        glBufferData(pixelUnpackBuffer, ringSize, nullptr, 0x88E0 /* GL_STREAM_DRAW */);
+        mode = Mode::Streaming;
+    }
+    glBindBuffer(pixelUnpackBuffer, (unsigned int)previousBuffer);
+    Log::info("TextureUploader", "Staging uploads in a %s buffer", mode == Mode::Persistent ? "persistently mapped" : "streaming");
+    return true;
+}
+
+size_t TextureUploader::getUploadSize(int width, int height, unsigned int format, unsigned int type) {
+    // Packed types describe a whole pixel, the others a single component
+    size_t elementSize;
+    bool packed = false;
+    switch(type) {
+    case 0x1400:  // GL_BYTE
+    case 0x1401:  // GL_UNSIGNED_BYTE
+        elementSize = 1;
+        break;
+    case 0x1402:  // GL_SHORT
+    case 0x1403:  // GL_UNSIGNED_SHORT
+    case 0x140B:  // GL_HALF_FLOAT
+    case 0x8D61:  // GL_HALF_FLOAT_OES
+        elementSize = 2;
+        break;
+    case 0x1404:  // GL_INT
+    case 0x1405:  // GL_UNSIGNED_INT
+    case 0x1406:  // GL_FLOAT
+        elementSize = 4;
+        break;
+    case 0x8363:  // GL_UNSIGNED_SHORT_5_6_5
+    case 0x8033:  // GL_UNSIGNED_SHORT_4_4_4_4
+    case 0x8034:  // GL_UNSIGNED_SHORT_5_5_5_1
+        elementSize = 2;
+        packed = true;
+        break;
+    case 0x8368:  // GL_UNSIGNED_INT_2_10_10_10_REV
+    case 0x8C3B:  // GL_UNSIGNED_INT_10F_11F_11F_REV
+    case 0x8C3E:  // GL_UNSIGNED_INT_5_9_9_9_REV
+    case 0x84FA:  // GL_UNSIGNED_INT_24_8
+        elementSize = 4;
+        packed = true;
+        break;
+    default:
+        return 0;
+    }
+    size_t components;
+    switch(format) {
+    case 0x1908:  // GL_RGBA
+    case 0x8D99:  // GL_RGBA_INTEGER
+    case 0x80E1:  // GL_BGRA_EXT
+        components = 4;
+        break;
+    case 0x1907:  // GL_RGB
+    case 0x8D98:  // GL_RGB_INTEGER
+        components = 3;
+        break;
+    case 0x8227:  // GL_RG
+    case 0x8228:  // GL_RG_INTEGER
+    case 0x190A:  // GL_LUMINANCE_ALPHA
+        components = 2;
+        break;
+    case 0x1903:  // GL_RED
+    case 0x8D94:  // GL_RED_INTEGER
+    case 0x1906:  // GL_ALPHA
+    case 0x1909:  // GL_LUMINANCE
+    case 0x1902:  // GL_DEPTH_COMPONENT
+    case 0x84F9:  // GL_DEPTH_STENCIL
+        components = 1;
+        break;
+    default:
+        return 0;
+    }
+    if(width <= 0 || height <= 0)
+        return 0;
+    size_t pixelSize = packed ? elementSize : elementSize * components;
+    size_t rowPixels = unpackRowLength > 0 ? unpackRowLength : width;
+    size_t stride = rowPixels * pixelSize;
+    // Rows are only padded to the alignment if a single element is smaller than it
+    if(elementSize < (size_t)unpackAlignment)
+        stride = (stride + unpackAlignment - 1) / unpackAlignment * unpackAlignment;
+    return (unpackSkipRows + height - 1) * stride + (unpackSkipPixels + width) * pixelSize;
+}
+
+void TextureUploader::waitSegment(size_t segment) {
+    auto fence = fences[segment];
+    if(!fence)
+        return;
+    if(glClientWaitSync(fence, 0, 0) == timeoutExpired) {
+        auto start = std::chrono::steady_clock::now();
+        while(glClientWaitSync(fence, syncFlushCommands, 1000000000) == timeoutExpired) {
+        }
+        current.stallNanos += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    }
+    glDeleteSync(fence);
+    fences[segment] = nullptr;
+}
+
+size_t TextureUploader::stage(const void *data, int width, int height, unsigned int format, unsigned int type) {
+    if(!data || mode == Mode::Unsupported || (mode == Mode::Unknown && !initBuffer()))
+        return npos;
+    size_t segmentSize = ringSize / segmentCount;
+    size_t size = getUploadSize(width, height, format, type);
+    if(size == 0 || size > segmentSize)
+        return npos;
+    // Uploads from an unpack buffer of the game already avoid the copy, data is an offset into it
+    int boundUnpackBuffer = 0;
+    glGetIntegerv(pixelUnpackBufferBinding, &boundUnpackBuffer);
+    if(boundUnpackBuffer != 0)
+        return npos;
+
+    // An upload never spans two segments, otherwise the fence of the first one wouldn't cover it
+    size_t offset = (head + stagingAlignment - 1) / stagingAlignment * stagingAlignment;
+    size_t segment = offset / segmentSize;
+    if(segment >= segmentCount || (offset + size - 1) / segmentSize != segment) {
+        segment = (segment + 1) % segmentCount;
+        offset = segment * segmentSize;
+    }
+    if(segment != currentSegment) {
+        fences[currentSegment] = glFenceSync(syncGpuCommandsComplete, 0);
+        waitSegment(segment);
+        currentSegment = segment;
+    }
+    head = offset + size;
+
+    glBindBuffer(pixelUnpackBuffer, buffer);
+    if(mode == Mode::Persistent) {
+        memcpy(mapped + offset, data, size);
+    } else {
+        // The fences already keep the driver from reading this range, no need to let the driver synchronize
+        auto dst = glMapBufferRange(pixelUnpackBuffer, offset, size, mapWrite | mapInvalidateRange | mapUnsynchronized);
+        if(!dst) {
+            glBindBuffer(pixelUnpackBuffer, 0);
+            return npos;
+        }
+        memcpy(dst, data, size);
+        glUnmapBuffer(pixelUnpackBuffer);
+    }
+    current.uploads++;
+    current.bytes += size;
+    return offset;
+}
+
+void TextureUploader::glPixelStorei(unsigned int pname, int param) {
+    switch(pname) {
+    case 0x0CF5:  // GL_UNPACK_ALIGNMENT
+        unpackAlignment = param;
+        break;
+    case 0x0CF2:  // GL_UNPACK_ROW_LENGTH
+        unpackRowLength = param;
+        break;
+    case 0x0CF3:  // GL_UNPACK_SKIP_ROWS
+        unpackSkipRows = param;
+        break;
+    case 0x0CF4:  // GL_UNPACK_SKIP_PIXELS
+        unpackSkipPixels = param;
+        break;
+    }
+    glPixelStorei_orig(pname, param);
+}
+
+void TextureUploader::glTexImage2D(unsigned int target, int level, int internalformat, int width, int height, int border, unsigned int format, unsigned int type, const void *data) {
+    size_t offset = stage(data, width, height, format, type);
+    if(offset == npos) {
+        if(data)
+            current.forwarded++;
+        glTexImage2D_orig(target, level, internalformat, width, height, border, format, type, data);
+        return;
+    }
+    glTexImage2D_orig(target, level, internalformat, width, height, border, format, type, (const void *)offset);
+    glBindBuffer(pixelUnpackBuffer, 0);
+}
+
+void TextureUploader::glTexSubImage2D(unsigned int target, int level, int xoffset, int yoffset, int width, int height, unsigned int format, unsigned int type, const void *data) {
+    size_t offset = stage(data, width, height, format, type);
+    if(offset == npos) {
+        if(data)
+            current.forwarded++;
+        glTexSubImage2D_orig(target, level, xoffset, yoffset, width, height, format, type, data);
+        return;
+    }
+    glTexSubImage2D_orig(target, level, xoffset, yoffset, width, height, format, type, (const void *)offset);
+    glBindBuffer(pixelUnpackBuffer, 0);
+}
+
+void TextureUploader::onFrame() {
+    last = current;
+    current = {};
+}
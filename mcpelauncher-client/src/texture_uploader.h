@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+/*
+ * Stages glTexImage2D / glTexSubImage2D uploads from client memory in a ring of pixel unpack buffer memory, the call
+ * returns after a memcpy and the driver copies into the texture asynchronously. The ring is split into segments, each
+ * fenced once the uploads moved past it and waited for before it is written again, the time spent waiting is reported.
+ * Uses a persistently mapped buffer with GL_EXT_buffer_storage and mapped ranges of a streaming buffer on plain GLES 3.
+ * On GLES 2 contexts, while the game has its own unpack buffer bound and for uploads larger than a segment or in
+ * unknown formats the call is forwarded unchanged. A segment is a quarter of the ring, 8 MiB by default, which fits a
+ * 2048x1024 RGBA8 atlas.
+ * Enabled with MCPELAUNCHER_GL_PBO_UPLOAD=1, MCPELAUNCHER_GL_PBO_UPLOAD_SIZE sets the ring size in MiB (32).
+ */
+class TextureUploader {
+public:
+    struct Stats {
+        uint32_t uploads = 0;
+        uint32_t forwarded = 0;
+        uint64_t bytes = 0;
+        uint64_t stallNanos = 0;
+    };
+
+private:
+    enum class Mode { Unknown, Persistent, Streaming, Unsupported };
+
+    static constexpr size_t segmentCount = 4;
+
+    static bool enabled;
+    static bool allowPersistent;
+    static Mode mode;
+    static size_t ringSize;
+    static size_t head;
+    static size_t currentSegment;
+    static unsigned int buffer;
+    static unsigned char *mapped;
+    static void *fences[segmentCount];
+
+    // Pixel store state set through glPixelStorei, decides which bytes of the client memory the driver reads
+    static int unpackAlignment;
+    static int unpackRowLength;
+    static int unpackSkipRows;
+    static int unpackSkipPixels;
+
+    static Stats current, last;
+
+    static void (*glGetIntegerv)(unsigned int pname, int *data);
+    static const unsigned char *(*glGetString)(unsigned int name);
+    static const unsigned char *(*glGetStringi)(unsigned int name, unsigned int index);
+    static void (*glGenBuffers)(int n, unsigned int *buffers);
+    static void (*glDeleteBuffers)(int n, const unsigned int *buffers);
+    static void (*glBindBuffer)(unsigned int target, unsigned int buffer);
+    static void (*glBufferData)(unsigned int target, intptr_t size, const void *data, unsigned int usage);
+    static void (*glBufferStorage)(unsigned int target, intptr_t size, const void *data, unsigned int flags);
+    static void *(*glMapBufferRange)(unsigned int target, intptr_t offset, intptr_t length, unsigned int access);
+    static unsigned char (*glUnmapBuffer)(unsigned int target);
+    static void *(*glFenceSync)(unsigned int condition, unsigned int flags);
+    static unsigned int (*glClientWaitSync)(void *sync, unsigned int flags, uint64_t timeout);
+    static void (*glDeleteSync)(void *sync);
+
+    static void (*glPixelStorei_orig)(unsigned int pname, int param);
+    static void glPixelStorei(unsigned int pname, int param);
+
+    static void (*glTexImage2D_orig)(unsigned int target, int level, int internalformat, int width, int height, int border, unsigned int format, unsigned int type, const void *data);
+    static void glTexImage2D(unsigned int target, int level, int internalformat, int width, int height, int border, unsigned int format, unsigned int type, const void *data);
+
+    static void (*glTexSubImage2D_orig)(unsigned int target, int level, int xoffset, int yoffset, int width, int height, unsigned int format, unsigned int type, const void *data);
+    static void glTexSubImage2D(unsigned int target, int level, int xoffset, int yoffset, int width, int height, unsigned int format, unsigned int type, const void *data);
+
+    // Creates the ring on the first upload, the context is only current on the render thread
+    static bool initBuffer();
+    static bool hasExtension(const char *name);
+    // Bytes the driver reads from client memory for the upload, 0 for formats that are not handled
+    static size_t getUploadSize(int width, int height, unsigned int format, unsigned int type);
+    static void waitSegment(size_t segment);
+
+    // Copies the upload into the ring and leaves the ring bound to GL_PIXEL_UNPACK_BUFFER. Returns the offset to pass
+    // instead of the pointer, or npos if the upload has to be forwarded unchanged
+    static constexpr size_t npos = (size_t)-1;
+    static size_t stage(const void *data, int width, int height, unsigned int format, unsigned int type);
+
+public:
+    static void installGL(std::unordered_map<std::string, void *> &overrides, void *(*resolver)(const char *));
+
+    // Called once per eglSwapBuffers, publishes the statistics of the finished frame
+    static void onFrame();
+
+    static bool isEnabled() {
+        return enabled;
+    }
+
+    static Stats getLastFrame() {
+        return last;
+    }
+};
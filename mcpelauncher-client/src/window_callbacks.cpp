@@ -8,6 +8,7 @@
 #include <cstdlib>
 #include <string>
 #include "settings.h"
+#include "frame_pacer.h"
 #include "util.h"
 
 WindowCallbacks::WindowCallbacks(GameWindow& window, JniSupport& jniSupport, FakeInputQueue& inputQueue) : window(window), jniSupport(jniSupport), inputQueue(inputQueue) {
@@ -19,12 +20,19 @@ WindowCallbacks::WindowCallbacks(GameWindow& window, JniSupport& jniSupport, Fak
     useRawInput = ReadEnvFlag("MCPELAUNCHER_CLIENT_RAW_INPUT");
     forcedMode = (InputMode)ReadEnvInt("MCPELAUNCHER_CLIENT_FORCED_INPUT_MODE", (int)forcedMode);
     inputModeSwitchDelay = ReadEnvInt("MCPELAUNCHER_CLIENT_INPUT_SWITCH_DELAY", inputModeSwitchDelay);
+    if(auto path = getenv("MCPELAUNCHER_INPUT_RECORD"))
+        inputRecorder = InputRecorder::open(path);
+    if(auto path = getenv("MCPELAUNCHER_INPUT_REPLAY")) {
+        auto speed = getenv("MCPELAUNCHER_INPUT_REPLAY_SPEED");
+        inputReplayer = InputReplayer::open(path, speed ? atof(speed) : 1.0);
+    }
 }
 
 void WindowCallbacks::registerCallbacks() {
     using namespace std::placeholders;
     window.setWindowSizeCallback(std::bind(&WindowCallbacks::onWindowSizeCallback, this, _1, _2));
     window.setCloseCallback(std::bind(&WindowCallbacks::onClose, this));
+    window.setFocusCallback(std::bind(&WindowCallbacks::onFocus, this, _1));
 
     window.setMouseButtonCallback(std::bind(&WindowCallbacks::onMouseButton, this, _1, _2, _3, _4));
     window.setMousePositionCallback(std::bind(&WindowCallbacks::onMousePosition, this, _1, _2));
@@ -64,6 +72,11 @@ void WindowCallbacks::startSendEvents() {
     }
 }
 
+void WindowCallbacks::replayInput() {
+    if(inputReplayer)
+        inputReplayer->dispatch(*this, jniSupport.isGameActivityVersion() ? nullptr : &inputQueue);
+}
+
 void WindowCallbacks::onWindowSizeCallback(int w, int h) {
     jniSupport.onWindowResized(w, h - Settings::menubarsize);
 }
@@ -78,6 +91,10 @@ void WindowCallbacks::onClose() {
     jniSupport.onWindowClosed();
 }
 
+void WindowCallbacks::onFocus(bool focused) {
+    FramePacer::instance.setFocused(focused);
+}
+
 void WindowCallbacks::setFullscreen(bool isFs) {
     if(Settings::fullscreen != isFs) {
         window.setFullscreen(isFs);
@@ -120,6 +137,8 @@ bool WindowCallbacks::hasInputMode(WindowCallbacks::InputMode want, bool changeM
 }
 
 void WindowCallbacks::onMouseButton(double x, double y, int btn, MouseButtonAction action) {
+    if(inputRecorder)
+        inputRecorder->record(InputRecord::Type::MouseButton, {btn, (int)action}, {(float)x, (float)y});
     if(hasInputMode(InputMode::Mouse)) {
         if(mouseButtonCallbacksLock.try_lock()) {
             for(size_t i = 0; i < mouseButtonCallbacks.size(); i++) {
@@ -184,6 +203,8 @@ void WindowCallbacks::onMouseButton(double x, double y, int btn, MouseButtonActi
     }
 }
 void WindowCallbacks::onMousePosition(double x, double y) {
+    if(inputRecorder)
+        inputRecorder->record(InputRecord::Type::MousePosition, {}, {(float)x, (float)y});
     if(hasInputMode(InputMode::Mouse)) {
         if(mousePositionCallbacksLock.try_lock()) {
             for(size_t i = 0; i < mousePositionCallbacks.size(); i++) {
@@ -221,6 +242,8 @@ void WindowCallbacks::onMousePosition(double x, double y) {
     }
 }
 void WindowCallbacks::onMouseRelativePosition(double x, double y) {
+    if(inputRecorder)
+        inputRecorder->record(InputRecord::Type::MouseRelativePosition, {}, {(float)x, (float)y});
     if(hasInputMode(InputMode::Mouse, std::abs(x) > 10 || std::abs(y) > 10)) {
         if(mousePositionCallbacksLock.try_lock()) {
             for(size_t i = 0; i < mousePositionCallbacks.size(); i++) {
@@ -241,6 +264,8 @@ void WindowCallbacks::onMouseRelativePosition(double x, double y) {
     }
 }
 void WindowCallbacks::onMouseScroll(double x, double y, double dx, double dy) {
+    if(inputRecorder)
+        inputRecorder->record(InputRecord::Type::MouseScroll, {}, {(float)x, (float)y, (float)dx, (float)dy});
     if(hasInputMode(InputMode::Mouse)) {
         if(mouseScrollCallbacksLock.try_lock()) {
             for(size_t i = 0; i < mouseScrollCallbacks.size(); i++) {
@@ -294,6 +319,8 @@ void WindowCallbacks::sendMouseEvent(int32_t source, int32_t deviceId, int32_t a
 }
 
 void WindowCallbacks::onTouchStart(int id, double x, double y) {
+    if(inputRecorder)
+        inputRecorder->record(InputRecord::Type::TouchStart, {id}, {(float)x, (float)y});
     if(hasInputMode(InputMode::Touch)) {
 #ifdef USE_IMGUI
         if(ImGui::GetCurrentContext() && imGuiTouchId == -1) {
@@ -315,6 +342,8 @@ void WindowCallbacks::onTouchStart(int id, double x, double y) {
     }
 }
 void WindowCallbacks::onTouchUpdate(int id, double x, double y) {
+    if(inputRecorder)
+        inputRecorder->record(InputRecord::Type::TouchUpdate, {id}, {(float)x, (float)y});
     if(hasInputMode(InputMode::Touch)) {
 #ifdef USE_IMGUI
         if(ImGui::GetCurrentContext() && imGuiTouchId == id) {
@@ -332,6 +361,8 @@ void WindowCallbacks::onTouchUpdate(int id, double x, double y) {
     }
 }
 void WindowCallbacks::onTouchEnd(int id, double x, double y) {
+    if(inputRecorder)
+        inputRecorder->record(InputRecord::Type::TouchEnd, {id}, {(float)x, (float)y});
     if(hasInputMode(InputMode::Touch)) {
 #ifdef USE_IMGUI
         if(ImGui::GetCurrentContext() && imGuiTouchId == id) {
@@ -516,6 +547,8 @@ static ImGuiKey mapImGuiModKey(KeyCode code) {
 #endif
 
 void WindowCallbacks::onKeyboard(KeyCode key, KeyAction action, int mods) {
+    if(inputRecorder)
+        inputRecorder->record(InputRecord::Type::Keyboard, {(int)key, (int)action, mods}, {});
     if(hasInputMode(InputMode::Mouse)) {
         if(keyboardCallbacksLock.try_lock()) {
             for(size_t i = 0; i < keyboardCallbacks.size(); i++) {
@@ -625,6 +658,8 @@ void WindowCallbacks::onKeyboard(KeyCode key, KeyAction action, int mods) {
     }
 }
 void WindowCallbacks::onKeyboardText(std::string const& c) {
+    if(inputRecorder)
+        inputRecorder->record(InputRecord::Type::KeyboardText, {}, {}, c);
 #ifdef USE_IMGUI
     if(ImGui::GetCurrentContext()) {
         ImGuiIO& io = ImGui::GetIO();
@@ -652,6 +687,8 @@ void WindowCallbacks::onPaste(std::string const& str) {
     jniSupport.getTextInputHandler().onTextInput(str);
 }
 void WindowCallbacks::onGamepadState(int gamepad, bool connected) {
+    if(inputRecorder)
+        inputRecorder->record(InputRecord::Type::GamepadState, {gamepad, connected}, {});
     Log::trace("WindowCallbacks", "Gamepad %s #%i", connected ? "connected" : "disconnected", gamepad);
     if(connected)
         gamepads.insert({gamepad, GamepadData()});
@@ -667,17 +704,15 @@ void WindowCallbacks::onGamepadState(int gamepad, bool connected) {
 }
 
 void WindowCallbacks::queueGamepadAxisInputIfNeeded(int gamepad) {
-    if(!needsQueueGamepadInput && !jniSupport.isGameActivityVersion())
+    auto gpi = gamepads.find(gamepad);
+    if(gpi == gamepads.end())
         return;
+    auto& gp = gpi->second;
     if(jniSupport.isGameActivityVersion()) {
-        auto gpi = gamepads.find(gamepad);
-        if(gpi == gamepads.end())
-            return;
-        auto& gp = gpi->second;
-
         GameActivityMotionEvent ev = {};
         ev.source = AINPUT_SOURCE_GAMEPAD;
         ev.deviceId = gamepad;
+        ev.eventTime = window.getGamepadEventTime();
         ev.action = AMOTION_EVENT_ACTION_MOVE;
         ev.pointerCount = 1;
         ev.pointers[0].id = 0;
@@ -704,45 +739,25 @@ void WindowCallbacks::queueGamepadAxisInputIfNeeded(int gamepad) {
 
         jniSupport.sendMotionEvent(&ev);
     } else {
-        inputQueue.addEvent(FakeMotionEvent(AINPUT_SOURCE_GAMEPAD, gamepad, AMOTION_EVENT_ACTION_MOVE, 0, 0.f, 0.f,
-                                            [this, gamepad](int axis) {
-                                                auto gpi = gamepads.find(gamepad);
-                                                if(gpi == gamepads.end())
-                                                    return 0.f;
-                                                auto& gp = gpi->second;
-                                                if(axis == AMOTION_EVENT_AXIS_X)
-                                                    return gp.axis[(int)GamepadAxisId::LEFT_X];
-                                                if(axis == AMOTION_EVENT_AXIS_Y)
-                                                    return gp.axis[(int)GamepadAxisId::LEFT_Y];
-                                                if(axis == AMOTION_EVENT_AXIS_RX)
-                                                    return gp.axis[(int)GamepadAxisId::RIGHT_X];
-                                                if(axis == AMOTION_EVENT_AXIS_RY)
-                                                    return gp.axis[(int)GamepadAxisId::RIGHT_Y];
-                                                if(axis == AMOTION_EVENT_AXIS_BRAKE)
-                                                    return gp.axis[(int)GamepadAxisId::LEFT_TRIGGER];
-                                                if(axis == AMOTION_EVENT_AXIS_GAS)
-                                                    return gp.axis[(int)GamepadAxisId::RIGHT_TRIGGER];
-                                                if(axis == AMOTION_EVENT_AXIS_HAT_X) {
-                                                    if(gp.button[(int)GamepadButtonId::DPAD_LEFT])
-                                                        return -1.f;
-                                                    if(gp.button[(int)GamepadButtonId::DPAD_RIGHT])
-                                                        return 1.f;
-                                                    return 0.f;
-                                                }
-                                                if(axis == AMOTION_EVENT_AXIS_HAT_Y) {
-                                                    if(gp.button[(int)GamepadButtonId::DPAD_UP])
-                                                        return -1.f;
-                                                    if(gp.button[(int)GamepadButtonId::DPAD_DOWN])
-                                                        return 1.f;
-                                                    return 0.f;
-                                                }
-                                                return 0.f;
-                                            }));
+        FakeMotionEvent ev(AINPUT_SOURCE_GAMEPAD, gamepad, AMOTION_EVENT_ACTION_MOVE);
+        ev.eventTime = window.getGamepadEventTime();
+        auto& axisValues = ev.pointers[0].axisValues;
+        axisValues[AMOTION_EVENT_AXIS_X] = gp.axis[(int)GamepadAxisId::LEFT_X];
+        axisValues[AMOTION_EVENT_AXIS_Y] = gp.axis[(int)GamepadAxisId::LEFT_Y];
+        axisValues[AMOTION_EVENT_AXIS_RX] = gp.axis[(int)GamepadAxisId::RIGHT_X];
+        axisValues[AMOTION_EVENT_AXIS_RY] = gp.axis[(int)GamepadAxisId::RIGHT_Y];
+        axisValues[AMOTION_EVENT_AXIS_BRAKE] = gp.axis[(int)GamepadAxisId::LEFT_TRIGGER];
+        axisValues[AMOTION_EVENT_AXIS_GAS] = gp.axis[(int)GamepadAxisId::RIGHT_TRIGGER];
+        axisValues[AMOTION_EVENT_AXIS_HAT_X] = gp.button[(int)GamepadButtonId::DPAD_LEFT] ? -1.f : gp.button[(int)GamepadButtonId::DPAD_RIGHT] ? 1.f : 0.f;
+        axisValues[AMOTION_EVENT_AXIS_HAT_Y] = gp.button[(int)GamepadButtonId::DPAD_UP] ? -1.f : gp.button[(int)GamepadButtonId::DPAD_DOWN] ? 1.f : 0.f;
+        // Replaces the state of this gamepad still waiting in the queue
+        inputQueue.addEvent(ev, true);
     }
-    needsQueueGamepadInput = false;
 }
 
 void WindowCallbacks::onGamepadButton(int gamepad, GamepadButtonId btn, bool pressed) {
+    if(inputRecorder)
+        inputRecorder->record(InputRecord::Type::GamepadButton, {gamepad, (int)btn, pressed}, {});
     if(hasInputMode(InputMode::Gamepad)) {
         auto gpi = gamepads.find(gamepad);
         if(gpi == gamepads.end())
@@ -765,20 +780,22 @@ void WindowCallbacks::onGamepadButton(int gamepad, GamepadButtonId btn, bool pre
             event.source = AINPUT_SOURCE_GAMEPAD;
             event.action = pressed ? AKEY_EVENT_ACTION_DOWN : AKEY_EVENT_ACTION_UP;
             event.keyCode = mapGamepadToAndroidKey(btn);
+            event.eventTime = window.getGamepadEventTime();
             if(pressed)
                 jniSupport.sendKeyDown(&event);
             else
                 jniSupport.sendKeyUp(&event);
         } else {
-            if(pressed)
-                inputQueue.addEvent(FakeKeyEvent(AINPUT_SOURCE_GAMEPAD, gamepad, AKEY_EVENT_ACTION_DOWN, mapGamepadToAndroidKey(btn)));
-            else
-                inputQueue.addEvent(FakeKeyEvent(AINPUT_SOURCE_GAMEPAD, gamepad, AKEY_EVENT_ACTION_UP, mapGamepadToAndroidKey(btn)));
+            FakeKeyEvent event(AINPUT_SOURCE_GAMEPAD, gamepad, pressed ? AKEY_EVENT_ACTION_DOWN : AKEY_EVENT_ACTION_UP, mapGamepadToAndroidKey(btn));
+            event.eventTime = window.getGamepadEventTime();
+            inputQueue.addEvent(event);
         }
     }
 }
 
 void WindowCallbacks::onGamepadAxis(int gamepad, GamepadAxisId ax, float value) {
+    if(inputRecorder)
+        inputRecorder->record(InputRecord::Type::GamepadAxis, {gamepad, (int)ax}, {value});
     if(hasInputMode(InputMode::Gamepad, std::abs(value) > 0.4f)) {
         auto gpi = gamepads.find(gamepad);
         if(gpi == gamepads.end())
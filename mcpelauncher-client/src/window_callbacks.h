@@ -4,6 +4,7 @@
 #include <unordered_map>
 #include "jni/jni_support.h"
 #include "fake_inputqueue.h"
+#include "input_recorder.h"
 #include <chrono>
 #include <vector>
 #include <mutex>
@@ -55,7 +56,6 @@ private:
     uint8_t delayedPaste = 0;
     std::string lastPasteStr = "";
     bool useDirectMouseInput, useDirectKeyboardInput;
-    bool needsQueueGamepadInput = true;
     bool sendEvents = false;
     bool cursorLocked = false;
     bool imguiTextInput = false;
@@ -72,6 +72,8 @@ private:
     InputMode forcedMode = InputMode::Unknown;
     int inputModeSwitchDelay = 100;
     std::chrono::high_resolution_clock::time_point lastUpdated;
+    std::unique_ptr<InputRecorder> inputRecorder;
+    std::unique_ptr<InputReplayer> inputReplayer;
     bool hasInputMode(InputMode want = InputMode::Unknown, bool changeMode = true);
 
     void queueGamepadAxisInputIfNeeded(int gamepad);
@@ -89,7 +91,12 @@ public:
 
     void startSendEvents();
 
-    void markRequeueGamepadInput() { needsQueueGamepadInput = true; }
+    // Sends the due events of the MCPELAUNCHER_INPUT_REPLAY recording, called from the looper after the window events
+    void replayInput();
+
+    InputReplayer *getInputReplayer() {
+        return inputReplayer.get();
+    }
 
     void onWindowSizeCallback(int w, int h);
 
@@ -97,6 +104,8 @@ public:
 
     void onClose();
 
+    void onFocus(bool focused);
+
     void setFullscreen(bool isFs);
 
     InputMode getInputMode();
@@ -0,0 +1,327 @@
+#include <gtest/gtest.h>
+#include "../src/apk_assets.h"
+#include "../src/fake_assetmanager.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <fstream>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+struct AAsset;
+struct AAssetDir;
+
+namespace {
+
+// Writes a zip archive with stored or raw deflated entries, optionally with zip64 sizes, offsets and end records
+class ZipWriter {
+    std::string data;
+    std::string centralDirectory;
+    uint64_t count = 0;
+    bool zip64;
+
+    static void put16(std::string &s, uint16_t v) {
+        s += (char)(v & 0xff);
+        s += (char)(v >> 8);
+    }
+    static void put32(std::string &s, uint32_t v) {
+        put16(s, (uint16_t)v);
+        put16(s, (uint16_t)(v >> 16));
+    }
+    static void put64(std::string &s, uint64_t v) {
+        put32(s, (uint32_t)v);
+        put32(s, (uint32_t)(v >> 32));
+    }
+
+    static std::string deflateRaw(std::string const &input) {
+        z_stream z = {};
+        deflateInit2(&z, Z_BEST_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+        std::string out(deflateBound(&z, input.size()), '\0');
+        z.next_in = (Bytef *)input.data();
+        z.avail_in = (uInt)input.size();
+        z.next_out = (Bytef *)&out[0];
+        z.avail_out = (uInt)out.size();
+        deflate(&z, Z_FINISH);
+        out.resize(z.total_out);
+        deflateEnd(&z);
+        return out;
+    }
+
+public:
+    explicit ZipWriter(bool zip64 = false) : zip64(zip64) {}
+
+    void add(std::string const &name, std::string const &content, bool deflated) {
+        std::string stored = deflated ? deflateRaw(content) : content;
+        uint32_t crc = (uint32_t)crc32(0, (const Bytef *)content.data(), (uInt)content.size());
+        uint64_t offset = data.size();
+        uint16_t method = deflated ? 8 : 0;
+
+        put32(data, 0x04034b50);
+        put16(data, zip64 ? 45 : 20);
+        put16(data, 0);
+        put16(data, method);
+        put32(data, 0);
+        put32(data, crc);
+        put32(data, zip64 ? 0xffffffff : (uint32_t)stored.size());
+        put32(data, zip64 ? 0xffffffff : (uint32_t)content.size());
+        put16(data, (uint16_t)name.size());
+        put16(data, zip64 ? 20 : 0);
+        data += name;
+        if(zip64) {
+            put16(data, 1);
+            put16(data, 16);
+            put64(data, content.size());
+            put64(data, stored.size());
+        }
+        data += stored;
+
+        std::string &cd = centralDirectory;
+        put32(cd, 0x02014b50);
+        put16(cd, zip64 ? 45 : 20);
+        put16(cd, zip64 ? 45 : 20);
+        put16(cd, 0);
+        put16(cd, method);
+        put32(cd, 0);
+        put32(cd, crc);
+        put32(cd, zip64 ? 0xffffffff : (uint32_t)stored.size());
+        put32(cd, zip64 ? 0xffffffff : (uint32_t)content.size());
+        put16(cd, (uint16_t)name.size());
+        put16(cd, zip64 ? 28 : 0);
+        put16(cd, 0);
+        put16(cd, 0);
+        put16(cd, 0);
+        put32(cd, 0);
+        put32(cd, zip64 ? 0xffffffff : (uint32_t)offset);
+        cd += name;
+        if(zip64) {
+            put16(cd, 1);
+            put16(cd, 24);
+            put64(cd, content.size());
+            put64(cd, stored.size());
+            put64(cd, offset);
+        }
+        count++;
+    }
+
+    void write(std::string const &path) {
+        std::string out = data;
+        uint64_t cdOffset = out.size();
+        out += centralDirectory;
+        if(zip64) {
+            uint64_t zip64EocdOffset = out.size();
+            put32(out, 0x06064b50);
+            put64(out, 44);
+            put16(out, 45);
+            put16(out, 45);
+            put32(out, 0);
+            put32(out, 0);
+            put64(out, count);
+            put64(out, count);
+            put64(out, centralDirectory.size());
+            put64(out, cdOffset);
+            put32(out, 0x07064b50);
+            put32(out, 0);
+            put64(out, zip64EocdOffset);
+            put32(out, 1);
+        }
+        put32(out, 0x06054b50);
+        put16(out, 0);
+        put16(out, 0);
+        put16(out, zip64 ? 0xffff : (uint16_t)count);
+        put16(out, zip64 ? 0xffff : (uint16_t)count);
+        put32(out, zip64 ? 0xffffffff : (uint32_t)centralDirectory.size());
+        put32(out, zip64 ? 0xffffffff : (uint32_t)cdOffset);
+        const char comment[] = "test archive";
+        put16(out, sizeof(comment) - 1);
+        out += comment;
+        std::ofstream(path, std::ios::binary | std::ios::trunc) << out;
+    }
+};
+
+// Compressible, but not a single repeated byte, and larger than a few inflater blocks
+std::string makeContent(size_t length, unsigned seed) {
+    std::string ret(length, '\0');
+    for(size_t i = 0; i < length; i++) {
+        seed = seed * 1103515245 + 12345;
+        ret[i] = "abcdefgh"[(seed >> 16) & 7];
+    }
+    return ret;
+}
+
+struct AAssetHooks {
+    AAsset *(*open)(FakeAssetManager *, const char *, int);
+    AAssetDir *(*openDir)(FakeAssetManager *, const char *);
+    void (*close)(AAsset *);
+    int (*read)(AAsset *, void *, size_t);
+    off64_t (*seek64)(AAsset *, off64_t, int);
+    off64_t (*getLength64)(AAsset *);
+    const void *(*getBuffer)(AAsset *);
+    int (*openFileDescriptor64)(AAsset *, off64_t *, off64_t *);
+    void (*closeDir)(AAssetDir *);
+    const char *(*getNextFileName)(AAssetDir *);
+
+    AAssetHooks() {
+        std::unordered_map<std::string, void *> syms;
+        FakeAssetManager::initHybrisHooks(syms);
+        open = (decltype(open))syms.at("AAssetManager_open");
+        openDir = (decltype(openDir))syms.at("AAssetManager_openDir");
+        close = (decltype(close))syms.at("AAsset_close");
+        read = (decltype(read))syms.at("AAsset_read");
+        seek64 = (decltype(seek64))syms.at("AAsset_seek64");
+        getLength64 = (decltype(getLength64))syms.at("AAsset_getLength64");
+        getBuffer = (decltype(getBuffer))syms.at("AAsset_getBuffer");
+        openFileDescriptor64 = (decltype(openFileDescriptor64))syms.at("AAsset_openFileDescriptor64");
+        closeDir = (decltype(closeDir))syms.at("AAssetDir_close");
+        getNextFileName = (decltype(getNextFileName))syms.at("AAssetDir_getNextFileName");
+    }
+};
+
+class ApkAssetsTest : public ::testing::Test {
+protected:
+    const int modeStreaming = 2, modeBuffer = 3;
+
+    AAssetHooks hooks;
+    std::string dir;
+    std::string apkPath;
+    std::string stored = "stored asset data";
+    std::string deflated = makeContent(5 * ApkAssets::blockSize / 2, 1);
+
+    ApkAssetsTest() {
+        char tmpl[] = "/tmp/mcpelauncher-apk-XXXXXX";
+        dir = mkdtemp(tmpl);
+        apkPath = dir + "/test.apk";
+        mkdir((dir + "/assets").c_str(), 0755);
+    }
+
+    ~ApkAssetsTest() {
+        system(("rm -rf '" + dir + "'").c_str());
+    }
+
+    void writeApk(bool zip64) {
+        ZipWriter zip(zip64);
+        zip.add("AndroidManifest.xml", "manifest", false);
+        zip.add("assets/stored.txt", stored, false);
+        zip.add("assets/textures/blocks/stone.png", deflated, true);
+        zip.add("assets/textures/items/", "", false);
+        zip.add("assets/textures/items/apple.png", "apple", true);
+        zip.add("assets/empty.txt", "", false);
+        zip.write(apkPath);
+    }
+
+    std::string readAll(AAsset *asset, size_t chunk) {
+        std::string ret;
+        std::vector<char> buf(chunk);
+        while(true) {
+            int n = hooks.read(asset, buf.data(), buf.size());
+            if(n <= 0)
+                break;
+            ret.append(buf.data(), n);
+        }
+        return ret;
+    }
+
+    std::vector<std::string> listDir(FakeAssetManager &manager, const char *name) {
+        std::vector<std::string> ret;
+        auto d = hooks.openDir(&manager, name);
+        if(!d)
+            return ret;
+        while(auto entry = hooks.getNextFileName(d))
+            ret.push_back(entry);
+        hooks.closeDir(d);
+        std::sort(ret.begin(), ret.end());
+        return ret;
+    }
+
+    void checkEntries(FakeAssetManager &manager) {
+        ASSERT_NE(manager.apk, nullptr);
+        auto asset = hooks.open(&manager, "stored.txt", modeBuffer);
+        ASSERT_NE(asset, nullptr);
+        ASSERT_EQ(hooks.getLength64(asset), (off64_t)stored.size());
+        ASSERT_EQ(std::string((const char *)hooks.getBuffer(asset)), stored);
+        // Stored entries are handed out as a range of the APK
+        off64_t start = 0, length = 0;
+        int fd = hooks.openFileDescriptor64(asset, &start, &length);
+        ASSERT_GE(fd, 0);
+        std::string fromFd(stored.size(), '\0');
+        ASSERT_EQ(pread(fd, &fromFd[0], fromFd.size(), start), (ssize_t)fromFd.size());
+        ::close(fd);
+        ASSERT_EQ(fromFd, stored);
+        hooks.close(asset);
+
+        asset = hooks.open(&manager, "textures/blocks/stone.png", modeStreaming);
+        ASSERT_NE(asset, nullptr);
+        ASSERT_EQ(hooks.getLength64(asset), (off64_t)deflated.size());
+        ASSERT_EQ(readAll(asset, 1000), deflated);
+        // Seeking back restarts the inflater or uses a cached block
+        ASSERT_EQ(hooks.seek64(asset, 100, SEEK_SET), 100);
+        char buf[50];
+        ASSERT_EQ(hooks.read(asset, buf, sizeof(buf)), (int)sizeof(buf));
+        ASSERT_EQ(std::string(buf, sizeof(buf)), deflated.substr(100, sizeof(buf)));
+        off64_t start2, length2;
+        ASSERT_EQ(hooks.openFileDescriptor64(asset, &start2, &length2), -1);
+        hooks.close(asset);
+
+        asset = hooks.open(&manager, "textures/blocks/stone.png", modeBuffer);
+        ASSERT_NE(asset, nullptr);
+        ASSERT_EQ(std::string((const char *)hooks.getBuffer(asset), deflated.size()), deflated);
+        hooks.close(asset);
+
+        asset = hooks.open(&manager, "empty.txt", modeBuffer);
+        ASSERT_NE(asset, nullptr);
+        ASSERT_EQ(hooks.getLength64(asset), 0);
+        ASSERT_EQ(std::string((const char *)hooks.getBuffer(asset)), "");
+        hooks.close(asset);
+
+        ASSERT_EQ(hooks.open(&manager, "AndroidManifest.xml", modeBuffer), nullptr);
+    }
+};
+
+}
+
+TEST_F(ApkAssetsTest, StoredAndDeflatedEntries) {
+    writeApk(false);
+    FakeAssetManager manager(dir + "/assets", apkPath);
+    checkEntries(manager);
+}
+
+TEST_F(ApkAssetsTest, Zip64Entries) {
+    writeApk(true);
+    FakeAssetManager manager(dir + "/assets", apkPath);
+    checkEntries(manager);
+}
+
+TEST_F(ApkAssetsTest, ListsDirectories) {
+    writeApk(false);
+    FakeAssetManager manager(dir + "/assets", apkPath);
+    ASSERT_EQ(listDir(manager, ""), (std::vector<std::string>{"empty.txt", "stored.txt", "textures"}));
+    ASSERT_EQ(listDir(manager, "textures"), (std::vector<std::string>{"blocks", "items"}));
+    ASSERT_EQ(listDir(manager, "textures/"), (std::vector<std::string>{"blocks", "items"}));
+    ASSERT_EQ(listDir(manager, "textures/items"), (std::vector<std::string>{"apple.png"}));
+    ASSERT_EQ(listDir(manager, "missing"), (std::vector<std::string>{}));
+}
+
+TEST_F(ApkAssetsTest, FallsBackToExtractedAssets) {
+    writeApk(false);
+    std::ofstream(dir + "/assets/extracted.txt") << "extracted";
+    std::ofstream(dir + "/assets/stored.txt") << "outdated";
+    FakeAssetManager manager(dir + "/assets", apkPath);
+    auto asset = hooks.open(&manager, "extracted.txt", modeBuffer);
+    ASSERT_NE(asset, nullptr);
+    ASSERT_EQ(std::string((const char *)hooks.getBuffer(asset)), "extracted");
+    hooks.close(asset);
+    // The APK takes precedence
+    asset = hooks.open(&manager, "stored.txt", modeStreaming);
+    ASSERT_NE(asset, nullptr);
+    ASSERT_EQ(readAll(asset, 4), stored);
+    hooks.close(asset);
+    ASSERT_EQ(hooks.open(&manager, "missing.txt", modeBuffer), nullptr);
+}
+
+TEST_F(ApkAssetsTest, RejectsInvalidArchives) {
+    std::ofstream(apkPath) << "not a zip archive";
+    ASSERT_EQ(ApkAssets::open(apkPath), nullptr);
+    ASSERT_EQ(ApkAssets::open(dir + "/missing.apk"), nullptr);
+}
@@ -0,0 +1,135 @@
+#include <gtest/gtest.h>
+#include "../src/asset_index.h"
+#include "../src/fake_assetmanager.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fcntl.h>
+#include <fstream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+struct AAssetDir;
+
+namespace {
+
+class AssetIndexTest : public ::testing::Test {
+protected:
+    std::string dir;
+    std::string root;
+    std::string indexPath;
+
+    AssetIndexTest() {
+        char tmpl[] = "/tmp/mcpelauncher-index-XXXXXX";
+        dir = mkdtemp(tmpl);
+        root = dir + "/assets/";
+        indexPath = dir + "/assets.idx";
+        mkdir(root.c_str(), 0755);
+        for(auto d : {"textures", "textures/blocks", "textures/items", "sounds"})
+            mkdir((root + d).c_str(), 0755);
+        for(auto f : {"textures/blocks/stone.png", "textures/blocks/dirt.png", "textures/blocks/Bedrock.png", "textures/items/apple.png", "manifest.json"})
+            std::ofstream(root + f) << f;
+    }
+
+    ~AssetIndexTest() {
+        system(("rm -rf '" + dir + "'").c_str());
+    }
+
+    // Gives a directory an mtime it can't have had at scan time, timestamps may be too coarse to see the change
+    void touchDir(std::string const &name, time_t sec) {
+        timespec times[2] = {{sec, 0}, {sec, 0}};
+        ASSERT_EQ(utimensat(AT_FDCWD, (root + name).c_str(), times, 0), 0);
+    }
+
+    ino_t getIndexInode() {
+        struct stat st;
+        return stat(indexPath.c_str(), &st) == 0 ? st.st_ino : 0;
+    }
+
+    static std::vector<std::string> listDir(FakeAssetManager &manager, const char *name) {
+        std::unordered_map<std::string, void *> syms;
+        FakeAssetManager::initHybrisHooks(syms);
+        auto openDir = (AAssetDir * (*)(FakeAssetManager *, const char *)) syms.at("AAssetManager_openDir");
+        auto getNextFileName = (const char *(*)(AAssetDir *))syms.at("AAssetDir_getNextFileName");
+        auto closeDir = (void (*)(AAssetDir *))syms.at("AAssetDir_close");
+        std::vector<std::string> ret;
+        auto d = openDir(&manager, name);
+        if(!d)
+            return ret;
+        while(auto entry = getNextFileName(d))
+            ret.push_back(entry);
+        closeDir(d);
+        return ret;
+    }
+};
+
+}
+
+TEST_F(AssetIndexTest, ListsSortedEntries) {
+    auto index = AssetDirIndex::load(root, "");
+    ASSERT_NE(index, nullptr);
+    ASSERT_NE(index->list(""), nullptr);
+    ASSERT_EQ(*index->list(""), (std::vector<std::string>{"manifest.json", "sounds", "textures"}));
+    ASSERT_EQ(*index->list("textures/blocks"), (std::vector<std::string>{"Bedrock.png", "dirt.png", "stone.png"}));
+    ASSERT_EQ(*index->list("textures/blocks/"), (std::vector<std::string>{"Bedrock.png", "dirt.png", "stone.png"}));
+    ASSERT_EQ(*index->list("sounds"), (std::vector<std::string>{}));
+    ASSERT_EQ(index->list("missing"), nullptr);
+    ASSERT_EQ(index->list("manifest.json"), nullptr);
+}
+
+TEST_F(AssetIndexTest, ReusesTheIndexUntilADirectoryChanges) {
+    ASSERT_NE(AssetDirIndex::load(root, indexPath), nullptr);
+    ino_t written = getIndexInode();
+    ASSERT_NE(written, 0u);
+    // The index is replaced by a rename, an unchanged inode means it was read back
+    auto index = AssetDirIndex::load(root, indexPath);
+    ASSERT_NE(index, nullptr);
+    ASSERT_EQ(getIndexInode(), written);
+    ASSERT_EQ(*index->list("textures/items"), (std::vector<std::string>{"apple.png"}));
+
+    std::ofstream(root + "textures/items/bread.png") << "bread";
+    touchDir("textures/items", 1000000000);
+    index = AssetDirIndex::load(root, indexPath);
+    ASSERT_NE(index, nullptr);
+    ASSERT_NE(getIndexInode(), written);
+    ASSERT_EQ(*index->list("textures/items"), (std::vector<std::string>{"apple.png", "bread.png"}));
+}
+
+TEST_F(AssetIndexTest, RejectsAnIndexOfAnotherRoot) {
+    ASSERT_NE(AssetDirIndex::load(root, indexPath), nullptr);
+    std::string otherRoot = dir + "/other/";
+    mkdir(otherRoot.c_str(), 0755);
+    std::ofstream(otherRoot + "only.txt") << "only";
+    auto index = AssetDirIndex::load(otherRoot, indexPath);
+    ASSERT_NE(index, nullptr);
+    ASSERT_EQ(*index->list(""), (std::vector<std::string>{"only.txt"}));
+}
+
+TEST_F(AssetIndexTest, StopsAtSymlinkLoops) {
+    ASSERT_EQ(symlink("..", (root + "textures/blocks/up").c_str()), 0);
+    auto index = AssetDirIndex::load(root, "");
+    ASSERT_NE(index, nullptr);
+    ASSERT_EQ(*index->list("textures/blocks"), (std::vector<std::string>{"Bedrock.png", "dirt.png", "stone.png", "up"}));
+    // The link leads back to textures, which is already indexed
+    ASSERT_EQ(index->list("textures/blocks/up"), nullptr);
+    ASSERT_EQ(index->list("textures/blocks/up/blocks"), nullptr);
+}
+
+TEST_F(AssetIndexTest, FallsBackToTheHostForMissingEntries) {
+    ASSERT_EQ(symlink("..", (root + "textures/blocks/up").c_str()), 0);
+    FakeAssetManager manager(root, "", indexPath);
+    ASSERT_NE(manager.dirIndex, nullptr);
+    // Created after the index was loaded
+    mkdir((root + "late").c_str(), 0755);
+    std::ofstream(root + "late/new.txt") << "new";
+    ASSERT_EQ(manager.dirIndex->list("late"), nullptr);
+    ASSERT_EQ(listDir(manager, "late"), (std::vector<std::string>{"new.txt"}));
+    // Paths that aren't normalized and directories left out of the index are listed by the host
+    auto items = listDir(manager, "textures/./items");
+    ASSERT_EQ(items, (std::vector<std::string>{"apple.png"}));
+    auto linked = listDir(manager, "textures/blocks/up");
+    std::sort(linked.begin(), linked.end());
+    ASSERT_EQ(linked, (std::vector<std::string>{"blocks", "items"}));
+    ASSERT_EQ(listDir(manager, "missing"), (std::vector<std::string>{}));
+    ASSERT_EQ(listDir(manager, "textures/blocks"), (std::vector<std::string>{"Bedrock.png", "dirt.png", "stone.png", "up"}));
+}
@@ -0,0 +1,124 @@
+#include <gtest/gtest.h>
+#include "../src/asset_prefetcher.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <unistd.h>
+
+using namespace std::chrono;
+
+namespace {
+
+class AssetPrefetcherTest : public ::testing::Test {
+protected:
+    std::string tracePath;
+
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::vector<std::string> prefetched;
+
+    AssetPrefetcherTest() {
+        char tmpl[] = "/tmp/mcpelauncher-asset-trace-XXXXXX";
+        int fd = mkstemp(tmpl);
+        close(fd);
+        tracePath = tmpl;
+    }
+
+    ~AssetPrefetcherTest() {
+        remove(tracePath.c_str());
+    }
+
+    void writeTrace(std::vector<std::string> const &names) {
+        std::ofstream s(tracePath, std::ios::trunc);
+        for(auto &&name : names)
+            s << name << '\n';
+    }
+
+    std::vector<std::string> readTrace() {
+        std::ifstream s(tracePath);
+        std::vector<std::string> ret;
+        std::string line;
+        while(std::getline(s, line))
+            ret.push_back(line);
+        return ret;
+    }
+
+    std::function<void(std::string const &)> prefetchCallback() {
+        return [this](std::string const &name) {
+            std::lock_guard<std::mutex> lock(mutex);
+            prefetched.push_back(name);
+            condition.notify_all();
+        };
+    }
+
+    void waitForPrefetch(size_t count) {
+        std::unique_lock<std::mutex> lock(mutex);
+        ASSERT_TRUE(condition.wait_for(lock, seconds(5), [&] { return prefetched.size() >= count; }));
+    }
+};
+
+}
+
+TEST_F(AssetPrefetcherTest, PrefetchesInTraceOrder) {
+    writeTrace({"c.png", "a.json", "b.png", "a.json"});
+    AssetPrefetcher prefetcher(tracePath, prefetchCallback(), 1);
+    waitForPrefetch(3);
+    std::vector<std::string> expected = {"c.png", "a.json", "b.png"};
+    ASSERT_EQ(prefetched, expected);
+}
+
+TEST_F(AssetPrefetcherTest, CountsTheFirstOpenOnly) {
+    writeTrace({"a", "b"});
+    AssetPrefetcher prefetcher(tracePath, prefetchCallback(), 1, hours(1));
+    waitForPrefetch(2);
+    prefetcher.onOpen("a");
+    prefetcher.onOpen("a");
+    prefetcher.onOpen("x");
+    prefetcher.onOpen("x");
+    prefetcher.onOpen("b");
+    auto stats = prefetcher.getStats();
+    ASSERT_EQ(stats.hits, 2);
+    ASSERT_EQ(stats.late, 0);
+    ASSERT_EQ(stats.misses, 1);
+}
+
+TEST_F(AssetPrefetcherTest, LateOpensStayLate) {
+    writeTrace({"a", "b"});
+    // Without worker threads nothing is prefetched in time
+    AssetPrefetcher prefetcher(tracePath, prefetchCallback(), 0, hours(1));
+    prefetcher.onOpen("a");
+    prefetcher.onOpen("a");
+    prefetcher.onOpen("b");
+    auto stats = prefetcher.getStats();
+    ASSERT_EQ(stats.hits, 0);
+    ASSERT_EQ(stats.late, 2);
+    ASSERT_EQ(stats.misses, 0);
+}
+
+TEST_F(AssetPrefetcherTest, RecordsTheOpenOrder) {
+    writeTrace({});
+    {
+        AssetPrefetcher prefetcher(tracePath, prefetchCallback(), 1, milliseconds(100));
+        prefetcher.onOpen("b");
+        prefetcher.onOpen("a");
+        prefetcher.onOpen("b");
+        std::this_thread::sleep_for(milliseconds(300));
+        // Opened after the record duration passed
+        prefetcher.onOpen("c");
+    }
+    std::vector<std::string> expected = {"b", "a"};
+    ASSERT_EQ(readTrace(), expected);
+}
+
+TEST_F(AssetPrefetcherTest, EarlyExitKeepsTheOldTrace) {
+    writeTrace({"a", "b", "c", "d"});
+    {
+        AssetPrefetcher prefetcher(tracePath, prefetchCallback(), 0, hours(1));
+        prefetcher.onOpen("c");
+        prefetcher.onOpen("x");
+        prefetcher.onOpen("a");
+    }
+    std::vector<std::string> expected = {"c", "x", "a", "b", "d"};
+    ASSERT_EQ(readTrace(), expected);
+}
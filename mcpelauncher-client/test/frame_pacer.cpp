@@ -0,0 +1,55 @@
+#include <gtest/gtest.h>
+#include "../src/frame_pacer.h"
+
+#include <thread>
+
+using namespace std::chrono;
+
+TEST(FramePacerTest, FramePeriod) {
+    FramePacer pacer;
+    ASSERT_EQ(pacer.getFramePeriod(), FramePacer::Clock::duration::zero());
+    pacer.setTargetFps(100);
+    ASSERT_EQ(duration_cast<milliseconds>(pacer.getFramePeriod()).count(), 10);
+    pacer.setUnfocusedFps(20);
+    ASSERT_EQ(duration_cast<milliseconds>(pacer.getFramePeriod()).count(), 10);
+    pacer.setFocused(false);
+    ASSERT_EQ(duration_cast<milliseconds>(pacer.getFramePeriod()).count(), 50);
+}
+
+TEST(FramePacerTest, UnlimitedDoesNotWait) {
+    FramePacer pacer;
+    int swaps = 0;
+    for(int i = 0; i < 10; i++)
+        pacer.present([&]() { swaps++; });
+    ASSERT_EQ(swaps, 10);
+    ASSERT_LT(pacer.getLastFrameTiming().waitTime, milliseconds(5));
+}
+
+TEST(FramePacerTest, LimitsMockSwap) {
+    FramePacer pacer;
+    pacer.setTargetFps(100);
+    auto start = FramePacer::Clock::now();
+    for(int i = 0; i < 11; i++)
+        pacer.present([]() { std::this_thread::sleep_for(milliseconds(1)); });
+    auto elapsed = FramePacer::Clock::now() - start;
+    // The first present starts the schedule, every later one lands on the next 10 ms slot
+    ASSERT_GE(elapsed, milliseconds(100));
+    ASSERT_LT(elapsed, milliseconds(300));
+    auto &timing = pacer.getLastFrameTiming();
+    ASSERT_GE(timing.swapTime, milliseconds(1));
+    ASSERT_GT(timing.waitTime, milliseconds(0));
+    ASSERT_LT(timing.cpuTime, milliseconds(5));
+}
+
+TEST(FramePacerTest, NoBurstAfterLongFrame) {
+    FramePacer pacer;
+    pacer.setTargetFps(100);
+    pacer.present([]() {});
+    std::this_thread::sleep_for(milliseconds(50));
+    pacer.present([]() {});
+    ASSERT_GE(pacer.getLastFrameTiming().cpuTime, milliseconds(50));
+    // The missed deadline is dropped instead of being caught up, so the next frame waits a full period again
+    auto start = FramePacer::Clock::now();
+    pacer.present([]() {});
+    ASSERT_GE(FramePacer::Clock::now() - start, milliseconds(9));
+}
@@ -0,0 +1,126 @@
+#include <gtest/gtest.h>
+#include "../src/frame_stats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace {
+
+// Ratio between the bounds of one histogram bucket, 0.05ms to 5s over 512 buckets
+const float bucketRatio = std::pow(5000.f / 0.05f, 1.f / 512);
+
+// Same rank definition as the histogram, the smallest value with at least p of the frames at or below it
+float getExactPercentile(std::vector<float> sorted, double p) {
+    std::sort(sorted.begin(), sorted.end());
+    auto rank = (size_t)std::ceil(p * sorted.size());
+    return sorted[std::max<size_t>(rank, 1) - 1];
+}
+
+void expectWithinABucket(float value, float exact) {
+    EXPECT_LE(value, exact * bucketRatio) << "exact " << exact;
+    EXPECT_GE(value, exact / bucketRatio) << "exact " << exact;
+}
+
+}
+
+TEST(FrameStatsTest, PercentilesWithinABucket) {
+    FrameStats stats;
+    std::mt19937 rng(42);
+    std::lognormal_distribution<float> frameTime(std::log(16.f), 0.35f);
+    std::vector<float> times;
+    for(int i = 0; i < 20000; i++) {
+        float ms = frameTime(rng);
+        times.push_back(ms);
+        stats.addFrameTime(ms);
+    }
+    auto s = stats.getSummary();
+    ASSERT_EQ(s.frames, times.size());
+    expectWithinABucket(s.p50Ms, getExactPercentile(times, 0.5));
+    expectWithinABucket(s.p95Ms, getExactPercentile(times, 0.95));
+    expectWithinABucket(s.p99Ms, getExactPercentile(times, 0.99));
+    expectWithinABucket(s.p999Ms, getExactPercentile(times, 0.999));
+    ASSERT_EQ(s.maxMs, *std::max_element(times.begin(), times.end()));
+    double total = 0;
+    for(float ms : times)
+        total += ms;
+    ASSERT_NEAR(s.averageMs, total / times.size(), 1e-3);
+    // Percentiles never exceed the slowest frame even if its bucket center does
+    ASSERT_LE(s.p999Ms, s.maxMs);
+}
+
+TEST(FrameStatsTest, OnePercentAndPointOnePercentLows) {
+    FrameStats stats;
+    // The 990th slowest of 1000 frames takes 40ms, the 999th 100ms
+    for(int i = 0; i < 985; i++)
+        stats.addFrameTime(10.f);
+    for(int i = 0; i < 13; i++)
+        stats.addFrameTime(40.f);
+    for(int i = 0; i < 2; i++)
+        stats.addFrameTime(100.f);
+    auto s = stats.getSummary();
+    expectWithinABucket(s.p50Ms, 10.f);
+    expectWithinABucket(s.p99Ms, 40.f);
+    expectWithinABucket(s.p999Ms, 100.f);
+    expectWithinABucket(s.low1Fps, 25.f);
+    expectWithinABucket(s.low01Fps, 10.f);
+    ASSERT_EQ(s.low1Fps, 1000.f / s.p99Ms);
+    ASSERT_EQ(s.low01Fps, 1000.f / s.p999Ms);
+}
+
+TEST(FrameStatsTest, CountsHitches) {
+    FrameStats stats;
+    // The first frame has nothing to compare with
+    stats.addFrameTime(200.f);
+    ASSERT_EQ(stats.getSummary().hitches, 0u);
+    stats.reset();
+    for(int i = 0; i < 100; i++)
+        stats.addFrameTime(16.f);
+    // Slower than average, but not twice as slow
+    stats.addFrameTime(30.f);
+    ASSERT_EQ(stats.getSummary().hitches, 0u);
+    for(int i = 0; i < 100; i++)
+        stats.addFrameTime(16.f);
+    stats.addFrameTime(40.f);
+    ASSERT_EQ(stats.getSummary().hitches, 1u);
+    // Back to back spikes raise the recent average, the second one counts only while it's still twice as slow
+    stats.addFrameTime(40.f);
+    ASSERT_EQ(stats.getSummary().hitches, 2u);
+    for(int i = 0; i < 100; i++)
+        stats.addFrameTime(16.f);
+    for(int i = 0; i < 10; i++)
+        stats.addFrameTime(100.f);
+    auto hitches = stats.getSummary().hitches;
+    ASSERT_GT(hitches, 2u);
+    ASSERT_LT(hitches, 12u);
+    stats.reset();
+    ASSERT_EQ(stats.getSummary().hitches, 0u);
+    ASSERT_EQ(stats.getSummary().frames, 0u);
+}
+
+TEST(FrameStatsTest, HistoryWrapsAround) {
+    FrameStats stats;
+    ASSERT_EQ(stats.getHistoryCount(), 0u);
+    for(size_t i = 0; i < 10; i++)
+        stats.addFrameTime((float)i);
+    ASSERT_EQ(stats.getHistoryCount(), 10u);
+    ASSERT_EQ(stats.getHistoryOffset(), 0u);
+    ASSERT_EQ(stats.getHistory()[9], 9.f);
+
+    constexpr size_t extra = 37;
+    for(size_t i = 10; i < FrameStats::historySize + extra; i++)
+        stats.addFrameTime((float)i);
+    ASSERT_EQ(stats.getHistoryCount(), FrameStats::historySize);
+    ASSERT_EQ(stats.getHistoryOffset(), extra);
+    // Oldest first from the offset, the frames before it were overwritten
+    for(size_t i = 0; i < FrameStats::historySize; i++)
+        ASSERT_EQ(stats.getHistory()[(stats.getHistoryOffset() + i) % FrameStats::historySize], (float)(extra + i));
+    // The summary still covers every frame
+    auto s = stats.getSummary();
+    ASSERT_EQ(s.frames, FrameStats::historySize + extra);
+    ASSERT_EQ(s.maxMs, (float)(FrameStats::historySize + extra - 1));
+    stats.reset();
+    ASSERT_EQ(stats.getHistoryCount(), 0u);
+    ASSERT_EQ(stats.getHistoryOffset(), 0u);
+}
@@ -0,0 +1,218 @@
+#include <gtest/gtest.h>
+#include "../src/gl_state_cache.h"
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Records the calls that reach the driver
+std::vector<std::string> calls;
+
+void record(std::string call) {
+    calls.push_back(std::move(call));
+}
+
+void mockUseProgram(unsigned int program) {
+    record("UseProgram " + std::to_string(program));
+}
+
+void mockBindBuffer(unsigned int target, unsigned int buffer) {
+    record("BindBuffer " + std::to_string(target) + " " + std::to_string(buffer));
+}
+
+void mockDeleteBuffers(int n, const unsigned int *buffers) {
+    record("DeleteBuffers");
+}
+
+void mockBindVertexArray(unsigned int array) {
+    record("BindVertexArray " + std::to_string(array));
+}
+
+void mockDeleteVertexArrays(int n, const unsigned int *arrays) {
+    record("DeleteVertexArrays");
+}
+
+void mockBindVertexArrayOES(unsigned int array) {
+    record("BindVertexArrayOES " + std::to_string(array));
+}
+
+void mockDeleteVertexArraysOES(int n, const unsigned int *arrays) {
+    record("DeleteVertexArraysOES");
+}
+
+void mockBindVertexArrayAPPLE(unsigned int array) {
+    record("BindVertexArrayAPPLE " + std::to_string(array));
+}
+
+void mockActiveTexture(unsigned int unit) {
+    record("ActiveTexture " + std::to_string(unit));
+}
+
+void mockBindTexture(unsigned int target, unsigned int texture) {
+    record("BindTexture " + std::to_string(target) + " " + std::to_string(texture));
+}
+
+void mockEnable(unsigned int cap) {
+    record("Enable " + std::to_string(cap));
+}
+
+void mockDisable(unsigned int cap) {
+    record("Disable " + std::to_string(cap));
+}
+
+void mockViewport(int x, int y, int width, int height) {
+    record("Viewport");
+}
+
+void *resolve(const char *name) {
+    static const std::unordered_map<std::string, void *> functions = {
+        {"glUseProgram", (void *)mockUseProgram},
+        {"glBindBuffer", (void *)mockBindBuffer},
+        {"glDeleteBuffers", (void *)mockDeleteBuffers},
+        {"glBindVertexArray", (void *)mockBindVertexArray},
+        {"glDeleteVertexArrays", (void *)mockDeleteVertexArrays},
+        {"glBindVertexArrayOES", (void *)mockBindVertexArrayOES},
+        {"glDeleteVertexArraysOES", (void *)mockDeleteVertexArraysOES},
+        {"glBindVertexArrayAPPLE", (void *)mockBindVertexArrayAPPLE},
+        {"glActiveTexture", (void *)mockActiveTexture},
+        {"glBindTexture", (void *)mockBindTexture},
+        {"glEnable", (void *)mockEnable},
+        {"glDisable", (void *)mockDisable},
+        {"glViewport", (void *)mockViewport},
+    };
+    auto it = functions.find(name);
+    return it != functions.end() ? it->second : nullptr;
+}
+
+const unsigned int arrayBuffer = 0x8892, elementArrayBuffer = 0x8893;
+
+class GLStateCacheTest : public ::testing::Test {
+protected:
+    std::unordered_map<std::string, void *> overrides;
+
+    GLStateCacheTest() {
+        setenv("MCPELAUNCHER_GL_STATE_CACHE", "1", 1);
+        GLStateCache::installGL(overrides, resolve);
+        unsetenv("MCPELAUNCHER_GL_STATE_CACHE");
+        calls.clear();
+    }
+
+    template<typename T>
+    T get(const char *name) {
+        auto it = overrides.find(name);
+        EXPECT_NE(it, overrides.end()) << name;
+        return it != overrides.end() ? (T)it->second : nullptr;
+    }
+};
+
+}
+
+TEST_F(GLStateCacheTest, UnsupportedFunctionsStayUnhooked) {
+    ASSERT_EQ(overrides.count("glBindVertexArrayOES"), 1);
+    ASSERT_EQ(overrides.count("glDeleteVertexArraysAPPLE"), 0);
+    ASSERT_EQ(overrides.count("glBlendFunc"), 0);
+}
+
+TEST_F(GLStateCacheTest, DropsRedundantCalls) {
+    auto useProgram = get<void (*)(unsigned int)>("glUseProgram");
+    auto bindBuffer = get<void (*)(unsigned int, unsigned int)>("glBindBuffer");
+    auto enable = get<void (*)(unsigned int)>("glEnable");
+    auto disable = get<void (*)(unsigned int)>("glDisable");
+    uint64_t elided = GLStateCache::getElidedCount();
+    useProgram(3);
+    useProgram(3);
+    bindBuffer(arrayBuffer, 7);
+    bindBuffer(arrayBuffer, 7);
+    enable(0x0BE2);
+    enable(0x0BE2);
+    disable(0x0BE2);
+    useProgram(4);
+    std::vector<std::string> expected = {"UseProgram 3", "BindBuffer 34962 7", "Enable 3042", "Disable 3042", "UseProgram 4"};
+    ASSERT_EQ(calls, expected);
+    ASSERT_EQ(GLStateCache::getElidedCount() - elided, 3);
+}
+
+TEST_F(GLStateCacheTest, UnshadowedCapsAreForwarded) {
+    auto enable = get<void (*)(unsigned int)>("glEnable");
+    enable(0x0BD0); // GL_DITHER
+    enable(0x0BD0);
+    ASSERT_EQ(calls.size(), 2);
+}
+
+TEST_F(GLStateCacheTest, TextureBindingsPerUnit) {
+    auto activeTexture = get<void (*)(unsigned int)>("glActiveTexture");
+    auto bindTexture = get<void (*)(unsigned int, unsigned int)>("glBindTexture");
+    activeTexture(0x84C0);
+    bindTexture(0x0DE1, 5);
+    activeTexture(0x84C1);
+    bindTexture(0x0DE1, 5);
+    activeTexture(0x84C0);
+    bindTexture(0x0DE1, 5);
+    std::vector<std::string> expected = {"ActiveTexture 33984", "BindTexture 3553 5", "ActiveTexture 33985", "BindTexture 3553 5", "ActiveTexture 33984"};
+    ASSERT_EQ(calls, expected);
+}
+
+TEST_F(GLStateCacheTest, DeletedBuffersAreUnbound) {
+    auto bindBuffer = get<void (*)(unsigned int, unsigned int)>("glBindBuffer");
+    auto deleteBuffers = get<void (*)(int, const unsigned int *)>("glDeleteBuffers");
+    bindBuffer(arrayBuffer, 7);
+    unsigned int buffer = 7;
+    deleteBuffers(1, &buffer);
+    // The name can be reused by glGenBuffers right away
+    bindBuffer(arrayBuffer, 7);
+    ASSERT_EQ(calls.size(), 3);
+    ASSERT_EQ(calls.back(), "BindBuffer 34962 7");
+}
+
+TEST_F(GLStateCacheTest, VertexArraySwitchForgetsElementArrayBuffer) {
+    for(auto name : {"glBindVertexArray", "glBindVertexArrayOES", "glBindVertexArrayAPPLE"}) {
+        auto bindVertexArray = get<void (*)(unsigned int)>(name);
+        auto bindBuffer = get<void (*)(unsigned int, unsigned int)>("glBindBuffer");
+        calls.clear();
+        bindVertexArray(1);
+        bindBuffer(elementArrayBuffer, 9);
+        bindVertexArray(2);
+        bindBuffer(elementArrayBuffer, 9);
+        bindVertexArray(2);
+        ASSERT_EQ(calls.size(), 4) << name;
+        ASSERT_EQ(calls[3], "BindBuffer 34963 9") << name;
+        GLStateCache::invalidate();
+    }
+}
+
+TEST_F(GLStateCacheTest, VertexArrayEntryPointsShareTheBinding) {
+    auto bindVertexArray = get<void (*)(unsigned int)>("glBindVertexArray");
+    auto bindVertexArrayOES = get<void (*)(unsigned int)>("glBindVertexArrayOES");
+    bindVertexArray(1);
+    bindVertexArrayOES(2);
+    bindVertexArray(1);
+    std::vector<std::string> expected = {"BindVertexArray 1", "BindVertexArrayOES 2", "BindVertexArray 1"};
+    ASSERT_EQ(calls, expected);
+}
+
+TEST_F(GLStateCacheTest, DeletingTheBoundVertexArray) {
+    auto bindVertexArrayOES = get<void (*)(unsigned int)>("glBindVertexArrayOES");
+    auto deleteVertexArraysOES = get<void (*)(int, const unsigned int *)>("glDeleteVertexArraysOES");
+    auto bindBuffer = get<void (*)(unsigned int, unsigned int)>("glBindBuffer");
+    bindVertexArrayOES(0);
+    bindVertexArrayOES(3);
+    bindBuffer(elementArrayBuffer, 9);
+    unsigned int array = 3;
+    deleteVertexArraysOES(1, &array);
+    // Deleting binds vertex array 0, whose element array buffer isn't known
+    bindVertexArrayOES(0);
+    bindBuffer(elementArrayBuffer, 9);
+    std::vector<std::string> expected = {"BindVertexArrayOES 0", "BindVertexArrayOES 3", "BindBuffer 34963 9", "DeleteVertexArraysOES", "BindBuffer 34963 9"};
+    ASSERT_EQ(calls, expected);
+}
+
+TEST_F(GLStateCacheTest, InvalidateForwardsEverything) {
+    auto viewport = get<void (*)(int, int, int, int)>("glViewport");
+    viewport(0, 0, 64, 64);
+    viewport(0, 0, 64, 64);
+    GLStateCache::invalidate();
+    viewport(0, 0, 64, 64);
+    ASSERT_EQ(calls.size(), 2);
+}
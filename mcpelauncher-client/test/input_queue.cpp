@@ -0,0 +1,222 @@
+#include <gtest/gtest.h>
+#include "../src/fake_inputqueue.h"
+
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+namespace {
+
+// Key events carry their sequence number as key code, motion events as x
+int32_t getSequence(FakeInputEvent *event) {
+    if(event->type == AINPUT_EVENT_TYPE_KEY)
+        return ((FakeKeyEvent *)event)->keyCode;
+    return (int32_t)((FakeMotionEvent *)event)->getAxisValue(AMOTION_EVENT_AXIS_X, 0);
+}
+
+FakeMotionEvent makeMove(int32_t source, float x, float y, int64_t eventTime) {
+    FakeMotionEvent event(source, source == AINPUT_SOURCE_MOUSE ? AMOTION_EVENT_ACTION_HOVER_MOVE : AMOTION_EVENT_ACTION_MOVE, 0, x, y);
+    event.eventTime = eventTime;
+    return event;
+}
+
+// The AMotionEvent_* entry points the game calls
+struct MotionHooks {
+    size_t (*getHistorySize)(const AInputEvent *);
+    int64_t (*getHistoricalEventTime)(const AInputEvent *, size_t);
+    float (*getHistoricalX)(const AInputEvent *, size_t, size_t);
+    float (*getHistoricalY)(const AInputEvent *, size_t, size_t);
+    float (*getHistoricalAxisValue)(const AInputEvent *, int32_t, size_t, size_t);
+    float (*getX)(const AInputEvent *, size_t);
+    int64_t (*getEventTime)(const AInputEvent *);
+
+    MotionHooks() {
+        std::unordered_map<std::string, void *> syms;
+        FakeInputQueue::initHybrisHooks(syms);
+        getHistorySize = (decltype(getHistorySize))syms.at("AMotionEvent_getHistorySize");
+        getHistoricalEventTime = (decltype(getHistoricalEventTime))syms.at("AMotionEvent_getHistoricalEventTime");
+        getHistoricalX = (decltype(getHistoricalX))syms.at("AMotionEvent_getHistoricalX");
+        getHistoricalY = (decltype(getHistoricalY))syms.at("AMotionEvent_getHistoricalY");
+        getHistoricalAxisValue = (decltype(getHistoricalAxisValue))syms.at("AMotionEvent_getHistoricalAxisValue");
+        getX = (decltype(getX))syms.at("AMotionEvent_getX");
+        getEventTime = (decltype(getEventTime))syms.at("AMotionEvent_getEventTime");
+    }
+};
+
+}
+
+TEST(FakeInputQueueTest, KeepsOrderAndOwnership) {
+    FakeInputQueue queue;
+    FakeInputEvent *event;
+    ASSERT_EQ(queue.getEvent(&event), -1);
+    queue.addEvent(FakeKeyEvent(AINPUT_SOURCE_KEYBOARD, 0, AKEY_EVENT_ACTION_DOWN, 1));
+    queue.addEvent(FakeMotionEvent(AINPUT_SOURCE_TOUCHSCREEN, AMOTION_EVENT_ACTION_DOWN, 0, 2.f, 0.f));
+    ASSERT_EQ(queue.getSize(), 2u);
+    ASSERT_EQ(queue.getEvent(&event), 0);
+    // The front slot stays handed out until it is finished
+    FakeInputEvent *again;
+    ASSERT_EQ(queue.getEvent(&again), 0);
+    ASSERT_EQ(event, again);
+    ASSERT_EQ(getSequence(event), 1);
+    queue.finishEvent(event);
+    ASSERT_EQ(queue.getEvent(&event), 0);
+    ASSERT_EQ(getSequence(event), 2);
+    FakeInputEvent *wrong = event + 1;
+    ASSERT_THROW(queue.finishEvent(wrong), std::runtime_error);
+    queue.finishEvent(event);
+    ASSERT_FALSE(queue.hasEvents());
+}
+
+TEST(FakeInputQueueTest, KeyEventsUseTheReserve) {
+    FakeInputQueue queue;
+    for(size_t i = 0; i < FakeInputQueue::capacity; i++)
+        queue.addEvent(FakeMotionEvent(AINPUT_SOURCE_TOUCHSCREEN, AMOTION_EVENT_ACTION_DOWN, 0, (float)i, 0.f));
+    ASSERT_EQ(queue.getSize(), FakeInputQueue::capacity - FakeInputQueue::keyReserve);
+    for(size_t i = 0; i < FakeInputQueue::keyReserve + 1; i++)
+        queue.addEvent(FakeKeyEvent(AINPUT_SOURCE_KEYBOARD, 0, AKEY_EVENT_ACTION_UP, (int32_t)i));
+    ASSERT_EQ(queue.getSize(), FakeInputQueue::capacity);
+    ASSERT_EQ(queue.getOverflowCount(), FakeInputQueue::keyReserve + 1);
+}
+
+TEST(FakeInputQueueTest, ProducerConsumerStress) {
+    constexpr int32_t count = 200000;
+    FakeInputQueue queue;
+    std::thread producer([&]() {
+        for(int32_t i = 0; i < count; i++) {
+            if(i % 3 == 0)
+                queue.addEvent(FakeKeyEvent(AINPUT_SOURCE_KEYBOARD, 0, AKEY_EVENT_ACTION_DOWN, i));
+            else
+                queue.addEvent(FakeMotionEvent(AINPUT_SOURCE_TOUCHSCREEN, AMOTION_EVENT_ACTION_DOWN, 0, (float)i, 0.f));
+            if(i % 1024 == 0)
+                std::this_thread::yield();
+        }
+    });
+    int32_t received = 0, last = -1;
+    bool ordered = true;
+    auto drain = [&]() {
+        FakeInputEvent *event;
+        while(queue.getEvent(&event) == 0) {
+            int32_t sequence = getSequence(event);
+            ordered = ordered && sequence > last;
+            last = sequence;
+            received++;
+            queue.finishEvent(event);
+        }
+    };
+    while(last < count - 1 && received + (int32_t)queue.getOverflowCount() < count)
+        drain();
+    producer.join();
+    drain();
+    ASSERT_TRUE(ordered);
+    ASSERT_EQ(received + (int32_t)queue.getOverflowCount(), count);
+    ASSERT_EQ(queue.getCoalescedCount(), 0u);
+}
+
+TEST(FakeInputQueueTest, SumsRelativeMoves) {
+    FakeInputQueue queue;
+    for(int i = 0; i < 100; i++)
+        queue.addEvent(FakeMotionEvent(AINPUT_SOURCE_MOUSE_RELATIVE, AMOTION_EVENT_ACTION_HOVER_MOVE, 0, 1.f, -2.f, 0, 0));
+    ASSERT_EQ(queue.getSize(), 1u);
+    FakeInputEvent *event;
+    ASSERT_EQ(queue.getEvent(&event), 0);
+    // A claimed event is never changed, the next move starts a new one
+    queue.addEvent(FakeMotionEvent(AINPUT_SOURCE_MOUSE_RELATIVE, AMOTION_EVENT_ACTION_HOVER_MOVE, 0, 1.f, 1.f, 0, 0));
+    auto motionEvent = (FakeMotionEvent *)event;
+    ASSERT_EQ(motionEvent->getAxisValue(AMOTION_EVENT_AXIS_X, 0), 100.f);
+    ASSERT_EQ(motionEvent->getAxisValue(AMOTION_EVENT_AXIS_Y, 0), -200.f);
+    ASSERT_EQ(motionEvent->historySize, 0u);
+    queue.finishEvent(event);
+    ASSERT_EQ(queue.getSize(), 1u);
+    ASSERT_EQ(queue.getCoalescedCount(), 99u);
+}
+
+TEST(FakeInputQueueTest, BatchesAbsoluteMovesIntoHistory) {
+    MotionHooks hooks;
+    FakeInputQueue queue;
+    queue.addEvent(FakeMotionEvent(AINPUT_SOURCE_TOUCHSCREEN, AMOTION_EVENT_ACTION_DOWN, 0, 0.f, 0.f));
+    for(int i = 1; i <= 4; i++)
+        queue.addEvent(makeMove(AINPUT_SOURCE_TOUCHSCREEN, (float)i, (float)-i, i * 1000));
+    // The down isn't a move, the moves after it share one slot even though the game isn't behind
+    ASSERT_EQ(queue.getSize(), 2u);
+    ASSERT_EQ(queue.getCoalescedCount(), 3u);
+    FakeInputEvent *event;
+    ASSERT_EQ(queue.getEvent(&event), 0);
+    queue.finishEvent(event);
+    ASSERT_EQ(queue.getEvent(&event), 0);
+    auto aevent = (const AInputEvent *)(void *)event;
+    ASSERT_EQ(hooks.getHistorySize(aevent), 3u);
+    for(size_t i = 0; i < 3; i++) {
+        ASSERT_EQ(hooks.getHistoricalX(aevent, 0, i), (float)(i + 1));
+        ASSERT_EQ(hooks.getHistoricalY(aevent, 0, i), -(float)(i + 1));
+        ASSERT_EQ(hooks.getHistoricalAxisValue(aevent, AMOTION_EVENT_AXIS_X, 0, i), (float)(i + 1));
+        ASSERT_EQ(hooks.getHistoricalEventTime(aevent, i), (int64_t)(i + 1) * 1000);
+    }
+    ASSERT_EQ(hooks.getX(aevent, 0), 4.f);
+    ASSERT_EQ(hooks.getEventTime(aevent), 4000);
+    queue.finishEvent(event);
+}
+
+TEST(FakeInputQueueTest, HistoryKeepsTheNewestSamples) {
+    MotionHooks hooks;
+    FakeInputQueue queue;
+    constexpr int count = (int)FakeMotionEvent::maxHistory + 5;
+    for(int i = 0; i < count; i++)
+        queue.addEvent(makeMove(AINPUT_SOURCE_MOUSE, (float)i, 0.f, i + 1));
+    ASSERT_EQ(queue.getSize(), 1u);
+    FakeInputEvent *event;
+    ASSERT_EQ(queue.getEvent(&event), 0);
+    auto aevent = (const AInputEvent *)(void *)event;
+    ASSERT_EQ(hooks.getHistorySize(aevent), FakeMotionEvent::maxHistory);
+    // The oldest samples are dropped, the last one is the move before the current position
+    size_t first = count - 1 - FakeMotionEvent::maxHistory;
+    for(size_t i = 0; i < FakeMotionEvent::maxHistory; i++) {
+        ASSERT_EQ(hooks.getHistoricalX(aevent, 0, i), (float)(first + i));
+        ASSERT_EQ(hooks.getHistoricalEventTime(aevent, i), (int64_t)(first + i + 1));
+    }
+    ASSERT_EQ(hooks.getX(aevent, 0), (float)(count - 1));
+    // Out of range samples and axes without history report the current value
+    ASSERT_EQ(hooks.getHistoricalX(aevent, 0, FakeMotionEvent::maxHistory), (float)(count - 1));
+    ASSERT_EQ(hooks.getHistoricalEventTime(aevent, FakeMotionEvent::maxHistory), (int64_t)count);
+    ASSERT_EQ(hooks.getHistoricalAxisValue(aevent, AMOTION_EVENT_AXIS_VSCROLL, 0, 0), 0.f);
+    queue.finishEvent(event);
+}
+
+TEST(FakeInputQueueTest, BatchesEveryPointer) {
+    MotionHooks hooks;
+    FakeInputQueue queue;
+    auto makeTwoPointerMove = [](float offset, int32_t secondId) {
+        FakeMotionEvent event(AINPUT_SOURCE_TOUCHSCREEN, 0, AMOTION_EVENT_ACTION_MOVE);
+        event.pointerCount = 2;
+        for(int32_t i = 0; i < 2; i++) {
+            event.pointers[i].id = i == 0 ? 0 : secondId;
+            event.pointers[i].axisValues[AMOTION_EVENT_AXIS_X] = offset + (float)(i * 100);
+            event.pointers[i].axisValues[AMOTION_EVENT_AXIS_Y] = offset + (float)(i * 200);
+        }
+        return event;
+    };
+    queue.addEvent(makeTwoPointerMove(1.f, 1));
+    queue.addEvent(makeTwoPointerMove(2.f, 1));
+    // A different set of pointers isn't batched into the pending move
+    queue.addEvent(makeTwoPointerMove(3.f, 2));
+    ASSERT_EQ(queue.getSize(), 2u);
+    FakeInputEvent *event;
+    ASSERT_EQ(queue.getEvent(&event), 0);
+    auto aevent = (const AInputEvent *)(void *)event;
+    ASSERT_EQ(hooks.getHistorySize(aevent), 1u);
+    ASSERT_EQ(hooks.getHistoricalX(aevent, 0, 0), 1.f);
+    ASSERT_EQ(hooks.getHistoricalX(aevent, 1, 0), 101.f);
+    ASSERT_EQ(hooks.getHistoricalY(aevent, 1, 0), 201.f);
+    ASSERT_EQ(hooks.getX(aevent, 1), 102.f);
+    // The claimed event doesn't grow, the next move starts a new one
+    queue.addEvent(makeTwoPointerMove(4.f, 2));
+    ASSERT_EQ(hooks.getHistorySize(aevent), 1u);
+    queue.finishEvent(event);
+    ASSERT_EQ(queue.getEvent(&event), 0);
+    aevent = (const AInputEvent *)(void *)event;
+    ASSERT_EQ(hooks.getHistorySize(aevent), 1u);
+    ASSERT_EQ(hooks.getHistoricalX(aevent, 1, 0), 103.f);
+    ASSERT_EQ(hooks.getX(aevent, 1), 104.f);
+    queue.finishEvent(event);
+    ASSERT_FALSE(queue.hasEvents());
+}
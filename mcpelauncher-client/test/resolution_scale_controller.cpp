@@ -0,0 +1,117 @@
+#include <gtest/gtest.h>
+#include "../src/resolution_scale_controller.h"
+
+namespace {
+
+const double targetMs = 1000.0 / 60;
+// Frames after an adjustment that keep the scale, and in-budget frames before the frame time driven probe
+const int settleFrames = 20;
+const int probeFrames = 180;
+
+ResolutionScaleController makeController(float minScale, float maxScale, float startScale) {
+    ResolutionScaleController controller;
+    ResolutionScaleController::Config config;
+    config.minScale = config.maxScale = startScale;
+    controller.setConfig(config);
+    config.minScale = minScale;
+    config.maxScale = maxScale;
+    controller.setConfig(config);
+    return controller;
+}
+
+// Number of updates until the scale changes, limit if it doesn't
+int countUntilChange(ResolutionScaleController &controller, double ms, bool gpu, int limit) {
+    float scale = controller.getScale();
+    for(int i = 1; i <= limit; i++) {
+        if(controller.update(ms, gpu) != scale)
+            return i;
+    }
+    return limit;
+}
+
+}
+
+TEST(ResolutionScaleControllerTest, ClampsToTheConfiguredRange) {
+    ResolutionScaleController controller;
+    ResolutionScaleController::Config config;
+    config.minScale = 0.6f;
+    config.maxScale = 0.9f;
+    controller.setConfig(config);
+    ASSERT_FLOAT_EQ(controller.getScale(), 0.9f);
+    for(int i = 0; i < 1000; i++)
+        ASSERT_GE(controller.update(200, true), 0.6f);
+    ASSERT_FLOAT_EQ(controller.getScale(), 0.6f);
+    for(int i = 0; i < 1000; i++)
+        ASSERT_LE(controller.update(1, true), 0.9f);
+    ASSERT_FLOAT_EQ(controller.getScale(), 0.9f);
+    // A narrower range moves the current scale into it, reset starts at the maximum
+    config.maxScale = 0.7f;
+    controller.setConfig(config);
+    ASSERT_FLOAT_EQ(controller.getScale(), 0.7f);
+    config.minScale = 0.8f;
+    config.maxScale = 1.0f;
+    controller.setConfig(config);
+    ASSERT_FLOAT_EQ(controller.getScale(), 0.8f);
+    controller.reset();
+    ASSERT_FLOAT_EQ(controller.getScale(), 1.0f);
+}
+
+TEST(ResolutionScaleControllerTest, LimitsEachStep) {
+    // Six times over budget would ask for a scale of 0.39, the first step only goes down by 0.1
+    auto controller = makeController(0.3f, 1.0f, 1.0f);
+    ASSERT_FLOAT_EQ(controller.update(targetMs * 6, true), 0.9f);
+    float expected = 0.9f;
+    while(expected > 0.35f) {
+        countUntilChange(controller, targetMs * 6, true, settleFrames + 1);
+        expected -= 0.1f;
+        ASSERT_NEAR(controller.getScale(), expected, 1e-4);
+    }
+    // Way below budget, steps up by 0.05
+    controller = makeController(0.3f, 1.0f, 0.5f);
+    ASSERT_FLOAT_EQ(controller.update(1, true), 0.55f);
+    countUntilChange(controller, 1, true, settleFrames + 1);
+    ASSERT_FLOAT_EQ(controller.getScale(), 0.6f);
+    // Slightly over budget moves less than a full step, rounded to a hundredth
+    controller = makeController(0.3f, 1.0f, 0.8f);
+    ASSERT_FLOAT_EQ(controller.update(targetMs * 1.1, true), 0.72f);
+}
+
+TEST(ResolutionScaleControllerTest, SettlesAfterEachAdjustment) {
+    auto controller = makeController(0.5f, 1.0f, 1.0f);
+    ASSERT_FLOAT_EQ(controller.update(targetMs * 3, true), 0.9f);
+    // Still over budget, but the scale stays until the new one had time to show its effect
+    ASSERT_EQ(countUntilChange(controller, targetMs * 3, true, 100), settleFrames + 1);
+    ASSERT_FLOAT_EQ(controller.getScale(), 0.8f);
+    // Within the hysteresis nothing changes
+    controller = makeController(0.5f, 1.0f, 0.8f);
+    ASSERT_EQ(countUntilChange(controller, targetMs * 1.04, true, 1000), 1000);
+    ASSERT_EQ(countUntilChange(controller, targetMs * 0.8, true, 1000), 1000);
+    // Single slow frames are smoothed out
+    for(int i = 0; i < 10; i++) {
+        ASSERT_EQ(controller.update(targetMs * 1.4, true), 0.8f);
+        for(int j = 0; j < 30; j++)
+            ASSERT_EQ(controller.update(targetMs * 0.9, true), 0.8f);
+    }
+}
+
+TEST(ResolutionScaleControllerTest, ProbesUpwardsWithoutGpuTime) {
+    // Capped frame times look like a full budget, only a probe finds out whether there is room
+    auto controller = makeController(0.5f, 1.0f, 0.5f);
+    ASSERT_EQ(countUntilChange(controller, targetMs, false, 1000), probeFrames);
+    ASSERT_FLOAT_EQ(controller.getScale(), 0.55f);
+    ASSERT_EQ(countUntilChange(controller, targetMs, false, 1000), settleFrames + probeFrames);
+    ASSERT_FLOAT_EQ(controller.getScale(), 0.6f);
+    // A frame time over budget after the probe steps back down and restarts the count
+    ASSERT_EQ(countUntilChange(controller, targetMs * 2, false, 1000), settleFrames + 1);
+    ASSERT_LT(controller.getScale(), 0.6f);
+    float scale = controller.getScale();
+    int frames = countUntilChange(controller, targetMs, false, 1000);
+    ASSERT_GT(frames, probeFrames);
+    ASSERT_FLOAT_EQ(controller.getScale(), scale + 0.05f);
+    // GPU time shows the headroom, the same load doesn't probe
+    controller = makeController(0.5f, 1.0f, 0.5f);
+    ASSERT_EQ(countUntilChange(controller, targetMs, true, 1000), 1000);
+    // At the maximum a probe has nowhere to go
+    controller = makeController(0.5f, 1.0f, 1.0f);
+    ASSERT_EQ(countUntilChange(controller, targetMs, false, 1000), 1000);
+}
@@ -0,0 +1,240 @@
+#include <gtest/gtest.h>
+#include "../src/texture_patch.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace {
+
+// The per-pixel fix-up glTexSubImage2D used before TexturePatch, returns true if it changed the data
+bool referenceApply(int width, int height, void *data) {
+    if(width == 1024 && height == 1024) {
+        size_t z = 0;
+        for(long long y = 0; y < height; ++y) {
+            if(*((int32_t *)data + 987 + y * width) == *((int32_t *)data + 988 + y * width) && *((int32_t *)data + 988 + y * width) == *((int32_t *)data + 989 + y * width) && *((int32_t *)data + 989 + y * width) == *((int32_t *)data + 990 + y * width) && *((int32_t *)data + 990 + y * width) != *((int32_t *)data + 991 + y * width)) {
+                z++;
+            }
+        }
+        if(z >= 64) {
+            for(long long y = 0; y < 32; ++y) {
+                memmove((char *)data + y * width * 4 + 32 * 4, (char *)data + y * width * 4 + 31 * 4, width * 4 - 32 * 4);
+            }
+            for(long long y = height - 2; y >= 31; --y) {
+                memcpy((char *)data + (y + 1) * width * 4 + 32 * 4, (char *)data + y * width * 4 + 31 * 4, width * 4 - 32 * 4);
+                memcpy((char *)data + (y + 1) * width * 4, (char *)data + y * width * 4, 32 * 4);
+            }
+            return true;
+        }
+    }
+    if(width == 2048 && height == 1024) {
+        if(*((int32_t *)data + 989 + 1024) == *((int32_t *)data + 990 + 1024) && *((int32_t *)data + 990 + 1024) != *((int32_t *)data + 991 + 1024)) {
+            for(long long y = 0; y < 32; ++y) {
+                memmove((char *)data + y * width * 4 + 32 * 4, (char *)data + y * width * 4 + 31 * 4, width * 4 - 32 * 4);
+            }
+            for(long long y = height - 2; y >= 31; --y) {
+                memcpy((char *)data + (y + 1) * width * 4 + 32 * 4, (char *)data + y * width * 4 + 31 * 4, width * 4 - 32 * 4);
+                memcpy((char *)data + (y + 1) * width * 4, (char *)data + y * width * 4, 32 * 4);
+            }
+            return true;
+        }
+    }
+    if(width == 512 && height == 512) {
+        size_t uscore = 0;
+        size_t itemscorea = 0, itemscoreb = 0, itemscorec = 0, itemscored = 0;
+        for(int y = 0; y < height; ++y) {
+            if(*((uint32_t *)data + y * width + 511 - 14) != 0) {
+                ++itemscorea;
+            }
+            if(*((uint32_t *)data + y * width + 511 - 13) != 0) {
+                ++itemscoreb;
+            }
+            if(*((uint32_t *)data + y * width + 511 - 12) != 0) {
+                ++itemscorec;
+            }
+            if(*((uint32_t *)data + y * width + 511 - 11) == 0) {
+                ++itemscored;
+            }
+        }
+        for(int x = 0; x < width; ++x) {
+            if(*((uint32_t *)data + 1 * width + x) != 0) {
+                ++uscore;
+            }
+        }
+        size_t z = 0;
+        for(long long y = 0; y < height; ++y) {
+            if(*((int32_t *)data + 511 - 20 + y * width) == *((int32_t *)data + 511 - 19 + y * width) && *((int32_t *)data + 511 - 19 + y * width) == *((int32_t *)data + 511 - 18 + y * width) && *((int32_t *)data + 511 - 18 + y * width) == *((int32_t *)data + 511 - 17 + y * width) && *((int32_t *)data + 511 - 17 + y * width) != *((int32_t *)data + 511 - 16 + y * width)) {
+                z++;
+            }
+        }
+        if(z >= 64 || (itemscorea > 64 && itemscoreb > 64 && itemscorec > 64 && itemscored > 64)) {
+            if(z >= 64 || uscore < 16) {
+                for(long long y = 0; y < 16; ++y) {
+                    memmove((char *)data + y * width * 4 + 16 * 4, (char *)data + y * width * 4 + 15 * 4, width * 4 - 16 * 4);
+                }
+            } else {
+                for(long long y = 15; y >= 0; --y) {
+                    memcpy((char *)data + (y + 1) * width * 4 + 16 * 4, (char *)data + y * width * 4 + 15 * 4, width * 4 - 16 * 4);
+                }
+            }
+            if(z >= 64) {
+                for(long long y = height - 2; y >= 16; --y) {
+                    memcpy((char *)data + (y + 1) * width * 4 + 16 * 4, (char *)data + y * width * 4 + 15 * 4, width * 4 - 16 * 4);
+                    memcpy((char *)data + (y + 1) * width * 4, (char *)data + y * width * 4, 16 * 4);
+                }
+            } else {
+                for(long long y = height - 2; y >= 16; --y) {
+                    memcpy((char *)data + (y + 1) * width * 4 + 4, (char *)data + y * width * 4 + 0, width * 4 - 4);
+                }
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+class Atlas {
+    std::mt19937 rng;
+
+public:
+    int width, height;
+    std::vector<uint32_t> px;
+
+    Atlas(int width, int height, unsigned seed, unsigned zeroPercent = 0) : rng(seed), width(width), height(height), px((size_t)width * height) {
+        for(auto &&p : px)
+            p = rng() % 100 < zeroPercent ? 0 : (rng() | 1);
+    }
+
+    uint32_t *row(int y) {
+        return px.data() + (size_t)y * width;
+    }
+
+    // Rows picked at random get the 4 duplicated pixels of a misaligned tile ending at column x + 3
+    void addRunEnds(int x, int count) {
+        std::vector<int> rows(height);
+        for(int y = 0; y < height; y++)
+            rows[y] = y;
+        std::shuffle(rows.begin(), rows.end(), rng);
+        for(int i = 0; i < count; i++) {
+            uint32_t *p = row(rows[i]) + x;
+            p[1] = p[2] = p[3] = p[0];
+            if(p[4] == p[0])
+                p[4] = p[0] + 2;
+        }
+    }
+
+    // Rows with only 3 duplicated pixels, which don't count
+    void addNearMisses(int x, int count) {
+        for(int y = 0; y < count; y++) {
+            uint32_t *p = row(y) + x;
+            if(p[0] == p[1] && p[1] == p[2] && p[2] == p[3])
+                continue;
+            p[1] = p[2] = p[0];
+            p[3] = p[0] + 2;
+        }
+    }
+
+    void setColumn(int x, int rows, uint32_t value) {
+        for(int y = 0; y < rows; y++)
+            row(height - 1 - y)[x] = value;
+    }
+
+    void clearRow(int y, int keep) {
+        for(int x = keep; x < width; x++)
+            row(y)[x] = 0;
+    }
+
+    // Applies both implementations to copies, expects the same result and returns whether the atlas was patched
+    bool check() {
+        std::vector<uint32_t> expected = px, actual = px;
+        bool expectedPatched = referenceApply(width, height, expected.data());
+        bool patched = TexturePatch::apply(width, height, actual.data());
+        EXPECT_EQ(patched, expectedPatched);
+        EXPECT_EQ(patched, expected != px);
+        EXPECT_TRUE(actual == expected) << width << "x" << height << " differs from the reference";
+        return patched;
+    }
+};
+
+}
+
+TEST(TexturePatchTest, BlockAtlas) {
+    for(unsigned seed = 0; seed < 6; seed++) {
+        Atlas plain(1024, 1024, seed);
+        ASSERT_FALSE(plain.check());
+        // Detection starts at exactly 64 rows
+        Atlas below(1024, 1024, seed);
+        below.addRunEnds(987, 63);
+        below.addNearMisses(987, 200);
+        ASSERT_FALSE(below.check());
+        Atlas detected(1024, 1024, seed);
+        detected.addRunEnds(987, 64 + seed * 100);
+        ASSERT_TRUE(detected.check());
+    }
+    Atlas transparent(1024, 1024, 7, 40);
+    transparent.addRunEnds(987, 300);
+    ASSERT_TRUE(transparent.check());
+}
+
+TEST(TexturePatchTest, WideAtlas) {
+    for(unsigned seed = 0; seed < 4; seed++) {
+        Atlas plain(2048, 1024, seed);
+        ASSERT_FALSE(plain.check());
+        Atlas detected(2048, 1024, seed);
+        uint32_t *p = detected.row(0) + 1024 + 989;
+        p[1] = p[0];
+        ASSERT_TRUE(detected.check());
+        // Three equal pixels aren't the end of the duplicated run
+        p[2] = p[0];
+        ASSERT_FALSE(detected.check());
+    }
+}
+
+TEST(TexturePatchTest, ItemAtlasRunEnds) {
+    for(unsigned seed = 0; seed < 6; seed++) {
+        Atlas below(512, 512, seed);
+        below.addRunEnds(511 - 20, 63);
+        below.addNearMisses(511 - 20, 200);
+        ASSERT_FALSE(below.check());
+        Atlas detected(512, 512, seed);
+        detected.addRunEnds(511 - 20, 64 + seed * 50);
+        ASSERT_TRUE(detected.check());
+    }
+}
+
+TEST(TexturePatchTest, ItemAtlasColumnScores) {
+    for(unsigned seed = 0; seed < 6; seed++) {
+        // Column 500 has to be empty in more than 64 rows
+        Atlas below(512, 512, seed);
+        below.setColumn(511 - 11, 64, 0);
+        ASSERT_FALSE(below.check());
+        Atlas detected(512, 512, seed);
+        detected.setColumn(511 - 11, 65 + seed * 40, 0);
+        ASSERT_TRUE(detected.check());
+        // An almost empty second row selects the other fix-up of the top rows
+        Atlas emptyRow(512, 512, seed);
+        emptyRow.setColumn(511 - 11, 65 + seed * 40, 0);
+        emptyRow.clearRow(1, 15);
+        ASSERT_TRUE(emptyRow.check());
+        Atlas fullRow(512, 512, seed);
+        fullRow.setColumn(511 - 11, 65 + seed * 40, 0);
+        fullRow.clearRow(1, 16);
+        ASSERT_TRUE(fullRow.check());
+        // Columns 497 to 499 have to be set in more than 64 rows
+        Atlas emptyColumn(512, 512, seed);
+        emptyColumn.setColumn(511 - 11, 200, 0);
+        emptyColumn.setColumn(511 - 12 - seed % 3, 512 - 64, 0);
+        ASSERT_FALSE(emptyColumn.check());
+    }
+    // Transparent pixels all over the atlas
+    for(unsigned zeroPercent : {5u, 30u, 60u, 90u})
+        Atlas(512, 512, zeroPercent, zeroPercent).check();
+}
+
+TEST(TexturePatchTest, OtherSizes) {
+    Atlas atlas(256, 256, 1);
+    atlas.addRunEnds(200, 256);
+    ASSERT_FALSE(atlas.check());
+}
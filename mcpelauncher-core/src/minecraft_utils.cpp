@@ -307,6 +307,7 @@ size_t MinecraftUtils::getLibraryBase(void* handle) {
 void MinecraftUtils::setupGLES2Symbols(void* (*resolver)(const char*)) {
     int i = 0;
     std::unordered_map<std::string, void*> syms;
+    syms.reserve(sizeof(glesv2_symbols) / sizeof(*glesv2_symbols));
     while(true) {
         const char* sym = glesv2_symbols[i];
         if(sym == nullptr)